@@ -1,7 +1,7 @@
 // pwalk.c - by Bob Sneed (Bob.Sneed@dell.com) - FREE CODE, based on prior work whose source
 // was previously distributed as FREE CODE.
 
-#define PWALK_VERSION "pwalk 2.10b1"	// See also: CHANGELOG
+#define PWALK_VERSION "pwalk 2.11b1"	// See also: CHANGELOG
 #define PWALK_SOURCE 1
 
 // --- DISCLAIMERS ---
@@ -93,9 +93,11 @@
 // One technique for identifying such files is to read the first 128 bytes of a file and calculate
 // its MD5 checksum. The resulting I/O workload is characteristically small-random-read in nature.
 //
-// When '+denist' specified, pwalk will read() the 1st 128 bytes of each ordinary file encountered.
-// This feature is for the sole purpose of benchmarking how long de-NISTing logic might run on a
-// given data set with a given degree on concurrency applied.
+// When '+denist' specified, pwalk will read() the 1st 128 bytes of each ordinary file encountered
+// and MD5 them.  Alone, that shows how long de-NISTing logic might run on a given data set with a
+// given degree of concurrency applied.  With '+denist=<hashlist>', those MD5s are looked up in a
+// NIST-style hash list, and matching files are tagged ' NIST' in -ls and -xml outputs.  These small
+// reads are run ahead of each worker's scan by helper threads (see pwalk_denist.h).
 
 // @@@ SECTION: Declarations @@@
 
@@ -141,6 +143,22 @@
 #include "pwalk_onefs.h"	// OneFS-specific logic
 #include "pwalk_report.h"	// Generic reporting
 #include "pwalk_sums.h"		// Checksum generators
+#include "pwalk_merge.h"		// -merge sorted output
+#include "pwalk_writer.h"		// -writers output threads
+#include "pwalk_dups.h"		// -dups duplicate-file finder
+#include "pwalk_cmp.h"		// -cmp pipelined content compare
+#include "pwalk_extents.h"	// SEEK_DATA/SEEK_HOLE extent maps
+#include "pwalk_denist.h"	// +denist read-ahead and hash list
+#include "pwalk_io.h"		// -io= page cache policy for content reads
+#include "pwalk_rmtree.h"	// -rm=tree bottom-up rmdir()
+#include "pwalk_trash.h"	// -trash moves into [target]
+#include "pwalk_tally.h"	// +tally_by= histograms
+#include "pwalk_rollup.h"	// +rollup subtree totals
+#include "pwalk_top.h"		// +top= heaps
+#include "pwalk_usage.h"	// +usage accounting
+#include "pwalk_lat.h"		// +lat histograms
+#include "pwalk_progress.h"	// SIGUSR1 & -progress= snapshots
+#include "pwalk_metrics.h"	// -metrics & -metrics_port exporter
 
 #if PWALK_ACLS			// POSIX ACL-handling logic only on Linux
 #include "pwalk_acls.h"
@@ -175,15 +193,16 @@
 #endif
 
 #define WORKER_OBUF_SIZE 32*1024	// Output buffer, per-worker
+#define WORKER_OUT_BUF_SIZE PO_BUF_SIZE	// WOUT formatting buffer, per-worker
 #define NUL '\0';
-#define PATHSEPCHR '/'			// Might make conditional for Windoze
-#define PATHSEPSTR "/"			// Might make conditional for Windoze
 #define SECS_PER_DAY 86400		// 24*60*60 = 86400
 
 // @@@ Forward declarations ...
-void fifo_push(char *p, struct stat *sb, int w_id);
+int fifo_push(char *p, struct stat *sb, int w_id);
 int fifo_pop(char *p);
 void directory_scan(int w_id);
+void worker_flush(int w_id);
+char *manifest_digest_name(void);
 void abend(char *msg);
 void *worker_thread(void *parg);
 
@@ -194,7 +213,20 @@ static int ABSPATH_MODE = 0;		// True when absolute paths used (FUTURE: eliminat
 static int Opt_IFSVAR = 0;		// Include .ifsvar dirs
 static int Opt_SNAPSHOTS = 0;		// Include .snapshot[s] dirs
 static int Opt_TSTAT = 0;		// Show timed statistics when +tstat used
+static int Opt_LAT = 0;			// +lat call latency histograms
 static int Opt_GZ = 0;			// gzip output streams when '-gz' used
+static int Opt_MERGE = 0;		// Path-sorted pwalk_merged.<ftype> output when '-merge' used
+static count_64 MERGE_MEM = 256*1024*1024;	// -merge=<bytes> in-memory run budget (all workers)
+static int N_WRITERS = 1;		// -writers=<N> threads writing worker outputs (0: workers write)
+static int FLUSH_SECS = 1;		// -flush=<secs> between worker output flushes (0: every directory)
+static int PROGRESS_SECS = 0;		// -progress=<secs> between progress snapshots (0: on SIGUSR1 only)
+static int Opt_METRICS = 0;			// -metrics[=<file>]
+static char *METRICS_FILE = NULL;		// ... default ${OUTPUT_DIR}/pwalk_metrics.prom
+static int METRICS_SECS = MT_DEFAULT_SECS;	// -metrics_secs=<secs>
+static int METRICS_PORT = 0;			// -metrics_port=<port> (on 127.0.0.1)
+static int N_SHARDS = 0;		// -shards=<N> output files per type, instead of per-worker files
+static count_64 SHARD_SIZE = 0;		// -shard_size=<bytes> rotation (0: none)
+static int SHARD_TIME = 0;		// -shard_time=<secs> rotation (0: none)
 static int Opt_REDACT = 0;		// Redact output (hex inodes instead of names)
 static int Opt_PMODE = 1;		// Show mode bits unless -pmode suppresses
 static int Opt_SPAN = 0;		// Include dirs that cross filesystems unless '+span'
@@ -203,8 +235,7 @@ static int P_ACL_P = 1;			// Show ACL as '+' always (because we know from st_fla
 #else
 static int P_ACL_P = 0;			// Show ACL as '+' when +acls specified
 #endif
-static int P_CRC32 = 0;			// Show CRC32 for -ls, -xml
-static int P_MD5 = 0;			// Show MD5 for -ls, -xml
+static int P_SUMS = 0;			// Show +crc, +md5, etc. digests (SUM_* bits) for -ls, -xml
 static int ST_BLOCK_SIZE = 1024;	// Units for statbuf->st_blocks (-bs=512 option to change)
 static struct {				// UID and EUID are different when pwalk is setuid root
    uid_t uid;
@@ -222,14 +253,27 @@ static int Cmd_CMP = 0;
 static int Cmd_CSV = 0;
 static int Cmd_AUDIT = 0;
 static int Cmd_RM = 0;
+static int Cmd_RM_TREE = 0;		// -rm=tree also removes emptied directories
 static int Cmd_FIXTIMES = 0;
 static int Cmd_TRASH = 0;
 static int Cmd_XML = 0;
+static int Cmd_DUPS = 0;
+static int Cmd_MANIFEST = 0;
+static count_64 DUPS_MIN_SIZE = 1;		// -dups=<min_bytes>
 
 // Secondary modes ...
 static int Cmd_DENIST = 0;			// +denist
+static char *DENIST_FILE = NULL;		// +denist=<hashlist> of MD5s to tag
+static int DENIST_DEPTH = DENIST_DEPTH_DEFAULT;	// -denist_depth=<n> helper threads per worker
+static int IO_POLICY = IO_BUFFERED;		// -io=<policy> for file content reads
+static count_64 IO_READAHEAD = 0;		// -io_readahead=<bytes>
 static int Cmd_RM_ACLS = 0;			// +rm_acls (OneFS only)
 static int Cmd_TALLY = 0;			// +tally
+static int Cmd_ROLLUP = 0;			// +rollup
+static int Cmd_TOP = 0;				// +top=
+static int Cmd_USAGE = 0;			// +usage[=top] (2 for =top)
+static char *DIR_ARGS[256];			// <directory> args, for dir_root()
+static int N_DIR_ARGS = 0;
 static int Cmd_WACLS = 0;			// +wacls=
 static int Cmd_XACLS = 0;			// +xacls= (Linux only) bitmask combo of ...
 #define Cmd_XACLS_BIN 1
@@ -243,11 +287,17 @@ static ino_t CWD_INODE;				// For -redact
 static char *SOURCE_ARG = NULL;  		// For -source= arg
 static char *TARGET_ARG = NULL;  		// For -target= arg
 static char *OUTPUT_ARG = ".";  		// For -output= arg
+static char *CSV_ARG = NULL;  		// For -csv=<fields> arg
+static time_t CSV_WALK_TIME;			// -csv walk_time; one for the whole walk
 static char OUTPUT_DIR[MAX_PATHLEN+1];		// Directory we'll create for output files
 static char *WACLS_CMD = NULL;  		// For +wacls= arg
 
 // For -cmp ...
-#define CMP_BUFFER_SIZE 128*1024		// -cmp buffer sizes
+static count_64 CMP_BUFFER_SIZE = CMP_BUFSIZE_DEFAULT;	// -cmp_bufsize=<bytes> read size (also -dups)
+static count_64 CMP_CHUNK_SIZE = CMP_CHUNK_DEFAULT;	// -cmp_chunk=<bytes>; bigger files compared in chunks (0: never)
+static char *CMP_CACHE_FILE = NULL;		// -cmp_cache=<file> of pairs verified equal
+static char *CMP_MANIFEST_FILE = NULL;		// -cmp=manifest:<file> stands in for -target=
+static int CMP_REVERIFY_PCT = 0;		// -cmp_reverify=<pct> of cache hits to compare anyway
 
 // For selection-related options ...
 static int SELECT_OPTIONS = 0;			// Any of the following -select option(s) specified ...
@@ -320,6 +370,8 @@ unsigned Workers_BUSY = 0;			// Also WDAT.status uses this mutex
 count_64 FIFO_PUSHES = 0;			// # pushes (increments in fifo_push())
 count_64 FIFO_POPS = 0;				// # pops (increments in fifo_pop())
 count_64 FIFO_DEPTH = 0;			// # FIFO_PUSHES - FIFO_POPS
+void (*WORKER_PHASE_F)(int w_id) = NULL;	// Post-walk work for all workers (see run_worker_phase())
+unsigned WORKER_PHASE_GEN = 0;			// ... its number; copied to WDAT.phase_gen when worker is done
 
 // LOGMSG mutex for serializaing access to pwalk.log (in LogMsg()) ...
 static pthread_mutex_t	LOGMSG_mutex;
@@ -436,18 +488,26 @@ usage(void)
    printf("	-lsd			// creates .ls outputs (directory subtotals *only)\n");
    printf("	-lsf			// creates .ls outputs (full pathnames, preceded by type)\n");
    printf("	-xml			// creates .xml outputs\n");
-   //printf("	-csv  (DEVELOPMENTAL!)	// creates .csv outputs based on -pfile= [csv] parms\n");
+   printf("	-csv[=<field_list>]	// creates .csv outputs of comma-separated fields (-csv=help lists them)\n");
    printf("	-cmp[=<keyword_list>]	// creates .cmp outputs based on stat(2) and binary compares\n");
+   printf("	NOTE: -cmp=manifest:<file>[,<keyword>...] compares with a -manifest file instead of -target=.\n");
 #if PWALK_AUDIT // OneFS only
    printf("	-audit			// creates .audit files based on OneFS SmartLock status\n");
 #endif // PWALK_AUDIT
    printf("	-fix_times		// creates .fix outputs (CAUTION: changes timestamps unless -dryrun!)\n");
    printf("	-rm			// creates .sh outputs (CAUTION: deletes files unless -dryrun!)\n");
-   //printf("	-trash (DEVELOPMENTAL!)	// creates .sh outputs (CAUTION: moves files unless -dryrun!)\n");
+   printf("	-rm=tree		// ... and also rmdir()s directories it empties, bottom-up\n");
+   printf("	-dups[=<min_bytes>]	// creates pwalk_dups.txt; duplicate-file groups (reads candidates!)\n");
+   printf("	-manifest		// creates pwalk_merged.manifest; metadata (and one +<digest>) for -cmp=manifest:\n");
+   printf("	-trash			// creates .trash outputs (CAUTION: moves files to -target= unless -dryrun!)\n");
    printf("	NOTE: When no <primary_mode> is specified, pwalk creates .out outputs.\n");
    printf("   <secondary_mode> is zero or more of:\n");
-   printf("	+denist			// read first 128 bytes of every file encountered\n");
+   printf("	+denist[=<hashlist>]	// MD5 first 128 bytes of every file; tag ' NIST' if in <hashlist>\n");
    printf("	+tally[=<tag>]		// output file/space tally to pwalk_tally.csv\n");
+   printf("	+rollup			// output cumulative subtree totals to pwalk_rollup.csv\n");
+   printf("	+usage[=top]		// output per-uid, per-gid (and per-uid x top-level dir) usage to pwalk_usage_*.csv\n");
+   printf("	+top=<N>:<metric>[,...]	// output top N by size,psize,mtime,atime,entries,depth to pwalk_top_<metric>.csv\n");
+   printf("	+tally_by=<dim>[+<dim>][,...] // ... also by uid,top,age,atime,ext,size to pwalk_tally_<dims>.csv\n");
 #if defined(__ONEFS__)
    printf("	+rm_acls		// DEVELOPMENTAL: also ... remove non-inherited ACEs in ACLs\n");
 #endif
@@ -458,8 +518,25 @@ usage(void)
    printf("   Main <option> values are:\n");
    printf("	-dop=<n>		// specifies the Degree Of Parallelism (max number of workers)\n");
    printf("	-gz			// gzip primary output files\n");
-   printf("	-dryrun			// suppress making any changes (with -fix_times & -rm)\n");
-   printf("	-pfile=<pfile>		// specify parameters for [source|target|output|select|csv]\n");
+   printf("	-merge[=<bytes>]	// also sort all outputs by path into one pwalk_merged.<ftype> (<bytes> of memory)\n");
+   printf("	-writers=<n>		// threads writing worker outputs (default 1; 0 = workers write directly)\n");
+   printf("	-flush=<secs>		// max seconds between worker output flushes (default 1; 0 = every directory)\n");
+   printf("	-progress=<secs>	// progress snapshot (also on SIGUSR1) to log and pwalk_progress.csv every <secs>\n");
+   printf("	-metrics[=<file>]	// write counters for Prometheus (default pwalk_metrics.prom in output dir) ...\n");
+   printf("	-metrics_secs=<secs>	// ... every <secs> (default %d)\n", MT_DEFAULT_SECS);
+   printf("	-metrics_port=<port>	// serve counters for Prometheus on 127.0.0.1:<port> while walking\n");
+   printf("	-shards=<n>		// write <n> shard-*.<ftype> files per output type instead of per-worker files\n");
+   printf("	-shard_size=<bytes>	// ... rotating to a new shard file after <bytes> (at a directory boundary)\n");
+   printf("	-shard_time=<secs>	// ... rotating to a new shard file after <secs>\n");
+   printf("	-cmp_bufsize=<bytes>	// -cmp (and +crc, etc.) content read size (default 1Mi; 64Ki-64Mi; %d read ahead on target)\n", CMP_DEPTH);
+   printf("	-cmp_chunk=<bytes>	// -cmp content of bigger files split into chunks for all workers (default 1Gi; 0 = never)\n");
+   printf("	-cmp_cache=<file>	// -cmp content skipped for pairs verified equal in earlier runs, and unchanged since\n");
+   printf("	-cmp_reverify=<pct>	// ... but still compare <pct>%% of those, at random\n");
+   printf("	-denist_depth=<n>	// +denist helper threads reading ahead, per worker (default %d; 0 = none)\n", DENIST_DEPTH_DEFAULT);
+   printf("	-io=<policy>		// file content reads: buffered (default), dontneed (drop from page cache), direct (bypass it)\n");
+   printf("	-io_readahead=<bytes>	// ... hint this much readahead past each read (default 0 = kernel's choice)\n");
+   printf("	-dryrun			// suppress making any changes (with -fix_times, -rm, & -trash)\n");
+   printf("	-pfile=<pfile>		// specify parameters for [source|target|output|select|csv] ([csv] implies -csv)\n");
    printf("	-output=<output_dir>	// output directory location; (default is $CWD)\n");
    printf("	-source=<source_dir>	// source directory; must be absolute path (default is $CWD)\n");
    printf("	-target=<target_dir>	// target directory; optional w/ -fix_times, required w/ -cmp!\n");
@@ -470,9 +547,13 @@ usage(void)
    printf("	-redact			// output hex inode #'s instead of names\n");
    printf("	-pmode			// suppress showing formatted mode bits (with -ls and -xml)\n");
    printf("	+acls			// show ACL info in some outputs, eg: '+' with -ls\n");
-   printf("	+crc			// show CRC for each file (READS ALL FILES!)\n");
-   printf("	+md5  (COMING SOON!)	// show MD5 for each file (READS ALL FILES!)\n");
+   printf("	+crc			// show CRC-32 (as gzip, zlib) for each file (READS ALL FILES!)\n");
+   printf("	+crc32c			// show CRC-32C (Castagnoli) for each file (READS ALL FILES!)\n");
+   printf("	+md5, +sha1, +sha256	// show MD5, SHA-1, SHA-256 for each file (READS ALL FILES!)\n");
+   printf("	+xxh64			// show XXH64 (fast, non-cryptographic) for each file (READS ALL FILES!)\n");
+   printf("				// ... any combination of these still reads each file only once\n");
    printf("	+tstat			// show hi-res timing statistics in some outputs\n");
+   printf("	+lat			// call latency percentiles (opendir, fstatat, pread, etc.) in pwalk.log, pwalk_lat.csv\n");
    printf("   File selection <option> values are implicitly AND'ed together:\n");
    printf("	+span			// include directories that span filesystems (OFF by default)\n");
    printf("	+.ifsvar		// include .ifsvar directories (OFF by default)\n");
@@ -532,7 +613,7 @@ worker_status(unsigned *nw_idle, unsigned *nw_busy, count_64 *fifo_depth)
       if (WDAT.status == BUSY) busy++;
    }
    assert(busy == Workers_BUSY);	// sanity check
-   depth = FIFO_DEPTH;
+   depth = FIFO_DEPTH + cmp_chunks_queued();	// Queued -cmp chunks are work, too
    MP_UNLOCK;								// --- MP lock ---
 
    if (nw_idle) *nw_idle = idle;
@@ -540,6 +621,34 @@ worker_status(unsigned *nw_idle, unsigned *nw_busy, count_64 *fifo_depth)
    if (fifo_depth) *fifo_depth = depth;
 }
 
+// progress_status() - Like worker_status(), but for progress snapshots: no MP lock, so
+// just a recent value of each.
+
+void
+progress_status(unsigned *nw_busy, count_64 *fifo_depth)
+{
+   *nw_busy = __atomic_load_n(&Workers_BUSY, __ATOMIC_RELAXED);
+   *fifo_depth = __atomic_load_n(&FIFO_DEPTH, __ATOMIC_RELAXED) + cmp_chunks_queued();
+}
+
+// metrics_status() - Worker and FIFO state for -metrics; like progress_status(), no MP lock.
+
+void
+metrics_status(MT_STATUS *st)
+{
+   wstatus_t wstatus;
+   int w_id;
+
+   for (w_id=0; w_id < N_WORKERS; w_id++) {
+      wstatus = __atomic_load_n(&WDAT.status, __ATOMIC_RELAXED);
+      if (wstatus >= EMBRYONIC && wstatus <= BUSY) st->workers[wstatus] += 1;
+   }
+   st->fifo_pushes = __atomic_load_n(&FIFO_PUSHES, __ATOMIC_RELAXED);
+   st->fifo_pops = __atomic_load_n(&FIFO_POPS, __ATOMIC_RELAXED);
+   st->fifo_depth = __atomic_load_n(&FIFO_DEPTH, __ATOMIC_RELAXED);
+   st->cmp_chunks = cmp_chunks_queued();
+}
+
 // LogMsg() - write to main output log stream (Plog); serialized by mutex, with a timestamp
 // being generated anytime more than a second has passed since the last output, with optional
 // force-flush of the log stream.
@@ -608,18 +717,41 @@ close_all_outputs(void)
 {
    char pw_acls_emsg[128] = "";
    int pw_acls_errno = 0;
-   int w_id, rc;
+   int w_id, rc, i;
+   WR_STATS_T wst;
 
-   // Output trailer[s] ...
-   if (Cmd_XML)
+   // Output trailer[s] (shard files get theirs from the writer) ...
+   if (Cmd_XML && !Opt_MERGE && !N_SHARDS)
       for (w_id=0; w_id<N_WORKERS; w_id++)
-         fprintf(WLOG, "\n</xml-listing>\n");
+         po_puts(WOUT, "\n</xml-listing>\n");
+
+   // Hand last buffers to writer thread(s) and wait for them to finish ...
+   if (N_WRITERS) {
+      for (w_id=0; w_id<N_WORKERS; w_id++) {
+         po_mark(WOUT);
+         po_drain(WOUT);
+         WOUT->ring = NULL;
+         for (i=0; i<WDAT.n_shard_aux; i++) {
+            fflush(WDAT.shard_aux_file[i]);
+            po_mark(WDAT.shard_aux_obuf[i]);
+            po_drain(WDAT.shard_aux_obuf[i]);
+            WDAT.shard_aux_obuf[i]->ring = NULL;
+         }
+      }
+      wr_finish(&wst);
+      fprintf(Plog, "@ -writers: %d thread%s, %d ring%s, %llu bytes in %llu writev() calls, %llu stall%s\n",
+         wst.nwriters, (wst.nwriters != 1) ? "s" : "", wst.nrings, (wst.nrings != 1) ? "s" : "",
+         wst.bytes, wst.writevs, wst.stalls, (wst.stalls != 1) ? "s" : "");
+      if (N_SHARDS)
+         fprintf(Plog, "@ -shards: %d shard file%s written\n", wst.shard_files, (wst.shard_files != 1) ? "s" : "");
+      fflush(Plog);
+   }
 
    // Close per-worker outputs ...
    for (w_id=0; w_id<N_WORKERS; w_id++) {
       // Close per-worker primary output WLOG file (iff open) ...
       if (WLOG) {			// Close worker log file/pipe ...
-         fflush(WLOG);
+         po_free(WOUT);
          if (Opt_GZ) {			// Close log stream ...
 #if defined(__OSX__)
             // OSX pwalk version has historically had issues with incomplete .gz outputs.
@@ -635,6 +767,8 @@ close_all_outputs(void)
          } else {
             fclose(WLOG);
          }
+      } else if (WDAT.wout.buf) {	// (-merge or -shards)
+         po_free(WOUT);
       }
 
       // Close per-worker error output WERR file (iff open) ...
@@ -655,7 +789,10 @@ close_all_outputs(void)
          pw_acl4_fwrite_binary(NULL, NULL, &(WDAT.WACLS_PIPE), 'p', pw_acls_emsg, &pw_acls_errno);
       }
       if (WDAT.XACLS_BIN_FILE) {
-         pw_acl4_fwrite_binary(NULL, NULL, &(WDAT.XACLS_BIN_FILE), 'o', pw_acls_emsg, &pw_acls_errno);
+         if (N_SHARDS && WR_HAVE_FOPEN)	// Shard files get the terminating zeroes
+            fclose(WDAT.XACLS_BIN_FILE);
+         else
+            pw_acl4_fwrite_binary(NULL, NULL, &(WDAT.XACLS_BIN_FILE), 'o', pw_acls_emsg, &pw_acls_errno);
       }
       if (WDAT.XACLS_CHEX_FILE) {
          fclose(WDAT.XACLS_CHEX_FILE);
@@ -685,6 +822,7 @@ abend(char *msg)
 
    fprintf(stderr, "%d: FATAL: %s\n", getpid(), msg);
    LogMsg(msg, 1);
+   wr_abend_flush();		// Writer thread(s) write out all worker output, and close shards
    //perror("");
    //close_all_outputs();
    kill(getpid(), SIGQUIT);	// dump core
@@ -801,6 +939,20 @@ fix_owner(FILE *file)
    fchown(fileno(file), USER.uid, USER.gid);
 }
 
+// worker_shard_fopen() - stdio stream into -shards outputs of <ftype>; it gets flushed
+// and marked at each directory end by worker_flush().
+
+FILE *
+worker_shard_fopen(int w_id, char *ftype)
+{
+   int i = WDAT.n_shard_aux;
+
+   assert(i < sizeof(WDAT.shard_aux_file)/sizeof(FILE *));
+   WDAT.shard_aux_file[i] = wr_fopen(ftype, WORKER_OUT_BUF_SIZE, &(WDAT.shard_aux_obuf[i]));
+   WDAT.n_shard_aux = i + 1;
+   return (WDAT.shard_aux_file[i]);
+}
+
 // worker_aux_create() - creates per-worker auxillary output files.
 // Passed-in ftype is filename suffix, eg: ".bin"
 
@@ -810,6 +962,13 @@ worker_aux_create(int w_id, FILE **pFILE, char *ftype)
    char ofile[MAX_PATHLEN+64];
    char emsg[128];
 
+   // With -shards, output goes to shard-*.<ftype> files via the writer thread(s) ...
+   if (N_SHARDS && WR_HAVE_FOPEN) {
+      *pFILE = worker_shard_fopen(w_id, ftype);
+      setvbuf(*pFILE, NULL, _IOFBF, WORKER_OBUF_SIZE);		// Fully-buffered
+      return;
+   }
+
    sprintf(ofile, "%s%cworker-%03d.%s", OUTPUT_DIR, PATHSEPCHR, w_id, ftype);
    *pFILE = fopen(ofile, "wx");					// O_EXCL create
    if (*pFILE == NULL) {
@@ -829,6 +988,14 @@ worker_err_create(int w_id)
 {
    char strbuf[MAX_PATHLEN+64];
 
+   // With -shards, errors go to shard-*.err files at each flush (see -flush=) ...
+   if (N_SHARDS && WR_HAVE_FOPEN) {
+      WDAT.werr = worker_shard_fopen(w_id, "err");
+      sprintf(strbuf, "@ Worker %d .err output goes to %s%cshard-*.err\n", w_id, OUTPUT_DIR, PATHSEPCHR);
+      LogMsg(strbuf, 1);
+      return(WDAT.werr);
+   }
+
    sprintf(strbuf, "%s%cworker-%03d.err", OUTPUT_DIR, PATHSEPCHR, w_id);
    WDAT.werr = fopen(strbuf, "wx");			// O_EXCL create
    if (WDAT.werr == NULL)
@@ -841,6 +1008,48 @@ worker_err_create(int w_id)
    return(WDAT.werr);
 }
 
+// primary_ftype() - Output file type is determined by <primary_mode>; NULL if none.
+
+char *
+primary_ftype(void)
+{
+   if (Cmd_LS | Cmd_LSC | Cmd_LSD | Cmd_LSF) return "ls";
+   else if (Cmd_XML) return "xml";
+   else if (Cmd_CMP) return "cmp";
+   else if (Cmd_AUDIT) return "audit";
+   else if (Cmd_FIXTIMES) return "fix";
+   else if (Cmd_RM) return "rm";
+   else if (Cmd_TRASH) return "trash";
+   else if (Cmd_CSV) return "csv";
+   else if (Cmd_MANIFEST) return "manifest";
+   else return NULL;
+}
+
+// output_headings() - Once-per-file headings for <primary_mode> outputs ...
+
+void
+output_headings(PW_OBUF *o)
+{
+   if (Cmd_XML) {
+      po_puts(o, "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"yes\" ?>\n\n");
+      po_puts(o, "<!DOCTYPE xml-listing [\n");
+      po_puts(o, "	<!ELEMENT directory (path,(file,error,warning)*,summary)>\n");
+      po_puts(o, "	<!ELEMENT path (#PCDATA)>\n");
+      po_puts(o, "	<!ELEMENT file (#PCDATA)>\n");
+      po_puts(o, "	<!ELEMENT error (#PCDATA)>\n");
+      po_puts(o, "	<!ELEMENT warning (#PCDATA)>\n");
+      po_puts(o, "	<!ELEMENT summary (#PCDATA)>\n");
+      po_puts(o, "]>\n\n");
+      po_puts(o, "<xml-listing>\n\n");
+   } else if (Cmd_CSV) {
+      po_commit(o, csv_format_header(po_reserve(o, CSV_ROW_MAX)));
+   } else if (Cmd_MANIFEST) {
+      po_puts(o, CMP_MANIFEST_MAGIC);
+      po_puts(o, manifest_digest_name());
+      po_putc(o, '\n');
+   }
+}
+
 // worker_log_create() - creates per-worker <primary_mode> output file.
 
 // Create a buffered output stream WDAT.wlog, which will be referred to by the macro
@@ -855,14 +1064,21 @@ worker_log_create(int w_id)
 
    // Create ${OUTPUT_DIR}/worker%03d.{ls,xml,cmp,audit,fix,rm,csv}[.gz] ...
    // Output type is determined by <primary_mode>, or '.out' otherwise
-   if (Cmd_LS | Cmd_LSC | Cmd_LSD | Cmd_LSF) ftype = "ls";
-   else if (Cmd_XML) ftype = "xml";
-   else if (Cmd_CMP) ftype = "cmp";
-   else if (Cmd_AUDIT) ftype = "audit";
-   else if (Cmd_FIXTIMES) ftype = "fix";
-   else if (Cmd_RM) ftype = "rm";
-   else if (Cmd_CSV) ftype = "csv";
-   else return;			// Nothing to do!
+   if ((ftype = primary_ftype()) == NULL) return;	// Nothing to do!
+
+   // With -merge, WOUT holds each directory's output until merge_put_block() takes it ...
+   if (Opt_MERGE) {
+      po_init(WOUT, NULL, WORKER_OUT_BUF_SIZE);
+      WOUT->hold = 1;
+      return;
+   }
+
+   // With -shards, WOUT drains to shard-*.<ftype> files, which get their own headings ...
+   if (N_SHARDS) {
+      po_init(WOUT, NULL, WORKER_OUT_BUF_SIZE);
+      WOUT->ring = wr_ring_open(-1, ftype, WORKER_OUT_BUF_SIZE, WOUT);
+      return;
+   }
 
    if (Opt_GZ) {		// WARNING: gzip-piped output hangs on OSX!
       sprintf(ofile, "gzip > %s%cworker-%03d.%s.gz", OUTPUT_DIR, PATHSEPCHR, w_id, ftype);
@@ -876,21 +1092,14 @@ worker_log_create(int w_id)
    fix_owner(WLOG);
 
    // Give each output stream a decent buffer size ...
+   // NOTE: Primary output is formatted into WOUT, which drains to WLOG in large chunks.
    setvbuf(WLOG, NULL, _IOFBF, WORKER_OBUF_SIZE);		// Fully-buffered
+   po_init(WOUT, WLOG, WORKER_OUT_BUF_SIZE);
+   if (N_WRITERS)						// ... or bypass stdio for writer thread(s)
+      WOUT->ring = wr_ring_open(fileno(WLOG), NULL, WORKER_OUT_BUF_SIZE, WOUT);
 
    // Output headings ...
-   if (Cmd_XML) {
-      fprintf(WLOG, "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"yes\" ?>\n\n");
-      fprintf(WLOG, "<!DOCTYPE xml-listing [\n");
-      fprintf(WLOG, "	<!ELEMENT directory (path,(file,error,warning)*,summary)>\n");
-      fprintf(WLOG, "	<!ELEMENT path (#PCDATA)>\n");
-      fprintf(WLOG, "	<!ELEMENT file (#PCDATA)>\n");
-      fprintf(WLOG, "	<!ELEMENT error (#PCDATA)>\n");
-      fprintf(WLOG, "	<!ELEMENT warning (#PCDATA)>\n");
-      fprintf(WLOG, "	<!ELEMENT summary (#PCDATA)>\n");
-      fprintf(WLOG, "]>\n\n");
-      fprintf(WLOG, "<xml-listing>\n\n");
-   }
+   output_headings(WOUT);
 }
 
 // @@@ SECTION: Initializations @@@
@@ -1099,6 +1308,35 @@ str_ends_with(char *str, char ch)
    return(0);
 }
 
+// dir_root() - For +tally_by=top, +top=depth, and +usage=top: how much of <relpathdir> is
+// the longest <directory> argument that is it or a parent of it (*root_len; 0 if none), and
+// how much runs through the first component below that (*top_len; all of it if none).
+
+static void
+dir_root(const char *relpathdir, size_t *root_len, size_t *top_len)
+{
+   const char *p, *s;
+   size_t len, best = 0;
+   int i, found = 0;
+
+   for (i = 0; i < N_DIR_ARGS; i++) {
+      len = strlen(DIR_ARGS[i]);
+      if (len < best || strncmp(relpathdir, DIR_ARGS[i], len) != 0) continue;
+      if (relpathdir[len] == '\0' || relpathdir[len] == PATHSEPCHR ||
+          (len && DIR_ARGS[i][len-1] == PATHSEPCHR)) {
+         best = len;
+         found = 1;
+      }
+   }
+   *root_len = best;
+   p = relpathdir + best;
+   if (found) {
+      while (*p == PATHSEPCHR) p++;
+      s = strchr(p, PATHSEPCHR);
+      *top_len = s ? (size_t) (s - relpathdir) : strlen(relpathdir);
+   } else *top_len = strlen(relpathdir);
+}
+
 // str_dump() - formats passed string into buffer with non-printables escaped in octal ...
 char *
 str_dump(char *str, char *dump)
@@ -1258,6 +1496,49 @@ setup_root_path(char **dirpath_p, int *dfd_out, ino_t *inode_out)
    if (PWdebug) fprintf(Plog, "DEBUG: setup_root_path(\"%s\") inode=%lld\n", dirpath, st.st_ino);
 }
 
+// dir_under_roots() - Is the directory open as <dfd> one of the <n> directories open as
+// <roots>, or anywhere below one?  Walks up by "..", comparing (st_dev, st_ino), so it can't
+// be fooled by symlinks or paths spelled differently.
+
+static int
+dir_under_roots(int dfd, int *roots, int n)
+{
+   struct stat st, pst, rst;
+   int fd, pfd, i, under = FALSE;
+
+   if ((fd = dup(dfd)) < 0) return (FALSE);
+   while (!under && fstat(fd, &st) == 0) {
+      for (i = 0; i < n; i++)
+         if (fstat(roots[i], &rst) == 0 && rst.st_dev == st.st_dev && rst.st_ino == st.st_ino) under = TRUE;
+      if (under || (pfd = openat(fd, "..", O_RDONLY)) < 0) break;
+      if (fstat(pfd, &pst) || (pst.st_dev == st.st_dev && pst.st_ino == st.st_ino)) {	// At "/"
+         close(pfd);
+         break;
+      }
+      close(fd);
+      fd = pfd;
+   }
+   close(fd);
+   return (under);
+}
+
+// trash_check_dirarg() - Exit if the -trash target is <directory> arg <dirarg> (relative to
+// the source path, as the walk will open it) or anywhere below it.
+
+static void
+trash_check_dirarg(const char *dirarg)
+{
+   int dfd, under;
+
+   if ((dfd = openat(SOURCE_DFDS[0], dirarg, O_RDONLY)) < 0) return;	// The walk will report it
+   under = dir_under_roots(TARGET_DFDS[0], &dfd, 1);
+   close(dfd);
+   if (under) {
+      fprintf(Plog, "ERROR: -trash target path cannot be inside <directory> \"%s\"!\n", dirarg);
+      exit(-1);
+   }
+}
+
 // @@@ Parser for -pfile= contents @@@
 
 #define RELOP_NULL 0
@@ -1391,9 +1672,9 @@ parse_pfile(char *parfile)
    count_64 i64val;
    char *p, *buf, *line, *next, *errstr = "";
    struct stat sb;
-   int got_target = 0, got_source = 0, got_output = 0, got_select = 0, got_tally = 0;;
+   int got_target = 0, got_source = 0, got_output = 0, got_select = 0, got_tally = 0, got_csv = 0;
    int dfd;	// directory file descriptor
-   enum { NONE, TARGET, SOURCE, SELECT, OUTPUT, TALLY } section = NONE;
+   enum { NONE, TARGET, SOURCE, SELECT, OUTPUT, TALLY, CSV } section = NONE;
 
    // Read -pfile=<file> and process entirely into memory ...
    fd = open(parfile, O_RDONLY);
@@ -1436,6 +1717,10 @@ parse_pfile(char *parfile)
             Cmd_TALLY = 1;
             N_TALLY_BUCKETS = 0;
             bzero(&TALLY_BUCKET_SIZE, sizeof(TALLY_BUCKET_SIZE));
+         } else if (strcasecmp(line, "[csv]") == 0) {
+            if (got_csv) { errstr = "Only one %s section is allowed!\n"; goto error; }
+            got_csv = 1; section = CSV;
+            Cmd_CSV = 1;				// [csv] implies -csv
          } else {
             errstr = "-pfile= content invalid: \"%s\"\n";  goto error;
          }
@@ -1474,6 +1759,10 @@ parse_pfile(char *parfile)
                } else {
                   TALLY_BUCKET_SIZE[N_TALLY_BUCKETS++] = i64val;
                }
+               break;
+            case CSV:						// One field per line: <name> [<format>]
+               csv_field_add(line);
+               break;
             }
          }
    }
@@ -1489,7 +1778,7 @@ error:
 
 // @@@ SECTION: pwalk -fix_times support @@@
 
-// NOTE: w_id is passed-in for WLOG macro, as this operates in an MT context ...
+// NOTE: w_id is passed-in for WOUT macro, as this operates in an MT context ...
 // If no target paths specified, return 0
 // If target exists and has value mtime, return 1 and populate passed statbuf struct.
 
@@ -1745,7 +2034,7 @@ pwalk_fix_times(char *filename, char *filepath, struct stat *ssbp, int w_id)
    strcpy(mtime_epoch_str, format_epoch_ts(&(ssbp->st_mtimespec)));
    strcpy(ctime_epoch_str, format_epoch_ts(&(ssbp->st_ctimespec)));
    strcpy(btime_epoch_str, format_epoch_ts(&(ssbp->st_birthtimespec)));
-   fprintf(WLOG, "# %c%s %s \"%s\" a=%s m=%s c=%s b=%s%s\n",
+   po_printf(WOUT, "# %c%s %s \"%s\" a=%s m=%s c=%s b=%s%s\n",
       ftype, touch_strategy,
       bad_time_str,
       filename,
@@ -1763,14 +2052,14 @@ pwalk_fix_times(char *filename, char *filepath, struct stat *ssbp, int w_id)
    // COMMAND #1: touch [-A [-][[hh]mm]SS] [-acfhm] [-r file] [-t [[CC]YY]MMDDhhmm[.SS]] file ...
    localtime_r((time_t *) &(ts_ttime[0].tv_sec), &touch_t_tm);
    strftime(touch_t_str, sizeof (touch_t_str) - 1, "%G%m%d%H%M.%S", &touch_t_tm);
-   fprintf(WLOG, "touch -%s -t %s \"%s\"\n", atime_OK ? "mc" : "amc", touch_t_str, filepath);
+   po_printf(WOUT, "touch -%s -t %s \"%s\"\n", atime_OK ? "mc" : "amc", touch_t_str, filepath);
 
    // COMMAND #2: touch3 <info> <atime> <mtime> <btime> <ifs_pathname> ...
    // NOTE: pwalk_create_target depends on these 'touch3' commands ...
    strcpy(atime_epoch_str, atime_OK ? "-" : format_epoch_ts(&ts_ttime[0]));
    strcpy(mtime_epoch_str, mtime_OK ? "-" : format_epoch_ts(&ts_ttime[1]));
    strcpy(btime_epoch_str, btime_OK ? "-" : format_epoch_ts(&ts_ttime[2]));
-   fprintf(WLOG, "touch3 %c%s %s %s %s \"%s\"\n",
+   po_printf(WOUT, "touch3 %c%s %s %s %s \"%s\"\n",
       ftype, touch_strategy,
       atime_epoch_str,
       mtime_epoch_str,
@@ -1796,10 +2085,40 @@ pwalk_fix_times(char *filename, char *filepath, struct stat *ssbp, int w_id)
          if (ftype != 'l') rc = utimes(filepath, tv_ttime);
          else		rc = lutimes(filepath, tv_ttime);
       }
-      if (rc) fprintf(WLOG, "# FAILED!\n");
+      if (rc) po_printf(WOUT, "# FAILED!\n");
    }
 }
-// @@@ SECTION: pwalk -cmp support @@@
+// @@@ SECTION: pwalk -manifest support @@@
+
+// manifest_digest_name() - The one +<digest> a -manifest records, or "none".
+
+char *
+manifest_digest_name(void)
+{
+   int i;
+
+   for (i=0; i<SUM_NALGS; i++) if (P_SUMS & (1 << i)) return ((char *) SUM_NAMES[i]);
+   return ("none");
+}
+
+// manifest_put() - One -manifest <record> line (format in pwalk_cmp.c), after <prefix>.
+// NOTE: klooge: names containing newlines would break the line format (as with -ls).
+
+void
+manifest_put(PW_OBUF *o, char *prefix, struct stat *sb, char *digest, char *name)
+{
+   unsigned long flags = 0;
+
+#if HAVE_STRUCT_STAT_ST_FLAGS
+   flags = sb->st_flags;
+#endif
+   po_printf(o, "%s%o %u %u %lld %lld %lld %lld %lld %lu %s %s\n", prefix, (unsigned) sb->st_mode,
+      (unsigned) sb->st_uid, (unsigned) sb->st_gid, (long long) sb->st_size, (long long) sb->st_blocks,
+      (long long) sb->st_atime, (long long) sb->st_mtime, (long long) sb->st_birthtime, flags,
+      digest ? digest : "-", name);
+}
+
+// @@@ SECTION: pwalk -cmp support @@@
 
 // KEYWORD   C  MASK VALUE
 // -------------------------
@@ -1817,6 +2136,7 @@ pwalk_fix_times(char *filename, char *filepath, struct stat *ssbp, int w_id)
 // mtime     m  CMP_mtime
 // birthtime b  CMP_birthtime
 // content   C  CMP_content
+// <always>  X  CMP_extra (name only in TARGET; never for directories)
 
 #define CMP_equal     0x00000000
 #define CMP_error     0x00000001
@@ -1832,6 +2152,14 @@ pwalk_fix_times(char *filename, char *filepath, struct stat *ssbp, int w_id)
 #define CMP_mtime     0x00000400
 #define CMP_birthtime 0x00000800
 #define CMP_content   0x00001000
+#define CMP_extra     0x00002000
+#define CMP_chunked   0x80000000	// (internal) content compare queued as chunks; never shown
+#define CMP_cachekey  0x40000000	// (internal) -cmp_cache key valid; add it if verified equal
+#define CMP_reverify  0x20000000	// (internal) ... and it is a cache hit being re-verified
+#define CMP_internal  0xf0000000
+#if !defined(DTTOIF)
+#define DTTOIF(dt) ((dt) << 12)		// d_type to st_mode type bits
+#endif
 
 static int cmp_Check = CMP_notfound | CMP_type;	// Always check existence and type
 static struct {					// For -cmp= keyword parse into cmp_Check
@@ -1854,6 +2182,7 @@ static struct {					// For -cmp= keyword parse into cmp_Check
    { "mtime",     'm', CMP_mtime     },
    { "birthtime", 'b', CMP_birthtime },
    { "content",   'C', CMP_content   },
+   { "",          'X', CMP_extra     },
    { NULL,        0,   0             }
 };
 
@@ -1873,6 +2202,11 @@ cmp_arg_parse(char *argstr)
 
    p = p0 = words;
    while ((p-p0) < len) {		// for each passwd kw
+      if (strncmp(p, "manifest:", 9) == 0 && p[9]) {	// Not a check; where TARGET comes from
+         CMP_MANIFEST_FILE = strdup(p+9);
+         p += strlen(p) + 1;
+         continue;
+      }
       for (i=0; ; i++) {		// for each value kw
          if (cmp_Keywords[i].keyword == NULL) {
             fprintf(Plog, "FATAL: Invalid -cmp= keyword: \"%s\"\n", p);
@@ -1885,134 +2219,389 @@ cmp_arg_parse(char *argstr)
    }
 }
 
+// worker_read_bufs() - Allocate worker's read buffers (if not previously allocated), for
+// -cmp, -dups, and +crc, etc.  They are IO_ALIGN-aligned where -io=direct can use them.
+// NOTE: These buffers will NEVER BE FREE'D!  The pointers to these buffers are persisted in the WorkerData[]
+// data structure.
+
+void
+worker_read_bufs(int w_id)
+{
+#if defined(__LINUX__) || defined(__ONEFS__)
+   // Where possible, use well-aligned allocations ...
+   //	int posix_memalign(void **memptr, size_t alignment, size_t size);
+   if (WorkerData[w_id].SOURCE_BUF_P == NULL)
+      assert (posix_memalign(&WorkerData[w_id].SOURCE_BUF_P, 4096, CMP_BUFFER_SIZE) == 0);
+   if (WorkerData[w_id].TARGET_BUF_P == NULL)
+      assert (posix_memalign(&WorkerData[w_id].TARGET_BUF_P, 4096, CMP_BUFFER_SIZE) == 0);
+#else
+   if (WorkerData[w_id].SOURCE_BUF_P == NULL)
+      assert ((WorkerData[w_id].SOURCE_BUF_P = malloc(CMP_BUFFER_SIZE)) != NULL);
+   if (WorkerData[w_id].TARGET_BUF_P == NULL)
+      assert ((WorkerData[w_id].TARGET_BUF_P = malloc(CMP_BUFFER_SIZE)) != NULL);
+#endif
+}
+
 // cmp_files() - Open SOURCE and TARGET versions of pathname to do READONLY compare.
+// Files bigger than one buffer go through cmp_range(), which reads both sides at once
+// (and skips holes the two have in common).
 
 int
-cmp_files(int w_id, char *relpath)
+cmp_files(int w_id, char *relpath, off_t size)
 {
    int fds = -1, fdt = -1;
    int rc = -1;		// Default is "files not equal"
-   int src_bytes, tgt_bytes;
+   int src_bytes, tgt_bytes, diff;
    char *src_buf, *tgt_buf;
-   struct stat source_sb, target_sb;
    char *relpath_str;
+   off_t nbytes = 0, holes = 0;
+   long long t0, t_lat;
 
    if (PWdebug) {
       relpath_str = relpath;								// default
       if (relpath[0] == '.' && relpath[1] == PATHSEPCHR) relpath_str = relpath + 2;	// strip '.', if present)
-      fprintf(WLOG, "cmp_files(s): %s%c%s\n", SOURCE_PATH(w_id), PATHSEPCHR, relpath_str);
-      fprintf(WLOG, "cmp_files(t): %s%c%s\n", TARGET_PATH(w_id), PATHSEPCHR, relpath_str);
+      po_printf(WOUT, "cmp_files(s): %s%c%s\n", SOURCE_PATH(w_id), PATHSEPCHR, relpath_str);
+      po_printf(WOUT, "cmp_files(t): %s%c%s\n", TARGET_PATH(w_id), PATHSEPCHR, relpath_str);
    }
 
+   t0 = gethrtime();
+   WS[w_id]->CMP_Content_Files += 1;
+
    // Open both files ...
-   if ((fds = openat(SOURCE_DFD(w_id), relpath, O_RDONLY|O_NOFOLLOW|O_OPENLINK)) < 0) goto out;
-   if ((fdt = openat(TARGET_DFD(w_id), relpath, O_RDONLY|O_NOFOLLOW|O_OPENLINK)) < 0) goto out;
+   // NOTE: io_open() also advises sequential reading, unless -io=direct ...
+   if ((fds = io_open(SOURCE_DFD(w_id), relpath, IO_CMP)) < 0) goto out;
+   if ((fdt = io_open(TARGET_DFD(w_id), relpath, IO_CMP)) < 0) goto out;
 
    // ==== klooge: test to assure source and target not same file?
 
-   // Optimize sequential reading and page cache usage (klooge: would OSX fcntl() help?) ...
-#if !defined(__OSX__)
-   posix_fadvise(fds, 0L, 0L, POSIX_FADV_SEQUENTIAL|POSIX_FADV_DONTNEED);
-   posix_fadvise(fdt, 0L, 0L, POSIX_FADV_SEQUENTIAL|POSIX_FADV_DONTNEED);
-#endif
-
-   // Allocate read buffers (if not previously allocated) ...
-   // NOTE: These buffers will NEVER BE FREE'D!  The pointers to these buffers are persisted in the WorkerData[]
-   // data structure.
-#if defined(__LINUX__) || defined(__ONEFS__)
-   // Where possible, use well-aligned allocations ...
-   //	int posix_memalign(void **memptr, size_t alignment, size_t size);
-   if (WorkerData[w_id].SOURCE_BUF_P == NULL)
-      assert (posix_memalign(&WorkerData[w_id].SOURCE_BUF_P, 4096, CMP_BUFFER_SIZE) == 0);
-   if (WorkerData[w_id].TARGET_BUF_P == NULL)
-      assert (posix_memalign(&WorkerData[w_id].TARGET_BUF_P, 4096, CMP_BUFFER_SIZE) == 0);
-#else
-   assert ((WorkerData[w_id].SOURCE_BUF_P = malloc(CMP_BUFFER_SIZE)) != NULL);
-   assert ((WorkerData[w_id].TARGET_BUF_P = malloc(CMP_BUFFER_SIZE)) != NULL);
-#endif
-
+   worker_read_bufs(w_id);
    src_buf = WorkerData[w_id].SOURCE_BUF_P;
    tgt_buf = WorkerData[w_id].TARGET_BUF_P;
 
-   // Read and compare files ...
+   // Big files: pipelined, with target read-ahead overlapping source reads ...
+   if (size > CMP_BUFFER_SIZE) {
+      rc = (cmp_range(w_id, fds, fdt, src_buf, 0, -1, &nbytes, &holes) == 0) ? 0 : -1;
+      WS[w_id]->CMP_Content_Holes += holes;
+      goto out;
+   }
+
+   // Small files: read and compare files ...
    while (1) {
-       src_bytes = read(fds, src_buf, CMP_BUFFER_SIZE);
-       tgt_bytes = read(fdt, tgt_buf, CMP_BUFFER_SIZE);
+       src_bytes = io_pread(fds, src_buf, CMP_BUFFER_SIZE, nbytes, IO_CMP);
+       tgt_bytes = io_pread(fdt, tgt_buf, CMP_BUFFER_SIZE, nbytes, IO_CMP);
        if ((src_bytes == 0) && (tgt_bytes == 0)) { rc = 0; goto out; }	// Both @ EOF w/ zero difference!
        if (src_bytes != tgt_bytes) goto out;				// WTF?
        if (src_bytes <= 0) goto out;					// WTF?
-       if (memcmp(src_buf, tgt_buf, src_bytes)) goto out;		// Explicitly different!
+       nbytes += src_bytes;
+       LAT_BEGIN(t_lat);
+       diff = memcmp(src_buf, tgt_buf, src_bytes);
+       LAT_END(LAT_MEMCMP, t_lat);
+       if (diff) goto out;						// Explicitly different!
    }
    // Close files as we leave ...
 out:
-   if (fds >= 0) close(fds);
-   if (fdt >= 0) close(fdt);
+   if (fds >= 0) io_close(fds);
+   if (fdt >= 0) io_close(fdt);
+   if (rc) WS[w_id]->CMP_Content_Diffs += 1;
+   WS[w_id]->CMP_Content_Bytes += nbytes;
+   WS[w_id]->CMP_Content_ns += gethrtime() - t0;
    return rc;
 }
 
-// cmp_source_target() - Compare SOURCE with TARGET dir or file. w_id is needed to drive multi-pathing
-// logic for compare operations. We assume output cmp_compare_result_str is at least 16 bytes.
+// cmp_result_format() - Result string from cmp_result mask; at least 16 bytes.
 
 void
-cmp_source_target(int w_id, char *relpath, struct stat *src_sb_p, char *cmp_compare_result_str)
+cmp_result_format(unsigned cmp_result, char *cmp_compare_result_str)
 {
-   int i, rc;
-   struct stat target_sb;
-   struct stat *tgt_sb_p = &target_sb;;
    char *pstr = cmp_compare_result_str;
-   unsigned cmp_result = CMP_equal;	// Start with 0
+   int i;
+
+   memset(cmp_compare_result_str, 0, 16);	// Start w/ all NULs
+   for (i=0; cmp_Keywords[i].keyword; i++)
+      if (cmp_result&cmp_Keywords[i].maskval) *pstr++ = cmp_Keywords[i].code;
+   if ((cmp_result&~CMP_internal) == CMP_equal) strcpy(cmp_compare_result_str, "-");
+}
+
+// cmp_cache_result() - Content compare of a pair done; remember if verified equal, and
+// count re-verify results.
+
+void
+cmp_cache_result(int w_id, unsigned cmp_result, CMP_KEY *cache_key)
+{
+   if (!(cmp_result&CMP_cachekey)) return;
+   if (cmp_result&CMP_reverify) {
+      WS[w_id]->CMP_Cache_Reverified += 1;
+      if (cmp_result&CMP_content) WS[w_id]->CMP_Cache_Mismatches += 1;	// Changed w/o metadata change!
+   }
+   if (!(cmp_result&CMP_content)) cmp_cache_add(w_id, cache_key);
+}
+
+// cmp_digest() - Digest SOURCE file <relpath> with the algorithm named in a manifest's
+// "<alg>=<hex>" <digest>, and compare; <size> bytes are expected.  Returns 0 if equal.
+
+int
+cmp_digest(int w_id, char *relpath, off_t size, const char *digest)
+{
+   char str[SUM_STR_MAX];
+   SUM_VALUES v;
+   SUM_STATS st;
+   size_t len;
+   int fd, alg, rc = -1;
+   long long t0;
+
+   t0 = gethrtime();
+   WS[w_id]->CMP_Content_Files += 1;
+   memset(&st, 0, sizeof(st));
+   if (digest == NULL) goto out;		// Not recorded; cannot be verified
+   for (alg = 0; alg < SUM_NALGS; alg++) {
+      len = strlen(SUM_NAMES[alg]);
+      if (strncmp(digest, SUM_NAMES[alg], len) == 0 && digest[len] == '=') break;
+   }
+   if (alg == SUM_NALGS) goto out;
+   if ((fd = io_open(SOURCE_DFD(w_id), relpath, IO_SUMS)) < 0) goto out;
+   worker_read_bufs(w_id);
+   if (sums_file(fd, WorkerData[w_id].SOURCE_BUF_P, CMP_BUFFER_SIZE, 1 << alg, &v, &st) == size) {
+      sums_format(str, 1 << alg, &v);
+      rc = strcmp(str + 1, digest) ? -1 : 0;	// Skip the leading ' '
+   }
+   io_close(fd);
+out:
+   if (rc) WS[w_id]->CMP_Content_Diffs += 1;
+   WS[w_id]->CMP_Content_Bytes += st.read_bytes;
+   WS[w_id]->CMP_Content_ns += gethrtime() - t0;
+   return rc;
+}
+
+// cmp_metadata() - Compare SOURCE <src_sb_p> with TARGET <tgt_sb_p>, which is either from
+// a stat() or recorded in a manifest along with a <digest> for its content.  w_id is needed
+// to drive multi-pathing logic for content compares.  We assume output cmp_compare_result_str
+// is at least 16 bytes.  Returns the cmp_result mask; with CMP_chunked set, the content
+// compare is still to come (see cmp_chunk_file()), and the string is not yet final.  With
+// -cmp_cache=, *cache_key gets the pair's key for a regular-file content compare.
 
-   rc = fstatat(TARGET_DFD(w_id), relpath, &target_sb, AT_SYMLINK_NOFOLLOW);
+unsigned
+cmp_metadata(int w_id, char *relpath, struct stat *src_sb_p, struct stat *tgt_sb_p, const char *digest,
+   char *cmp_compare_result_str, CMP_KEY *cache_key)
+{
+   int rc = CMP_CACHE_MISS;
+   unsigned cmp_result = CMP_equal;	// Start with 0
 
    // Construct result mask ...
-   if (rc != 0) {
-      cmp_result |= CMP_notfound;
-      if (errno != ENOENT) {		// ==== klooge: add WARNING to worker's count!
-          fprintf(Plog, "WARNING: fstatat(target, \"%s\") errno=%d\n", relpath, errno);
-          cmp_result |= CMP_error;
-      }
-   } else {
-      if ((src_sb_p->st_mode&S_IFMT) != (tgt_sb_p->st_mode&S_IFMT)) cmp_result |= CMP_type;
-      if ((cmp_Check&CMP_mode) && ((src_sb_p->st_mode&07777) != (tgt_sb_p->st_mode&07777))) cmp_result |= CMP_mode;
+   if ((src_sb_p->st_mode&S_IFMT) != (tgt_sb_p->st_mode&S_IFMT)) cmp_result |= CMP_type;
+   if ((cmp_Check&CMP_mode) && ((src_sb_p->st_mode&07777) != (tgt_sb_p->st_mode&07777))) cmp_result |= CMP_mode;
 #if HAVE_STRUCT_STAT_ST_FLAGS
-      if ((cmp_Check&CMP_flags) && (src_sb_p->st_flags != tgt_sb_p->st_flags)) cmp_result |= CMP_flags;
+   if ((cmp_Check&CMP_flags) && (src_sb_p->st_flags != tgt_sb_p->st_flags)) cmp_result |= CMP_flags;
 #endif
-      if ((cmp_Check&CMP_uid) && (src_sb_p->st_uid != tgt_sb_p->st_uid)) cmp_result |= CMP_uid;
-      if ((cmp_Check&CMP_gid) && (src_sb_p->st_gid != tgt_sb_p->st_gid)) cmp_result |= CMP_gid;
-      if ((cmp_Check&CMP_atime) && (src_sb_p->st_atime != tgt_sb_p->st_atime)) cmp_result |= CMP_atime;
-      if ((cmp_Check&CMP_mtime) && (src_sb_p->st_mtime != tgt_sb_p->st_mtime)) cmp_result |= CMP_mtime;
-      if ((cmp_Check&CMP_birthtime) && (src_sb_p->st_birthtime != tgt_sb_p->st_birthtime)) cmp_result |= CMP_birthtime;
-      if (!(cmp_result&CMP_type) && S_ISREG(src_sb_p->st_mode)) {	// Only for regular files ...
-         if ((cmp_Check&CMP_size) && (src_sb_p->st_size != tgt_sb_p->st_size)) cmp_result |= CMP_size;
-         if ((cmp_Check&CMP_blocks) && (src_sb_p->st_blocks != tgt_sb_p->st_blocks)) cmp_result |= CMP_blocks;
-         if (cmp_Check&CMP_content) {
-            if (cmp_result&(CMP_size|CMP_type)) {
-               cmp_result |= CMP_content;	// Inferred difference
+   if ((cmp_Check&CMP_uid) && (src_sb_p->st_uid != tgt_sb_p->st_uid)) cmp_result |= CMP_uid;
+   if ((cmp_Check&CMP_gid) && (src_sb_p->st_gid != tgt_sb_p->st_gid)) cmp_result |= CMP_gid;
+   if ((cmp_Check&CMP_atime) && (src_sb_p->st_atime != tgt_sb_p->st_atime)) cmp_result |= CMP_atime;
+   if ((cmp_Check&CMP_mtime) && (src_sb_p->st_mtime != tgt_sb_p->st_mtime)) cmp_result |= CMP_mtime;
+   if ((cmp_Check&CMP_birthtime) && (src_sb_p->st_birthtime != tgt_sb_p->st_birthtime)) cmp_result |= CMP_birthtime;
+   if (!(cmp_result&CMP_type) && S_ISREG(src_sb_p->st_mode)) {	// Only for regular files ...
+      if ((cmp_Check&CMP_size) && (src_sb_p->st_size != tgt_sb_p->st_size)) cmp_result |= CMP_size;
+      if ((cmp_Check&CMP_blocks) && (src_sb_p->st_blocks != tgt_sb_p->st_blocks)) cmp_result |= CMP_blocks;
+      if (cmp_Check&CMP_content) {
+         if (cmp_result&(CMP_size|CMP_type)) {
+            cmp_result |= CMP_content;	// Inferred difference
+         } else if (CMP_MANIFEST_FILE) {	// Recorded digest stands in for TARGET content
+            if (cmp_digest(w_id, relpath, src_sb_p->st_size, digest))
+               cmp_result |= CMP_content;
+         } else if (CMP_CACHE_FILE && cache_key &&
+                    (rc = cmp_cache_lookup(w_id, src_sb_p, tgt_sb_p, cache_key)) == CMP_CACHE_HIT) {
+            WS[w_id]->CMP_Cache_Hits += 1;	// Verified equal before, and unchanged since
+            WS[w_id]->CMP_Cache_Bytes += src_sb_p->st_size;
+         } else {
+            if (CMP_CACHE_FILE && cache_key) {
+               cmp_result |= CMP_cachekey;
+               if (rc == CMP_CACHE_REVERIFY) cmp_result |= CMP_reverify;
+            }
+            if (CMP_CHUNK_SIZE && src_sb_p->st_size > CMP_CHUNK_SIZE) {
+               cmp_result |= CMP_chunked;	// Big file; caller queues chunks for all workers
             } else {
-               if (cmp_files(w_id, relpath))	// Exhaustive compare
+               if (cmp_files(w_id, relpath, src_sb_p->st_size))	// Exhaustive compare
                   cmp_result |= CMP_content;
+               cmp_cache_result(w_id, cmp_result, cache_key);
             }
          }
       }
    }
 
    // Construct result string from mask ...
-   memset(cmp_compare_result_str, 0, 16);	// Start w/ all NULs
-   for (i=0; cmp_Keywords[i].keyword; i++)
-      if (cmp_result&cmp_Keywords[i].maskval) *pstr++ = cmp_Keywords[i].code;
-   if (cmp_result == CMP_equal) strcpy(cmp_compare_result_str, "-");
+   cmp_result_format(cmp_result, cmp_compare_result_str);
+   return cmp_result;
+}
+
+// cmp_source_target() - Compare SOURCE with TARGET dir or file, as cmp_metadata() does.
+// The TARGET is <tpath> relative to <tdfd>: relpath from TARGET_DFD(w_id), or just the
+// name from a cmp_tdir_load() dir.
+
+unsigned
+cmp_source_target(int w_id, char *relpath, int tdfd, char *tpath, struct stat *src_sb_p,
+   char *cmp_compare_result_str, CMP_KEY *cache_key)
+{
+   struct stat target_sb;
+   unsigned cmp_result = CMP_notfound;
+
+   if (fstatat(tdfd, tpath, &target_sb, AT_SYMLINK_NOFOLLOW) == 0)
+      return cmp_metadata(w_id, relpath, src_sb_p, &target_sb, NULL, cmp_compare_result_str, cache_key);
+   if (errno != ENOENT) {		// ==== klooge: add WARNING to worker's count!
+       fprintf(Plog, "WARNING: fstatat(target, \"%s\") errno=%d\n", relpath, errno);
+       cmp_result |= CMP_error;
+   }
+   cmp_result_format(cmp_result, cmp_compare_result_str);
+   return cmp_result;
+}
+
+// @@@ -cmp content of big files: chunks run by any worker, reported by the last one ...
+
+typedef struct {			// CMP_JOB context for the eventual report
+   unsigned cmp_result;			// All but content, from cmp_source_target()
+   CMP_KEY cache_key;			// -cmp_cache key (with CMP_cachekey)
+   char mode_ch;			// First char of mode string
+   char dir_result[16];			// Directory's result string
+   char *dir;				// RelPathDir
+   char *name;				// FileName (follows dir in same malloc)
+} CMP_CHUNKED;
+
+// cmp_chunk_file() - Queue chunks of a big file for any worker to compare; poke the
+// manager so idle workers come help.
+
+void
+cmp_chunk_file(int w_id, char *relpath, off_t size, unsigned cmp_result, CMP_KEY *cache_key,
+   char mode_ch, char *dir_result, char *dir, char *name)
+{
+   CMP_CHUNKED *c;
+
+   c = malloc(sizeof(*c) + strlen(dir) + strlen(name) + 2);
+   if (c == NULL) abend("Cannot malloc -cmp chunk context!");
+   c->cmp_result = cmp_result;
+   c->cache_key = *cache_key;
+   c->mode_ch = mode_ch;
+   strncpy(c->dir_result, dir_result, sizeof(c->dir_result) - 1);
+   c->dir_result[sizeof(c->dir_result) - 1] = '\0';
+   c->dir = (char *) (c + 1);
+   strcpy(c->dir, dir);
+   c->name = c->dir + strlen(dir) + 1;
+   strcpy(c->name, name);
+
+   WS[w_id]->CMP_Content_Files += 1;
+   WS[w_id]->CMP_Content_Chunked += 1;
+   (void) cmp_job_add(relpath, size, c);
+   poke_manager("cmp_chunk_file()");
+}
+
+// cmp_chunk_worker() - Run one chunk taken from the queue; if it was the file's last,
+// report the file.  Its report is a record of its own: the directory line again, then
+// the file's line (only when different, as in directory_scan()).
+
+void
+cmp_chunk_worker(int w_id, CMP_JOB *j, unsigned chunk)
+{
+   CMP_CHUNKED *c = j->arg;
+   char result_str[32];
+   off_t nbytes, holes;
+   long long t0;
+
+   worker_read_bufs(w_id);
+   t0 = gethrtime();
+   if (!cmp_chunk_run(w_id, j, chunk, SOURCE_DFD(w_id), TARGET_DFD(w_id), WDAT.SOURCE_BUF_P, &nbytes, &holes)) {
+      WS[w_id]->CMP_Content_Bytes += nbytes;
+      WS[w_id]->CMP_Content_Holes += holes;
+      WS[w_id]->CMP_Content_ns += gethrtime() - t0;
+      return;
+   }
+   WS[w_id]->CMP_Content_Bytes += nbytes;
+   WS[w_id]->CMP_Content_Holes += holes;
+   WS[w_id]->CMP_Content_ns += gethrtime() - t0;
+
+   // Last chunk done; the file's result is final ...
+   if (j->rc) {
+      c->cmp_result |= CMP_content;
+      WS[w_id]->CMP_Content_Diffs += 1;
+   }
+   cmp_cache_result(w_id, c->cmp_result, &c->cache_key);
+   cmp_result_format(c->cmp_result, result_str);
+   if (strcmp(result_str, "-")) {
+      if (!WDAT.wout.buf) worker_log_create(w_id);	// This worker may not have scanned yet
+      if (po_tell(WOUT)) po_putc(WOUT, '\n');
+      po_printf(WOUT, "@ %s %s\n", c->dir_result, c->dir);
+      po_putc(WOUT, c->mode_ch);
+      po_putc(WOUT, ' ');
+      po_puts(WOUT, result_str);
+      po_putc(WOUT, ' ');
+      po_puts(WOUT, c->name);
+      po_putc(WOUT, '\n');
+      if (Opt_MERGE) merge_put_block(w_id, c->dir, WOUT);
+      worker_flush(w_id);
+   }
+   free(c);
+   cmp_job_free(j);
 }
 
 // @@@ SECTION: pwalk +tally support @@@
 
+// @@@ +tally bucket lookup ...
+
+// When the explicit buckets are successive powers of two (after an optional 0 bucket), a
+// size's bucket is just its log2; otherwise, it is found by binary search.
+static int TALLY_POW2_FIRST = -1;	// Index of the first power-of-two bucket, or -1
+static int TALLY_POW2_SHIFT;		// ... log2 of its size
+
+// init_tally() - Settle the bucket lookup, and +tally_by= context.
+
+void
+init_tally(void)
+{
+   int i, j0;
+
+   j0 = (TALLY_BUCKET_SIZE[0] == 0) ? 1 : 0;
+   if (N_TALLY_BUCKETS > j0 + 1 && (TALLY_BUCKET_SIZE[j0] & (TALLY_BUCKET_SIZE[j0] - 1)) == 0) {
+      for (i = j0 + 1; i < N_TALLY_BUCKETS; i++)
+         if (TALLY_BUCKET_SIZE[i] != TALLY_BUCKET_SIZE[i-1] << 1) break;
+      if (i == N_TALLY_BUCKETS) {
+         TALLY_POW2_FIRST = j0;
+         for (TALLY_POW2_SHIFT = 0; (1ULL << TALLY_POW2_SHIFT) < TALLY_BUCKET_SIZE[j0]; TALLY_POW2_SHIFT++) ;
+      }
+   }
+   if (tally_by_count()) tally_by_init(time(NULL), N_TALLY_BUCKETS, TALLY_BUCKET_SIZE);
+}
+
+// tally_bucket() - Index of the first bucket with size <= <size>; N_TALLY_BUCKETS if none.
+
+int
+tally_bucket(count_64 size)
+{
+   int lo, hi, mid, bits;
+
+   if (TALLY_POW2_FIRST >= 0) {
+      if (size <= TALLY_BUCKET_SIZE[TALLY_POW2_FIRST])
+         return ((size == 0 || TALLY_POW2_FIRST == 0) ? 0 : TALLY_POW2_FIRST);
+#if defined(__GNUC__)
+      bits = 64 - __builtin_clzll(size - 1);		// ceil(log2(size))
+#else
+      for (bits = 0; (size - 1) >> bits; bits++) ;
+#endif
+      mid = TALLY_POW2_FIRST + bits - TALLY_POW2_SHIFT;
+      return ((mid < N_TALLY_BUCKETS) ? mid : N_TALLY_BUCKETS);
+   }
+   lo = 0; hi = N_TALLY_BUCKETS;
+   while (lo < hi) {
+      mid = (lo + hi) / 2;
+      if (size <= TALLY_BUCKET_SIZE[mid]) hi = mid;
+      else lo = mid + 1;
+   }
+   return (lo);
+}
+
 // @@@ +tally per-file accumulator - accumulate per-worker subtotals ...
 
-// pwalk_tally_file() - Accumulate per-worker +tally subtotals.
+// pwalk_tally_file() - Accumulate per-worker +tally (and +tally_by=) subtotals.
 // NOTE: Bucket[N_TALLY_BUCKETS] catches files that did not fall into previous buckets.
 
 void
-pwalk_tally_file(struct stat *sb, int w_id)
+pwalk_tally_file(struct stat *sb, char *name, int w_id)
 {  
+   count_64 space;
    int i;
    
    // Probably-redundant check ...
@@ -2022,14 +2611,12 @@ pwalk_tally_file(struct stat *sb, int w_id)
    if (!S_ISREG(sb->st_mode)) return;
    
    // Accumulate WS subtotals from per-file contributions ...
-   for (i=0; i<=N_TALLY_BUCKETS; i++) {
-      if ((sb->st_size <= TALLY_BUCKET_SIZE[i]) || (i == N_TALLY_BUCKETS)) {	// "current or last bucket ..."
-         WS[w_id]->TALLY_BUCKET.count[i] += 1;
-         WS[w_id]->TALLY_BUCKET.size[i] += sb->st_size;
-         WS[w_id]->TALLY_BUCKET.space[i] += sb->st_blocks * ST_BLOCK_SIZE;
-         return;
-      }
-   }
+   i = tally_bucket(sb->st_size);
+   space = sb->st_blocks * ST_BLOCK_SIZE;
+   WS[w_id]->TALLY_BUCKET.count[i] += 1;
+   WS[w_id]->TALLY_BUCKET.size[i] += sb->st_size;
+   WS[w_id]->TALLY_BUCKET.space[i] += space;
+   if (tally_by_count()) tally_by_file(w_id, name, sb, i, space);
 }
 
 // @@@ +tally output - calculate & output ...
@@ -2039,7 +2626,7 @@ pwalk_tally_output()
 {
    FILE *TALLY;
    char ofile[MAX_PATHLEN+2];
-   char *relop;
+   char *relop, label[64];
    int i, w_id;
 
    // @@@ Create output file ...
@@ -2094,17 +2681,9 @@ pwalk_tally_output()
       if (i == N_TALLY_BUCKETS) relop = ">";
       else if (TALLY_BUCKET_SIZE[i] == 0) relop = "=";
       else relop = "<=";
-      fprintf(TALLY,"%s[0x%llx],\"%s %llu %s\",%llu,%04.02f,%llu,%04.02f,%llu,%04.02f,%06.04f\n",
-         TALLY_TAG, TALLY_BUCKET_SIZE[i],
-         relop,
-         (TALLY_BUCKET_SIZE[i] < (1L << 20)) ? (TALLY_BUCKET_SIZE[i] >> 10) :
-            (TALLY_BUCKET_SIZE[i] < (1L << 30)) ? (TALLY_BUCKET_SIZE[i] >> 20) :
-               (TALLY_BUCKET_SIZE[i] < (1L << 40)) ? (TALLY_BUCKET_SIZE[i] >> 30) :
-                  (TALLY_BUCKET_SIZE[i] >> 40),
-         TALLY_BUCKET_SIZE[i] < (1L << 20) ? "KiB" :
-            TALLY_BUCKET_SIZE[i] < (1L << 30) ? "MiB" :
-               TALLY_BUCKET_SIZE[i] < (1L << 40) ? "GiB" :
-                  "TiB",
+      tally_size_label(label, TALLY_BUCKET_SIZE[i], relop);
+      fprintf(TALLY,"%s[0x%llx],\"%s\",%llu,%04.02f,%llu,%04.02f,%llu,%04.02f,%06.04f\n",
+         TALLY_TAG, TALLY_BUCKET_SIZE[i], label,
          GS.TALLY_BUCKET.count[i], tally_pct_count[i],
          GS.TALLY_BUCKET.size[i], tally_pct_size[i],
          GS.TALLY_BUCKET.space[i], tally_pct_space[i],
@@ -2158,11 +2737,13 @@ select_regex_match(char *filename)
 //	... otherwise, applying De Morgan's law to reformulate some conditions would be even uglier!
 
 int
-selected(char *filename, struct dirent *dirent, struct stat *sb)
+selected(char *filename, struct dirent *dirent, struct stat *sb, int dfd)
 {
    int d_namlen;		// strlen() or d_namlen
    int is_sparse = 0;		// Unreliable outside of OneFS native!
    int is_stubbed = 0;		// Only ever TRUE of ONEFS native!
+   int fd;
+   off_t holes;			// ext_holes() result; -1 if unknown
    long long physical_size;	// = (st_blocks * ST_BLOCK_SIZE)
    long long logical_size;	// = (st_size)
 
@@ -2255,15 +2836,22 @@ selected(char *filename, struct dirent *dirent, struct stat *sb)
    //	- being a stub			// sparse file must NOT be a stub
    //	- being zero- sized or small	// sparse file must have logical size > 256 KB
    //	- being medium-sized		// sparse file must have (physical - logical) > 1024 KB
-   // On OneFS natively, filesystem flags will prevail in the determination of spareness,
-   // otherwise, sparseness will be determined using stat(2) data in the same manner as on other
-   // pwalk execution environments.
+   // On OneFS natively, filesystem flags will prevail in the determination of spareness.
+   // Elsewhere, a big file with fewer blocks than bytes is asked for its holes with
+   // SEEK_HOLE (ext_holes()), which sees past compression and dedupe; only when that is
+   // unsupported or inconclusive (eg: NFS) does the stat(2) guess above decide.
    if (SELECT_OPTIONS&SELECT_SPARSE) {
       physical_size = sb->st_blocks * ST_BLOCK_SIZE;	// *signed*
       logical_size = sb->st_size;			// *signed*
-      is_sparse |= S_ISREG(sb->st_mode) &&
-                   (logical_size > 256*1024) &&
-                   ((logical_size - physical_size) > 1024*1024);
+      if (!is_sparse && S_ISREG(sb->st_mode) && (logical_size > 256*1024) && (physical_size < logical_size)) {
+         holes = -1;
+         if ((fd = openat(dfd, dirent->d_name, O_RDONLY|O_NOFOLLOW|O_OPENLINK)) >= 0) {
+            holes = ext_holes(fd, logical_size);
+            close(fd);
+         }
+         if (holes >= 0) is_sparse = (holes > 1024*1024);
+         else is_sparse = ((logical_size - physical_size) > 1024*1024);
+      }
       if (!is_sparse) return(0);
       // Fall-through only for files that are determined to be sparse ...
       if (PWdebug) fprintf(stderr, "DEBUG/sparse: (%lld / %lld = %4.2f%%) %s\n",
@@ -2347,8 +2935,9 @@ asciify(char *istr, char *ostr)
 // FIFO is never ambiguous for even an instant.
 
 // fifo_push() - Push passed directory path onto file-based FIFO (pwalk.fifo).
+// Returns TRUE iff pushed; FALSE if skip_this_directory().
 
-void
+int
 fifo_push(char *pathname, struct stat *sb, int w_id)
 {
    char ascii_path[8192];
@@ -2356,7 +2945,11 @@ fifo_push(char *pathname, struct stat *sb, int w_id)
 
    // We usually skip .snapshot and .isi-compliance directories entirely ...
    if (skip_this_directory(pathname, sb, w_id))
-      return;
+      return (FALSE);
+
+   // -rm=tree: Count it against its parent before any worker can pop it ...
+   if (Cmd_RM_TREE && sb) rmt_push(pathname);
+   if (Cmd_ROLLUP && sb) ru_push(pathname);		// +rollup: ditto
 
    // Make sure pushed path is ASCII ...
    asciify(pathname, ascii_path);
@@ -2368,6 +2961,7 @@ fifo_push(char *pathname, struct stat *sb, int w_id)
    FIFO_DEPTH += 1;
    if (Workers_BUSY < N_WORKERS) poke_manager("fifo_push()");
    MP_UNLOCK;							// --- MP lock ---
+   return (TRUE);
 }
 
 // hex_cval() - For de-ASCII-fying pathnames.
@@ -2481,12 +3075,16 @@ worker_thread(void *parg)
    int w_id = *((int *) parg);	// Unique to our thread & passed on to subordinate functions
    sigset_t sigmask;
    count_64 w_fifo_pops = 0, w_fifo_pops_0;
+   count_64 w_chunks = 0, w_chunks_0;	// -cmp chunks taken
+   CMP_JOB *cmp_job;
+   unsigned cmp_chunk;
    unsigned w_wakeups = 0;
    char msg[256], *dp;		// *dp - dynamic; should be freed, but only used to abend!
    int rc, status_change;
    pthread_mutexattr_t mattr;	// klooge: TINY one-time memory leak
 
    if (PWdebug) fprintf(stderr, "= Worker %d -> START ...\n", w_id);
+   lat_thread(w_id);			// +lat: our calls count for our source path
 
    // Disable *most* signals in our thread ...
 //   sigemptyset(&sigmask);
@@ -2531,11 +3129,15 @@ worker_thread(void *parg)
       // Track if we do anything on this wake cycle ...
       w_fifo_pops_0 = w_fifo_pops;
 
-      // Stay BUSY as long as FIFO can be popped ...
-      while (fifo_pop(WDAT.DirPath)) {
-         w_fifo_pops += 1;
+      // Stay BUSY as long as there are -cmp chunks to take (they finish files already
+      // started), or the FIFO can be popped ...
+      w_chunks_0 = w_chunks;
+      while (1) {
+         if ((cmp_job = cmp_chunk_take(&cmp_chunk)) != NULL) w_chunks += 1;
+         else if (fifo_pop(WDAT.DirPath)) w_fifo_pops += 1;
+         else break;
          // Transition to BUSY busy after FIRST successful pop ...
-         if (w_fifo_pops == (w_fifo_pops_0 + 1)) {
+         if ((w_fifo_pops - w_fifo_pops_0) + (w_chunks - w_chunks_0) == 1) {
             if (PWdebug) fprintf(stderr, "= Worker %d ->BUSY ...\n", w_id);
             MP_LOCK("MP mutex transition to BUSY");		// +++ MP lock +++
             WDAT.status = BUSY;
@@ -2545,11 +3147,23 @@ worker_thread(void *parg)
             if (PWdebug) fputs(msg, stderr);
             LogMsg(msg, 1);
          }
-         directory_scan(w_id);					// $$$ WORKER'S MISSION $$$
+         if (cmp_job)
+            cmp_chunk_worker(w_id, cmp_job, cmp_chunk);
+         else
+            directory_scan(w_id);				// $$$ WORKER'S MISSION $$$
          // Give other workers a chance push or pop FIFO!
          yield_cpu();
       }
 
+      // After the treewalk, do our share of any post-walk phase (eg: -dups hashing) ...
+      if (WORKER_PHASE_F && WDAT.phase_gen != WORKER_PHASE_GEN) {
+         WORKER_PHASE_F(w_id);
+         MP_LOCK("phase done");					// +++ MP lock +++
+         WDAT.phase_gen = WORKER_PHASE_GEN;
+         MP_UNLOCK;						// --- MP lock ---
+         poke_manager("phase done");
+      }
+
       // If we were BUSY, transition to IDLE ...
       MP_LOCK("transition to IDLE?");				// +++ MP lock +++
       status_change = 0;
@@ -2646,11 +3260,76 @@ loop:
    if (PWdebug) fprintf(stderr, "= manage_workers: exits\n");
 }
 
+// run_worker_phase() - After the treewalk, run <f>(w_id) once on every worker and wait for all
+// of them to finish; <f> shares out its own work.  Taking a worker's cv lock to signal it
+// means it is in its condition wait, so no wakeup is lost; our own wait is timed, because
+// poke_manager() does not take our lock.
+
+void
+run_worker_phase(void (*f)(int w_id))
+{
+   struct timespec ts;
+   int w_id, ndone;
+
+   WORKER_PHASE_F = f;
+   WORKER_PHASE_GEN += 1;
+   for (w_id=0; w_id<N_WORKERS; w_id++) {
+      assert(pthread_mutex_lock(&(WORKER_mutex[w_id])) == 0);		// +++ WORKER cv lock +++
+      assert(pthread_cond_signal(&(WORKER_cond[w_id])) == 0);
+      assert(pthread_mutex_unlock(&(WORKER_mutex[w_id])) == 0);		// --- WORKER cv lock ---
+   }
+   while (1) {
+      MP_LOCK("run_worker_phase()");					// +++ MP lock +++
+      for (ndone=0, w_id=0; w_id<N_WORKERS; w_id++)
+         if (WDAT.phase_gen == WORKER_PHASE_GEN) ndone++;
+      MP_UNLOCK;							// --- MP lock ---
+      if (ndone == N_WORKERS) break;
+      clock_gettime(CLOCK_REALTIME, &ts);
+      ts.tv_sec += 1;
+      (void) pthread_cond_timedwait(&MANAGER_cond, &MANAGER_mutex, &ts);
+   }
+   WORKER_PHASE_F = NULL;
+}
+
+// worker_flush() - Called at the end of each directory; at most every FLUSH_SECS, flush the
+// worker's output and force main pwalk.log flush (with possible progress report).  Flushing
+// per-directory makes trees of tiny directories a write() storm and a LOGMSG lock convoy.
+
+void
+worker_flush(int w_id)
+{
+   time_t now;
+   int i;
+
+   // Directory end is a record boundary for -shards outputs ...
+   po_mark(WOUT);
+   for (i=0; i<WDAT.n_shard_aux; i++) {
+      fflush(WDAT.shard_aux_file[i]);
+      po_mark(WDAT.shard_aux_obuf[i]);
+   }
+
+   // ... and an open record must be submitted at one, -flush= or not ...
+   if (FLUSH_SECS) {
+      now = time(NULL);
+      if ((now - WDAT.flush_time) < FLUSH_SECS) {
+         if (wr_mid_record(WOUT)) po_drain(WOUT);
+         for (i=0; i<WDAT.n_shard_aux; i++)
+            if (wr_mid_record(WDAT.shard_aux_obuf[i])) po_drain(WDAT.shard_aux_obuf[i]);
+         return;
+      }
+      WDAT.flush_time = now;
+   }
+   if (!Opt_MERGE) po_flush(WOUT);
+   for (i=0; i<WDAT.n_shard_aux; i++)
+      po_drain(WDAT.shard_aux_obuf[i]);
+   LogMsg(NULL, 1);
+}
+
 // @@@ SECTION: PathName Redaction @@@
 
 // redact_path() - Create a redacted relative pathname from the passed-in relpath (directory) and its
 // inode number.  We will stat() each partial path up to the final directory to get its inode number.
-// The passed-in w_id is used both for multipathing the stat() calls and for the WLOG and WERR macros.
+// The passed-in w_id is used both for multipathing the stat() calls and for the WOUT and WERR macros.
 //
 // If the relpath is ".", the redacted_relpath will just be the inode for ".". Otherwise, all other output
 // values will begin with "./", representing the relative root of the source tree, even if pwalk is in
@@ -2752,7 +3431,15 @@ directory_scan(int w_id)		// CAUTION: MT-safe and RE-ENTRANT!
    int openit;				// Flag indicates we must open files for READONLY purposes
    int pathlen, namelen;
    count_64 n_dirent_selected;		// Triggers mode-specific directory_entry output when == 1
-   count_64 rm_path_hits;		// Count files rm'd within directory ===== klooge/globalize?
+   count_64 rm_path_hits = 0;		// Count files rm'd within directory ===== klooge/globalize?
+   count_64 rmt_seen = 0, rmt_gone = 0;	// -rm=tree: dirents, and those removed or pushed
+   RMT_NODE *rmt_n;			// ... directory ready for rmdir()
+   int trash_tdfd = -1;			// -trash: TARGET directory, once opened (-2: cannot)
+   int trash_errno = 0;			// ... and why not
+   int trash_how;			// ... TRASH_RENAMED or TRASH_COPIED
+   char trash_tdir[MAX_PATHLEN+1];	// ... its absolute path, for the output
+   RU_TOTALS ru_t;			// +rollup: this directory's direct totals
+   time_t ru_mtime = 0;			// ... newest selected() mtime
    char *p, *pend;
    struct dirent *pdirent, *result;
    struct stat curdir_sb, dirent_sb;
@@ -2762,6 +3449,7 @@ directory_scan(int w_id)		// CAUTION: MT-safe and RE-ENTRANT!
    char dump_str[8192];
    char owner_sid[128], group_sid[128];
    char owner_name[64], group_name[64];
+   PW_REPORT_ENTRY csv_entry;		// -csv formatter input
    char rm_rc_str[16];			// For "%s rm ..." -> '#' == dryrun, <n> == errno
 
    // @@@ Implement -redact as macros ...
@@ -2776,13 +3464,22 @@ directory_scan(int w_id)		// CAUTION: MT-safe and RE-ENTRANT!
    int cmp_target_dir_exists;		// In -cmp mode, report all files as 'E' if target dir non-existant
    char cmp_dir_result_str[32];		// Concatenation of -cmp letter codes ('[-ET]' or '[MFogsSambC]*') for dir
    char cmp_file_result_str[32];	// Concatenation of -cmp letter codes ('[-ET]' or '[MFogsSambC]*') for file
+   unsigned cmp_file_result;		// ... and the mask behind it
+   CMP_KEY cmp_cache_key;		// ... and the -cmp_cache key
    int cmp_dir_reported = FALSE;	// Set when directory cmp line has been reported
+   int cmp_tloaded = 0;			// TARGET dir table loaded (cmp_tdir_load() or a manifest)
+   int cmp_tdfd = -1;			// ... the live TARGET dir, or -1
+   int cmp_tent = -1;			// ... dirent's entry there, or -1 if not there
+   int cmp_ttype;			// ... and its d_type
+   unsigned cmp_titer;			// ... iterator for names only in TARGET
+   const char *cmp_tname;		// ... and one of those names
+   struct stat cmp_tsb;			// ... and its stat() if d_type is unknown (or manifest's dir)
    // Locals ...
-   unsigned crc_val;			// +crc results
-   char crc_str[16];			// ... formatted as hex
-   unsigned long md5_val;		// +md5 results
-   char md5_str[32];			// ... formatted as hex
+   SUM_VALUES sums_val;			// +crc, +md5, etc. results
+   int sums_read;			// ... valid (file was read), or -1 if open() or read failed
+   char sums_str[SUM_STR_MAX];		// ... formatted as hex
    long long t0, t1, t2;		// For high-resolution timing samples
+   long long t_lat;			// ... and for +lat
    long long ns_stat, ns_getacl;	// ns for stat() and get ACL calls
    char ns_stat_s[32], ns_getacl_s[32];	// Formatted timing values
    char mode_str[16];			// Formatted mode bits
@@ -2790,12 +3487,16 @@ directory_scan(int w_id)		// CAUTION: MT-safe and RE-ENTRANT!
 
    char *FileName;			// Pointer to filename (dirent)
    char *RelPathDir;			// Pointer to WDAT.DirPath (value popped from FIFO)
+   size_t root_len, top_len;		// ... its <directory> arg, and top-level directory (dir_root())
    char AbsPathDir[MAX_PATHLEN+1];	// Absolute directory path (value prepended by source/target relative root)
    char RelPathName[MAX_PATHLEN+1];	// Relative pathname (relative to source/target relative roots)
    char AbsPathName[MAX_PATHLEN+1];	// Absolute pathname (value prepended by AbsPathDir)
 
-   unsigned char rbuf[128*1024];	// READONLY buffer for +crc and +denist (cheap, on-stack, should be dynamic)
-   size_t nbytes;			// READONLY bytes read
+   size_t nbytes;			// READONLY bytes read (into worker's SOURCE buffer)
+   int content_io;			// ... file opened by io_open()
+   unsigned char denist_md5[16];	// +denist MD5 of first 128 bytes
+   int denist_n;			// ... bytes read, or -1
+   int denist_nist;			// ... found in +denist=<hashlist>
 
    PWALK_STATS_T DS;			// Per-directory counters
    char emsg[MAX_PATHLEN+256];
@@ -2812,15 +3513,21 @@ directory_scan(int w_id)		// CAUTION: MT-safe and RE-ENTRANT!
 #endif // PWALK_ACLS
 
    // Make sure worker's output file is ready ...
-   if (!WDAT.wlog) worker_log_create(w_id);
+   if (!WDAT.wout.buf) worker_log_create(w_id);
 
    // @@@ ACCESS/directory_enter: opendir() just-popped directory ...
    RelPathDir = WDAT.DirPath;
+   if ((Cmd_TALLY && tally_by_count()) || Cmd_TOP || Cmd_USAGE) {
+      dir_root(RelPathDir, &root_len, &top_len);
+      if (Cmd_TALLY && tally_by_count()) tally_by_dir(w_id, RelPathDir, top_len);
+      if (Cmd_TOP) top_dir(w_id, RelPathDir, root_len);
+      if (Cmd_USAGE) usage_dir(w_id, RelPathDir, top_len);
+   }
    if (VERBOSE) {
       sprintf(emsg, "@ Worker %d popped %s\n", w_id, RelPathDir);
       LogMsg(emsg, 1);
-      if (VERBOSE > 2) { fprintf(WLOG, "@%s\n", RelPathDir); fflush(WLOG); }
-      if (VERBOSE > 2) { fprintf(WLOG, "@opendir\n"); fflush(WLOG); }
+      if (VERBOSE > 2) { po_printf(WOUT, "@%s\n", RelPathDir); po_flush(WOUT); }
+      if (VERBOSE > 2) { po_printf(WOUT, "@opendir\n"); po_flush(WOUT); }
    }
 
    // Calculate AbsPathDir for directory we are entering ...
@@ -2839,7 +3546,9 @@ directory_scan(int w_id)		// CAUTION: MT-safe and RE-ENTRANT!
       sprintf(AbsPathDir, "%s%c%s", SOURCE_PATH(w_id), PATHSEPCHR, p);	// Concatenate with PATHSEPCHR ...
 
    // @@@ Here's the actual opendir() ...
+   LAT_BEGIN(t_lat);
    dir = opendir(AbsPathDir);	// No opendirat() exists  :-(  !
+   LAT_END(LAT_OPENDIR, t_lat);
    if (PWdebug >2) fprintf(Plog, "@ opendir(\"%s\") errno=%d\n", AbsPathDir, dir == NULL ? errno : 0);
    if (dir == NULL) {							// @@ <warning> ...
       // Directory open errors (ENOEXIST, !ISDIR, etc) just provoke WARNING output.
@@ -2848,7 +3557,7 @@ directory_scan(int w_id)		// CAUTION: MT-safe and RE-ENTRANT!
       WS[w_id]->NWarnings += 1;
       assert(strerror_r(rc, errstr, sizeof(errstr)) == 0);
       fprintf(WERR, "WARNING: Cannot opendir(\"%s\") (%s)\n", AbsPathDir, errstr);
-      if (Cmd_XML) fprintf(WLOG, "<warning> Cannot opendir(\"%s\") (%s) </warning>\n", AbsPathDir, errstr);
+      if (Cmd_XML) po_printf(WOUT, "<warning> Cannot opendir(\"%s\") (%s) </warning>\n", AbsPathDir, errstr);
       goto dir_summary; // Skip to summary for this directory ...
    } else if (VERBOSE > 1) {
       sprintf(emsg, "VERBOSE: Worker %d diropen(\"%s\") errno=%d)\n", w_id, AbsPathDir, rc);
@@ -2865,9 +3574,11 @@ directory_scan(int w_id)		// CAUTION: MT-safe and RE-ENTRANT!
 #endif
    ns_stat_s[0]='\0';
    if (Opt_TSTAT) t0 = gethrtime();
+   LAT_BEGIN(t_lat);
    fstat(dfd, &curdir_sb);		// klooge: assuming success because it's open	+++++
+   LAT_END(LAT_FSTATAT, t_lat);
    if (Opt_TSTAT) { t1 = gethrtime(); ns_stat = t1 - t0; sprintf(ns_stat_s," (%lldus) ", ns_stat/1000); }
-   if (VERBOSE > 2) { fprintf(WLOG, "@stat\n"); fflush(WLOG); }
+   if (VERBOSE > 2) { po_printf(WOUT, "@stat\n"); po_flush(WOUT); }
    format_mode_bits(mode_str, curdir_sb.st_mode);
    if (Opt_REDACT)
       redact_path(RedactedRelPathDir, RelPathDir, curdir_sb.st_ino, w_id);
@@ -2877,20 +3588,47 @@ directory_scan(int w_id)		// CAUTION: MT-safe and RE-ENTRANT!
    if (SELECT_OPTIONS == 0) { // Skip including directory sizes when -select options in use ...
       DS.NBytesLogical = curdir_sb.st_size;
       DS.NBytesPhysical = bytes_physical = curdir_sb.st_blocks * ST_BLOCK_SIZE;
+      ru_mtime = curdir_sb.st_mtime;
    }
 
    // @@@ GATHER & OUTPUT (directory): -cmp mode for the directory itself ...
    if (Cmd_CMP) {
-      cmp_source_target(w_id, RelPathDir, &curdir_sb, cmp_dir_result_str);
+      if (CMP_MANIFEST_FILE) {		// TARGET as recorded: this directory's manifest block
+         if ((rc = cmp_manifest_load(w_id, RelPathDir, &cmp_tsb)) == 0 || rc == 2) {
+            cmp_metadata(w_id, RelPathDir, &curdir_sb, &cmp_tsb, NULL, cmp_dir_result_str, NULL);
+            cmp_tloaded = (rc == 0);
+         } else {
+            if (rc < 0) {
+               WS[w_id]->NWarnings += 1;
+               fprintf(WERR, "WARNING: -cmp=manifest: block for \"%s\" unreadable or garbled\n", RelPathDir);
+            }
+            cmp_result_format((rc < 0) ? CMP_notfound|CMP_error : CMP_notfound, cmp_dir_result_str);
+         }
+      } else {
+         cmp_source_target(w_id, RelPathDir, TARGET_DFD(w_id), RelPathDir, &curdir_sb, cmp_dir_result_str, NULL);
+      }
       // If TARGET dir does not exist, save scan time by just reporting 'E' for all dir contents.
       cmp_target_dir_exists = (strpbrk(cmp_dir_result_str, "ET!") == NULL);	// 'E' or 'T' or '!'  means 'no'
+      // Otherwise read it once, so dirents are joined against its names instead of each
+      // needing a fstatat() from TARGET root; failing that, fall back to the latter ...
+      if (cmp_target_dir_exists && !CMP_MANIFEST_FILE) {
+         if ((cmp_tdfd = cmp_tdir_load(w_id, TARGET_DFD(w_id), RelPathDir)) >= 0) {
+            cmp_tloaded = 1;
+         } else {
+            WS[w_id]->NWarnings += 1;
+            fprintf(WERR, "WARNING: Cannot read -target dir \"%s\" (errno=%d)\n", RelPathDir, errno);
+         }
+      }
       if (strcmp(cmp_dir_result_str, "-")) {		// Maybe defer this until a file difference is found
-         if (ftell(WDAT.wlog)) fprintf(WLOG, "\n");	// Blank line before each new directory
-         fprintf(WLOG, "@ %s %s\n", cmp_dir_result_str, RelPathDir);
+         if (po_tell(WOUT)) po_putc(WOUT, '\n');	// Blank line before each new directory
+         po_printf(WOUT, "@ %s %s\n", cmp_dir_result_str, RelPathDir);
          cmp_dir_reported = TRUE;
       }
    }
 
+   // @@@ OUTPUT (directory): -manifest record for the directory itself heads its block ...
+   if (Cmd_MANIFEST) manifest_put(WOUT, "@ ", &curdir_sb, NULL, RelPathDir);
+
    // @@@ GATHER & PROCESS (directory): ACL on the directory itself ...
    // directory_acl = pwalk_acl_get_fd(dfd);	// DEVELOPMENTAL for +rm_acls
 #if defined(__ONEFS__)
@@ -2902,7 +3640,9 @@ directory_scan(int w_id)		// CAUTION: MT-safe and RE-ENTRANT!
    ns_getacl_s[0]='\0';
    if (P_ACL_P || Cmd_XACLS || Cmd_WACLS) {
       // INPUT & TRANSLATE: Translate POSIX ACL plus DACL to a single ACL4 ...
+      LAT_BEGIN(t_lat);
       pw_acl4_get_from_posix_acls(AbsPathDir, 1, &aclstat, &acl4, pw_acls_emsg, &pw_acls_errno);
+      LAT_END(LAT_ACL, t_lat);
       if (PWdebug > 2) fprintf(Plog, "$ AbsPathDir=\"%s\" aclstat=%d pw_acls_errno=%d\n", AbsPathDir, aclstat, pw_acls_errno);
       if (Opt_TSTAT) { t2 = gethrtime(); ns_getacl = t2 - t1; sprintf(ns_getacl_s," (%lldus) ", ns_getacl/1000); }
       if (pw_acls_errno == EOPNOTSUPP) {	// If no support on directory, no point asking for files!
@@ -2912,7 +3652,7 @@ directory_scan(int w_id)		// CAUTION: MT-safe and RE-ENTRANT!
          DS.NWarnings += 1;
          fprintf(WERR, "WARNING: \"%s\": %s [%d - \"%s\"]\n", RelPathDir, pw_acls_emsg, pw_acls_errno, errstr);
          // Also log to .xml in -xml mode ...
-         if (Cmd_XML) fprintf(WLOG, "<warning> \"%s\": %s (rc=%d - %s) </warning>\n",
+         if (Cmd_XML) po_printf(WOUT, "<warning> \"%s\": %s (rc=%d - %s) </warning>\n",
             RelPathDir, pw_acls_emsg, pw_acls_errno, errstr);
       }
       if (aclstat) {
@@ -2943,7 +3683,7 @@ dir_rm_acls_logic: // @@@ PROCESS (directory): +rm_acls ...
          fprintf(WERR, "WARNING: onefs_rm_acls(\"%s\") for \"%s\"\n", rc_msg, RelPathName);
       } else if (rc > 0) {
          WS[w_id]->NACLs += 1;
-         sprintf(emsg, "@ %s \"%s\"\n", rc_msg, RelPathName); fputs(emsg, WLOG);
+         sprintf(emsg, "@ %s \"%s\"\n", rc_msg, RelPathName); po_puts(WOUT, emsg);
       }
    }
 #endif
@@ -2957,14 +3697,19 @@ dir_scan_loop_begin: // @@@ DIRECTORY SCAN LOOP (top): push dirs as we go ...
    pdirent = WDAT.Dirent; // Convenience pointer
 
    // NOTE: readdir_r() is the main potential metadata-reading LATENCY HOTSPOT
-   if (VERBOSE > 2) { fprintf(WLOG, "@readdir_r loop\n"); fflush(WLOG); }
+   if (VERBOSE > 2) { po_printf(WOUT, "@readdir_r loop\n"); po_flush(WOUT); }
    n_dirent_selected = 0;
    directory_reported = 0;
-   while (((rc = readdir_r(dir, pdirent, &result)) == 0) && (result == pdirent)) {
+   if (Cmd_DENIST) denist_batch_begin(w_id, dfd);	// Helpers start reading ahead of this loop
+   // NOTE: -merge wants each directory's entries in name order, so its blocks are deterministic
+   while (((rc = (Opt_MERGE ? merge_readdir(w_id, dir, pdirent, &result) : lat_readdir(dir, pdirent, &result))) == 0)
+          && (result == pdirent)) {
       // @@@ PATHCALC (dirent): Quietly skip "." and ".." ...
       FileName = pdirent->d_name;
       if (strcmp(FileName, ".") == 0) continue;
       if (strcmp(FileName, "..") == 0) continue;
+      rmt_seen += 1;
+      if (cmp_tloaded) cmp_tent = cmp_tdir_find(w_id, FileName);	// -cmp: also marks it seen
 
       // Construct RelPathName from current directory entry (dirent) ...
       // struct dirent { // (from OSX; Solaris has no d_namlen)
@@ -2984,7 +3729,7 @@ dir_scan_loop_begin: // @@@ DIRECTORY SCAN LOOP (top): push dirs as we go ...
       if ((namelen + pathlen + 1) > MAX_PATHLEN) {		// @@ <warning> ...
          DS.NWarnings += 1;
          if (Cmd_XML)
-            fprintf(WLOG, "<warning> Cannot expand %s! </warning>\n", RelPathDir);
+            po_printf(WOUT, "<warning> Cannot expand %s! </warning>\n", RelPathDir);
          fprintf(WERR, "WARNING: Filename \"%s\" expansion would exceed MAX_PATHLEN (%d)\n",
             FileName, MAX_PATHLEN);
          continue;
@@ -3008,7 +3753,7 @@ dirent_read_meta: // @@@ GATHER/dirent: stat/fstatat() info ...
       if (Cmd_AUDIT && 0) {		// DORMANT/EXPERIMENTAL: FAST TREEWALK W/O STAT() - FUTURE
          // Avoid stat() call, require d_type ...
          if (pdirent->d_type == DT_UNKNOWN) {
-            fprintf(WLOG, "ERROR: DT_UNKNOWN %s\n", RelPathName);
+            po_printf(WOUT, "ERROR: DT_UNKNOWN %s\n", RelPathName);
             continue;
          }
          if (pdirent->d_type == DT_REG || pdirent->d_type == DT_DIR) dirent_type = pdirent->d_type;
@@ -3016,20 +3761,22 @@ dirent_read_meta: // @@@ GATHER/dirent: stat/fstatat() info ...
       } else {				// Gather stat() info for dirent ...
          if (Opt_TSTAT) t0 = gethrtime();
          // NOTE: dfd aleady incorporates multipath logic ...
+         LAT_BEGIN(t_lat);
          rc = fstatat(dfd, FileName, &dirent_sb, AT_SYMLINK_NOFOLLOW);		// $$$ PAYDAY $$$
+         LAT_END(LAT_FSTATAT, t_lat);
          if (Opt_TSTAT) { t1 = gethrtime(); sprintf(ns_stat_s," (%lldus) ", (t1-t0)/1000); }
          DS.NStatCalls += 1;
          if (rc) {
             DS.NStatErrs += 1;
             WS[w_id]->NWarnings += 1;
-            if (Cmd_XML) fprintf(WLOG, "<warning> Cannot stat(%s) (rc=%d) </warning>\n", RelPathName, rc);
+            if (Cmd_XML) po_printf(WOUT, "<warning> Cannot stat(%s) (rc=%d) </warning>\n", RelPathName, rc);
             else fprintf(WERR, "WARNING: Cannot stat(%s) (rc=%d)\n", RelPathName, rc);
             continue;
          }
          have_stat = 1;
 
          // Redaction ...
-         if (Opt_REDACT) sprintf(RedactedFileName, "%llx", dirent_sb.st_ino);
+         if (Opt_REDACT) *po_fmt_hex(RedactedFileName, dirent_sb.st_ino) = '\0';
          format_mode_bits(mode_str, dirent_sb.st_mode);
 
          // Make up for these bits not always being set correctly (eg: over NFS) ...
@@ -3039,6 +3786,7 @@ dirent_read_meta: // @@@ GATHER/dirent: stat/fstatat() info ...
 
          // Update DS per-directory misc counters ...
          DS.NScanned += 1;
+         PG_ADD(w_id, entries, 1);
          if (dirent_type != DT_DIR) {
             if (dirent_sb.st_nlink > 1) {
                DS.NHardLinkFiles += 1;
@@ -3050,7 +3798,7 @@ dirent_read_meta: // @@@ GATHER/dirent: stat/fstatat() info ...
 
       // @@@ ACTION(s)/dirent: Depends on whether or not dirent is selected(), whether
       // it's a directory or not, and the <primary_mode> of pwalk operation.
-      dirent_selected = (SELECT_OPTIONS == 0) ? 1 : selected(RelPathName, pdirent, &dirent_sb);
+      dirent_selected = (SELECT_OPTIONS == 0) ? 1 : selected(RelPathName, pdirent, &dirent_sb, dfd);
       if (dirent_selected) n_dirent_selected += 1;	// "output it"
       dirent_isdir = S_ISDIR(dirent_sb.st_mode);
 
@@ -3086,9 +3834,57 @@ dirent_read_meta: // @@@ GATHER/dirent: stat/fstatat() info ...
                WS[w_id]->NRemoved += 1;			// Successful -rm
             }
          }
+         if (rm_rc_str[0] == '0' || rm_rc_str[0] == '#') rmt_gone += 1;
+         if (!PWquiet) {
+            if (rm_path_hits == 1) po_printf(WOUT, "@ cd \"%s\"\n", AbsPathDir);
+            po_puts(WOUT, rm_rc_str);
+            po_write(WOUT, " rm \"", 5);
+            po_puts(WOUT, FileName);
+            po_write(WOUT, "\"\n", 2);
+         }
+      }
+
+      // @@@ ACTION/dirent: -trash selected() non-directories to TARGET unless -dryrun ...
+      // NOTE: Same .sh-like output as -rm, and for the same reason.  The TARGET directory is
+      // made (if need be) and opened on the first move out of this directory, then each file
+      // is renamed between the two directory fds.
+      if (Cmd_TRASH && !dirent_isdir && dirent_selected) {
+         rm_path_hits += 1;
+         rm_rc_str[0] = '0'; rm_rc_str[1] = '\0';
+         if (rm_path_hits == 1) catpath3(trash_tdir, TARGET_PATH(w_id), RelPathDir, NULL);
+         if (PWdryrun) {
+            rm_rc_str[0] = '#';
+         } else {
+            if (trash_tdfd == -1 && (trash_tdfd = trash_dir_open(TARGET_DFD(w_id), RelPathDir)) < 0) {
+               trash_errno = errno;
+               trash_tdfd = -2;
+            }
+            if (trash_tdfd < 0) {
+               rc = -1;
+               errno = trash_errno;
+            } else {
+               worker_read_bufs(w_id);		// In case of a copy
+               rc = trash_move(dfd, trash_tdfd, FileName, &dirent_sb, WDAT.SOURCE_BUF_P, CMP_BUFFER_SIZE, &trash_how);
+            }
+            if (rc) {
+               assert(strerror_r(errno, errstr, sizeof(errstr)) == 0);
+               WS[w_id]->NWarnings += 1;
+               fprintf(WERR, "WARNING: In \"%s\", cannot -trash \"%s\" to \"%s\" (%s)\n",
+                  AbsPathDir, FileName, trash_tdir, errstr);
+               sprintf(rm_rc_str, "%d", rc);
+            } else {
+               WS[w_id]->NTrashed += 1;
+               if (trash_how == TRASH_COPIED) WS[w_id]->NTrashCopied += 1;
+            }
+         }
          if (!PWquiet) {
-            if (rm_path_hits == 1) fprintf(WLOG, "@ cd \"%s\"\n", AbsPathDir);
-            fprintf(WLOG, "%s rm \"%s\"\n", rm_rc_str, FileName);
+            if (rm_path_hits == 1) po_printf(WOUT, "@ cd \"%s\"\n", AbsPathDir);
+            po_puts(WOUT, rm_rc_str);
+            po_write(WOUT, " mv \"", 5);
+            po_puts(WOUT, FileName);
+            po_write(WOUT, "\" \"", 3);
+            po_puts(WOUT, trash_tdir);
+            po_write(WOUT, "/\"\n", 3);
          }
       }
 
@@ -3103,13 +3899,15 @@ dirent_read_meta: // @@@ GATHER/dirent: stat/fstatat() info ...
       if (acl_supported && (P_ACL_P || Cmd_XACLS || Cmd_WACLS)) {
          assert(have_stat);		// klooge: primitive insurance
          // INPUT & TRANSLATE: Translate POSIX ACL plus DACL to a single ACL4 ...
+         LAT_BEGIN(t_lat);
          pw_acl4_get_from_posix_acls(AbsPathName, S_ISDIR(dirent_sb.st_mode), &aclstat, &acl4, pw_acls_emsg, &pw_acls_errno);
+         LAT_END(LAT_ACL, t_lat);
          if (PWdebug > 2) fprintf(Plog, "$ AbsPathName=\"%s\" aclstat=%d pw_acls_errno=%d\n", AbsPathName, aclstat, pw_acls_errno);
          if (Opt_TSTAT) { t2 = gethrtime(); ns_getacl = t2 - t1; sprintf(ns_getacl_s," (%lldus) ", ns_getacl/1000); }
          if (pw_acls_errno) {
             DS.NWarnings += 1;
             if (Cmd_XML) {
-               fprintf(WLOG, "<warning> \"%s\": %s (rc=%d) %s </warning>\n",
+               po_printf(WOUT, "<warning> \"%s\": %s (rc=%d) %s </warning>\n",
                   AbsPathName, pw_acls_emsg, pw_acls_errno, strerror(pw_acls_errno));
             } else {
                fprintf(WERR, "WARNING: \"%s\": %s [%d - \"%s\"]\n",
@@ -3142,7 +3940,8 @@ dirent_read_meta: // @@@ GATHER/dirent: stat/fstatat() info ...
                AbsPathDir, AbsPathName);
             goto next_dirent;
          } else {
-            fifo_push(RelPathName, &dirent_sb, w_id);			// PUSH! <<< @$%!#$!! <<< HERE!
+            if (fifo_push(RelPathName, &dirent_sb, w_id))		// PUSH! <<< @$%!#$!! <<< HERE!
+               rmt_gone += 1;		// -rm=tree: it is rmt_done() that decides about this one
          }
       }
       // After possible PUSH, SKIP the rest for non-selected dirents ...
@@ -3161,6 +3960,7 @@ dirent_read_meta: // @@@ GATHER/dirent: stat/fstatat() info ...
       } else {					// other
          DS.NOthers += 1;
       }
+      if (dirent_sb.st_mtime > ru_mtime) ru_mtime = dirent_sb.st_mtime;
 
       // NOTE: To avoid double-counting, we only count nominal directory sizes ONCE; when we pop them,
       // and even then only if -select options are not being used. In all cases, however, directory
@@ -3168,6 +3968,7 @@ dirent_read_meta: // @@@ GATHER/dirent: stat/fstatat() info ...
       // towards the -select'ed totals..
       if (!S_ISDIR(dirent_sb.st_mode)) {
          DS.NBytesLogical += dirent_sb.st_size;
+         PG_ADD(w_id, bytes, dirent_sb.st_size);
          DS.NBytesPhysical += bytes_physical = dirent_sb.st_blocks * ST_BLOCK_SIZE;
       }
 
@@ -3175,7 +3976,19 @@ dirent_read_meta: // @@@ GATHER/dirent: stat/fstatat() info ...
       get_owner_group(&dirent_sb, owner_name, group_name, owner_sid, group_sid);
 
       // @@@ META/dirent: '+tally' accumulation from stat() data ...
-      if (Cmd_TALLY) pwalk_tally_file(&dirent_sb, w_id);
+      if (Cmd_TALLY) pwalk_tally_file(&dirent_sb, FileName, w_id);
+
+      // @@@ META/dirent: '+top=' candidate ...
+      if (Cmd_TOP) top_file(w_id, FileName, &dirent_sb);
+
+      // @@@ META/dirent: '+usage' accumulation, by uid and gid ...
+      if (Cmd_USAGE) usage_file(w_id, &dirent_sb);
+
+      // @@@ META/dirent: -dups candidate, by size ...
+      // NOTE: Multipath mounts of one export may show different st_dev values for one file; without
+      // +span the walk stays in one filesystem anyway, so then inode alone identifies hard links.
+      if (Cmd_DUPS && S_ISREG(dirent_sb.st_mode))
+         dups_add(RelPathName, &dirent_sb, (N_SOURCE_PATHS > 1 && !Opt_SPAN) ? 0 : dirent_sb.st_dev);
 
       // @@@ ACTION/dirent: READONLY operations (+crc, +md5, +denist, etc) ...
       // Multiple purposes will be served from the open file handle ...
@@ -3184,17 +3997,37 @@ dirent_read_meta: // @@@ GATHER/dirent: stat/fstatat() info ...
       // ... For OneFS +rm_acls  we must open each file|dir to get&set its security_descriptor.
       // ... For +crc, +md5, and +denist, we must only open each non-zero-length ordinary file.
       openit = (Cmd_RM_ACLS || (PWget_MASK & PWget_SD));			// MUST open!
-      crc_val = md5_val = 0;
-      if ((dirent_type == DT_REG) && (Cmd_DENIST || P_CRC32 || P_MD5)) {	// MIGHT open ...
+      sums_read = 0;
+      denist_nist = 0;
+      if ((dirent_type == DT_REG) && (Cmd_DENIST || P_SUMS)) {	// MIGHT open ...
          if (dirent_sb.st_size == 0) WS[w_id]->READONLY_Zero_Files += 1;
-         else openit = 1;
+         else if (P_SUMS) openit = 1;
+      }
+
+      // +denist reads its own file handle, usually already opened and read by a helper ...
+      if ((dirent_type == DT_REG) && Cmd_DENIST && dirent_sb.st_size > 0) {
+         denist_n = denist_file(w_id, dfd, FileName, denist_md5);
+         if (denist_n >= 0) WS[w_id]->READONLY_Opens += 1;
+         if (denist_n > 0) {
+            WS[w_id]->READONLY_DENIST_Bytes += denist_n;
+            if ((denist_nist = denist_match(denist_md5))) WS[w_id]->READONLY_DENIST_Matches += 1;
+         } else {
+            WS[w_id]->READONLY_Errors += 1;
+         }
       }
       if (!openit) goto dirent_meta_munge;	// ------< BEGIN OPERATIONS REQUIRING A OPEN() >---------
 
       // We do NOT follow symlinks, ever ...
       // NOTE: OneFS has O_OPENLINK to explicitly permit opening a symlink!
-      if ((fd = openat(SOURCE_DFD(w_id), RelPathName, O_RDONLY|O_NOFOLLOW, 0)) < 0) {
+      // NOTE: Content reads go by the -io= policy ...
+      content_io = (dirent_type == DT_REG && P_SUMS);
+      LAT_BEGIN(t_lat);		// (io_open() times its own)
+      if ((fd = content_io ? io_open(SOURCE_DFD(w_id), RelPathName, IO_SUMS) :
+                             openat(SOURCE_DFD(w_id), RelPathName, O_RDONLY|O_NOFOLLOW, 0)) >= 0 && !content_io)
+         LAT_END(LAT_OPENAT, t_lat);
+      if (fd < 0) {
          WS[w_id]->READONLY_Errors += 1;
+         if (content_io) sums_read = -1;
          assert(strerror_r(errno, errstr, sizeof(errstr)) == 0);
          fprintf(WERR, "ERROR: Cannot READONLY open(\"%s\") (%s)\n", AbsPathName, errstr);
          goto dirent_meta_munge;
@@ -3203,17 +4036,17 @@ dirent_read_meta: // @@@ GATHER/dirent: stat/fstatat() info ...
 
       // klooge: TODO - do all READONLY ops in single pass across file!
 
-      if (Cmd_DENIST) {						// This is ALL that +denist does!
-         nbytes = pread(fd, &rbuf, 128, 0);
-         if (nbytes > 0) WS[w_id]->READONLY_DENIST_Bytes += nbytes;
-         else WS[w_id]->READONLY_Errors += 1;
-      }
-
-      if (P_CRC32 || P_MD5) {		// klooge: need f() to do CRC32 and MD5 in single pass!
-         nbytes = crc32(fd, (void *) rbuf, sizeof(rbuf), &crc_val);
-         if (nbytes > 0) WS[w_id]->READONLY_CRC_Bytes += nbytes;
+      if (P_SUMS) {			// All selected digests from one read of the file ...
+         worker_read_bufs(w_id);
+         nbytes = sums_file(fd, WDAT.SOURCE_BUF_P, CMP_BUFFER_SIZE, P_SUMS, &sums_val, &WS[w_id]->READONLY_Sums);
+         sums_read = 1;
          // Cross-check that we read all bytes of the file ...
-         // ==== if (nbytes != dirent_sb.st_size) WS[w_id]->READONLY_Errors += 1;	// === Add error!
+         if (nbytes != (size_t) dirent_sb.st_size) {
+            WS[w_id]->READONLY_Errors += 1;
+            sums_read = -1;
+            fprintf(WERR, "ERROR: READONLY read(\"%s\") got %llu of %lld bytes\n", AbsPathName,
+               (unsigned long long) nbytes, (long long) dirent_sb.st_size);
+         }
       }
 
 #if defined(__ONEFS__)
@@ -3235,7 +4068,8 @@ dirent_read_meta: // @@@ GATHER/dirent: stat/fstatat() info ...
 #endif
 
       // @@@ ACTION/dirent: End READONLY operations and close() file ...
-      close(fd);	// klooge: SHOULD check rc, but WTF, it's READONLY
+      if (content_io) io_close(fd);
+      else close(fd);	// klooge: SHOULD check rc, but WTF, it's READONLY
 
       // ------------------------------------------------< END OPERATIONS REQUIRING A OPEN() >-----------
 
@@ -3245,8 +4079,11 @@ dirent_meta_munge: // @@@
       // NOTE: ns_stat_s will be empty string unless '+pstat' option is used
       // NOTE: ns_getacl_s will be empty string unless '+pstat' option is used
 
-      // NOTE: crc_str will be empty if +crc not specified
-      if (P_CRC32) sprintf(crc_str, " crc=0x%x", crc_val); else crc_str[0] = '\0';
+      // NOTE: sums_str will be empty unless +crc, +md5, etc. specified; zero-length files get empty-input
+      // NOTE: values, non-regular entries get "md5=-" etc., and files we failed to open or read in full "md5=?"
+      if (sums_read < 0) sums_format_failed(sums_str, P_SUMS);
+      else if (dirent_type != DT_REG) sums_format_none(sums_str, P_SUMS);
+      else sums_format(sums_str, P_SUMS, sums_read ? &sums_val : NULL);
 
 #if defined(BIRTHTIME_CODE)
       // ... EXPERIMENTAL; on OneFS only (NFS clients may not convey birthtime or get it right!)
@@ -3254,7 +4091,7 @@ dirent_meta_munge: // @@@
       //    struct timespec st_mtimespec;
       //    struct timespec st_ctimespec;
       //    struct timespec st_birthtimespec;
-      fprintf(WLOG, "<file>%s%s %lld %s%s b=%lu c=%lu a=%lu m=%lu%s </file>\n",
+      po_printf(WOUT, "<file>%s%s %lld %s%s b=%lu c=%lu a=%lu m=%lu%s </file>\n",
          (PMODE ? " " : ""), mode_str, (long long) dirent_sb.st_size, FileName, ns_stat_s,
          UL(dirent_sb.st_birthtime), UL(dirent_sb.st_ctime), UL(dirent_sb.st_atime), UL(dirent_sb.st_mtime),
          (UL(dirent_sb.st_birthtime) != UL(dirent_sb.st_ctime)) ? " NOTE: B!=C" : ""
@@ -3270,10 +4107,12 @@ dirent_meta_munge: // @@@
       // worker's outputs are cat'ed together.  ;-)
       if (!directory_reported && (dirent_selected && n_dirent_selected == 1)) {
          if (Cmd_LS || Cmd_LSC || Cmd_LSD || Cmd_LSF) {
-            if (w_id || ftell(WLOG)) fprintf(WLOG, "\n");
-            fprintf(WLOG, "@ %s\n", REDACT_RelPathDir);
+            if (w_id || po_tell(WOUT)) po_putc(WOUT, '\n');
+            po_write(WOUT, "@ ", 2);
+            po_puts(WOUT, REDACT_RelPathDir);
+            po_putc(WOUT, '\n');
          } else if (Cmd_XML) {
-            fprintf(WLOG, "<directory>\n<path> %lld%s%s %u %lld %s%s </path>\n",
+            po_printf(WOUT, "<directory>\n<path> %lld%s%s %u %lld %s%s </path>\n",
                bytes_physical, (Opt_PMODE ? " " : ""), mode_str, curdir_sb.st_nlink,
                (long long) curdir_sb.st_size, REDACT_RelPathDir, ns_stat_s);
          }
@@ -3281,43 +4120,90 @@ dirent_meta_munge: // @@@
       }
 
       // @@@ OUTPUT/dirent: Mutually-exclusive primary modes ...
+      // NOTE: Hot path!  Each line below is the moral equivalent of the fprintf() in its comment.
       if (Cmd_LS) {			// -ls
-         if (SELECT_OPTIONS&SELECT_FAKE) {		// Include uid and gid in output ...
-            fprintf(WLOG, "%s %u %u %u %lld %s%s%s\n",
-                    (Opt_PMODE ? mode_str : ""), dirent_sb.st_nlink,
-                    dirent_sb.st_uid, dirent_sb.st_gid,
-                    (long long) dirent_sb.st_size, REDACT_FileName, ns_stat_s, crc_str);
-         } else if (SELECT_OPTIONS&SELECT_SPARSE) {	// Include physical size (1k blocks) in the output ...
+         if ((SELECT_OPTIONS&(SELECT_FAKE|SELECT_SPARSE)) == SELECT_SPARSE) {	// Include physical size (1k blocks) ...
             // If ST_BLOCK_SIZE is 512, normalize to 1K units, rounding up ...
-            fprintf(WLOG, "%lld %s %u %lld %s%s%s\n",
-                    (ST_BLOCK_SIZE == 1024) ? dirent_sb.st_blocks : (dirent_sb.st_blocks+1)/2,
-                    (Opt_PMODE ? mode_str : ""), dirent_sb.st_nlink,
-                    (long long) dirent_sb.st_size, REDACT_FileName, ns_stat_s, crc_str);
-         } else {
-            fprintf(WLOG, "%s %u %lld %s%s%s\n",
-                    (Opt_PMODE ? mode_str : ""), dirent_sb.st_nlink,
-                    (long long) dirent_sb.st_size, REDACT_FileName, ns_stat_s, crc_str);
+            po_puts64(WOUT, (ST_BLOCK_SIZE == 1024) ? dirent_sb.st_blocks : (dirent_sb.st_blocks+1)/2);
+            po_putc(WOUT, ' ');
+         }
+         // "%s %u [%u %u ]%lld %s%s%s\n"
+         if (Opt_PMODE) po_puts(WOUT, mode_str);
+         po_putc(WOUT, ' ');
+         po_putu64(WOUT, (unsigned) dirent_sb.st_nlink);
+         po_putc(WOUT, ' ');
+         if (SELECT_OPTIONS&SELECT_FAKE) {		// Include uid and gid in output ...
+            po_putu64(WOUT, dirent_sb.st_uid);
+            po_putc(WOUT, ' ');
+            po_putu64(WOUT, dirent_sb.st_gid);
+            po_putc(WOUT, ' ');
          }
-      } else if (Cmd_LSC) {		// -lsc
-         fprintf(WLOG, "%c %s\n", mode_str[0], REDACT_FileName);
-      } else if (Cmd_LSF) {		// -lsf
-         fprintf(WLOG, "%c %s\n", mode_str[0], RelPathName);
-      } else if (Cmd_XML) {		// -xml
-         fprintf(WLOG, "<file> %s %u %lld %s%s%s </file>\n",
-            (Opt_PMODE ? mode_str : ""), dirent_sb.st_nlink, (long long) dirent_sb.st_size, REDACT_FileName, ns_stat_s, crc_str);
+         po_puts64(WOUT, (long long) dirent_sb.st_size);
+         po_putc(WOUT, ' ');
+         po_puts(WOUT, REDACT_FileName);
+         po_puts(WOUT, ns_stat_s);
+         po_puts(WOUT, sums_str);
+         if (denist_nist) po_write(WOUT, " NIST", 5);
+         po_putc(WOUT, '\n');
+      } else if (Cmd_LSC || Cmd_LSF) {	// -lsc, -lsf: "%c %s\n"
+         po_putc(WOUT, mode_str[0]);
+         po_putc(WOUT, ' ');
+         po_puts(WOUT, Cmd_LSC ? REDACT_FileName : RelPathName);
+         po_putc(WOUT, '\n');
+      } else if (Cmd_XML) {		// -xml: "<file> %s %u %lld %s%s%s </file>\n"
+         po_write(WOUT, "<file> ", 7);
+         if (Opt_PMODE) po_puts(WOUT, mode_str);
+         po_putc(WOUT, ' ');
+         po_putu64(WOUT, (unsigned) dirent_sb.st_nlink);
+         po_putc(WOUT, ' ');
+         po_puts64(WOUT, (long long) dirent_sb.st_size);
+         po_putc(WOUT, ' ');
+         po_puts(WOUT, REDACT_FileName);
+         po_puts(WOUT, ns_stat_s);
+         po_puts(WOUT, sums_str);
+         if (denist_nist) po_write(WOUT, " NIST", 5);
+         po_write(WOUT, " </file>\n", 9);
       } else if (Cmd_CMP) {		// -cmp
-         if (cmp_target_dir_exists)
-            cmp_source_target(w_id, RelPathName, &dirent_sb, cmp_file_result_str);
-         else // File CANNOT exist!
+         cmp_file_result = 0;
+         if (!cmp_target_dir_exists) {		// File CANNOT exist!
             strcpy(cmp_file_result_str, "E");
-         if (strcmp(cmp_file_result_str, "-")) {	// Only report differences
+         } else if (!cmp_tloaded) {		// No preload; stat() from TARGET root
+            cmp_file_result = cmp_source_target(w_id, RelPathName, TARGET_DFD(w_id), RelPathName,
+               &dirent_sb, cmp_file_result_str, &cmp_cache_key);
+         } else if (cmp_tent < 0 ||		// Not in TARGET, or type is all we check and d_type has it
+                    ((cmp_ttype = cmp_tdir_type(w_id, cmp_tent)) != DT_UNKNOWN &&
+                     (cmp_Check&~(CMP_notfound|CMP_type)) == 0)) {
+            if (cmp_tent < 0) cmp_file_result = CMP_notfound;
+            else if ((dirent_sb.st_mode&S_IFMT) != DTTOIF(cmp_ttype)) cmp_file_result = CMP_type;
+            cmp_result_format(cmp_file_result, cmp_file_result_str);
+            WS[w_id]->CMP_Target_Nostat += 1;
+         } else if (CMP_MANIFEST_FILE) {	// Recorded metadata and digest
+            cmp_file_result = cmp_metadata(w_id, RelPathName, &dirent_sb, cmp_tdir_stat(w_id, cmp_tent),
+               cmp_tdir_digest(w_id, cmp_tent), cmp_file_result_str, NULL);
+            WS[w_id]->CMP_Target_Nostat += 1;
+         } else {
+            cmp_file_result = cmp_source_target(w_id, RelPathName, cmp_tdfd, FileName,
+               &dirent_sb, cmp_file_result_str, &cmp_cache_key);
+         }
+         if (cmp_file_result&CMP_chunked) {		// Big file; reported when its chunks are done
+            cmp_chunk_file(w_id, RelPathName, dirent_sb.st_size, cmp_file_result, &cmp_cache_key,
+               mode_str[0], cmp_dir_result_str, RelPathDir, FileName);
+         } else if (strcmp(cmp_file_result_str, "-")) {	// Only report differences
             if (!cmp_dir_reported) {			// If we deferred reporting directory, do it now
-               if (ftell(WDAT.wlog)) fprintf(WLOG, "\n");	// blank line before each new directory
-               fprintf(WLOG, "@ %s %s\n", cmp_dir_result_str, RelPathDir);
+               if (po_tell(WOUT)) po_putc(WOUT, '\n');	// blank line before each new directory
+               po_printf(WOUT, "@ %s %s\n", cmp_dir_result_str, RelPathDir);
                cmp_dir_reported = TRUE;
             }
-            fprintf(WLOG, "%c %s %s\n", mode_str[0], cmp_file_result_str, FileName);
+            po_putc(WOUT, mode_str[0]);		// "%c %s %s\n"
+            po_putc(WOUT, ' ');
+            po_puts(WOUT, cmp_file_result_str);
+            po_putc(WOUT, ' ');
+            po_puts(WOUT, FileName);
+            po_putc(WOUT, '\n');
          }
+      } else if (Cmd_MANIFEST) {		// -manifest: "<record>\n"; digest w/o sums_str's leading ' '
+         if (sums_read >= 0)		// ... but no record for files we couldn't digest (see .err)
+            manifest_put(WOUT, "", &dirent_sb, (P_SUMS && dirent_type == DT_REG) ? sums_str + 1 : NULL, FileName);
       } else if (Cmd_AUDIT) {		// -audit
 #if PWALK_AUDIT // OneFS only
          pwalk_audit_file(RelPathName, &dirent_sb, w_id);
@@ -3326,9 +4212,20 @@ dirent_meta_munge: // @@@
 #endif // PWALK_AUDIT
       } else if (Cmd_FIXTIMES) {	// -fixtimes
          pwalk_fix_times(FileName, RelPathName, &dirent_sb, w_id);
-      } else if (Cmd_CSV) {		// -csv= (DEVELOPMENTAL: Temporary placeholder code)
-         fprintf(WLOG, "%u,%s,%s,%u,%s,%s,\"%s\"\n",
-            dirent_sb.st_uid, owner_name, owner_sid, dirent_sb.st_gid, group_name, group_sid, RelPathName);
+      } else if (Cmd_CSV) {		// -csv[=<fields>]
+         csv_entry.path = RelPathName;
+         csv_entry.abspath = AbsPathName;
+         csv_entry.name = FileName;
+         csv_entry.sb = &dirent_sb;
+         csv_entry.mode_str = mode_str;
+         csv_entry.owner_name = owner_name;
+         csv_entry.group_name = group_name;
+         csv_entry.owner_sid = owner_sid;
+         csv_entry.group_sid = group_sid;
+         csv_entry.ref_time = time(NULL);
+         csv_entry.walk_time = CSV_WALK_TIME;
+         csv_entry.st_block_size = ST_BLOCK_SIZE;
+         po_commit(WOUT, csv_format_row(po_reserve(WOUT, CSV_ROW_MAX), &csv_entry));
       }
 
 #if PWALK_ACLS // Linux-only ACL-related outputs ...
@@ -3363,9 +4260,11 @@ next_dirent:
 
    // @@@ DIRECTORY_SCAN_LOOP/end: Subtotals & such ...
 dir_summary:
+   if (trash_tdfd >= 0) close(trash_tdfd);
    if (dir != NULL) {
+      if (Cmd_DENIST) denist_batch_end(w_id);	// Helpers are done with dfd
       rc = closedir(dir);
-      if (VERBOSE > 2) { fprintf(WLOG, "@closedir rc=%d\n", rc); fflush(WLOG); }
+      if (VERBOSE > 2) { po_printf(WOUT, "@closedir rc=%d\n", rc); po_flush(WOUT); }
 
       // @@@ STATS (directory exit): Aggregate per-directory statistics (DS.<value>) to per-worker
       // statistics (WS[w_id]-><value>) After workers finish, per-worker statistsics will be
@@ -3386,15 +4285,40 @@ dir_summary:
       WS[w_id]->NHardLinkFiles += DS.NHardLinkFiles;
       WS[w_id]->NHardLinks += DS.NHardLinks;
 
+      // @@@ OUTPUT/directory_exit: -cmp names in the preloaded TARGET dir that SOURCE lacks ...
+      // NOTE: Not with -select options, which cannot be applied to what only TARGET has.
+      // A directory only in TARGET is reported as one line; it is not descended into.
+      if (cmp_tloaded && SELECT_OPTIONS == 0) {
+         cmp_titer = 0;
+         while ((cmp_tname = cmp_tdir_unmatched(w_id, &cmp_titer, &cmp_ttype)) != NULL) {
+            WS[w_id]->CMP_Target_Only += 1;
+            if (cmp_ttype != DT_UNKNOWN) format_mode_bits(mode_str, DTTOIF(cmp_ttype));
+            else if (cmp_tdfd >= 0 && fstatat(cmp_tdfd, cmp_tname, &cmp_tsb, AT_SYMLINK_NOFOLLOW) == 0)
+               format_mode_bits(mode_str, cmp_tsb.st_mode);
+            else strcpy(mode_str, "?");
+            if (!cmp_dir_reported) {
+               if (po_tell(WOUT)) po_putc(WOUT, '\n');
+               po_printf(WOUT, "@ %s %s\n", cmp_dir_result_str, RelPathDir);
+               cmp_dir_reported = TRUE;
+            }
+            po_putc(WOUT, mode_str[0]);		// "%c X %s\n"
+            po_write(WOUT, " X ", 3);
+            po_puts(WOUT, cmp_tname);
+            po_putc(WOUT, '\n');
+         }
+      }
+
       // @@@ OUTPUT/directory_start: klooge (repeated code) for *empty* directories ...
       // Empty directories never have a dirent to trigger the directory start reporting.
       // Non-empty directories will have reported the directory start in the dirent loop.
       if ((SELECT_OPTIONS == 0) && !directory_reported) {
          if (Cmd_LS || Cmd_LSC || Cmd_LSD || Cmd_LSF) {
-            if (w_id || ftell(WLOG)) fprintf(WLOG, "\n");
-            fprintf(WLOG, "@ %s\n", REDACT_RelPathDir);
+            if (w_id || po_tell(WOUT)) po_putc(WOUT, '\n');
+            po_write(WOUT, "@ ", 2);
+            po_puts(WOUT, REDACT_RelPathDir);
+            po_putc(WOUT, '\n');
          } else if (Cmd_XML) {
-            fprintf(WLOG, "<directory>\n<path> %lld%s%s %u %lld %s%s </path>\n",
+            po_printf(WOUT, "<directory>\n<path> %lld%s%s %u %lld %s%s </path>\n",
                bytes_physical, (Opt_PMODE ? " " : ""), mode_str, curdir_sb.st_nlink,
                (long long) curdir_sb.st_size, REDACT_RelPathDir, ns_stat_s);
          }
@@ -3404,11 +4328,11 @@ dir_summary:
       // @@@ OUTPUT/directory_exit: End-of-directory output ...
       if ((SELECT_OPTIONS == 0) || (SELECT_OPTIONS && n_dirent_selected > 0)) {
          if (Cmd_XML) {
-            fprintf(WLOG, "<summary> f=%llu d=%llu s=%llu o=%llu errs=%llu lsize=%lld psize=%llu </summary>\n",
+            po_printf(WOUT, "<summary> f=%llu d=%llu s=%llu o=%llu errs=%llu lsize=%lld psize=%llu </summary>\n",
                DS.NFiles, DS.NDirs, DS.NSymlinks, DS.NOthers, DS.NStatErrs, DS.NBytesLogical, DS.NBytesPhysical);
-            fprintf(WLOG, "</directory>\n");
+            po_printf(WOUT, "</directory>\n");
          } else if (Cmd_LS || Cmd_LSC || Cmd_LSD || Cmd_LSF) {
-            fprintf(WLOG, "S: f=%llu d=%llu s=%lld o=%llu z=%llu lsize=%llu psize=%llu errs=%llu\n",
+            po_printf(WOUT, "S: f=%llu d=%llu s=%lld o=%llu z=%llu lsize=%llu psize=%llu errs=%llu\n",
                DS.NFiles, DS.NDirs, DS.NSymlinks, DS.NOthers,
                DS.NZeroFiles, DS.NBytesLogical, DS.NBytesPhysical, DS.NStatErrs);
          } else if (Cmd_RM && DS.NRemoved) {
@@ -3417,13 +4341,248 @@ dir_summary:
       }
    }
 
+   // @@@ ACTION/directory_exit: -rm=tree rmdir()s this directory once it and everything below
+   // it are done, then each ancestor this was the last thing outstanding for ...
+   // NOTE: With -select options, a directory that was empty to begin with is not 'emptied'.
+   if (Cmd_RM_TREE) {
+      rmt_n = rmt_done(RelPathDir, dir == NULL || rmt_gone < rmt_seen || (SELECT_OPTIONS && rmt_seen == 0));
+      for ( ; rmt_n; rmt_n = rmt_removed(rmt_n, rc == 0)) {
+         rm_rc_str[0] = '0'; rm_rc_str[1] = '\0';
+         rc = 0;
+         if (PWdryrun) {
+            rm_rc_str[0] = '#';
+         } else if ((rc = unlinkat(SOURCE_DFD(w_id), rmt_path(rmt_n), AT_REMOVEDIR))) {
+            assert(strerror_r(errno, errstr, sizeof(errstr)) == 0);
+            WS[w_id]->NWarnings += 1;
+            fprintf(WERR, "WARNING: Cannot -rm=tree rmdir \"%s\" (%s)\n", rmt_path(rmt_n), errstr);
+            sprintf(rm_rc_str, "%d", rc);
+         } else {
+            WS[w_id]->NRemovedDirs += 1;
+         }
+         if (!PWquiet) {
+            catpath3(AbsPathName, SOURCE_PATH(w_id), (char *) rmt_path(rmt_n), NULL);
+            po_puts(WOUT, rm_rc_str);
+            po_write(WOUT, " rmdir \"", 8);
+            po_puts(WOUT, AbsPathName);
+            po_write(WOUT, "\"\n", 2);
+         }
+      }
+   }
+
+   // @@@ OUTPUT/directory_exit: +rollup adds this directory's totals to its subtree's ...
+   if (Cmd_ROLLUP) {
+      bzero(&ru_t, sizeof(ru_t));
+      if (dir != NULL) {
+         ru_t.files = DS.NFiles;
+         ru_t.dirs = DS.NDirs;
+         ru_t.lsize = DS.NBytesLogical;
+         ru_t.psize = DS.NBytesPhysical;
+         ru_t.max_mtime = ru_mtime;
+      }
+      ru_done(RelPathDir, &ru_t);
+   }
+   if (Cmd_TOP && dir != NULL) top_entries(w_id, DS.NScanned);
+
    // @@@ End traversing current directory -- flush outputs ...
-   fflush(WLOG);	// Flush worker's output at end of each directory scan ...
-   LogMsg(NULL, 1);	// ... also force main pwalk.log flush with possible progress report
+   PG_ADD(w_id, dirs, 1);
+   if (cmp_tloaded) cmp_tdir_close(w_id);
+   if (Opt_MERGE)	// -merge takes the whole directory's output as one sortable block ...
+      merge_put_block(w_id, RelPathDir, WOUT);
+   worker_flush(w_id);
 }	// +++++ klooge: BREAK UP THIS SPAGHETTI CODE: END +++++
 
 // @@@ SECTION: Top-level pwalk logic & main() @@@
 
+// pwalk_merge_output() - -merge post-phase; all workers' blocks into one path-sorted
+// ${OUTPUT_DIR}/pwalk_merged.<ftype>[.gz] file.
+
+void
+pwalk_merge_output(void)
+{
+   MERGE_OUTPUT_T mo;
+   MERGE_STATS_T ms;
+   PW_OBUF prologue;
+   char ofile[MAX_PATHLEN+64];
+   long long t0, t1;
+   char ebuf[64];
+
+   sprintf(ofile, "%s%cpwalk_merged.%s%s", OUTPUT_DIR, PATHSEPCHR, primary_ftype(), Opt_GZ ? ".gz" : "");
+   po_init(&prologue, NULL, WORKER_OUT_BUF_SIZE);
+   prologue.hold = 1;
+   output_headings(&prologue);
+   po_putc(&prologue, '\0');
+
+   mo.ofile = ofile;
+   mo.gz = Opt_GZ;
+   mo.sep = (Cmd_LS || Cmd_LSC || Cmd_LSD || Cmd_LSF || Cmd_CMP) ? "\n" : "";
+   mo.prologue = prologue.buf;
+   mo.trailer = Cmd_XML ? "\n</xml-listing>\n" : "";
+   mo.nthreads = N_WORKERS;
+
+   t0 = gethrtime();
+   merge_finish(&mo, &ms);
+   t1 = gethrtime();
+   po_free(&prologue);
+
+   fprintf(Plog, "@ -merge: %llu block%s (%llu bytes) from %llu run%s (%llu bytes spilled), %d partition%s, %s\n",
+      ms.blocks, (ms.blocks != 1) ? "s" : "", ms.bytes, ms.runs, (ms.runs != 1) ? "s" : "",
+      ms.spill_bytes, ms.parts, (ms.parts != 1) ? "s" : "", format_ns_delta_t(ebuf, t0, t1));
+   fprintf(Plog, "@ -merge: output = %s\n", ofile);
+}
+
+// dups_worker() - A worker's share of a -dups hashing stage, using its own source path and
+// read buffer.
+
+void
+dups_worker(int w_id)
+{
+   worker_read_bufs(w_id);
+   dups_hash(w_id, SOURCE_DFD(w_id), WorkerData[w_id].SOURCE_BUF_P, CMP_BUFFER_SIZE);
+}
+
+// pwalk_dups_output() - -dups post-phase; hash same-size candidates on the worker pool,
+// stage by stage, then write ${OUTPUT_DIR}/pwalk_dups.txt.
+
+void
+pwalk_dups_output(void)
+{
+   DUPS_STATS_T ds;
+   char ofile[MAX_PATHLEN+64];
+   long long t0, t1;
+   char ebuf[64];
+
+   t0 = gethrtime();
+   while (dups_next_stage()) run_worker_phase(dups_worker);
+   sprintf(ofile, "%s%cpwalk_dups.txt", OUTPUT_DIR, PATHSEPCHR);
+   dups_output(ofile, &ds);
+   t1 = gethrtime();
+
+   fprintf(Plog, "@ -dups: %llu file%s of %llu distinct size%s; %llu candidate%s; %llu sampled, %llu fully hashed (%llu bytes read), %s\n",
+      ds.files, (ds.files != 1) ? "s" : "", ds.sizes, (ds.sizes != 1) ? "s" : "",
+      ds.candidates, (ds.candidates != 1) ? "s" : "", ds.sampled, ds.full, ds.bytes_read,
+      format_ns_delta_t(ebuf, t0, t1));
+   fprintf(Plog, "@ -dups: %llu group%s, %llu redundant cop%s, %llu bytes reclaimable (%llu more hard link%s, %llu error%s)\n",
+      ds.groups, (ds.groups != 1) ? "s" : "", ds.dups, (ds.dups != 1) ? "ies" : "y", ds.reclaimable,
+      ds.links, (ds.links != 1) ? "s" : "", ds.errors, (ds.errors != 1) ? "s" : "");
+   fprintf(Plog, "@ -dups: output = %s\n", ofile);
+}
+
+// init_cmp_manifest() - Index -cmp=manifest:<file>; -cmp=content needs recorded digests.
+
+void
+init_cmp_manifest(void)
+{
+   char digest[32];
+   long long n;
+
+   if ((n = cmp_manifest_init(CMP_MANIFEST_FILE, digest, sizeof(digest))) < 0) {
+      fprintf(Plog, "ERROR: -cmp=manifest:%s is unreadable, or not a -manifest file!\n", CMP_MANIFEST_FILE);
+      exit(-1);
+   }
+   fprintf(Plog, "@ -cmp=manifest: %lld director%s indexed from %s (digest=%s)\n",
+      n, (n != 1) ? "ies" : "y", CMP_MANIFEST_FILE, digest);
+   if ((cmp_Check&CMP_content) && strcmp(digest, "none") == 0) {
+      fprintf(Plog, "ERROR: -cmp=content needs a manifest written with a +<digest>!\n");
+      exit(-1);
+   }
+}
+
+// init_cmp_cache() - Load -cmp_cache=<file>; a missing file is just an empty cache.
+
+void
+init_cmp_cache(void)
+{
+   long long n;
+
+   if ((n = cmp_cache_init(CMP_CACHE_FILE, CMP_REVERIFY_PCT)) < 0) {
+      fprintf(Plog, "ERROR: -cmp_cache=%s is unreadable, or not a -cmp_cache file!\n", CMP_CACHE_FILE);
+      exit(-1);
+   }
+   fprintf(Plog, "@ -cmp_cache: %lld verified pair%s loaded from %s", n, (n != 1) ? "s" : "", CMP_CACHE_FILE);
+   if (CMP_REVERIFY_PCT) fprintf(Plog, "; re-verifying %d%% of hits", CMP_REVERIFY_PCT);
+   fprintf(Plog, "\n");
+}
+
+// pwalk_cmp_cache_save() - -cmp_cache post-phase; rewrite the cache file.
+
+void
+pwalk_cmp_cache_save(void)
+{
+   CMP_CACHE_STATS cs;
+
+   if (cmp_cache_save(&cs) != 0) {
+      fprintf(Plog, "ERROR: Cannot rewrite -cmp_cache=%s; errno=%d\n", CMP_CACHE_FILE, errno);
+      return;
+   }
+   fprintf(Plog, "@ -cmp_cache: %llu verified pair%s saved to %s (%llu of %llu kept, %llu added)\n",
+      cs.kept + cs.added, (cs.kept + cs.added != 1) ? "s" : "", CMP_CACHE_FILE, cs.kept, cs.loaded, cs.added);
+}
+
+// init_denist() - Load +denist=<hashlist>, if given.
+
+void
+init_denist(void)
+{
+   long long n;
+
+   if ((n = denist_init(DENIST_FILE, DENIST_DEPTH)) < 0) {
+      fprintf(Plog, "ERROR: +denist=%s is unreadable!\n", DENIST_FILE);
+      exit(-1);
+   }
+   if (DENIST_FILE) fprintf(Plog, "@ +denist: %lld MD5%s loaded from %s\n", n, (n != 1) ? "s" : "", DENIST_FILE);
+}
+
+// init_sums() - Self-test digest code and pick the fastest implementations; log which
+// ones, and their hot-cache speeds, since +crc, +md5, etc. should then be bound by I/O,
+// not CPU.
+
+void
+init_sums(void)
+{
+   double mbps;
+   void *buf;
+   int i;
+
+   if (sums_init() != 0) abend("+crc/+md5/etc. self-test failed!");
+   buf = malloc(1024*1024);
+   if (buf == NULL) abend("Cannot malloc +crc/+md5/etc. benchmark buffer!");
+   for (i = 0; i < SUM_NALGS; i++) {
+      if (!(P_SUMS & (1 << i))) continue;
+      mbps = sums_bench(1 << i, buf, 1024*1024);
+      fprintf(Plog, "@ +%s: self-test OK; %s implementation, %.0f MB/s (hot cache)\n",
+         SUM_NAMES[i], sums_impl(1 << i), mbps);
+   }
+   free(buf);
+}
+
+// init_shards() - -shards setup; register every output type that will be sharded, with
+// the headings and trailer each shard file of that type needs.
+
+void
+init_shards(void)
+{
+   PW_OBUF prologue;
+   char *ftype, *trailer;
+   static char zeroes[8];	// +xacls=bin terminator
+
+   wr_shards_init(OUTPUT_DIR, N_SHARDS, SHARD_SIZE, SHARD_TIME);
+   if ((ftype = primary_ftype())) {
+      po_init(&prologue, NULL, WORKER_OUT_BUF_SIZE);
+      prologue.hold = 1;
+      output_headings(&prologue);
+      trailer = Cmd_XML ? "\n</xml-listing>\n" : "";
+      wr_shard_type(ftype, Opt_GZ, prologue.buf, prologue.len, trailer, strlen(trailer));
+      po_free(&prologue);
+   }
+   if (WR_HAVE_FOPEN) {
+      wr_shard_type("err", 0, "", 0, "", 0);
+      if (Cmd_XACLS & Cmd_XACLS_BIN) wr_shard_type("acl4bin", 0, "", 0, zeroes, sizeof(zeroes));
+      if (Cmd_XACLS & Cmd_XACLS_CHEX) wr_shard_type("acl4chex", 0, "", 0, "", 0);
+      if (Cmd_XACLS & Cmd_XACLS_NFS) wr_shard_type("acl4nfs", 0, "", 0, "", 0);
+      if (Cmd_XACLS & Cmd_XACLS_ONEFS) wr_shard_type("acl4onefs", 0, "", 0, "", 0);
+   }
+}
+
 // check_maxfiles() - Spot check max open file limit
 
 void
@@ -3617,17 +4776,31 @@ process_arglist(int argc, char *argv[])
          Cmd_CMP = 1;
       } else if (strcmp(arg, "-fix_times") == 0 || strcmp(arg, "-fix-times") == 0) {
          Cmd_FIXTIMES = 1;
-      } else if (strcmp(arg, "-rm") == 0) {
+      } else if (strcmp(arg, "-rm") == 0 || strcmp(arg, "-rm=tree") == 0) {
          Cmd_RM = 1;
+         Cmd_RM_TREE = (arg[3] == '=');
+      } else if (strcmp(arg, "-dups") == 0 || strncmp(arg, "-dups=", 6) == 0) {
+         Cmd_DUPS = 1;
+         if (arg[5] == '=' && parse_64u(arg+6, &DUPS_MIN_SIZE) != 0) {
+            fprintf(stderr, "ERROR: -dups=<min_bytes> value invalid!\n");
+            exit(-1);
+         }
+      } else if (strcmp(arg, "-manifest") == 0) {
+         Cmd_MANIFEST = 1;
       } else if (strcmp(arg, "-trash") == 0) {
          Cmd_TRASH = 1;
-         assert("-trash primary mode not-yet implemented" == NULL);
-         exit(-42);
-      } else if (strncmp(arg, "-csv=", 5) == 0) {	// DEVELOPMENTAL ====
-         csv_pfile_parse(arg+5);
+      } else if (strcmp(arg, "-csv") == 0 || strncmp(arg, "-csv=", 5) == 0) {
+         if (strcmp(arg, "-csv=help") == 0) { csv_fields_help(stdout); exit(0); }
+         if (arg[4] == '=') CSV_ARG = arg+5;
          Cmd_CSV = 1;
-      } else if (strcmp(arg, "+denist") == 0) {
+      } else if (strcmp(arg, "+denist") == 0 || strncmp(arg, "+denist=", 8) == 0) {
+         if (arg[7] == '=') DENIST_FILE = arg+8;
          Cmd_DENIST = 1;
+      } else if (strncmp(arg, "-denist_depth=", 14) == 0) {
+         if (sscanf(arg+14, "%d", &DENIST_DEPTH) != 1 || DENIST_DEPTH < 0 || DENIST_DEPTH > DENIST_DEPTH_MAX) {
+            fprintf(stderr, "ERROR: -denist_depth=<n> value invalid (0-%d)!\n", DENIST_DEPTH_MAX);
+            exit(-1);
+         }
 #if defined(__ONEFS__)	// OneFS only features
       } else if (strcmp(arg, "+rm_acls") == 0) {
          Cmd_RM_ACLS = 1;
@@ -3638,6 +4811,23 @@ process_arglist(int argc, char *argv[])
          if (strlen(arg) > 7) TALLY_TAG = arg + 7;	// <tag> value for +tally output
          N_TALLY_BUCKETS=1;	 // Count the compile-time default buckets ...
          while (TALLY_BUCKET_SIZE[N_TALLY_BUCKETS]) N_TALLY_BUCKETS++;
+      } else if (strcmp(arg, "+rollup") == 0) {
+         Cmd_ROLLUP = 1;
+      } else if (strncmp(arg, "+top=", 5) == 0) {
+         if (top_parse(arg+5) != 0) {
+            fprintf(stderr, "ERROR: +top= value invalid (<N>:<metric>[,...]; metrics: size,psize,mtime,atime,entries,depth)!\n");
+            exit(-1);
+         }
+         Cmd_TOP = 1;
+      } else if (strcmp(arg, "+usage") == 0) {
+         Cmd_USAGE = 1;
+      } else if (strcmp(arg, "+usage=top") == 0) {
+         Cmd_USAGE = 2;
+      } else if (strncmp(arg, "+tally_by=", 10) == 0) {
+         if (tally_by_parse(arg+10) != 0) {
+            fprintf(stderr, "ERROR: +tally_by= value invalid (<dim>[+<dim>...][,...]; dims: uid,top,age,atime,ext,size)!\n");
+            exit(-1);
+         }
 #if PWALK_ACLS // ACL-related command args (Linux only) ...
       } else if (strncmp(arg, "+wacls=", 7) == 0) {	// Write binary NFS4 ACLS over a pipe ...
          Cmd_WACLS = 1;
@@ -3655,11 +4845,106 @@ process_arglist(int argc, char *argv[])
       } else if (strcmp(arg, "+acls") == 0) {		// showing ACL presence (ie: with '+')
          P_ACL_P = TRUE;
       } else if (strcmp(arg, "+crc") == 0) {		// Tag-along modes ...
-         P_CRC32 = 1;
+         P_SUMS |= SUM_CRC32;
+      } else if (strcmp(arg, "+crc32c") == 0) {
+         P_SUMS |= SUM_CRC32C;
+      } else if (strcmp(arg, "+md5") == 0) {
+         P_SUMS |= SUM_MD5;
+      } else if (strcmp(arg, "+sha1") == 0) {
+         P_SUMS |= SUM_SHA1;
+      } else if (strcmp(arg, "+sha256") == 0) {
+         P_SUMS |= SUM_SHA256;
+      } else if (strcmp(arg, "+xxh64") == 0) {
+         P_SUMS |= SUM_XXH64;
+      } else if (strcmp(arg, "+lat") == 0) {
+         Opt_LAT = 1;
       } else if (strcmp(arg, "+tstat") == 0) {		// also add timed stats
          Opt_TSTAT = 1;
       } else if (strcmp(arg, "-gz") == 0) {
          Opt_GZ = 1;
+      } else if (strcmp(arg, "-merge") == 0 || strncmp(arg, "-merge=", 7) == 0) {
+         Opt_MERGE = 1;
+         if (arg[6] == '=' && (parse_64u(arg+7, &MERGE_MEM) != 0 || MERGE_MEM == 0)) {
+            fprintf(stderr, "ERROR: -merge=<bytes> value invalid!\n");
+            exit(-1);
+         }
+      } else if (strncmp(arg, "-writers=", 9) == 0) {
+         if (sscanf(arg+9, "%d", &N_WRITERS) != 1 || N_WRITERS < 0 || N_WRITERS > 64) {
+            fprintf(stderr, "ERROR: -writers=<N> value invalid (0-64)!\n");
+            exit(-1);
+         }
+      } else if (strncmp(arg, "-shards=", 8) == 0) {
+         if (sscanf(arg+8, "%d", &N_SHARDS) != 1 || N_SHARDS < 1 || N_SHARDS > 999) {
+            fprintf(stderr, "ERROR: -shards=<N> value invalid (1-999)!\n");
+            exit(-1);
+         }
+      } else if (strncmp(arg, "-shard_size=", 12) == 0) {
+         if (parse_64u(arg+12, &SHARD_SIZE) != 0 || SHARD_SIZE == 0) {
+            fprintf(stderr, "ERROR: -shard_size=<bytes> value invalid!\n");
+            exit(-1);
+         }
+      } else if (strncmp(arg, "-shard_time=", 12) == 0) {
+         if (sscanf(arg+12, "%d", &SHARD_TIME) != 1 || SHARD_TIME < 1) {
+            fprintf(stderr, "ERROR: -shard_time=<secs> value invalid!\n");
+            exit(-1);
+         }
+      } else if (strncmp(arg, "-cmp_bufsize=", 13) == 0) {
+         if (parse_64u(arg+13, &CMP_BUFFER_SIZE) != 0 ||
+             CMP_BUFFER_SIZE < CMP_BUFSIZE_MIN || CMP_BUFFER_SIZE > CMP_BUFSIZE_MAX) {
+            fprintf(stderr, "ERROR: -cmp_bufsize=<bytes> value invalid (64Ki-64Mi)!\n");
+            exit(-1);
+         }
+      } else if (strncmp(arg, "-cmp_chunk=", 11) == 0) {
+         if (parse_64u(arg+11, &CMP_CHUNK_SIZE) != 0 || (CMP_CHUNK_SIZE && CMP_CHUNK_SIZE < CMP_CHUNK_MIN)) {
+            fprintf(stderr, "ERROR: -cmp_chunk=<bytes> value invalid (0, or at least 64Mi)!\n");
+            exit(-1);
+         }
+      } else if (strncmp(arg, "-cmp_cache=", 11) == 0) {
+         CMP_CACHE_FILE = arg+11;
+      } else if (strncmp(arg, "-cmp_reverify=", 14) == 0) {
+         if (sscanf(arg+14, "%d", &CMP_REVERIFY_PCT) != 1 || CMP_REVERIFY_PCT < 0 || CMP_REVERIFY_PCT > 100) {
+            fprintf(stderr, "ERROR: -cmp_reverify=<pct> value invalid (0-100)!\n");
+            exit(-1);
+         }
+      } else if (strncmp(arg, "-io=", 4) == 0) {
+         if ((IO_POLICY = io_policy_parse(arg+4)) < 0) {
+            fprintf(stderr, "ERROR: -io=<policy> value invalid (buffered, dontneed, direct)!\n");
+            exit(-1);
+         }
+      } else if (strncmp(arg, "-io_readahead=", 14) == 0) {
+         if (parse_64u(arg+14, &IO_READAHEAD) != 0) {
+            fprintf(stderr, "ERROR: -io_readahead=<bytes> value invalid!\n");
+            exit(-1);
+         }
+      } else if (strncmp(arg, "-flush=", 7) == 0) {
+         if (sscanf(arg+7, "%d", &FLUSH_SECS) != 1 || FLUSH_SECS < 0) {
+            fprintf(stderr, "ERROR: -flush=<secs> value invalid!\n");
+            exit(-1);
+         }
+      } else if (strncmp(arg, "-progress=", 10) == 0) {
+         if (sscanf(arg+10, "%d", &PROGRESS_SECS) != 1 || PROGRESS_SECS < 1) {
+            fprintf(stderr, "ERROR: -progress=<secs> value invalid!\n");
+            exit(-1);
+         }
+      } else if (strcmp(arg, "-metrics") == 0) {
+         Opt_METRICS = 1;
+      } else if (strncmp(arg, "-metrics=", 9) == 0) {
+         Opt_METRICS = 1;
+         METRICS_FILE = arg+9;
+         if (*METRICS_FILE == '\0') {
+            fprintf(stderr, "ERROR: -metrics=<file> value missing!\n");
+            exit(-1);
+         }
+      } else if (strncmp(arg, "-metrics_secs=", 14) == 0) {
+         if (sscanf(arg+14, "%d", &METRICS_SECS) != 1 || METRICS_SECS < 1) {
+            fprintf(stderr, "ERROR: -metrics_secs=<secs> value invalid!\n");
+            exit(-1);
+         }
+      } else if (strncmp(arg, "-metrics_port=", 14) == 0) {
+         if (sscanf(arg+14, "%d", &METRICS_PORT) != 1 || METRICS_PORT < 1 || METRICS_PORT > 65535) {
+            fprintf(stderr, "ERROR: -metrics_port=<port> value invalid!\n");
+            exit(-1);
+         }
       } else if (strcmp(arg, "-redact") == 0) {
          Opt_REDACT = 1;
       } else if (strcmp(arg, "-pmode") == 0) {
@@ -3730,6 +5015,22 @@ process_arglist(int argc, char *argv[])
 
    // @@@ Argument sanity checks @@@
 
+   // @@@ ... +tally_by= implies +tally, with the default buckets unless [tally] gave some ...
+   if (tally_by_count() && !Cmd_TALLY) {
+      Cmd_TALLY = 1;
+      N_TALLY_BUCKETS=1;
+      while (TALLY_BUCKET_SIZE[N_TALLY_BUCKETS]) N_TALLY_BUCKETS++;
+   }
+
+   if (Cmd_ROLLUP && Opt_REDACT) {	// Its paths are not redacted
+      fprintf(Plog, "ERROR: +rollup cannot be used with -redact!\n");
+      exit(-1);
+   }
+   if (Cmd_TOP && Opt_REDACT) {
+      fprintf(Plog, "ERROR: +top= cannot be used with -redact!\n");
+      exit(-1);
+   }
+
    // @@@ ... Enforce mutual exclusion of PRIMARY modes ...
    nmodes  = Cmd_LS;
    nmodes += Cmd_LSC;
@@ -3742,15 +5043,62 @@ process_arglist(int argc, char *argv[])
    nmodes += Cmd_TRASH;
    nmodes += Cmd_FIXTIMES;
    nmodes += Cmd_AUDIT;
+   nmodes += Cmd_DUPS;
+   nmodes += Cmd_MANIFEST;
    if (nmodes > 1) {
-      p = "ls|lsc|lsd|lsf|xml|csv|cmp|rm|trash|fix_times|audit"; // Mutually Exclusive options
+      p = "ls|lsc|lsd|lsf|xml|csv|cmp|rm|trash|fix_times|audit|dups|manifest"; // Mutually Exclusive options
       fprintf(Plog, "ERROR: Only one PRIMARY mode (%s) can be specified!\n", p);
       exit(-1);
    }
 
+   // @@@ ... -manifest is one path-sorted, uncompressed file, with at most one digest ...
+   if (Cmd_MANIFEST) {
+      if (N_SHARDS || Opt_GZ) {
+         fprintf(Plog, "ERROR: -manifest cannot be used with -shards=<N> or -gz!\n");
+         exit(-1);
+      }
+      if (P_SUMS & (P_SUMS - 1)) {
+         fprintf(Plog, "ERROR: -manifest records at most one +<digest>!\n");
+         exit(-1);
+      }
+      Opt_MERGE = 1;
+   }
+
+   // @@@ ... -merge sorts <primary_mode> outputs, so it needs one (but not -audit) ...
+   if (Opt_MERGE && (primary_ftype() == NULL || Cmd_AUDIT)) {
+      fprintf(Plog, "ERROR: -merge requires a <primary_mode> (other than -audit)!\n");
+      exit(-1);
+   }
+
+   // @@@ ... -shards go through writer thread(s), and are an alternative to -merge ...
+   if ((SHARD_SIZE || SHARD_TIME) && !N_SHARDS) {
+      fprintf(Plog, "ERROR: -shard_size= and -shard_time= require -shards=<N>!\n");
+      exit(-1);
+   }
+   if (N_SHARDS && (N_WRITERS == 0 || Opt_MERGE)) {
+      fprintf(Plog, "ERROR: -shards=<N> cannot be used with -writers=0 or -merge!\n");
+      exit(-1);
+   }
+
+   // @@@ ... Compile -csv fields from -csv=<list> or -pfile= [csv] (but not both) ...
+   if (Cmd_CSV) {
+      if (CSV_ARG) {
+         if (csv_nfields() > 0) {
+            fprintf(Plog, "ERROR: Cannot specify both -csv=<fields> and -pfile= [csv] fields!\n");
+            exit(-1);
+         }
+         csv_fields_parse(CSV_ARG);
+      }
+      csv_compile();
+      CSV_WALK_TIME = time(NULL);
+   }
+
    // @@@ ... Enforce that we MUST have at least one PRIMARY or SECONDARY mode specified ...
    nmodes += Cmd_DENIST;
    nmodes += Cmd_TALLY;
+   nmodes += Cmd_ROLLUP;
+   nmodes += Cmd_TOP;
+   nmodes += (Cmd_USAGE != 0);
    nmodes += Cmd_XACLS;
    nmodes += Cmd_WACLS;
    nmodes += Cmd_RM_ACLS;
@@ -3801,12 +5149,32 @@ process_arglist(int argc, char *argv[])
       }
    }
 
-   if (Cmd_CMP && (N_TARGET_PATHS < 1)) {
+   if (Cmd_CMP && (N_TARGET_PATHS < 1) && !CMP_MANIFEST_FILE) {
       fprintf(Plog, "ERROR: '-cmp' requires '-target=' or [target] paths from '-pfile='!\n");
       exit(-1);
    }
 
-   if (N_TARGET_PATHS > 0 && !(Cmd_CMP || Cmd_FIXTIMES)) {
+   if (CMP_MANIFEST_FILE && (N_TARGET_PATHS > 0 || CMP_CACHE_FILE || CMP_REVERIFY_PCT)) {
+      fprintf(Plog, "ERROR: '-cmp=manifest:' cannot be used with '-target=', '-cmp_cache=', or '-cmp_reverify='!\n");
+      exit(-1);
+   }
+
+   if ((CMP_CACHE_FILE || CMP_REVERIFY_PCT) && !(Cmd_CMP && (cmp_Check&CMP_content))) {
+      fprintf(Plog, "ERROR: '-cmp_cache=' and '-cmp_reverify=' require '-cmp=content'!\n");
+      exit(-1);
+   }
+
+   if (IO_POLICY == IO_DIRECT && CMP_BUFFER_SIZE % IO_ALIGN) {
+      fprintf(Plog, "ERROR: '-io=direct' requires a -cmp_bufsize= multiple of %d!\n", IO_ALIGN);
+      exit(-1);
+   }
+
+   if (Cmd_TRASH && (N_TARGET_PATHS < 1)) {
+      fprintf(Plog, "ERROR: '-trash' requires '-target=' or [target] paths from '-pfile='!\n");
+      exit(-1);
+   }
+
+   if (N_TARGET_PATHS > 0 && !(Cmd_CMP || Cmd_TRASH || Cmd_FIXTIMES)) {
       fprintf(Plog, "ERROR: '-target=' or -pfile= [target] only allowed with -cmp, -trash, and -fix_times!\n");
       exit(-1);
    }
@@ -3838,6 +5206,13 @@ process_arglist(int argc, char *argv[])
    if ((N_TARGET_PATHS > 0) && (TARGET_INODES[0] == SOURCE_INODES[0]))
          { fprintf(Plog, "ERROR: source and target paths cannot point to the same place!\n"); exit(-1); }
 
+   // -trash would find what it moved all over again, if its target were under a <directory> arg ...
+   if (Cmd_TRASH) {
+      for (narg=1; narg < argc; narg++)
+         if (*argv[narg] != '-' && *argv[narg] != '+') trash_check_dirarg(argv[narg]);
+      if (dirarg_count == 0) trash_check_dirarg(".");
+   }
+
    // @@@ ... Other argument sanity checks ...
 
    if (N_WORKERS < 0 || N_WORKERS > MAX_WORKERS) {
@@ -3880,6 +5255,8 @@ main(int argc, char *argv[])
 
    unsigned nw_busy;
    count_64 fifo_depth;
+   IO_STATS io_st;
+   unsigned long long j;
 
    // ------------------------------------------------------------------------
 
@@ -3931,6 +5308,28 @@ main(int argc, char *argv[])
    // Create output dir (OUTPUT_DIR), pwalk.log (Plog), and pwalk.fifo ...
    // NOTE: After this, errors all go to Plog rather than stderr ...
    init_main_outputs();
+   if (Opt_MERGE) merge_init(OUTPUT_DIR, N_WORKERS, MERGE_MEM);
+   if (Cmd_DUPS) dups_init(N_WORKERS, DUPS_MIN_SIZE);
+   if (Cmd_CMP) cmp_pipe_init(CMP_BUFFER_SIZE);
+   if (Cmd_CMP && CMP_CHUNK_SIZE) cmp_chunk_init(CMP_CHUNK_SIZE);
+   if (P_SUMS || Cmd_DUPS || CMP_CACHE_FILE || CMP_MANIFEST_FILE || Cmd_DENIST) init_sums();
+   if (Cmd_DENIST) init_denist();
+   if (Cmd_RM_TREE) rmt_init();
+   if (Cmd_TRASH) trash_init();
+   if (Cmd_TALLY) init_tally();
+   if (Cmd_TOP) top_init(ST_BLOCK_SIZE);
+   if (Opt_LAT) lat_init(N_SOURCE_PATHS);
+   if (Cmd_USAGE) usage_init(Cmd_USAGE == 2, ST_BLOCK_SIZE);
+   if (Cmd_ROLLUP && ru_init(OUTPUT_DIR) != 0) {
+      fprintf(Plog, "ERROR: Cannot create pwalk_rollup.csv!\n");
+      exit(-1);
+   }
+   io_init(IO_POLICY, IO_READAHEAD);
+   if (CMP_CACHE_FILE) init_cmp_cache();
+   if (CMP_MANIFEST_FILE) init_cmp_manifest();
+   if (N_SHARDS) init_shards();
+   else if (Opt_MERGE || primary_ftype() == NULL) N_WRITERS = 0;	// No per-worker primary outputs
+   if (N_WRITERS) wr_init(N_WRITERS);
 
    fprintf(Plog, " cmd =");
    for (i=0; i<argc; i++) fprintf(Plog, " %s", argv[i]);
@@ -3985,10 +5384,13 @@ main(int argc, char *argv[])
    for (i=1; i < argc; i++)
       if (*argv[i] != '-' && *argv[i] != '+') {
          dirarg_count += 1;
+         if (N_DIR_ARGS < (int) (sizeof(DIR_ARGS) / sizeof(DIR_ARGS[0]))) DIR_ARGS[N_DIR_ARGS++] = argv[i];
          fifo_push(argv[i], NULL, 0);
       }
-   if (dirarg_count == 0)	// Default directory arg is just "."
+   if (dirarg_count == 0) {	// Default directory arg is just "."
+      DIR_ARGS[N_DIR_ARGS++] = ".";
       fifo_push(".", NULL, 0);
+   }
 
    // Force flush Plog so far. HENCEFORTH, Plog WRITES from WORKERS GO THRU LogMsg() ...
    LogMsg(NULL, 1);
@@ -4010,13 +5412,38 @@ main(int argc, char *argv[])
 
    // @@@ Main runtime loop ...
    T_START_hires = gethrtime();		// Start hi-res work clock
+   pg_start(PROGRESS_SECS, OUTPUT_DIR, N_WORKERS, N_SOURCE_PATHS, SOURCE_PATHS, progress_status, LogMsg);
+   if (Opt_METRICS || METRICS_PORT) {
+      if (Opt_METRICS && METRICS_FILE == NULL) {
+         METRICS_FILE = malloc(strlen(OUTPUT_DIR) + 24);
+         sprintf(METRICS_FILE, "%s%cpwalk_metrics.prom", OUTPUT_DIR, PATHSEPCHR);
+      }
+      if (mt_start(METRICS_FILE, METRICS_SECS, METRICS_PORT, N_WORKERS, N_SOURCE_PATHS, SOURCE_PATHS,
+            Cmd_TALLY ? N_TALLY_BUCKETS : -1, TALLY_BUCKET_SIZE, metrics_status, LogMsg)) {
+         fprintf(Plog, "ERROR: -metrics_port=%d: cannot listen on 127.0.0.1 (%s)!\n", METRICS_PORT, strerror(errno));
+         fprintf(stderr, "ERROR: -metrics_port=%d: cannot listen on 127.0.0.1 (%s)!\n", METRICS_PORT, strerror(errno));
+         exit(-1);
+      }
+   }
    manage_workers();			// Runs until all workers are IDLE and FIFO is empty
+   pg_stop();
+   mt_stop();
    T_FINISH_hires = gethrtime();	// Stop hi-res work clock
 
    // ------------------------------------------------------------------------
 
    // Force flush Plog. HENCEFORTH, Further Plog writes *CAN* simply fprintf(Plog ...) ...
    LogMsg(NULL, 1);
+
+   // @@@ -merge post-phase ...
+   if (Opt_MERGE) pwalk_merge_output();
+
+   // @@@ -dups post-phase; worker pool is still up, and IDLE ...
+   if (Cmd_DUPS) pwalk_dups_output();
+
+   // @@@ -cmp_cache post-phase ...
+   if (CMP_CACHE_FILE) pwalk_cmp_cache_save();
+
    fprintf(Plog, "@ %s ENDS ...\n", PWALK_VERSION);
 
    // @@@ Aggregate per-worker-stats (WS[w_id]) to program's global-stats (GS) (lockless) ...
@@ -4028,6 +5455,9 @@ main(int argc, char *argv[])
       GS.NScanned += WS[w_id]->NScanned;
       GS.NSelected += WS[w_id]->NSelected;
       GS.NRemoved += WS[w_id]->NRemoved;
+      GS.NRemovedDirs += WS[w_id]->NRemovedDirs;
+      GS.NTrashed += WS[w_id]->NTrashed;
+      GS.NTrashCopied += WS[w_id]->NTrashCopied;
       GS.NWarnings += WS[w_id]->NWarnings;
       GS.NStatCalls += WS[w_id]->NStatCalls;
       GS.NDirs += WS[w_id]->NDirs;
@@ -4043,8 +5473,27 @@ main(int argc, char *argv[])
       GS.READONLY_Zero_Files += WS[w_id]->READONLY_Zero_Files;
       GS.READONLY_Opens += WS[w_id]->READONLY_Opens;
       GS.READONLY_Errors += WS[w_id]->READONLY_Errors;
-      GS.READONLY_CRC_Bytes += WS[w_id]->READONLY_CRC_Bytes;
+      for (i=0; i<SUM_NALGS; i++) {
+         GS.READONLY_Sums.bytes[i] += WS[w_id]->READONLY_Sums.bytes[i];
+         GS.READONLY_Sums.ns[i] += WS[w_id]->READONLY_Sums.ns[i];
+      }
+      GS.READONLY_Sums.read_bytes += WS[w_id]->READONLY_Sums.read_bytes;
+      GS.READONLY_Sums.read_ns += WS[w_id]->READONLY_Sums.read_ns;
+      GS.READONLY_Sums.hole_bytes += WS[w_id]->READONLY_Sums.hole_bytes;
       GS.READONLY_DENIST_Bytes += WS[w_id]->READONLY_DENIST_Bytes;
+      GS.READONLY_DENIST_Matches += WS[w_id]->READONLY_DENIST_Matches;
+      GS.CMP_Content_Files += WS[w_id]->CMP_Content_Files;
+      GS.CMP_Content_Diffs += WS[w_id]->CMP_Content_Diffs;
+      GS.CMP_Content_Bytes += WS[w_id]->CMP_Content_Bytes;
+      GS.CMP_Content_ns += WS[w_id]->CMP_Content_ns;
+      GS.CMP_Content_Chunked += WS[w_id]->CMP_Content_Chunked;
+      GS.CMP_Content_Holes += WS[w_id]->CMP_Content_Holes;
+      GS.CMP_Cache_Hits += WS[w_id]->CMP_Cache_Hits;
+      GS.CMP_Cache_Bytes += WS[w_id]->CMP_Cache_Bytes;
+      GS.CMP_Cache_Reverified += WS[w_id]->CMP_Cache_Reverified;
+      GS.CMP_Cache_Mismatches += WS[w_id]->CMP_Cache_Mismatches;
+      GS.CMP_Target_Nostat += WS[w_id]->CMP_Target_Nostat;
+      GS.CMP_Target_Only += WS[w_id]->CMP_Target_Only;
       GS.NPythonCalls += WS[w_id]->NPythonCalls;
       GS.NPythonErrors += WS[w_id]->NPythonErrors;
       // @@@ Cheap-to-keep WS -> GS stats aggregation ...
@@ -4058,6 +5507,13 @@ main(int argc, char *argv[])
 
    // @@@ OUTPUT (.tally): +tally writes its own .tally file ...
    if (Cmd_TALLY) pwalk_tally_output();
+   if (Cmd_ROLLUP) fprintf(Plog, "@ +rollup: %llu directories to pwalk_rollup.csv\n", ru_close());
+   if (tally_by_count() && tally_by_output(OUTPUT_DIR, TALLY_TAG, N_WORKERS) != 0)
+      fprintf(Plog, "ERROR: Cannot write +tally_by= output(s)!\n");
+   if (Cmd_TOP && top_output(OUTPUT_DIR, N_WORKERS) != 0)
+      fprintf(Plog, "ERROR: Cannot write +top= output(s)!\n");
+   if (Cmd_USAGE && usage_output(OUTPUT_DIR, N_WORKERS) != 0)
+      fprintf(Plog, "ERROR: Cannot write +usage output(s)!\n");
 
    // @@@ OUTPUT (.log): Various final summary outputs ...
 
@@ -4124,6 +5580,10 @@ main(int argc, char *argv[])
          GS.NPythonCalls, (GS.NPythonCalls != 1) ? "s" : "");
    if (GS.NRemoved > 0) fprintf(Plog, "%16llu - file%s removed by -rm\n",
          GS.NRemoved, (GS.NRemoved != 1) ? "s" : "");
+   if (GS.NRemovedDirs > 0) fprintf(Plog, "%16llu - director%s removed by -rm=tree\n",
+         GS.NRemovedDirs, (GS.NRemovedDirs != 1) ? "ies" : "y");
+   if (GS.NTrashed > 0) fprintf(Plog, "%16llu - file%s moved by -trash (%llu copied across filesystems)\n",
+         GS.NTrashed, (GS.NTrashed != 1) ? "s" : "", GS.NTrashCopied);
    // ... Show  ACL-related stats ...
    if (Cmd_XACLS || Cmd_WACLS || Cmd_RM_ACLS || P_ACL_P) {
       fprintf(Plog, "%16llu - ACL%s found\n", GS.NACLs, (GS.NACLs != 1) ? "s" : "");
@@ -4152,18 +5612,88 @@ main(int argc, char *argv[])
       fprintf(Plog, "%16llx - MAX inode value selected\n", GS.MAX_inode_Value_Selected);
 
       // ... Show +crc, md5, and +denist stats ...
-      if (Cmd_DENIST || P_CRC32 || P_MD5 || Cmd_RM_ACLS) {
+      if (Cmd_DENIST || P_SUMS || Cmd_RM_ACLS) {
          fprintf(Plog, "@ Summary (READONLY) file stats ...\n");
          fprintf(Plog, "%16llu - zero-length file%s\n", GS.READONLY_Zero_Files, (GS.READONLY_Zero_Files != 1) ? "s" : "");
          fprintf(Plog, "%16llu - open() call%s\n", GS.READONLY_Opens, (GS.READONLY_Opens != 1) ? "s" : "");
          fprintf(Plog, "%16llu - open() or read() error%s\n", GS.READONLY_Errors, (GS.READONLY_Errors != 1) ? "s" : "");
-         if (P_CRC32)
-            fprintf(Plog, "%16llu - CRC byte%s read\n", GS.READONLY_CRC_Bytes, (GS.READONLY_CRC_Bytes != 1) ? "s" : "");
-         if (Cmd_DENIST)
-            fprintf(Plog, "%16llu - DENIST byte%s read\n", GS.READONLY_DENIST_Bytes, (GS.READONLY_DENIST_Bytes != 1) ? "s" : "");
+         if (P_SUMS) {	// Bytes read once; per-digest CPU time shows which one (if any) is the bottleneck
+            fprintf(Plog, "%16llu - digest byte%s read, %.3fs in pread()\n", GS.READONLY_Sums.read_bytes,
+               (GS.READONLY_Sums.read_bytes != 1) ? "s" : "", GS.READONLY_Sums.read_ns / 1e9);
+            if (GS.READONLY_Sums.hole_bytes)
+               fprintf(Plog, "%16llu - digest byte%s in holes, hashed as zeros without a read\n",
+                  GS.READONLY_Sums.hole_bytes, (GS.READONLY_Sums.hole_bytes != 1) ? "s" : "");
+            for (i=0; i<SUM_NALGS; i++) if (P_SUMS & (1 << i))
+               fprintf(Plog, "%16llu - +%s byte%s, %.3fs, %.0f MB/s\n", GS.READONLY_Sums.bytes[i], SUM_NAMES[i],
+                  (GS.READONLY_Sums.bytes[i] != 1) ? "s" : "", GS.READONLY_Sums.ns[i] / 1e9,
+                  GS.READONLY_Sums.ns[i] ? GS.READONLY_Sums.bytes[i] * 1e3 / GS.READONLY_Sums.ns[i] : 0.);
+         }
+         if (Cmd_DENIST) {
+            fprintf(Plog, "%16llu - DENIST byte%s read (%llu file%s read ahead by helpers)\n", GS.READONLY_DENIST_Bytes,
+               (GS.READONLY_DENIST_Bytes != 1) ? "s" : "", denist_ahead(), (denist_ahead() != 1) ? "s" : "");
+            if (DENIST_FILE)
+               fprintf(Plog, "%16llu - DENIST match%s in %s\n", GS.READONLY_DENIST_Matches,
+                  (GS.READONLY_DENIST_Matches != 1) ? "es" : "", DENIST_FILE);
+         }
+      }
+
+      // ... Show -cmp TARGET dir preload stats ...
+      if (Cmd_CMP) {
+         fprintf(Plog, "@ -cmp TARGET dir stats ...\n");
+         fprintf(Plog, "%16llu - entr%s compared without a TARGET stat()\n", GS.CMP_Target_Nostat,
+            (GS.CMP_Target_Nostat != 1) ? "ies" : "y");
+         fprintf(Plog, "%16llu - entr%s found only in TARGET ('X')\n", GS.CMP_Target_Only,
+            (GS.CMP_Target_Only != 1) ? "ies" : "y");
+      }
+
+      // ... Show -cmp content compare stats; time is summed over workers, so MB/s is per-worker ...
+      if (GS.CMP_Content_Files || GS.CMP_Cache_Hits) {
+         fprintf(Plog, "@ -cmp content compare stats ...\n");
+         fprintf(Plog, "%16llu - file%s compared (%llu different or unreadable)\n", GS.CMP_Content_Files,
+            (GS.CMP_Content_Files != 1) ? "s" : "", GS.CMP_Content_Diffs);
+         fprintf(Plog, "%16llu - source byte%s compared, %.3fs, %.0f MB/s per worker (%llu-byte reads)\n",
+            GS.CMP_Content_Bytes, (GS.CMP_Content_Bytes != 1) ? "s" : "", GS.CMP_Content_ns / 1e9,
+            GS.CMP_Content_ns ? GS.CMP_Content_Bytes * 1e3 / GS.CMP_Content_ns : 0., CMP_BUFFER_SIZE);
+         if (GS.CMP_Content_Chunked)
+            fprintf(Plog, "%16llu - file%s over %llu bytes compared in chunks by all workers\n",
+               GS.CMP_Content_Chunked, (GS.CMP_Content_Chunked != 1) ? "s" : "", CMP_CHUNK_SIZE);
+         if (GS.CMP_Content_Holes)
+            fprintf(Plog, "%16llu - byte%s in holes common to SOURCE and TARGET, not read\n",
+               GS.CMP_Content_Holes, (GS.CMP_Content_Holes != 1) ? "s" : "");
+         if (CMP_CACHE_FILE) {
+            fprintf(Plog, "%16llu - -cmp_cache hit%s; %llu source byte%s (and as many target) not re-read\n",
+               GS.CMP_Cache_Hits, (GS.CMP_Cache_Hits != 1) ? "s" : "",
+               GS.CMP_Cache_Bytes, (GS.CMP_Cache_Bytes != 1) ? "s" : "");
+            fprintf(Plog, "%16llu - -cmp_cache hit%s re-verified; %llu now differ%s with unchanged metadata%s\n",
+               GS.CMP_Cache_Reverified, (GS.CMP_Cache_Reverified != 1) ? "s" : "", GS.CMP_Cache_Mismatches,
+               (GS.CMP_Cache_Mismatches == 1) ? "s" : "", GS.CMP_Cache_Mismatches ? " (!)" : "");
+         }
+      }
+
+      // ... Show file content reads under the -io= policy ...
+      io_stats(&io_st);
+      for (i = 0, j = 0; i < IO_NUSERS; i++) j += io_st.opens[i];
+      if (j) {
+         fprintf(Plog, "@ -io=%s content read stats ...\n", IO_POLICY_NAMES[IO_POLICY]);
+         for (i = 0; i < IO_NUSERS; i++) if (io_st.opens[i])
+            fprintf(Plog, "%16llu - %s byte%s read from %llu file%s\n", io_st.bytes[i], IO_USER_NAMES[i],
+               (io_st.bytes[i] != 1) ? "s" : "", io_st.opens[i], (io_st.opens[i] != 1) ? "s" : "");
+         if (IO_POLICY == IO_DIRECT)
+            fprintf(Plog, "%16llu - file%s read bypassing the page cache (%llu refused it, read through it)\n",
+               io_st.direct, (io_st.direct != 1) ? "s" : "", io_st.fallbacks);
+         if (IO_POLICY == IO_DONTNEED)
+            fprintf(Plog, "%16llu - byte%s dropped from the page cache as read (files dropped again at close)\n",
+               io_st.dropped, (io_st.dropped != 1) ? "s" : "");
+         if (io_st.hinted)
+            fprintf(Plog, "%16llu - byte%s of readahead hinted (-io_readahead=%llu)\n",
+               io_st.hinted, (io_st.hinted != 1) ? "s" : "", IO_READAHEAD);
       }
    }
 
+   // @@@ ... +lat call latency percentiles ...
+   if (Opt_LAT && lat_report(Plog, OUTPUT_DIR, SOURCE_PATHS) != 0)
+      fprintf(Plog, "ERROR: Cannot write pwalk_lat.csv!\n");
+
    fprintf(Plog, "@ pwalk run summary ...\n");
    fprintf(Plog, "cmd =");
    for (i=0; i<argc; i++) fprintf(Plog, " %s", argv[i]);
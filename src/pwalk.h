@@ -2,6 +2,8 @@
 #define PWALK_H 1
 
 #include <sys/param.h>
+#include "pwalk_output.h"
+#include "pwalk_sums.h"
 
 // @@@ Portabiity tidbits ...
 // See also: http://sourceforge.net/p/predef/wiki/OperatingSystems/
@@ -96,6 +98,21 @@ static int CLK_TCK;
 #define MAXPATHS 64				// Arbitrary limit for [source] or [target] multi-paths
 #define MAX_PATH_DEPTH 128			// Max pathname components
 #define PROGRESS_TIME_INTERVAL 3600/4		// Seconds between progress outputs to log file
+#define PATHSEPCHR '/'				// Might make conditional for Windoze
+#define PATHSEPSTR "/"				// Might make conditional for Windoze
+
+// fnv1a() - 64-bit FNV-1a of <len> bytes; the hash for every table keyed by path or name
+// (those with 32-bit slots just use its low bits).
+
+static inline unsigned long long
+fnv1a(const void *p, size_t len)
+{
+   const unsigned char *s = p;
+   unsigned long long h = 14695981039346656037ULL;
+
+   while (len--) h = (h ^ *s++) * 1099511628211ULL;
+   return (h);
+}
 
 // Mask bits for metadata to gather during treewalk (in PWget_MASK) ...
 #define PWget_STAT	0x001		// Basic stat()
@@ -196,7 +213,13 @@ extern struct {
    int                  w_id;			// Worker's unique index
    wstatus_t            status;			// Worker status
    FILE                 *wlog;			// WLOG output file for this worker
+   PW_OBUF              wout;			// WOUT buffer; drains to wlog
    FILE                 *werr;			// WERR output file for this worker
+   time_t               flush_time;		// Last worker_flush() (see -flush=)
+   unsigned             phase_gen;		// Last post-walk phase done (see run_worker_phase())
+   int                  n_shard_aux;		// -shards stdio outputs (.err, .acl4*) ...
+   FILE                 *shard_aux_file[8];	// ... their FILE*
+   PW_OBUF              *shard_aux_obuf[8];	// ... and buffers behind them
    // Co-process & xacls support ...
    FILE                 *PYTHON_PIPE;		// Pipe for -audit Python symbiont
    FILE                 *WACLS_PIPE;		// Pipe for +wacls= process
@@ -228,6 +251,9 @@ typedef struct {
    count_64 NScanned;				// Files scanned (superset of selected files)
    count_64 NSelected;				// Files selected (when selection option(s) given)
    count_64 NRemoved;				// Files removed (with -rm)
+   count_64 NRemovedDirs;			// Directories removed (with -rm=tree)
+   count_64 NTrashed;				// Files moved (with -trash)
+   count_64 NTrashCopied;			// ... by copy and unlink, across filesystems
    count_64 NACLs;				// +acls, +xacls=, or +wacls= # files & dirs w/ ACL processed
    count_64 NStatCalls;				// Number of lstatat() calls on dirents
    count_64 NDirs;				// ... # that were directories
@@ -245,8 +271,21 @@ typedef struct {
    count_64 READONLY_Zero_Files;		// READONLY zero-length files
    count_64 READONLY_Opens;			// READONLY file opens
    count_64 READONLY_Errors;			// READONLY open/read errors
-   count_64 READONLY_CRC_Bytes;			// READONLY CRC bytes read
+   SUM_STATS READONLY_Sums;			// READONLY +crc, +md5, etc. bytes and times
    count_64 READONLY_DENIST_Bytes;		// READONLY DENIST bytes read
+   count_64 READONLY_DENIST_Matches;		// ... files whose MD5 is in +denist=<hashlist>
+   count_64 CMP_Content_Files;			// -cmp content compares
+   count_64 CMP_Content_Diffs;			// ... that found a difference (or error)
+   count_64 CMP_Content_Bytes;			// ... SOURCE bytes read
+   count_64 CMP_Content_ns;			// ... and time taken
+   count_64 CMP_Content_Chunked;		// ... files split into -cmp_chunk= chunks
+   count_64 CMP_Content_Holes;			// ... bytes in holes both sides share, not read
+   count_64 CMP_Cache_Hits;			// -cmp_cache pairs not compared
+   count_64 CMP_Cache_Bytes;			// ... their (source) bytes
+   count_64 CMP_Cache_Reverified;		// -cmp_reverify= hits compared anyway
+   count_64 CMP_Cache_Mismatches;		// ... that were different!
+   count_64 CMP_Target_Nostat;			// -cmp entries settled by TARGET dir preload alone
+   count_64 CMP_Target_Only;			// -cmp entries found only in TARGET
    count_64 NPythonCalls;			// Python calls
    count_64 NPythonErrors;			// Python errors
    count_64 MAX_inode_Value_Seen;		// Cheap-to-keep (WS, GS) stats
@@ -269,6 +308,7 @@ extern char *PYTHON_COMMAND;
 // ... which of course requires a context in which 'w_id' is defined.
 #define WDAT WorkerData[w_id]		// Coding convenience for w_id's worker data
 #define WLOG WDAT.wlog			// Coding convenience for w_id's output FILE*
+#define WOUT (&WDAT.wout)		// Coding convenience for w_id's output buffer (use this, not WLOG!)
 // Per-worker .err files get created only when needed ...
 #define WERR (WDAT.werr ? WDAT.werr : worker_err_create(w_id))  // Coding convenience for w_id's error FILE*
 
@@ -0,0 +1,880 @@
+// pwalk_cmp.c - -cmp content support; pipelined SOURCE/TARGET compare.
+// See pwalk_cmp.h for the overall scheme.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <assert.h>
+#include <pthread.h>
+#include <time.h>
+#include <limits.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "pwalk.h"
+#include "pwalk_cmp.h"
+#include "pwalk_extents.h"
+#include "pwalk_io.h"
+#include "pwalk_lat.h"
+
+// Per-worker read-ahead helper; everything below 'thread' is guarded by 'lock' ...
+typedef struct {
+   int w_id;
+   pthread_t thread;			// Helper; created on worker's first pipelined compare
+   pthread_mutex_t lock;
+   pthread_cond_t cond;			// Any change below (both sides wait on it)
+   int fd;				// TARGET fd being read, or -1 when helper is idle
+   off_t off, end;			// ... from off, up to end (or EOF when end < 0)
+   int stop;				// Worker is done with this compare
+   unsigned head, tail;			// Buffers filled by helper / consumed by worker
+   char *buf[CMP_DEPTH];
+   ssize_t len[CMP_DEPTH];		// pread() result for each buffer (0: EOF, -1: error)
+} CMP_PIPE;
+
+static CMP_PIPE PIPE[MAX_WORKERS+1];
+static size_t BUFSIZE = CMP_BUFSIZE_DEFAULT;
+
+// Chunk queue: jobs with chunks not yet taken, oldest first ...
+static pthread_mutex_t CHUNK_LOCK = PTHREAD_MUTEX_INITIALIZER;
+static CMP_JOB *QHEAD = NULL, *QTAIL = NULL;
+static unsigned long long QUEUED = 0;		// Chunks not yet taken (atomic reads)
+static off_t CHUNK_SIZE = 0;
+
+// cmp_pipe_init() - Set buffer size; called once, before any compares.
+
+void
+cmp_pipe_init(size_t bufsize)
+{
+   assert(bufsize >= CMP_BUFSIZE_MIN && bufsize <= CMP_BUFSIZE_MAX);
+   BUFSIZE = bufsize;
+}
+
+// cmp_readsize() - Bytes to read at <off>, for a compare ending at <end> (< 0: EOF).
+
+static size_t
+cmp_readsize(off_t off, off_t end)
+{
+   if (end < 0 || end - off >= (off_t) BUFSIZE) return (BUFSIZE);
+   return ((off < end) ? (size_t) (end - off) : 0);
+}
+
+// cmp_helper() - Read-ahead thread for one worker; reads each TARGET range handed to it
+// sequentially into free ring buffers until its end, EOF, error, or the worker says stop.
+
+static void *
+cmp_helper(void *arg)
+{
+   CMP_PIPE *p = arg;
+   unsigned slot;
+   ssize_t n;
+   off_t off, end;
+   size_t want;
+   int fd;
+
+   lat_thread(p->w_id);
+   pthread_mutex_lock(&p->lock);
+   while (1) {
+      while (p->fd < 0) pthread_cond_wait(&p->cond, &p->lock);
+      fd = p->fd;
+      off = p->off;
+      end = p->end;
+      while (!p->stop) {
+         if (p->head - p->tail >= CMP_DEPTH) {		// Ring full; wait for worker
+            pthread_cond_wait(&p->cond, &p->lock);
+            continue;
+         }
+         slot = p->head % CMP_DEPTH;
+         want = cmp_readsize(off, end);
+         pthread_mutex_unlock(&p->lock);
+         n = want ? io_pread(fd, p->buf[slot], want, off, IO_CMP) : 0;
+         pthread_mutex_lock(&p->lock);
+         p->len[slot] = n;
+         p->head += 1;
+         pthread_cond_broadcast(&p->cond);
+         if (n <= 0) break;
+         off += n;
+      }
+      p->fd = -1;					// Idle; worker may close fd now
+      pthread_cond_broadcast(&p->cond);
+   }
+   return (NULL);
+}
+
+// cmp_pipe_open() - Worker's helper and buffers; the first time, allocate and start them.
+
+static CMP_PIPE *
+cmp_pipe_open(int w_id)
+{
+   CMP_PIPE *p = &PIPE[w_id];
+   int i;
+
+   if (p->buf[0]) return (p);
+   p->w_id = w_id;
+   p->fd = -1;
+   for (i = 0; i < CMP_DEPTH; i++)
+      if (posix_memalign((void **) &p->buf[i], 4096, BUFSIZE) != 0) abend("Cannot malloc -cmp buffers!");
+   assert(pthread_mutex_init(&p->lock, NULL) == 0);
+   assert(pthread_cond_init(&p->cond, NULL) == 0);
+   if (pthread_create(&p->thread, NULL, cmp_helper, p)) abend("Cannot create -cmp read-ahead thread!");
+   return (p);
+}
+
+// cmp_pipe() - Compare open SOURCE and TARGET files from <off> for <len> bytes (or to EOF
+// when <len> < 0), using worker's <sbuf> (at least bufsize bytes) for SOURCE.  Returns 0
+// when equal, 1 when different, or -1 on a read error; *nbytes gets SOURCE bytes read.
+
+int
+cmp_pipe(int w_id, int fds, int fdt, char *sbuf, off_t off, off_t len, off_t *nbytes)
+{
+   CMP_PIPE *p = cmp_pipe_open(w_id);
+   off_t off0 = off, end = (len < 0) ? -1 : off + len;
+   ssize_t sn, tn;
+   size_t want;
+   unsigned slot;
+   int rc, diff;
+   long long t_lat;
+
+   // Hand TARGET to the helper, which starts reading ahead at once ...
+   pthread_mutex_lock(&p->lock);
+   p->head = p->tail = 0;
+   p->stop = 0;
+   p->off = off;
+   p->end = end;
+   p->fd = fdt;
+   pthread_cond_broadcast(&p->cond);
+   pthread_mutex_unlock(&p->lock);
+
+   // ... while we read SOURCE, one buffer at a time, hinting the next ...
+   while (1) {
+#if !defined(__OSX__)
+      if (io_policy() != IO_DIRECT) posix_fadvise(fds, off + BUFSIZE, BUFSIZE, POSIX_FADV_WILLNEED);
+#endif
+      sn = 0;
+      if ((want = cmp_readsize(off, end))) sn = io_pread(fds, sbuf, want, off, IO_CMP);
+
+      pthread_mutex_lock(&p->lock);
+      while (p->head == p->tail) pthread_cond_wait(&p->cond, &p->lock);
+      slot = p->tail % CMP_DEPTH;
+      tn = p->len[slot];
+      pthread_mutex_unlock(&p->lock);
+
+      if (sn < 0 || tn < 0) { rc = -1; break; }		// Read error
+      if (sn != tn) { rc = 1; break; }			// Different lengths
+      if (sn == 0) { rc = 0; break; }			// Both @ end w/ zero difference!
+      off += sn;
+      LAT_BEGIN(t_lat);
+      diff = memcmp(sbuf, p->buf[slot], sn);
+      LAT_END(LAT_MEMCMP, t_lat);
+      if (diff) { rc = 1; break; }			// Explicitly different!
+
+      pthread_mutex_lock(&p->lock);
+      p->tail += 1;					// Give buffer back to helper
+      pthread_cond_broadcast(&p->cond);
+      pthread_mutex_unlock(&p->lock);
+   }
+
+   // Stop the helper, and wait out any pread() it has in progress on fdt ...
+   pthread_mutex_lock(&p->lock);
+   p->stop = 1;
+   pthread_cond_broadcast(&p->cond);
+   while (p->fd >= 0) pthread_cond_wait(&p->cond, &p->lock);
+   pthread_mutex_unlock(&p->lock);
+
+   *nbytes = off - off0;
+   return (rc);
+}
+
+// cmp_range() - cmp_pipe(), except that when SOURCE and TARGET have the same holes in the
+// range, just their data extents are compared (holes read as zeros on both sides, so they
+// are equal); *holes gets the bytes skipped.
+
+int
+cmp_range(int w_id, int fds, int fdt, char *sbuf, off_t off, off_t len, off_t *nbytes, off_t *holes)
+{
+   struct stat ssb, tsb;
+   EXT_MAP sm, tm;
+   off_t end, n;
+   int i, rc;
+
+   *holes = 0;
+   if (fstat(fds, &ssb) != 0 || fstat(fdt, &tsb) != 0 ||
+       (len < 0 && ssb.st_size != tsb.st_size))		// cmp_pipe() reports the difference
+      return (cmp_pipe(w_id, fds, fdt, sbuf, off, len, nbytes));
+   end = (len < 0) ? ssb.st_size : off + len;
+   if (end - off <= (off_t) BUFSIZE ||
+       ext_map(fds, off, end, &sm) < 0 || ext_data_bytes(&sm) == end - off ||
+       ext_map(fdt, off, end, &tm) < 0 || !ext_map_equal(&sm, &tm))
+      return (cmp_pipe(w_id, fds, fdt, sbuf, off, len, nbytes));
+
+   *nbytes = 0;
+   for (i = 0; i < sm.n; i++) {
+      rc = cmp_pipe(w_id, fds, fdt, sbuf, sm.start[i], sm.end[i] - sm.start[i], &n);
+      *nbytes += n;
+      if (rc) return (rc);
+   }
+   *holes = (end - off) - ext_data_bytes(&sm);
+   return (0);
+}
+
+// @@@ SECTION: Chunk-parallel compare of big files @@@
+
+// cmp_chunk_init() - Files bigger than <chunk_size> get compared in chunks of that size.
+
+void
+cmp_chunk_init(off_t chunk_size)
+{
+   assert(chunk_size >= (off_t) BUFSIZE);
+   CHUNK_SIZE = chunk_size;
+}
+
+// cmp_chunks_queued() - Chunks waiting for a worker (a hint; no lock).
+
+unsigned long long
+cmp_chunks_queued(void)
+{
+   return (__atomic_load_n(&QUEUED, __ATOMIC_RELAXED));
+}
+
+// cmp_job_add() - Queue <relpath>'s chunks; <arg> comes back with the finished job.
+// Returns the number of chunks queued.
+
+unsigned
+cmp_job_add(const char *relpath, off_t size, void *arg)
+{
+   CMP_JOB *j;
+
+   assert(CHUNK_SIZE > 0);
+   j = calloc(1, sizeof(*j));
+   if (j == NULL || (j->relpath = strdup(relpath)) == NULL) abend("Cannot malloc -cmp chunk job!");
+   j->size = size;
+   j->nchunks = (size + CHUNK_SIZE - 1) / CHUNK_SIZE;
+   if (j->nchunks == 0) j->nchunks = 1;
+   j->arg = arg;
+
+   pthread_mutex_lock(&CHUNK_LOCK);
+   if (QTAIL) QTAIL->next = j; else QHEAD = j;
+   QTAIL = j;
+   __atomic_add_fetch(&QUEUED, j->nchunks, __ATOMIC_RELAXED);
+   pthread_mutex_unlock(&CHUNK_LOCK);
+   return (j->nchunks);
+}
+
+// cmp_chunk_take() - Take the next queued chunk; returns its job (and index in *chunk),
+// or NULL when there are none.
+
+CMP_JOB *
+cmp_chunk_take(unsigned *chunk)
+{
+   CMP_JOB *j;
+
+   if (cmp_chunks_queued() == 0) return (NULL);
+   pthread_mutex_lock(&CHUNK_LOCK);
+   if ((j = QHEAD) != NULL) {
+      *chunk = j->taken++;
+      if (j->taken == j->nchunks) {			// All handed out; dequeue
+         QHEAD = j->next;
+         if (QHEAD == NULL) QTAIL = NULL;
+      }
+      __atomic_sub_fetch(&QUEUED, 1, __ATOMIC_RELAXED);
+   }
+   pthread_mutex_unlock(&CHUNK_LOCK);
+   return (j);
+}
+
+// cmp_chunk_run() - Compare <chunk> of <j>, opening <j>'s relpath under the caller's own
+// SOURCE and TARGET dfds (so multi-pathing still spreads the load).  Once any chunk has
+// found a difference, the job's remaining chunks are skipped.  The last chunk reads to
+// EOF, so a length difference shows up there.  Returns TRUE when this was the job's last
+// chunk to finish; j->rc is then final, and the caller owns (and frees) the job.
+
+int
+cmp_chunk_run(int w_id, CMP_JOB *j, unsigned chunk, int sdfd, int tdfd, char *sbuf, off_t *nbytes, off_t *holes)
+{
+   int fds = -1, fdt = -1;
+   int rc = 0, skip, last;
+
+   *nbytes = *holes = 0;
+   pthread_mutex_lock(&CHUNK_LOCK);
+   skip = (j->rc != 0);
+   pthread_mutex_unlock(&CHUNK_LOCK);
+
+   if (!skip) {
+      rc = -1;
+      if ((fds = io_open(sdfd, j->relpath, IO_CMP)) >= 0 &&
+          (fdt = io_open(tdfd, j->relpath, IO_CMP)) >= 0) {
+#if !defined(__OSX__)
+         posix_fadvise(fds, chunk * CHUNK_SIZE, CHUNK_SIZE, POSIX_FADV_SEQUENTIAL);
+         posix_fadvise(fdt, chunk * CHUNK_SIZE, CHUNK_SIZE, POSIX_FADV_SEQUENTIAL);
+#endif
+         rc = cmp_range(w_id, fds, fdt, sbuf, chunk * CHUNK_SIZE,
+                        (chunk == j->nchunks - 1) ? -1 : CHUNK_SIZE, nbytes, holes);
+      }
+      if (fds >= 0) io_close(fds);
+      if (fdt >= 0) io_close(fdt);
+   }
+
+   pthread_mutex_lock(&CHUNK_LOCK);
+   if (rc && j->rc == 0) j->rc = rc;
+   j->done += 1;
+   last = (j->done == j->nchunks);
+   pthread_mutex_unlock(&CHUNK_LOCK);
+   return (last);
+}
+
+// cmp_job_free() - Done with a finished job.
+
+void
+cmp_job_free(CMP_JOB *j)
+{
+   free(j->relpath);
+   free(j);
+}
+
+// @@@ SECTION: Verified-compare cache (-cmp_cache=) @@@
+
+// The cache file is CACHE_MAGIC followed by 16-byte keys.  In memory, the keys loaded are
+// an open-addressed hash set (an all-zero key marks an empty slot; no real key is all
+// zero), with a 'seen' flag per slot; keys newly verified go to per-worker lists.
+
+#define CACHE_MAGIC "pwalk-cmpcache1\n"	// 16 bytes
+
+static char *CACHE_PATH = NULL;
+static int REVERIFY_PCT = 0;
+static CMP_KEY *CACHE = NULL;		// Hash set of loaded keys
+static unsigned char *CACHE_SEEN = NULL;	// ... looked up (or re-verified) this run
+static size_t CACHE_MASK = 0;		// Slots - 1
+static unsigned long long CACHE_LOADED = 0;
+
+static struct {				// Per-worker newly-verified keys and re-verify RNG
+   CMP_KEY *keys;
+   size_t n, max;
+   unsigned seed;
+} WCACHE[MAX_WORKERS+1];
+
+// cache_slot() - Slot holding <key>, or the empty slot where it would go.
+
+static size_t
+cache_slot(CMP_KEY *key)
+{
+   static const CMP_KEY zero;
+   size_t i;
+
+   memcpy(&i, key->k, sizeof(i));		// Key is a hash already
+   for (i &= CACHE_MASK; ; i = (i + 1) & CACHE_MASK)
+      if (memcmp(&CACHE[i], key, sizeof(*key)) == 0 || memcmp(&CACHE[i], &zero, sizeof(zero)) == 0)
+         return (i);
+}
+
+// cmp_cache_init() - Load <path> (if it exists); <reverify_pct> of hits get compared anyway.
+// Returns keys loaded, or -1 if the file is unreadable or not a -cmp_cache file.
+
+long long
+cmp_cache_init(char *path, int reverify_pct)
+{
+   char magic[sizeof(CACHE_MAGIC)];
+   struct stat sb;
+   CMP_KEY key;
+   size_t n, slots;
+   FILE *f;
+   int w_id;
+
+   CACHE_PATH = path;
+   REVERIFY_PCT = reverify_pct;
+   for (w_id = 0; w_id <= MAX_WORKERS; w_id++)
+      WCACHE[w_id].seed = (unsigned) time(NULL) ^ (w_id * 2654435761U);
+
+   // Size the set for the file (and room to spare) ...
+   n = 0;
+   if ((f = fopen(path, "r")) != NULL) {
+      if (fstat(fileno(f), &sb) != 0 || sb.st_size < 16 || (sb.st_size - 16) % sizeof(CMP_KEY) ||
+          fread(magic, 1, 16, f) != 16 || memcmp(magic, CACHE_MAGIC, 16) != 0) {
+         fclose(f);
+         return (-1);
+      }
+      n = (sb.st_size - 16) / sizeof(CMP_KEY);
+   } else if (errno != ENOENT) {
+      return (-1);
+   }
+   for (slots = 1024; slots < 2 * n; slots *= 2) ;
+   CACHE = calloc(slots, sizeof(CMP_KEY));
+   CACHE_SEEN = calloc(slots, 1);
+   if (CACHE == NULL || CACHE_SEEN == NULL) abend("Cannot malloc -cmp_cache table!");
+   CACHE_MASK = slots - 1;
+
+   if (f) {
+      while (fread(&key, sizeof(key), 1, f) == 1)
+         CACHE[cache_slot(&key)] = key;
+      fclose(f);
+      CACHE_LOADED = n;
+   }
+   return ((long long) n);
+}
+
+// cmp_cache_lookup() - Key for the pair <ssb>, <tsb> into *key; is it in the cache?
+
+int
+cmp_cache_lookup(int w_id, struct stat *ssb, struct stat *tsb, CMP_KEY *key)
+{
+   unsigned long long t[10];
+   SUM_VALUES v;
+   size_t i;
+
+   t[0] = ssb->st_dev; t[1] = ssb->st_ino; t[2] = ssb->st_size;
+   t[3] = ssb->st_mtimespec.tv_sec * 1000000000ULL + ssb->st_mtimespec.tv_nsec;
+   t[4] = ssb->st_ctimespec.tv_sec * 1000000000ULL + ssb->st_ctimespec.tv_nsec;
+   t[5] = tsb->st_dev; t[6] = tsb->st_ino; t[7] = tsb->st_size;
+   t[8] = tsb->st_mtimespec.tv_sec * 1000000000ULL + tsb->st_mtimespec.tv_nsec;
+   t[9] = tsb->st_ctimespec.tv_sec * 1000000000ULL + tsb->st_ctimespec.tv_nsec;
+   sums_buf(SUM_SHA256, t, sizeof(t), &v);
+   memcpy(key->k, v.sha256, sizeof(key->k));
+   if (key->k[0] == 0) key->k[0] = 1;		// Never all zero
+
+   i = cache_slot(key);
+   if (memcmp(&CACHE[i], key, sizeof(*key)) != 0) return (CMP_CACHE_MISS);
+   if (REVERIFY_PCT && (rand_r(&WCACHE[w_id].seed) % 100) < REVERIFY_PCT)
+      return (CMP_CACHE_REVERIFY);			// Kept only if it verifies again
+   __atomic_store_n(&CACHE_SEEN[i], 1, __ATOMIC_RELAXED);
+   return (CMP_CACHE_HIT);
+}
+
+// cmp_cache_add() - The pair with <key> was just verified equal.
+
+void
+cmp_cache_add(int w_id, CMP_KEY *key)
+{
+   size_t i = cache_slot(key);
+
+   if (memcmp(&CACHE[i], key, sizeof(*key)) == 0) {	// Re-verified
+      __atomic_store_n(&CACHE_SEEN[i], 1, __ATOMIC_RELAXED);
+      return;
+   }
+   if (WCACHE[w_id].n >= WCACHE[w_id].max) {
+      WCACHE[w_id].max = WCACHE[w_id].max ? 2 * WCACHE[w_id].max : 1024;
+      WCACHE[w_id].keys = realloc(WCACHE[w_id].keys, WCACHE[w_id].max * sizeof(CMP_KEY));
+      if (WCACHE[w_id].keys == NULL) abend("Cannot grow -cmp_cache list!");
+   }
+   WCACHE[w_id].keys[WCACHE[w_id].n++] = *key;
+}
+
+// cmp_cache_save() - After the treewalk, rewrite the cache file (via rename) with the keys
+// looked up or verified in this run.  Returns 0, or -1 if it could not be written.
+
+int
+cmp_cache_save(CMP_CACHE_STATS *cs)
+{
+   char tmp[PATH_MAX+8];
+   size_t i, n;
+   FILE *f;
+   int w_id, rc = 0;
+
+   memset(cs, 0, sizeof(*cs));
+   cs->loaded = CACHE_LOADED;
+   snprintf(tmp, sizeof(tmp), "%s.new", CACHE_PATH);
+   if ((f = fopen(tmp, "w")) == NULL) return (-1);
+   if (fwrite(CACHE_MAGIC, 1, 16, f) != 16) rc = -1;
+   for (i = 0; i <= CACHE_MASK; i++) {
+      if (!CACHE_SEEN[i]) continue;
+      if (fwrite(&CACHE[i], sizeof(CMP_KEY), 1, f) != 1) rc = -1;
+      cs->kept += 1;
+   }
+   for (w_id = 0; w_id <= MAX_WORKERS; w_id++) {
+      n = WCACHE[w_id].n;
+      if (n && fwrite(WCACHE[w_id].keys, sizeof(CMP_KEY), n, f) != n) rc = -1;
+      cs->added += n;
+   }
+   if (fclose(f) != 0) rc = -1;
+   if (rc == 0 && rename(tmp, CACHE_PATH) != 0) rc = -1;
+   if (rc) unlink(tmp);
+   return (rc);
+}
+
+// @@@ SECTION: TARGET directory preload @@@
+
+// Each worker reads the TARGET directory matching the SOURCE directory it is scanning into
+// a table of (name, d_type, matched), hashed by name.  The scan looks each SOURCE name up
+// as it goes; what remains unmatched at the end exists only in TARGET.  The TARGET dir
+// stays open, so any fstatat() still needed is relative to it rather than to TARGET root.
+// With -cmp=manifest:<file>, the table is loaded from the directory's manifest block
+// instead, and also holds each entry's recorded metadata and digest.
+
+#if !defined(IFTODT)
+#define IFTODT(mode) (((mode) & S_IFMT) >> 12)	// st_mode type bits to d_type
+#endif
+#define TDIR_NONE ((size_t) -1)
+
+typedef struct {
+   size_t name;				// Offset into names[]
+   size_t digest;			// ... of -cmp=manifest: digest ("<alg>=<hex>"), or TDIR_NONE
+   unsigned char type;			// d_type (DT_UNKNOWN if the filesystem won't say)
+   unsigned char matched;		// Seen in SOURCE
+} TDIR_ENT;
+
+static struct {				// Per-worker table, reused from directory to directory
+   int loaded;				// Holds a TARGET dir or manifest block
+   DIR *dir;				// Open TARGET dir, or NULL
+   char *names;				// NUL-terminated names, back to back (or a manifest block)
+   size_t nlen, nmax;
+   TDIR_ENT *ent;
+   unsigned n, max;
+   struct stat *sb;			// -cmp=manifest: recorded metadata, per ent[]
+   unsigned sbmax;
+   unsigned *slot;			// Hash of ent[] index+1 (0: empty)
+   unsigned mask;			// Slots - 1
+} TDIR[MAX_WORKERS+1];
+
+// tdir_names() - Make room for <len> more bytes of names.
+
+static void
+tdir_names(int w_id, size_t len)
+{
+   if (TDIR[w_id].nlen + len <= TDIR[w_id].nmax) return;
+   TDIR[w_id].nmax = TDIR[w_id].nmax ? 2 * TDIR[w_id].nmax : 64*1024;
+   if (TDIR[w_id].nmax < TDIR[w_id].nlen + len) TDIR[w_id].nmax = TDIR[w_id].nlen + len;
+   TDIR[w_id].names = realloc(TDIR[w_id].names, TDIR[w_id].nmax);
+   if (TDIR[w_id].names == NULL) abend("Cannot grow -cmp TARGET dir names!");
+}
+
+// tdir_ent() - Append an entry; returns it.
+
+static TDIR_ENT *
+tdir_ent(int w_id, size_t name, unsigned char type)
+{
+   TDIR_ENT *e;
+
+   if (TDIR[w_id].n >= TDIR[w_id].max) {
+      TDIR[w_id].max = TDIR[w_id].max ? 2 * TDIR[w_id].max : 1024;
+      TDIR[w_id].ent = realloc(TDIR[w_id].ent, TDIR[w_id].max * sizeof(TDIR_ENT));
+      if (TDIR[w_id].ent == NULL) abend("Cannot grow -cmp TARGET dir table!");
+   }
+   e = &TDIR[w_id].ent[TDIR[w_id].n++];
+   e->name = name;
+   e->digest = TDIR_NONE;
+   e->type = type;
+   e->matched = 0;
+   return (e);
+}
+
+// tdir_index() - Hash the entries just loaded, at most half full.
+
+static void
+tdir_index(int w_id)
+{
+   unsigned h, i, slots;
+   const char *name;
+
+   for (slots = 1024; slots < 2 * TDIR[w_id].n; slots *= 2) ;
+   if (slots - 1 > TDIR[w_id].mask) {
+      free(TDIR[w_id].slot);
+      if ((TDIR[w_id].slot = malloc(slots * sizeof(unsigned))) == NULL)
+         abend("Cannot malloc -cmp TARGET dir hash!");
+      TDIR[w_id].mask = slots - 1;
+   }
+   memset(TDIR[w_id].slot, 0, (TDIR[w_id].mask + 1) * sizeof(unsigned));
+   for (i = 0; i < TDIR[w_id].n; i++) {
+      name = TDIR[w_id].names + TDIR[w_id].ent[i].name;
+      h = fnv1a(name, strlen(name)) & TDIR[w_id].mask;
+      while (TDIR[w_id].slot[h]) h = (h + 1) & TDIR[w_id].mask;
+      TDIR[w_id].slot[h] = i + 1;
+   }
+   TDIR[w_id].loaded = 1;
+}
+
+// cmp_tdir_load() - Read TARGET dir <relpath> (relative to <tdfd>) into worker's table.
+// Returns the open dir's fd, or -1 (with errno) if it cannot be read.
+
+int
+cmp_tdir_load(int w_id, int tdfd, const char *relpath)
+{
+   struct dirent *d;
+   size_t len;
+   int fd;
+
+   cmp_tdir_close(w_id);
+   if ((fd = openat(tdfd, relpath, O_RDONLY|O_DIRECTORY)) < 0) return (-1);
+   if ((TDIR[w_id].dir = fdopendir(fd)) == NULL) { close(fd); return (-1); }
+
+   // readdir() is safe here because each worker has its own stream ...
+   while ((d = readdir(TDIR[w_id].dir)) != NULL) {
+      if (strcmp(d->d_name, ".") == 0 || strcmp(d->d_name, "..") == 0) continue;
+      len = strlen(d->d_name) + 1;
+      tdir_names(w_id, len);
+      memcpy(TDIR[w_id].names + TDIR[w_id].nlen, d->d_name, len);
+      tdir_ent(w_id, TDIR[w_id].nlen, d->d_type);
+      TDIR[w_id].nlen += len;
+   }
+   tdir_index(w_id);
+   return (dirfd(TDIR[w_id].dir));
+}
+
+// cmp_tdir_find() - Look up SOURCE <name> in the worker's TARGET dir, and mark it matched.
+// Returns its index for the cmp_tdir_*() accessors, or -1 if TARGET has no such name.
+
+int
+cmp_tdir_find(int w_id, const char *name)
+{
+   unsigned h, i;
+
+   if (!TDIR[w_id].loaded) return (-1);
+   for (h = fnv1a(name, strlen(name)) & TDIR[w_id].mask; (i = TDIR[w_id].slot[h]) != 0; h = (h + 1) & TDIR[w_id].mask) {
+      if (strcmp(TDIR[w_id].names + TDIR[w_id].ent[i-1].name, name) == 0) {
+         TDIR[w_id].ent[i-1].matched = 1;
+         return (i-1);
+      }
+   }
+   return (-1);
+}
+
+// cmp_tdir_type(), cmp_tdir_stat(), cmp_tdir_digest() - Entry <i>'s d_type, and (only
+// from a manifest) its recorded metadata and digest; NULL when there are none.
+
+int
+cmp_tdir_type(int w_id, int i)
+{
+   return (TDIR[w_id].ent[i].type);
+}
+
+struct stat *
+cmp_tdir_stat(int w_id, int i)
+{
+   return (TDIR[w_id].dir ? NULL : &TDIR[w_id].sb[i]);
+}
+
+const char *
+cmp_tdir_digest(int w_id, int i)
+{
+   return (TDIR[w_id].ent[i].digest == TDIR_NONE ? NULL : TDIR[w_id].names + TDIR[w_id].ent[i].digest);
+}
+
+// cmp_tdir_unmatched() - Iterate over the names in TARGET that SOURCE never looked up.
+// Start with *iter = 0; returns NULL when done.
+
+const char *
+cmp_tdir_unmatched(int w_id, unsigned *iter, int *d_type)
+{
+   TDIR_ENT *e;
+
+   if (!TDIR[w_id].loaded) return (NULL);
+   while (*iter < TDIR[w_id].n) {
+      e = &TDIR[w_id].ent[(*iter)++];
+      if (e->matched) continue;
+      *d_type = e->type;
+      return (TDIR[w_id].names + e->name);
+   }
+   return (NULL);
+}
+
+// cmp_tdir_close() - Done with the worker's TARGET dir (table memory is kept for the next).
+
+void
+cmp_tdir_close(int w_id)
+{
+   if (TDIR[w_id].dir) closedir(TDIR[w_id].dir);
+   TDIR[w_id].dir = NULL;
+   TDIR[w_id].loaded = 0;
+   TDIR[w_id].n = 0;
+   TDIR[w_id].nlen = 0;
+}
+
+// @@@ SECTION: -cmp=manifest:<file> @@@
+
+// A manifest is CMP_MANIFEST_MAGIC and its digest name, then one block per directory: a
+// "@ <record>" line for the directory itself, then a "<record>" line per entry, where
+// <record> is "<mode(octal)> <uid> <gid> <size> <blocks> <atime> <mtime> <birthtime>
+// <flags> <digest|-> <name>" (the directory's "name" is its relative path).  At startup
+// one sequential pass indexes the blocks by path; each worker then pread()s just the block
+// of the directory it is scanning into its TARGET dir table.
+
+typedef struct {
+   unsigned long long hash;		// 64-bit FNV-1a of directory path
+   off_t off;				// Block's offset in the manifest
+   size_t len;				// ... and length (0: empty slot)
+} MF_INDEX;
+
+static int MF_FD = -1;
+static MF_INDEX *MF = NULL;		// Open-addressed hash of blocks
+static size_t MF_MASK = 0;
+
+// mf_parse() - Split a manifest <record> (NUL-terminated) into *sb, *digest (NULL for
+// '-'), and *name.  Returns 0, or -1 if it is garbled.
+
+static int
+mf_parse(char *p, struct stat *sb, char **digest, char **name)
+{
+   unsigned long long v[9];
+   int i;
+
+   memset(sb, 0, sizeof(*sb));
+   for (i = 0; i < 9; i++) {
+      v[i] = strtoull(p, &p, i ? 10 : 8);
+      if (*p++ != ' ') return (-1);
+   }
+   sb->st_mode = v[0];
+   sb->st_uid = v[1];
+   sb->st_gid = v[2];
+   sb->st_size = v[3];
+   sb->st_blocks = v[4];
+   sb->st_atime = v[5];
+   sb->st_mtime = v[6];
+   sb->st_birthtime = v[7];
+#if HAVE_STRUCT_STAT_ST_FLAGS
+   sb->st_flags = v[8];
+#endif
+   *digest = p;
+   if ((p = strchr(p, ' ')) == NULL || p[1] == '\0') return (-1);
+   *p++ = '\0';
+   if (strcmp(*digest, "-") == 0) *digest = NULL;
+   *name = p;
+   return (0);
+}
+
+// mf_add() - Index a block.
+
+static void
+mf_add(unsigned long long hash, off_t off, size_t len)
+{
+   size_t i;
+
+   for (i = hash & MF_MASK; MF[i].len; i = (i + 1) & MF_MASK) ;
+   MF[i].hash = hash;
+   MF[i].off = off;
+   MF[i].len = len;
+}
+
+// cmp_manifest_init() - Open and index manifest <path>; <digest> gets the name of the digest
+// it records (or "none").  Returns the number of directories, or -1 if the file is
+// unreadable or not a manifest.
+
+long long
+cmp_manifest_init(char *path, char *digest, size_t digest_size)
+{
+   FILE *f;
+   char *line = NULL, *p;
+   size_t linecap = 0, slots;
+   ssize_t len;
+   off_t off, block = -1;
+   unsigned long long hash = 0;
+   MF_INDEX *blocks = NULL;
+   size_t n = 0, max = 0, i;
+
+   if ((f = fopen(path, "r")) == NULL) return (-1);
+   if ((len = getline(&line, &linecap, f)) <= 0 || strncmp(line, CMP_MANIFEST_MAGIC, strlen(CMP_MANIFEST_MAGIC)) != 0) {
+      fclose(f);
+      free(line);
+      return (-1);
+   }
+   p = line + strlen(CMP_MANIFEST_MAGIC);
+   p[strcspn(p, "\n")] = '\0';
+   snprintf(digest, digest_size, "%s", p);
+
+   // One pass, noting where each "@ " block starts and (at the next one) its length ...
+   for (off = len; (len = getline(&line, &linecap, f)) > 0; off += len) {
+      if (line[0] != '@') continue;
+      if (block >= 0) {
+         if (n >= max) {
+            max = max ? 2 * max : 1024;
+            if ((blocks = realloc(blocks, max * sizeof(MF_INDEX))) == NULL) abend("Cannot grow -cmp manifest index!");
+         }
+         blocks[n].hash = hash; blocks[n].off = block; blocks[n].len = off - block;
+         n += 1;
+      }
+      // Path is what follows the 11th space (ie: the <record>'s name) ...
+      for (p = line, i = 0; i < 11 && p; i++) if ((p = strchr(p, ' ')) != NULL) p++;
+      if (p == NULL) { fclose(f); free(line); free(blocks); return (-1); }
+      hash = fnv1a(p, strcspn(p, "\n"));
+      block = off;
+   }
+   if (block >= 0) {
+      if (n >= max && (blocks = realloc(blocks, (max = n + 1) * sizeof(MF_INDEX))) == NULL)
+         abend("Cannot grow -cmp manifest index!");
+      blocks[n].hash = hash; blocks[n].off = block; blocks[n].len = off - block;
+      n += 1;
+   }
+   fclose(f);
+   free(line);
+
+   for (slots = 1024; slots < 2 * n; slots *= 2) ;
+   if ((MF = calloc(slots, sizeof(MF_INDEX))) == NULL) abend("Cannot malloc -cmp manifest index!");
+   MF_MASK = slots - 1;
+   for (i = 0; i < n; i++) mf_add(blocks[i].hash, blocks[i].off, blocks[i].len);
+   free(blocks);
+   if ((MF_FD = open(path, O_RDONLY)) < 0) return (-1);
+   return ((long long) n);
+}
+
+// mf_load() - Load the manifest block for directory <relpath>; see cmp_manifest_load().
+
+static int
+mf_load(int w_id, const char *relpath, struct stat *dir_sb)
+{
+   unsigned long long hash = fnv1a(relpath, strlen(relpath));
+   char *p, *q, *digest, *name;
+   struct stat sb;
+   TDIR_ENT *e;
+   size_t i;
+
+   cmp_tdir_close(w_id);
+   for (i = hash & MF_MASK; MF[i].len; i = (i + 1) & MF_MASK) {
+      if (MF[i].hash != hash) continue;
+      tdir_names(w_id, MF[i].len + 1);
+      if (pread(MF_FD, TDIR[w_id].names, MF[i].len, MF[i].off) != (ssize_t) MF[i].len) return (-1);
+      TDIR[w_id].names[MF[i].len] = '\0';
+      TDIR[w_id].nlen = MF[i].len + 1;
+
+      // Header line: is it really this directory (not just the same hash)?
+      p = TDIR[w_id].names;
+      if ((q = strchr(p, '\n')) != NULL) *q++ = '\0';
+      if (p[0] != '@' || p[1] != ' ' || mf_parse(p + 2, dir_sb, &digest, &name) != 0) return (-1);
+      if (strcmp(name, relpath) != 0) continue;
+
+      // Entry lines, parsed in place ...
+      for (p = q; p && *p; p = q) {
+         if ((q = strchr(p, '\n')) != NULL) *q++ = '\0';
+         if (*p == '\0') continue;
+         if (mf_parse(p, &sb, &digest, &name) != 0) { TDIR[w_id].n = 0; return (-1); }
+         if (TDIR[w_id].n >= TDIR[w_id].sbmax) {
+            TDIR[w_id].sbmax = TDIR[w_id].sbmax ? 2 * TDIR[w_id].sbmax : 1024;
+            TDIR[w_id].sb = realloc(TDIR[w_id].sb, TDIR[w_id].sbmax * sizeof(struct stat));
+            if (TDIR[w_id].sb == NULL) abend("Cannot grow -cmp manifest table!");
+         }
+         TDIR[w_id].sb[TDIR[w_id].n] = sb;
+         e = tdir_ent(w_id, name - TDIR[w_id].names, IFTODT(sb.st_mode));
+         if (digest) e->digest = digest - TDIR[w_id].names;
+      }
+      tdir_index(w_id);
+      return (0);
+   }
+   return (1);
+}
+
+// cmp_manifest_load() - Load the manifest block for SOURCE directory <relpath> into the
+// worker's TARGET dir table, and its recorded metadata into *dir_sb.  Returns 0, 1 if the
+// manifest has no such directory, 2 if it has no such directory but records something else
+// by that name (in *dir_sb; table left empty), or -1 if a block is unreadable or garbled.
+
+int
+cmp_manifest_load(int w_id, const char *relpath, struct stat *dir_sb)
+{
+   char parent[PATH_MAX];
+   char *name;
+   int rc, i;
+
+   if ((rc = mf_load(w_id, relpath, dir_sb)) != 1) return (rc);
+
+   // Not a directory then; but was it there?  Only the parent's block knows ...
+   if (strlen(relpath) >= sizeof(parent)) return (1);
+   strcpy(parent, relpath);
+   if ((name = strrchr(parent, '/')) == NULL) return (1);
+   *name++ = '\0';
+   if ((rc = mf_load(w_id, parent, dir_sb)) == 0) {
+      rc = 1;
+      if ((i = cmp_tdir_find(w_id, name)) >= 0) {
+         *dir_sb = TDIR[w_id].sb[i];
+         rc = 2;
+      }
+   }
+   cmp_tdir_close(w_id);
+   return (rc);
+}
@@ -0,0 +1,94 @@
+#ifndef PWALK_CMP_H
+#define PWALK_CMP_H 1
+
+// pwalk_cmp.h - -cmp content support; pipelined SOURCE/TARGET compare.
+//
+// A file larger than one buffer is compared with both sides in flight at once: each
+// worker gets a read-ahead helper thread which pread()s TARGET into a small ring of
+// buffers, while the worker itself pread()s SOURCE (with a WILLNEED hint one buffer
+// ahead) and memcmp()s against the next ready TARGET buffer.  Source and target
+// latencies then overlap instead of adding up.  The first difference (content, length,
+// or read error) ends the compare; the worker waits only for the helper's pread() in
+// progress before it closes the files.  When both files have the same holes (see
+// pwalk_extents.h), only their data extents are compared (cmp_range()).
+//
+// Files bigger than -cmp_chunk= are not compared inside the directory scan that finds
+// them.  They become a CMP_JOB whose byte-range chunks go on a chunk queue, which
+// workers drain ahead of the directory FIFO; each chunk is a cmp_pipe() of its range.
+// The job counts its chunks as they finish, and the worker finishing the last one
+// reports the file's -cmp result.
+//
+// With -cmp_cache=<file>, pairs verified equal are remembered across runs by a key: the
+// first 16 bytes of a SHA-256 over both sides' (dev, ino, size, mtime, ctime).  A pair
+// whose key is in the cache is not read again, unless picked for a random re-verify
+// (-cmp_reverify=<pct>).  The cache file is rewritten at the end of the run with just
+// the keys looked up or verified in it, so entries for changed or vanished pairs age out.
+//
+// Each TARGET directory is read once (cmp_tdir_load()) into a per-worker name table that
+// SOURCE entries are joined against: a name missing from it is 'E' without a syscall, its
+// d_type can settle a type-only compare, and names never matched exist only in TARGET.
+// With -cmp=manifest:<file>, that table comes from the directory's block in a manifest
+// written by an earlier -manifest run, with the recorded metadata (and digest) of each
+// entry standing in for a TARGET stat() (and content read).
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#define CMP_BUFSIZE_DEFAULT (1024*1024)	// -cmp_bufsize= default
+#define CMP_BUFSIZE_MIN (64*1024)
+#define CMP_BUFSIZE_MAX (64*1024*1024)
+#define CMP_DEPTH 4			// TARGET read-ahead buffers per worker
+#define CMP_CHUNK_DEFAULT (1024LL*1024*1024)	// -cmp_chunk= default
+#define CMP_CHUNK_MIN (64LL*1024*1024)
+#define CMP_MANIFEST_MAGIC "# pwalk-manifest1 digest="	// -manifest first line, then digest name
+
+typedef struct cmp_job {
+   struct cmp_job *next;		// Chunk queue link
+   char *relpath;			// File, relative to each worker's SOURCE and TARGET
+   off_t size;				// SOURCE size when queued
+   unsigned nchunks;			// Chunks in the file (the last one reads to EOF)
+   unsigned taken;			// Chunks handed out so far
+   unsigned done;			// Chunks finished or skipped
+   int rc;				// 0: equal so far, 1: different, -1: error (first one sticks)
+   void *arg;				// Caller's context, for reporting
+} CMP_JOB;
+
+typedef struct {
+   unsigned char k[16];
+} CMP_KEY;
+
+#define CMP_CACHE_MISS 0		// Not verified before (or changed); compare
+#define CMP_CACHE_HIT 1			// Verified equal before, unchanged since; skip
+#define CMP_CACHE_REVERIFY 2		// ... but picked for a re-verify; compare
+
+typedef struct {
+   unsigned long long loaded;		// Keys read from cache file
+   unsigned long long kept;		// ... looked up again this run
+   unsigned long long added;		// Newly verified keys
+} CMP_CACHE_STATS;
+
+// Forward declarations ...
+void cmp_pipe_init(size_t bufsize);
+int cmp_pipe(int w_id, int fds, int fdt, char *sbuf, off_t off, off_t len, off_t *nbytes);
+int cmp_range(int w_id, int fds, int fdt, char *sbuf, off_t off, off_t len, off_t *nbytes, off_t *holes);
+void cmp_chunk_init(off_t chunk_size);
+unsigned long long cmp_chunks_queued(void);
+unsigned cmp_job_add(const char *relpath, off_t size, void *arg);
+CMP_JOB *cmp_chunk_take(unsigned *chunk);
+int cmp_chunk_run(int w_id, CMP_JOB *j, unsigned chunk, int sdfd, int tdfd, char *sbuf, off_t *nbytes, off_t *holes);
+void cmp_job_free(CMP_JOB *j);
+long long cmp_cache_init(char *path, int reverify_pct);
+int cmp_cache_lookup(int w_id, struct stat *ssb, struct stat *tsb, CMP_KEY *key);
+void cmp_cache_add(int w_id, CMP_KEY *key);
+int cmp_cache_save(CMP_CACHE_STATS *cs);
+int cmp_tdir_load(int w_id, int tdfd, const char *relpath);
+int cmp_tdir_find(int w_id, const char *name);
+int cmp_tdir_type(int w_id, int i);
+struct stat *cmp_tdir_stat(int w_id, int i);
+const char *cmp_tdir_digest(int w_id, int i);
+const char *cmp_tdir_unmatched(int w_id, unsigned *iter, int *d_type);
+void cmp_tdir_close(int w_id);
+long long cmp_manifest_init(char *path, char *digest, size_t digest_size);
+int cmp_manifest_load(int w_id, const char *relpath, struct stat *dir_sb);
+
+#endif // PWALK_CMP_H
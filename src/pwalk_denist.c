@@ -0,0 +1,335 @@
+// pwalk_denist.c - +denist support; MD5 of each ordinary file's first 128 bytes.
+// See pwalk_denist.h for the overall scheme.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <assert.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include "pwalk.h"
+#include "pwalk_sums.h"
+#include "pwalk_io.h"
+#include "pwalk_denist.h"
+#include "pwalk_lat.h"
+
+// @@@ SECTION: Hash set @@@
+
+// Open addressing, linear probing; MD5s are uniform, so their first 8 bytes are the hash.
+// An all-zero slot is empty (an all-zero MD5 in the list is remembered separately).
+static unsigned char (*SET)[16] = NULL;
+static size_t SET_MASK = 0;
+static int SET_ZERO = 0;
+static const unsigned char MD5_ZERO[16];
+
+static size_t
+set_slot(const unsigned char *md5)
+{
+   unsigned long long h;
+
+   memcpy(&h, md5, sizeof(h));
+   return ((size_t) h & SET_MASK);
+}
+
+static void
+set_add(const unsigned char *md5)
+{
+   size_t i;
+
+   if (memcmp(md5, MD5_ZERO, 16) == 0) { SET_ZERO = 1; return; }
+   for (i = set_slot(md5); memcmp(SET[i], MD5_ZERO, 16); i = (i + 1) & SET_MASK)
+      if (memcmp(SET[i], md5, 16) == 0) return;		// Duplicate in list
+   memcpy(SET[i], md5, 16);
+}
+
+// denist_match() - Is <md5> in the +denist=<hashlist> set?
+
+int
+denist_match(const unsigned char *md5)
+{
+   size_t i;
+
+   if (SET == NULL) return (0);
+   if (memcmp(md5, MD5_ZERO, 16) == 0) return (SET_ZERO);
+   for (i = set_slot(md5); memcmp(SET[i], MD5_ZERO, 16); i = (i + 1) & SET_MASK)
+      if (memcmp(SET[i], md5, 16) == 0) return (1);
+   return (0);
+}
+
+// hex32() - The first run of exactly 32 hex digits in <line>, as 16 bytes; 0 if none.
+
+static int
+hex32(const char *line, unsigned char *md5)
+{
+   const char *p, *q;
+   unsigned v;
+   int i;
+
+   for (p = line; *p; p = q) {
+      for (q = p; isxdigit((unsigned char) *q); q++) ;
+      if (q - p == 32) {
+         for (i = 0; i < 16; i++) {
+            sscanf(p + 2*i, "%2x", &v);
+            md5[i] = v;
+         }
+         return (1);
+      }
+      if (q == p) q++;
+   }
+   return (0);
+}
+
+// set_load() - Read <path> into the set; returns hashes read (duplicates included), or -1.
+
+static long long
+set_load(char *path)
+{
+   FILE *f;
+   char line[4096];
+   unsigned char (*list)[16] = NULL;
+   size_t n = 0, size = 0, i;
+
+   if ((f = fopen(path, "r")) == NULL) return (-1);
+   while (fgets(line, sizeof(line), f)) {
+      if (line[0] == '#') continue;
+      if (n == size) {
+         size = size ? 2 * size : 65536;
+         if ((list = realloc(list, size * 16)) == NULL) abend("+denist: cannot malloc hash list!");
+      }
+      if (hex32(line, list[n])) n += 1;
+   }
+   if (ferror(f)) { fclose(f); free(list); return (-1); }
+   fclose(f);
+
+   for (size = 1024; size < 2 * n; size *= 2) ;		// At most half full
+   if ((SET = calloc(size, 16)) == NULL) abend("+denist: cannot calloc hash set!");
+   SET_MASK = size - 1;
+   for (i = 0; i < n; i++) set_add(list[i]);
+   free(list);
+   return ((long long) n);
+}
+
+// @@@ SECTION: Per-worker read-ahead batches @@@
+
+#define ENT_QUEUED 0			// Waiting for a helper (or the worker)
+#define ENT_BUSY 1			// Being read
+#define ENT_DONE 2			// md5 and nbytes are valid
+
+typedef struct {
+   size_t name;				// Offset in the batch's name pool
+   unsigned next;			// Hash chain (index + 1; 0 ends it)
+   unsigned slot;			// ... whose head is slots[slot]
+   int state;
+   int nbytes;				// Bytes read, or -1 on error
+   unsigned char md5[16];
+} DN_ENT;
+
+typedef struct {
+   pthread_mutex_t lock;
+   pthread_cond_t cond;
+   int started;				// Helpers created
+   int dfd;				// Directory being scanned, or -1
+   DN_ENT *ent;
+   unsigned n;				// Entries in this batch
+   unsigned next;			// Next entry for a helper to try
+   unsigned busy;			// Helpers reading now
+   unsigned long long ahead;		// Reads the worker found done (or under way)
+   unsigned *slots;			// Name hash heads (index + 1)
+   char *pool;
+   size_t pool_used, pool_size;
+} DN_BATCH;
+
+static DN_BATCH BATCH[MAX_WORKERS+1];
+static int DEPTH = DENIST_DEPTH_DEFAULT;
+
+#define DN_SLOTS (2 * DENIST_BATCH_MAX)
+
+static unsigned
+name_slot(const char *s)
+{
+   return (fnv1a(s, strlen(s)) % DN_SLOTS);
+}
+
+// denist_read() - The open(), pread(), MD5, close() that +denist is all about.
+
+static int
+denist_read(int dfd, const char *name, unsigned char *md5)
+{
+   unsigned char space[2*IO_ALIGN], *buf;	// One IO_ALIGN-aligned block, for -io=direct
+   SUM_VALUES v;
+   int fd, n;
+
+   buf = (unsigned char *) (((unsigned long) space + IO_ALIGN - 1) & ~((unsigned long) IO_ALIGN - 1));
+   if ((fd = io_open(dfd, name, IO_DENIST)) < 0) return (-1);
+   n = io_pread(fd, buf, DENIST_BYTES, 0, IO_DENIST);
+   io_close(fd);
+   if (n < 0) return (-1);
+   sums_buf(SUM_MD5, buf, n, &v);
+   memcpy(md5, v.md5, 16);
+   return (n);
+}
+
+// denist_helper() - One of a worker's read-ahead threads; works through the current batch.
+
+static void *
+denist_helper(void *arg)
+{
+   DN_BATCH *b = arg;
+   DN_ENT *e;
+   int dfd;
+
+   lat_thread(b - BATCH);
+   pthread_mutex_lock(&b->lock);
+   while (1) {
+      while (b->next >= b->n) pthread_cond_wait(&b->cond, &b->lock);
+      e = &b->ent[b->next++];
+      if (e->state != ENT_QUEUED) continue;		// Worker got to it first
+      e->state = ENT_BUSY;
+      b->busy += 1;
+      dfd = b->dfd;
+      pthread_mutex_unlock(&b->lock);
+      e->nbytes = denist_read(dfd, b->pool + e->name, e->md5);
+      pthread_mutex_lock(&b->lock);
+      e->state = ENT_DONE;
+      b->busy -= 1;
+      pthread_cond_broadcast(&b->cond);
+   }
+   return (NULL);
+}
+
+// denist_init() - Load the hash list (if any) and set helpers per worker.  Returns the
+// number of hashes loaded (0 without a list), or -1 if <path> cannot be read.
+
+long long
+denist_init(char *path, int depth)
+{
+   DEPTH = depth;
+   return (path ? set_load(path) : 0);
+}
+
+// denist_batch_begin() - Queue the directory open on <dfd> for read-ahead.  The caller
+// must call denist_batch_end() before closing <dfd>.
+
+void
+denist_batch_begin(int w_id, int dfd)
+{
+   DN_BATCH *b = &BATCH[w_id];
+   struct dirent *d;
+   DIR *dir;
+   size_t len;
+   unsigned n = 0, s, i;
+   int fd;
+
+   if (DEPTH == 0) return;
+   if (!b->started) {
+      assert(pthread_mutex_init(&b->lock, NULL) == 0);
+      assert(pthread_cond_init(&b->cond, NULL) == 0);
+      if ((b->ent = malloc(DENIST_BATCH_MAX * sizeof(DN_ENT))) == NULL ||
+          (b->slots = calloc(DN_SLOTS, sizeof(unsigned))) == NULL)
+         abend("+denist: cannot malloc batch!");
+      for (i = 0; i < DEPTH; i++) {
+         pthread_t t;
+         if (pthread_create(&t, NULL, denist_helper, b)) abend("Cannot create +denist read-ahead thread!");
+      }
+      b->started = 1;
+   }
+
+   denist_batch_end(w_id);
+   for (i = 0; i < b->n; i++) b->slots[b->ent[i].slot] = 0;	// Just the heads last batch used
+   pthread_mutex_lock(&b->lock);		// Helpers are idle until b->n is set again
+   b->n = b->next = 0;
+   pthread_mutex_unlock(&b->lock);
+   b->pool_used = 0;
+
+   // A second stream on the directory, so the worker's own readdir() is undisturbed ...
+   if ((fd = openat(dfd, ".", O_RDONLY|O_DIRECTORY)) < 0) return;
+   if ((dir = fdopendir(fd)) == NULL) { close(fd); return; }
+   while (n < DENIST_BATCH_MAX && (d = readdir(dir)) != NULL) {
+      if (d->d_type != DT_REG && d->d_type != DT_UNKNOWN) continue;
+      if (strcmp(d->d_name, ".") == 0 || strcmp(d->d_name, "..") == 0) continue;
+      len = strlen(d->d_name) + 1;
+      if (b->pool_used + len > b->pool_size) {
+         b->pool_size = b->pool_size ? 2 * b->pool_size + len : 64 * 1024;
+         if ((b->pool = realloc(b->pool, b->pool_size)) == NULL) abend("+denist: cannot malloc names!");
+      }
+      memcpy(b->pool + b->pool_used, d->d_name, len);
+      b->ent[n].name = b->pool_used;
+      b->ent[n].state = ENT_QUEUED;
+      b->ent[n].slot = s = name_slot(d->d_name);
+      b->ent[n].next = b->slots[s];
+      b->slots[s] = n + 1;
+      b->pool_used += len;
+      n += 1;
+   }
+   closedir(dir);
+   pthread_mutex_lock(&b->lock);
+   b->dfd = dfd;
+   b->n = n;
+   pthread_cond_broadcast(&b->cond);
+   pthread_mutex_unlock(&b->lock);
+}
+
+// denist_batch_end() - Stop read-ahead for the directory, once helpers' reads are done.
+
+void
+denist_batch_end(int w_id)
+{
+   DN_BATCH *b = &BATCH[w_id];
+
+   if (!b->started) return;
+   pthread_mutex_lock(&b->lock);
+   b->next = b->n;				// Helpers take no more
+   while (b->busy) pthread_cond_wait(&b->cond, &b->lock);
+   b->dfd = -1;
+   pthread_mutex_unlock(&b->lock);
+}
+
+// denist_file() - MD5 of the first DENIST_BYTES of <name> in directory <dfd> into <md5>;
+// from the worker's batch when read ahead, else read now.  Returns bytes read, or -1 on
+// an open() or read() error.
+
+int
+denist_file(int w_id, int dfd, const char *name, unsigned char *md5)
+{
+   DN_BATCH *b = &BATCH[w_id];
+   DN_ENT *e = NULL;
+   unsigned i;
+
+   if (b->started && b->n) {
+      for (i = b->slots[name_slot(name)]; i; i = b->ent[i-1].next)
+         if (strcmp(b->pool + b->ent[i-1].name, name) == 0) { e = &b->ent[i-1]; break; }
+   }
+   if (e) {
+      pthread_mutex_lock(&b->lock);
+      if (e->state == ENT_QUEUED) {
+         e->state = ENT_BUSY;				// Ours; no helper will take it now
+         e = NULL;
+      } else {
+         while (e->state != ENT_DONE) pthread_cond_wait(&b->cond, &b->lock);
+      }
+      pthread_mutex_unlock(&b->lock);
+      if (e) {
+         b->ahead += 1;
+         memcpy(md5, e->md5, 16);
+         return (e->nbytes);
+      }
+   }
+   return (denist_read(dfd, name, md5));
+}
+
+// denist_ahead() - Reads done by helpers, all workers; call after the treewalk.
+
+unsigned long long
+denist_ahead(void)
+{
+   unsigned long long n = 0;
+   int w_id;
+
+   for (w_id = 0; w_id <= MAX_WORKERS; w_id++) n += BATCH[w_id].ahead;
+   return (n);
+}
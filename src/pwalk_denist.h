@@ -0,0 +1,34 @@
+#ifndef PWALK_DENIST_H
+#define PWALK_DENIST_H 1
+
+// pwalk_denist.h - +denist support; MD5 of each ordinary file's first 128 bytes.
+//
+// With +denist=<hashlist>, those MD5s are looked up in a set loaded from a NIST-style
+// hash list (eg: NSRL): each line's first run of exactly 32 hex digits is an MD5, so both
+// plain one-hash-per-line files and NSRL's quoted CSV work.  Matching files are tagged
+// " NIST" in -ls and -xml outputs, and counted.  Plain +denist just does the reads.
+//
+// Each of these reads is an open(), a 128-byte pread() and a close(): three round trips
+// for almost no data.  So when a worker opens a directory, it lists the directory's
+// possible ordinary files (d_type DT_REG or DT_UNKNOWN) as a batch for its own pool of
+// -denist_depth= helper threads, which run those reads ahead of the worker's scan.  By the
+// time the scan reaches a file, its MD5 is usually waiting; if a helper has not started
+// on it yet, the worker does it itself rather than wait.  Entries past DENIST_BATCH_MAX
+// in one directory are just done inline.
+
+#include <sys/types.h>
+
+#define DENIST_BYTES 128		// Bytes of each file hashed
+#define DENIST_DEPTH_DEFAULT 8		// -denist_depth= default; helper threads per worker
+#define DENIST_DEPTH_MAX 64
+#define DENIST_BATCH_MAX 65536		// Entries batched per directory
+
+// Forward declarations ...
+long long denist_init(char *path, int depth);
+void denist_batch_begin(int w_id, int dfd);
+void denist_batch_end(int w_id);
+int denist_file(int w_id, int dfd, const char *name, unsigned char *md5);
+int denist_match(const unsigned char *md5);
+unsigned long long denist_ahead(void);
+
+#endif // PWALK_DENIST_H
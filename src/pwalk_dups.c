@@ -0,0 +1,365 @@
+// pwalk_dups.c - -dups support; duplicate-file finder.
+// See pwalk_dups.h for the overall scheme.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <assert.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "pwalk.h"
+#include "pwalk_dups.h"
+
+#define DUPS_BUCKETS (1 << 18)		// Size-bucket table heads
+#define DUPS_STRIPES 1024		// Bucket b is guarded by LOCKS[b % DUPS_STRIPES]
+
+// One per path added; chained by size, and after planning by inode (hard links) ...
+typedef struct dfile {
+   struct dfile *next;
+   dev_t dev;
+   ino_t ino;
+   char path[1];			// NUL-terminated relative path (allocated to fit)
+} DFILE;
+
+typedef struct dsize {
+   struct dsize *next;			// Next size in same bucket
+   off_t size;
+   unsigned long long nfiles;
+   DFILE *files;
+} DSIZE;
+
+// One per candidate inode, for the hashing stages ...
+typedef struct {
+   off_t size;
+   DFILE *links;			// Path(s) to this inode; the first one gets read
+   int need;				// Needs hashing in current stage
+   int stage;				// 1: sample hash in key, 2: full SHA-256 in key, -1: error
+   int err;				// errno when stage is -1
+   unsigned char key[32];
+} DCAND;
+
+static DSIZE **TABLE = NULL;
+static pthread_mutex_t LOCKS[DUPS_STRIPES];
+static off_t MIN_SIZE = 1;
+static int NWORKERS = 0;
+
+static DCAND *CAND = NULL;
+static size_t NCAND = 0;
+static int STAGE = 0;			// 0: walking, 1: sample hashing, 2: full hashing, 3: done
+static size_t CURSOR = 0;		// Next CAND[] index to hash (atomic)
+static unsigned long long NFILES = 0, NSIZES = 0;
+
+// Per-worker hashing counters (summed by dups_output()) ...
+static struct {
+   unsigned long long sampled, full, errors;
+   SUM_STATS st;
+} WDUPS[MAX_WORKERS+1];
+
+// dups_init() - Call once before the treewalk.
+
+void
+dups_init(int nworkers, off_t min_size)
+{
+   int i;
+
+   NWORKERS = nworkers;
+   MIN_SIZE = (min_size > 0) ? min_size : 1;	// Empty files are all 'the same', but reclaim nothing
+   TABLE = calloc(DUPS_BUCKETS, sizeof(DSIZE *));
+   if (TABLE == NULL) abend("-dups: cannot calloc size-bucket table!");
+   for (i=0; i<DUPS_STRIPES; i++) assert(pthread_mutex_init(&LOCKS[i], NULL) == 0);
+}
+
+// dups_add() - Add an ordinary file found during the treewalk.  <dev> is what identifies its
+// filesystem for hard-link purposes (which the caller may know better than st_dev).  MT-safe.
+
+void
+dups_add(const char *relpath, struct stat *sb, dev_t dev)
+{
+   size_t len = strlen(relpath);
+   unsigned b;
+   DSIZE *s;
+   DFILE *f;
+
+   if (sb->st_size < MIN_SIZE) return;
+   if ((f = malloc(sizeof(DFILE) + len)) == NULL) abend("-dups: cannot malloc!");
+   f->dev = dev;
+   f->ino = sb->st_ino;
+   memcpy(f->path, relpath, len + 1);
+
+   b = ((unsigned long long) sb->st_size * 0x9e3779b97f4a7c15ULL) >> (64 - 18);
+   assert(pthread_mutex_lock(&LOCKS[b % DUPS_STRIPES]) == 0);		// +++ bucket lock +++
+   for (s = TABLE[b]; s && s->size != sb->st_size; s = s->next) ;
+   if (s == NULL) {
+      if ((s = calloc(1, sizeof(DSIZE))) == NULL) abend("-dups: cannot calloc!");
+      s->size = sb->st_size;
+      s->next = TABLE[b];
+      TABLE[b] = s;
+   }
+   f->next = s->files;
+   s->files = f;
+   s->nfiles += 1;
+   assert(pthread_mutex_unlock(&LOCKS[b % DUPS_STRIPES]) == 0);		// --- bucket lock ---
+}
+
+static int
+dfile_cmp(const void *a, const void *b)
+{
+   const DFILE *x = *(const DFILE **) a, *y = *(const DFILE **) b;
+
+   if (x->dev != y->dev) return (x->dev < y->dev) ? -1 : 1;
+   if (x->ino != y->ino) return (x->ino < y->ino) ? -1 : 1;
+   return strcmp(x->path, y->path);
+}
+
+static int
+dcand_cmp(const void *a, const void *b)
+{
+   const DCAND *x = a, *y = b;
+
+   if (x->size != y->size) return (x->size < y->size) ? -1 : 1;
+   if (x->stage != y->stage) return (x->stage < y->stage) ? -1 : 1;
+   return memcmp(x->key, y->key, sizeof(x->key));
+}
+
+// dups_plan() - After the walk; turn the size table into CAND[], one entry per inode that
+// shares its size with some other inode.  Everything else is freed here.
+
+static void
+dups_plan(void)
+{
+   DFILE **tmp = NULL, *f, *fnext;
+   DSIZE *s, *snext;
+   size_t ntmp = 0, maxcand = 0, i, j, k;
+   unsigned b;
+
+   for (b=0; b<DUPS_BUCKETS; b++) {
+      for (s = TABLE[b]; s; s = snext) {
+         snext = s->next;
+         NSIZES += 1;
+         NFILES += s->nfiles;
+         if (s->nfiles > 1) {
+            // Sort this size's files by inode, so hard links are adjacent ...
+            if (s->nfiles > ntmp) {
+               ntmp = s->nfiles;
+               if ((tmp = realloc(tmp, ntmp * sizeof(DFILE *))) == NULL) abend("-dups: cannot realloc!");
+            }
+            for (i = 0, f = s->files; f; f = f->next) tmp[i++] = f;
+            qsort(tmp, s->nfiles, sizeof(DFILE *), dfile_cmp);
+            for (i = 1, k = 1; i < s->nfiles; i++)
+               if (tmp[i]->dev != tmp[i-1]->dev || tmp[i]->ino != tmp[i-1]->ino) k++;
+            if (k > 1) {		// >1 inode of this size; each is a candidate
+               if (NCAND + k > maxcand) {
+                  maxcand = (NCAND + k) * 2;
+                  if ((CAND = realloc(CAND, maxcand * sizeof(DCAND))) == NULL) abend("-dups: cannot realloc!");
+               }
+               for (i = 0; i < s->nfiles; i = j) {
+                  bzero(&CAND[NCAND], sizeof(DCAND));
+                  CAND[NCAND].size = s->size;
+                  CAND[NCAND].need = 1;
+                  CAND[NCAND].links = tmp[i];
+                  for (j = i + 1; j < s->nfiles && tmp[j]->dev == tmp[i]->dev && tmp[j]->ino == tmp[i]->ino; j++)
+                     tmp[j-1]->next = tmp[j];
+                  tmp[j-1]->next = NULL;
+                  NCAND += 1;
+               }
+               s->files = NULL;	// Now owned by CAND[]
+            }
+         }
+         for (f = s->files; f; f = fnext) { fnext = f->next; free(f); }
+         free(s);
+      }
+   }
+   free(tmp);
+   free(TABLE);
+   TABLE = NULL;
+}
+
+// dups_next_stage() - Between hashing stages (and after the walk); set up the next stage.
+// Returns TRUE if the caller should run dups_hash() on the worker pool for it.
+
+int
+dups_next_stage(void)
+{
+   size_t i, j, k, nneed = 0;
+
+   if (STAGE == 0) {			// -> 1: sample-hash every candidate
+      dups_plan();
+      STAGE = 1;
+      nneed = NCAND;
+   } else if (STAGE == 1) {		// -> 2: full-hash candidates whose sample hashes collide
+      qsort(CAND, NCAND, sizeof(DCAND), dcand_cmp);
+      for (i = 0; i < NCAND; i = j) {
+         for (j = i + 1; j < NCAND && dcand_cmp(&CAND[i], &CAND[j]) == 0; j++) ;
+         if (CAND[i].stage == 1 && j - i > 1)
+            for (k = i; k < j; k++) { CAND[k].need = 1; nneed++; }
+      }
+      STAGE = 2;
+   } else {
+      STAGE = 3;
+   }
+   CURSOR = 0;
+   return (nneed > 0);
+}
+
+// Read <len> bytes at <off>, despite short reads; returns bytes read ...
+static size_t
+dups_pread(int fd, char *buf, size_t len, off_t off)
+{
+   ssize_t n;
+   size_t got = 0;
+
+   while (got < len && (n = pread(fd, buf + got, len - got, off + got)) > 0) got += n;
+   return (got);
+}
+
+// dups_hash() - Worker-pool body for one hashing stage; workers take CAND[] entries until
+// none are left.  <dfd> is the worker's source root, <buf> its aligned read buffer.
+
+void
+dups_hash(int w_id, int dfd, char *buf, size_t bufsize)
+{
+   DCAND *c;
+   SUM_VALUES v;
+   size_t i, n;
+   int fd;
+
+   assert(bufsize >= 2 * DUPS_SAMPLE);
+   while ((i = __atomic_fetch_add(&CURSOR, 1, __ATOMIC_RELAXED)) < NCAND) {
+      c = &CAND[i];
+      if (!c->need) continue;
+      c->need = 0;
+      if ((fd = openat(dfd, c->links->path, O_RDONLY|O_NOFOLLOW, 0)) < 0) {
+         c->stage = -1; c->err = errno;
+         WDUPS[w_id].errors += 1;
+         continue;
+      }
+      if (STAGE == 1 && c->size <= 2 * DUPS_SAMPLE) {	// Small; the 'sample' is the whole file
+         n = dups_pread(fd, buf, c->size, 0);
+         WDUPS[w_id].st.read_bytes += n;
+         if (n == c->size) {
+            sums_buf(SUM_SHA256, buf, n, &v);
+            memcpy(c->key, v.sha256, 32);
+            c->stage = 2;
+            WDUPS[w_id].full += 1;
+         }
+      } else if (STAGE == 1) {				// First and last DUPS_SAMPLE bytes
+         n = dups_pread(fd, buf, DUPS_SAMPLE, 0);
+         n += dups_pread(fd, buf + DUPS_SAMPLE, DUPS_SAMPLE, c->size - DUPS_SAMPLE);
+         WDUPS[w_id].st.read_bytes += n;
+         if (n == 2 * DUPS_SAMPLE) {
+            sums_buf(SUM_XXH64, buf, n, &v);
+            memcpy(c->key, &v.xxh64, sizeof(v.xxh64));
+            c->stage = 1;
+            WDUPS[w_id].sampled += 1;
+         }
+      } else {						// Full SHA-256
+#if !defined(__OSX__)
+         posix_fadvise(fd, 0L, 0L, POSIX_FADV_SEQUENTIAL);
+#endif
+         n = sums_file(fd, buf, bufsize, SUM_SHA256, &v, &WDUPS[w_id].st);
+         if (n == c->size) {
+            memcpy(c->key, v.sha256, 32);
+            c->stage = 2;
+            WDUPS[w_id].full += 1;
+         }
+      }
+      if (c->stage == 0 || (STAGE == 2 && c->stage == 1)) {	// Short read: error, or file changed
+         c->stage = -1; c->err = EIO;
+         WDUPS[w_id].errors += 1;
+      }
+      close(fd);
+   }
+}
+
+// Duplicate groups, for ordering output by bytes reclaimable ...
+typedef struct {
+   size_t first, n;
+   unsigned long long reclaimable;
+} DGROUP;
+
+static int
+dgroup_cmp(const void *a, const void *b)
+{
+   const DGROUP *x = a, *y = b;
+
+   if (x->reclaimable != y->reclaimable) return (x->reclaimable > y->reclaimable) ? -1 : 1;
+   return (x->first < y->first) ? -1 : (x->first > y->first);
+}
+
+static void
+hex(char *s, const unsigned char *p, int n)
+{
+   while (n--) { sprintf(s, "%02x", *p++); s += 2; }
+}
+
+// dups_output() - After the last stage; write duplicate groups (most reclaimable first)
+// to <ofile>, fill in <ds>, and free everything.
+
+void
+dups_output(char *ofile, DUPS_STATS_T *ds)
+{
+   FILE *out;
+   DGROUP *g;
+   DFILE *f, *fnext;
+   size_t i, j, k, ng = 0;
+   char keystr[65];
+   int w_id;
+
+   bzero(ds, sizeof(*ds));
+   ds->files = NFILES;
+   ds->sizes = NSIZES;
+   ds->candidates = NCAND;
+   for (w_id=0; w_id<NWORKERS; w_id++) {
+      ds->sampled += WDUPS[w_id].sampled;
+      ds->full += WDUPS[w_id].full;
+      ds->errors += WDUPS[w_id].errors;
+      ds->bytes_read += WDUPS[w_id].st.read_bytes;
+   }
+
+   // Group by (size, SHA-256) ...
+   qsort(CAND, NCAND, sizeof(DCAND), dcand_cmp);
+   if ((g = malloc((NCAND / 2 + 1) * sizeof(DGROUP))) == NULL) abend("-dups: cannot malloc!");
+   for (i = 0; i < NCAND; i = j) {
+      for (j = i + 1; j < NCAND && dcand_cmp(&CAND[i], &CAND[j]) == 0; j++) ;
+      if (CAND[i].stage != 2 || j - i < 2) continue;
+      g[ng].first = i;
+      g[ng].n = j - i;
+      g[ng].reclaimable = (j - i - 1) * (unsigned long long) CAND[i].size;
+      ds->groups += 1;
+      ds->dups += j - i - 1;
+      ds->reclaimable += g[ng].reclaimable;
+      for (k = i; k < j; k++)
+         for (f = CAND[k].links->next; f; f = f->next) ds->links += 1;
+      ng++;
+   }
+   qsort(g, ng, sizeof(DGROUP), dgroup_cmp);
+
+   // 'f' lines are distinct copies; 'h' lines are more hard links to the copy above ...
+   if ((out = fopen(ofile, "w")) == NULL) abend("Cannot create -dups output file!");
+   fprintf(out, "# pwalk -dups: %llu group%s, %llu redundant cop%s, %llu bytes reclaimable\n",
+      ds->groups, (ds->groups != 1) ? "s" : "", ds->dups, (ds->dups != 1) ? "ies" : "y", ds->reclaimable);
+   for (i = 0; i < ng; i++) {
+      hex(keystr, CAND[g[i].first].key, 32);
+      fprintf(out, "\n@ %zu copies of %lld bytes, %llu reclaimable, sha256=%s\n",
+         g[i].n, (long long) CAND[g[i].first].size, g[i].reclaimable, keystr);
+      for (k = g[i].first; k < g[i].first + g[i].n; k++)
+         for (f = CAND[k].links; f; f = f->next)
+            fprintf(out, "%c %s\n", (f == CAND[k].links) ? 'f' : 'h', f->path);
+   }
+   for (i = 0; i < NCAND; i++)
+      if (CAND[i].stage == -1)
+         fprintf(out, "# ERROR: Cannot read \"%s\" (%s)\n", CAND[i].links->path,
+            (CAND[i].err == EIO) ? "short read; changed since treewalk?" : strerror(CAND[i].err));
+   fclose(out);
+
+   free(g);
+   for (i = 0; i < NCAND; i++)
+      for (f = CAND[i].links; f; f = fnext) { fnext = f->next; free(f); }
+   free(CAND);
+   CAND = NULL;
+   NCAND = 0;
+}
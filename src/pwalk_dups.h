@@ -0,0 +1,43 @@
+#ifndef PWALK_DUPS_H
+#define PWALK_DUPS_H 1
+
+// pwalk_dups.h - -dups support; duplicate-file finder.
+//
+// During the treewalk, workers add every selected ordinary file's (size, dev, ino, path)
+// to a size-bucket table (striped locks).  Only files that share a size with some other
+// inode can be duplicates, and hard links (same dev/ino) are never counted as copies.
+// After the walk, hashing proceeds in stages, each run across the worker pool:
+//	1. Same-size candidates get a cheap sample hash (first and last DUPS_SAMPLE bytes);
+//	   files no bigger than the sample just get their full hash.
+//	2. Only files whose sample hash still collides get a full SHA-256.
+// Files that end with the same size and SHA-256 are reported as duplicate groups, with
+// the bytes that removing all but one copy would reclaim.
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "pwalk_sums.h"
+
+#define DUPS_SAMPLE (64*1024)		// Bytes sampled from each end of a candidate
+
+typedef struct {
+   unsigned long long files;		// Files added during treewalk
+   unsigned long long sizes;		// ... distinct sizes among them
+   unsigned long long candidates;	// Inodes sharing a size with another inode
+   unsigned long long sampled;		// Sample hashes
+   unsigned long long full;		// Full hashes
+   unsigned long long bytes_read;	// Bytes read hashing
+   unsigned long long errors;		// Open/read errors (or files changed since walk)
+   unsigned long long groups;		// Duplicate groups
+   unsigned long long dups;		// Redundant copies (files beyond the first in each group)
+   unsigned long long links;		// Extra hard links within groups (not copies)
+   unsigned long long reclaimable;	// Bytes freed by removing redundant copies
+} DUPS_STATS_T;
+
+// Forward declarations ...
+void dups_init(int nworkers, off_t min_size);
+void dups_add(const char *relpath, struct stat *sb, dev_t dev);
+int dups_next_stage(void);
+void dups_hash(int w_id, int dfd, char *buf, size_t bufsize);
+void dups_output(char *ofile, DUPS_STATS_T *ds);
+
+#endif // PWALK_DUPS_H
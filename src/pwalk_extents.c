@@ -0,0 +1,99 @@
+// pwalk_extents.c - Data extents of sparse files, via lseek(SEEK_DATA/SEEK_HOLE).
+// See pwalk_extents.h for what uses them.
+
+#if defined(LINUX)
+#define _GNU_SOURCE		// SEEK_DATA, SEEK_HOLE
+#endif
+
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/types.h>
+#if defined(__linux__)
+#include <sys/vfs.h>
+#endif
+#include "pwalk_extents.h"
+
+// ext_map() - Data extents of open file <fd> within [off, end), clipped to it, into *m.
+// Returns the number of extents (0: all hole), or -1 if the holes cannot be found.
+// NOTE: Moves the file offset; callers use pread().
+
+int
+ext_map(int fd, off_t off, off_t end, EXT_MAP *m)
+{
+#if defined(SEEK_DATA) && defined(SEEK_HOLE)
+   off_t pos, s, e;
+
+   m->n = 0;
+   for (pos = off; pos < end; pos = e) {
+      if ((s = lseek(fd, pos, SEEK_DATA)) < 0) {
+         if (errno == ENXIO) break;		// Hole from pos to EOF
+         return (-1);
+      }
+      if (s >= end) break;
+      if ((e = lseek(fd, s, SEEK_HOLE)) <= s) return (-1);
+      if (e > end) e = end;
+      if (m->n == EXT_MAX) return (-1);		// Too fragmented to bother
+      m->start[m->n] = s;
+      m->end[m->n] = e;
+      m->n += 1;
+   }
+   return (m->n);
+#else
+   return (-1);
+#endif
+}
+
+// ext_data_bytes() - Total bytes in a map's data extents.
+
+off_t
+ext_data_bytes(EXT_MAP *m)
+{
+   off_t n = 0;
+   int i;
+
+   for (i = 0; i < m->n; i++) n += m->end[i] - m->start[i];
+   return (n);
+}
+
+// ext_map_equal() - Same extents?
+
+int
+ext_map_equal(EXT_MAP *a, EXT_MAP *b)
+{
+   return (a->n == b->n &&
+           memcmp(a->start, b->start, a->n * sizeof(off_t)) == 0 &&
+           memcmp(a->end, b->end, a->n * sizeof(off_t)) == 0);
+}
+
+// ext_holes() - Bytes in the holes of open file <fd> of <size> bytes, or -1 if unknown.
+// NOTE: NFS clients before v4.2 report a file as all data, which is not the same as the
+// file having no holes, so no holes found over NFS is 'unknown'.
+
+off_t
+ext_holes(int fd, off_t size)
+{
+#if defined(SEEK_DATA) && defined(SEEK_HOLE)
+   off_t pos, s, e, holes = 0;
+#if defined(__linux__)
+   struct statfs sfs;
+#endif
+
+   for (pos = 0; pos < size; pos = e) {
+      if ((s = lseek(fd, pos, SEEK_DATA)) < 0) {
+         if (errno != ENXIO) return (-1);
+         s = size;				// Hole from pos to EOF
+      }
+      if (s > size) s = size;
+      holes += s - pos;
+      if (s == size) break;
+      if ((e = lseek(fd, s, SEEK_HOLE)) <= s) return (-1);
+   }
+#if defined(__linux__)
+   if (holes == 0 && fstatfs(fd, &sfs) == 0 && sfs.f_type == 0x6969) return (-1);	// NFS_SUPER_MAGIC
+#endif
+   return (holes);
+#else
+   return (-1);
+#endif
+}
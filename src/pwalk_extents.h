@@ -0,0 +1,30 @@
+#ifndef PWALK_EXTENTS_H
+#define PWALK_EXTENTS_H 1
+
+// pwalk_extents.h - Data extents of sparse files, via lseek(SEEK_DATA/SEEK_HOLE).
+//
+// READONLY operations use these to avoid reading holes: digests (+crc, +md5, etc.) take a
+// hole as the zeros it reads as, and -cmp compares two files whose hole maps match extent
+// by extent.  -select=sparse asks for the bytes in holes instead of guessing from st_blocks.
+// Where holes cannot be found (no SEEK_DATA, or more extents than EXT_MAX), callers just
+// read everything, as before.
+// NOTE: FIEMAP (Linux) would also report extents, but SEEK_DATA/SEEK_HOLE are portable
+// and report the same holes.
+
+#include <sys/types.h>
+
+#define EXT_MAX 256			// Extents mapped at most; beyond that, treat as dense
+
+typedef struct {
+   int n;				// Data extents, in order
+   off_t start[EXT_MAX];		// ... [start, end); holes are the gaps
+   off_t end[EXT_MAX];
+} EXT_MAP;
+
+// Forward declarations ...
+int ext_map(int fd, off_t off, off_t end, EXT_MAP *m);
+off_t ext_data_bytes(EXT_MAP *m);
+int ext_map_equal(EXT_MAP *a, EXT_MAP *b);
+off_t ext_holes(int fd, off_t size);
+
+#endif // PWALK_EXTENTS_H
@@ -0,0 +1,160 @@
+// pwalk_io.c - -io= policy for READONLY file content reads.
+// See pwalk_io.h for the policies.
+
+#if defined(LINUX)
+#define _GNU_SOURCE		// O_DIRECT
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/types.h>
+#include "pwalk.h"
+#include "pwalk_io.h"
+#include "pwalk_lat.h"
+
+const char *IO_POLICY_NAMES[] = { "buffered", "dontneed", "direct", NULL };
+const char *IO_USER_NAMES[IO_NUSERS] = { "digest", "+denist", "-cmp" };
+
+static int POLICY = IO_BUFFERED;
+static off_t READAHEAD = 0;
+static IO_STATS ST;
+
+#define ADD(field, n) __atomic_add_fetch(&ST.field, (unsigned long long) (n), __ATOMIC_RELAXED)
+
+// io_policy_parse() - IO_* value of a -io= name, or -1.
+
+int
+io_policy_parse(const char *s)
+{
+   int i;
+
+   for (i = 0; IO_POLICY_NAMES[i]; i++)
+      if (strcmp(s, IO_POLICY_NAMES[i]) == 0) return (i);
+   return (-1);
+}
+
+void
+io_init(int policy, off_t readahead)
+{
+   POLICY = policy;
+   READAHEAD = readahead;
+}
+
+int
+io_policy(void)
+{
+   return (POLICY);
+}
+
+// io_open() - Open <path> (relative to <dfd>) READONLY for content reads by <user>, per
+// the -io= policy.  Symlinks are not followed.  Returns fd, or -1 with errno set.
+
+int
+io_open(int dfd, const char *path, int user)
+{
+   int fd, direct = 0;
+   long long t_lat;
+
+   LAT_BEGIN(t_lat);
+#if defined(O_DIRECT)
+   if (POLICY == IO_DIRECT) {
+      if ((fd = openat(dfd, path, O_RDONLY|O_NOFOLLOW|O_OPENLINK|O_DIRECT)) >= 0) {
+         direct = 1;
+         goto opened;
+      }
+      if (errno != EINVAL) return (-1);
+      ADD(fallbacks, 1);				// eg: tmpfs
+   }
+#endif
+   if ((fd = openat(dfd, path, O_RDONLY|O_NOFOLLOW|O_OPENLINK)) < 0) return (-1);
+#if defined(F_NOCACHE)
+   if (POLICY == IO_DIRECT) {
+      if (fcntl(fd, F_NOCACHE, 1) == 0) direct = 1;
+      else ADD(fallbacks, 1);
+   }
+#elif defined(DIRECTIO_ON)
+   if (POLICY == IO_DIRECT) {
+      if (directio(fd, DIRECTIO_ON) == 0) direct = 1;
+      else ADD(fallbacks, 1);
+   }
+#endif
+#if defined(O_DIRECT)
+opened:
+#endif
+   LAT_END(LAT_OPENAT, t_lat);
+   ADD(opens[user], 1);
+   if (direct) ADD(direct, 1);
+#if !defined(__OSX__)
+   // NOTE: Not for +denist; reading 128 bytes, a bigger readahead is just waste ...
+   else if (user != IO_DENIST) posix_fadvise(fd, 0L, 0L, POSIX_FADV_SEQUENTIAL);
+#endif
+   return (fd);
+}
+
+// io_pread() - pread() for <user>, per the -io= policy; see pwalk_io.h for <buf>'s size.
+
+ssize_t
+io_pread(int fd, void *buf, size_t len, off_t off, int user)
+{
+   size_t want = len;
+   ssize_t n;
+   long long t_lat;
+#if defined(O_DIRECT)
+   int fl = 0;
+
+   if (POLICY == IO_DIRECT && (fl = fcntl(fd, F_GETFL)) >= 0 && (fl & O_DIRECT))
+      want = (len + IO_ALIGN - 1) & ~((size_t) IO_ALIGN - 1);
+#endif
+   LAT_BEGIN(t_lat);
+   do {
+      n = pread(fd, buf, want, off);
+   } while (n < 0 && errno == EINTR);
+#if defined(O_DIRECT)
+   // O_DIRECT refused this read (alignment); finish the file through the cache ...
+   if (n < 0 && errno == EINVAL && fl > 0 && (fl & O_DIRECT) && fcntl(fd, F_SETFL, fl & ~O_DIRECT) == 0) {
+      ADD(fallbacks, 1);
+      do {
+         n = pread(fd, buf, len, off);
+      } while (n < 0 && errno == EINTR);
+   }
+#endif
+   LAT_END(LAT_PREAD, t_lat);
+   if (n > (ssize_t) len) n = len;
+   if (n <= 0) return (n);
+   ADD(bytes[user], n);
+
+#if !defined(__OSX__)
+   if (POLICY == IO_DONTNEED) {			// Rolling drop behind the read position
+      posix_fadvise(fd, off, n, POSIX_FADV_DONTNEED);
+      ADD(dropped, n);
+   }
+   if (READAHEAD && POLICY != IO_DIRECT && (off == 0 || (off + n) / READAHEAD != off / READAHEAD)) {
+      posix_fadvise(fd, off + n, READAHEAD, POSIX_FADV_WILLNEED);
+      ADD(hinted, READAHEAD);
+   }
+#endif
+   return (n);
+}
+
+// io_close() - Close a file from io_open(); except for -io=buffered, first drop whatever
+// of it is still cached (readahead past where reading stopped, or a refused O_DIRECT).
+
+int
+io_close(int fd)
+{
+#if !defined(__OSX__)
+   if (POLICY != IO_BUFFERED) posix_fadvise(fd, 0L, 0L, POSIX_FADV_DONTNEED);
+#endif
+   return (close(fd));
+}
+
+// io_stats() - Totals so far, all workers.
+
+void
+io_stats(IO_STATS *st)
+{
+   *st = ST;
+}
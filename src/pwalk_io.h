@@ -0,0 +1,57 @@
+#ifndef PWALK_IO_H
+#define PWALK_IO_H 1
+
+// pwalk_io.h - -io= policy for READONLY file content reads (+crc, +md5, etc., -dups,
+// +denist, and -cmp).
+//
+// Reading a whole filesystem through the page cache evicts everything else on the host
+// to make room for data read exactly once.  -io= picks how content reads treat the cache:
+//	buffered	- plain reads (the default)
+//	dontneed	- plain reads, each range dropped from the cache (POSIX_FADV_DONTNEED)
+//			  right after it is read, and the whole file again at close
+//	direct		- bypass the cache: O_DIRECT (F_NOCACHE on macOS, directio() on
+//			  Solaris); a file whose filesystem refuses it is read through the
+//			  cache, and dropped from it at close
+// -io_readahead=<bytes> hints (POSIX_FADV_WILLNEED) that many bytes past each read, for
+// buffered and dontneed reads; 0 leaves readahead to the kernel.
+//
+// O_DIRECT wants aligned buffers, offsets, and lengths.  Callers of io_pread() use
+// IO_ALIGN-aligned buffers whose size is a multiple of IO_ALIGN (so -io=direct needs such
+// a -cmp_bufsize=); a short read at EOF is rounded up to IO_ALIGN and its result trimmed.
+// Anything else O_DIRECT refuses makes io_pread() fall back to the cache for that file.
+
+#include <sys/types.h>
+
+#define IO_BUFFERED 0
+#define IO_DONTNEED 1
+#define IO_DIRECT 2
+
+#define IO_SUMS 0			// io_open() <user>: digests (+crc, etc., -dups)
+#define IO_DENIST 1			// ... +denist
+#define IO_CMP 2			// ... -cmp content
+#define IO_NUSERS 3
+
+#define IO_ALIGN 4096
+
+typedef struct {
+   unsigned long long opens[IO_NUSERS];	// Files opened, per user
+   unsigned long long bytes[IO_NUSERS];	// ... bytes read from them
+   unsigned long long direct;		// Files read with the cache bypassed
+   unsigned long long fallbacks;	// Files whose filesystem refused that
+   unsigned long long dropped;		// Bytes advised DONTNEED after reading
+   unsigned long long hinted;		// Bytes advised WILLNEED ahead of reading
+} IO_STATS;
+
+extern const char *IO_POLICY_NAMES[];
+extern const char *IO_USER_NAMES[IO_NUSERS];
+
+// Forward declarations ...
+int io_policy_parse(const char *s);
+void io_init(int policy, off_t readahead);
+int io_policy(void);
+int io_open(int dfd, const char *path, int user);
+ssize_t io_pread(int fd, void *buf, size_t len, off_t off, int user);
+int io_close(int fd);
+void io_stats(IO_STATS *st);
+
+#endif // PWALK_IO_H
@@ -0,0 +1,253 @@
+// pwalk_lat.c - +lat support; per-thread latency histograms, merged after the walk.
+// See pwalk_lat.h for the call classes and outputs.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <pthread.h>
+#include <dirent.h>
+#include "pwalk.h"
+#include "pwalk_lat.h"
+
+static const char *OP_NAMES[LAT_NOPS] = {
+   "opendir", "readdir", "fstatat", "acl", "openat", "pread", "memcmp", "write"
+};
+
+typedef struct lat_set {
+   struct lat_set *next;		// All sets, for lat_report()
+   int source;				// Index into source paths, or -1 for none
+   count_64 n[LAT_NOPS], sum[LAT_NOPS], max[LAT_NOPS];
+   count_64 bucket[LAT_NOPS][LAT_BUCKETS];
+} LAT_SET;
+
+int LAT_ON = 0;
+const double LAT_PCT[LAT_NPCT] = { 50., 90., 99., 99.9 };
+static int NSOURCES = 1;
+
+static pthread_mutex_t LAT_mutex = PTHREAD_MUTEX_INITIALIZER;	// For SETS only
+static LAT_SET *SETS = NULL;
+static __thread LAT_SET *MY = NULL;	// This thread's own
+
+// lat_init() - Turn +lat on, with <nsources> source paths to bind workers to.
+
+void
+lat_init(int nsources)
+{
+   LAT_ON = 1;
+   NSOURCES = (nsources > 0) ? nsources : 1;
+}
+
+static LAT_SET *
+set_new(int source)
+{
+   LAT_SET *s;
+
+   if ((s = calloc(1, sizeof(LAT_SET))) == NULL) abend("+lat: cannot calloc histograms!");
+   s->source = source;
+   pthread_mutex_lock(&LAT_mutex);
+   s->next = SETS;
+   SETS = s;
+   pthread_mutex_unlock(&LAT_mutex);
+   return (s);
+}
+
+// lat_thread() - Calling thread works for worker <w_id>; its calls count for that
+// worker's source path.
+
+void
+lat_thread(int w_id)
+{
+   if (!LAT_ON) return;
+   if (MY == NULL) MY = set_new(w_id % NSOURCES);
+   else MY->source = w_id % NSOURCES;
+}
+
+long long
+lat_now(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (ts.tv_sec * 1000000000LL + ts.tv_nsec);
+}
+
+// lat_record() - Count a call of class <op> that took <ns>.
+
+void
+lat_record(int op, long long ns)
+{
+   LAT_SET *s = MY;
+   unsigned long long v;
+   int e, i;
+
+   if (s == NULL) s = MY = set_new(-1);		// Not bound to a worker
+   v = (ns < 0) ? 0 : (ns > LAT_MAX_NS) ? LAT_MAX_NS : ns;
+   if (v < LAT_SUB) {
+      i = v;
+   } else {
+      e = 63 - __builtin_clzll(v);		// v is in [2^e, 2^(e+1))
+      i = (e - LAT_SUB_BITS + 1) * LAT_SUB + ((v >> (e - LAT_SUB_BITS)) & (LAT_SUB - 1));
+   }
+   s->bucket[op][i] += 1;
+   s->n[op] += 1;
+   s->sum[op] += v;
+   if (v > s->max[op]) s->max[op] = v;
+}
+
+// lat_readdir() - readdir_r(), timed.
+
+int
+lat_readdir(DIR *dir, struct dirent *entry, struct dirent **result)
+{
+   long long t;
+   int rc;
+
+   LAT_BEGIN(t);
+   rc = readdir_r(dir, entry, result);
+   LAT_END(LAT_READDIR, t);
+   return (rc);
+}
+
+// bucket_top() - Highest value counted in bucket <i>.
+
+static count_64
+bucket_top(int i)
+{
+   int e;
+
+   if (i < LAT_SUB) return (i);
+   e = i / LAT_SUB + LAT_SUB_BITS - 1;
+   return ((((count_64) (LAT_SUB + i % LAT_SUB)) << (e - LAT_SUB_BITS)) + (1ULL << (e - LAT_SUB_BITS)) - 1);
+}
+
+// percentile() - Value at or below which <pct> of the calls of <op> in <s> fell.
+
+static count_64
+percentile(LAT_SET *s, int op, double pct)
+{
+   count_64 want, seen = 0, v;
+   int i;
+
+   want = (count_64) (pct / 100. * s->n[op] + 0.999999);
+   if (want == 0) want = 1;
+   for (i = 0; i < LAT_BUCKETS - 1; i++)		// (Counts being added as we look may not add up)
+      if ((seen += s->bucket[op][i]) >= want) break;
+   v = bucket_top(i);
+   return (v > s->max[op] ? s->max[op] : v);
+}
+
+static void
+set_add(LAT_SET *to, LAT_SET *from)
+{
+   int op, i;
+
+   for (op = 0; op < LAT_NOPS; op++) {
+      if (from->n[op] == 0) continue;
+      to->n[op] += from->n[op];
+      to->sum[op] += from->sum[op];
+      if (from->max[op] > to->max[op]) to->max[op] = from->max[op];
+      for (i = 0; i < LAT_BUCKETS; i++) to->bucket[op][i] += from->bucket[op][i];
+   }
+}
+
+// put_set() - One line per call class seen in <s>, to the log (in us) and the CSV (in ns).
+
+static void
+put_set(FILE *log, FILE *csv, const char *label, LAT_SET *s)
+{
+   count_64 p[LAT_NPCT];
+   int op, k;
+
+   for (op = 0; op < LAT_NOPS; op++) {
+      if (s->n[op] == 0) continue;
+      for (k = 0; k < LAT_NPCT; k++) p[k] = percentile(s, op, LAT_PCT[k]);
+      if (log) fprintf(log, "%16llu - %-7s %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+         s->n[op], OP_NAMES[op], s->sum[op] / 1000. / s->n[op],
+         p[0] / 1000., p[1] / 1000., p[2] / 1000., p[3] / 1000., s->max[op] / 1000.);
+      if (csv) fprintf(csv, "\"%s\",%s,%llu,%llu,%llu,%llu,%llu,%llu,%llu\n", label, OP_NAMES[op],
+         s->n[op], s->sum[op] / s->n[op], p[0], p[1], p[2], p[3], s->max[op]);
+   }
+}
+
+// merge() - All threads' histograms; [0] overall, [1] not bound to a worker, [2+i] source
+// path i.  Caller frees.
+
+static LAT_SET *
+merge(void)
+{
+   LAT_SET *all, *s;
+
+   if ((all = calloc(NSOURCES + 2, sizeof(LAT_SET))) == NULL) abend("+lat: cannot calloc!");
+   pthread_mutex_lock(&LAT_mutex);
+   for (s = SETS; s; s = s->next) {
+      set_add(&all[0], s);
+      set_add(&all[2 + s->source], s);
+   }
+   pthread_mutex_unlock(&LAT_mutex);
+   return (all);
+}
+
+// lat_report() - Merge all threads' histograms; report them overall to <log>, and overall
+// and per source path to pwalk_lat.csv in <outdir>.  Returns 0 if OK.
+
+int
+lat_report(FILE *log, const char *outdir, char **source_paths)
+{
+   char ofile[PATH_MAX+64];
+   LAT_SET *all, *src;
+   FILE *csv;
+   int i, rc = 0;
+
+   all = merge();
+   src = all + 2;				// all[0] is overall, src[-1] "none"
+
+   sprintf(ofile, "%s%cpwalk_lat.csv", outdir, PATHSEPCHR);
+   if ((csv = fopen(ofile, "w")) == NULL) rc = -1;
+   else fprintf(csv, "source,op,count,mean_ns,p50_ns,p90_ns,p99_ns,p99.9_ns,max_ns\n");
+
+   fprintf(log, "@ +lat call latencies (us) ...\n");
+   fprintf(log, "%16s   %-7s %10s %10s %10s %10s %10s %10s\n",
+      "calls", "", "mean", "p50", "p90", "p99", "p99.9", "max");
+   put_set(log, csv, "*", &all[0]);
+   if (csv) {
+      for (i = 0; i < NSOURCES; i++) put_set(NULL, csv, source_paths ? source_paths[i] : ".", &src[i]);
+      put_set(NULL, csv, "-", &src[-1]);
+      if (fclose(csv) != 0) rc = -1;
+   }
+   free(all);
+   return (rc);
+}
+
+const char *
+lat_op_name(int op)
+{
+   return (OP_NAMES[op]);
+}
+
+// lat_summarize() - Summaries so far, laid out as merge()'s: [NSOURCES+2][LAT_NOPS].  The
+// threads may be recording as we read, so each is only a recent value.  NULL without +lat;
+// caller frees.
+
+LAT_SUMMARY *
+lat_summarize(void)
+{
+   LAT_SET *all;
+   LAT_SUMMARY *sum, *p;
+   int i, op, k;
+
+   if (!LAT_ON) return (NULL);
+   all = merge();
+   if ((sum = calloc((NSOURCES + 2) * LAT_NOPS, sizeof(LAT_SUMMARY))) == NULL) abend("+lat: cannot calloc!");
+   for (i = 0; i < NSOURCES + 2; i++)
+      for (op = 0; op < LAT_NOPS; op++) {
+         p = &sum[i * LAT_NOPS + op];
+         if ((p->n = all[i].n[op]) == 0) continue;
+         p->sum = all[i].sum[op];
+         p->max = all[i].max[op];
+         for (k = 0; k < LAT_NPCT; k++) p->p[k] = percentile(&all[i], op, LAT_PCT[k]);
+      }
+   free(all);
+   return (sum);
+}
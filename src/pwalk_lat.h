@@ -0,0 +1,71 @@
+#ifndef PWALK_LAT_H
+#define PWALK_LAT_H 1
+
+// pwalk_lat.h - +lat support; latency histograms for each class of metadata and I/O call.
+//
+// +tstat puts per-entry timings into the outputs, which bloats them and adds nothing up.
+// With +lat, each call below is timed into an HDR-style histogram instead:
+//	opendir	- opendir() of each directory popped
+//	readdir	- each readdir_r() (a getdents() batch when it has to go to the filesystem)
+//	fstatat	- stat() of each dirent, and of each directory opened
+//	acl	- each ACL fetch (+acls, +xacls=, +wacls=; Linux only)
+//	openat	- each READONLY open for content (+crc, etc., +denist, -cmp)
+//	pread	- each content read
+//	memcmp	- each -cmp buffer compare
+//	write	- each write of worker output (stdio, or a -writers= writev())
+// Buckets are log-linear: LAT_SUB per power of 2, so each is within ~3% of the values in
+// it, from 1ns up to LAT_MAX_NS (longer calls count as LAT_MAX_NS).
+//
+// Every thread that records (workers, their -cmp and +denist read-ahead helpers, writer
+// threads) gets its own set of histograms on its first call, so recording is two clock
+// reads, a count-leading-zeros, and a few increments, with no locks or atomics.  A worker
+// and its helpers are bound by lat_thread() to the worker's source path (-source= or
+// [source]); the writer threads have none.  After the walk, the sets are merged per source
+// path and overall, and each call class's count, mean, p50/p90/p99/p99.9 and max go to
+// pwalk.log and ${OUTPUT_DIR}/pwalk_lat.csv.  lat_summarize() merges them the same way
+// during the walk (for -metrics), reading the other threads' histograms without locks.
+
+#include <stdio.h>
+#include <dirent.h>
+
+#define LAT_OPENDIR 0
+#define LAT_READDIR 1
+#define LAT_FSTATAT 2
+#define LAT_ACL 3
+#define LAT_OPENAT 4
+#define LAT_PREAD 5
+#define LAT_MEMCMP 6
+#define LAT_WRITE 7
+#define LAT_NOPS 8
+
+#define LAT_SUB_BITS 5
+#define LAT_SUB (1 << LAT_SUB_BITS)
+#define LAT_MAX_BITS 40				// LAT_MAX_NS is 2^40-1ns (~18 minutes)
+#define LAT_MAX_NS ((1LL << LAT_MAX_BITS) - 1)
+#define LAT_BUCKETS ((LAT_MAX_BITS - LAT_SUB_BITS + 1) * LAT_SUB)
+
+#define LAT_NPCT 4				// Percentiles reported; see LAT_PCT[]
+
+typedef struct {
+   unsigned long long n, sum, max;	// Calls, and their total and longest ns
+   unsigned long long p[LAT_NPCT];	// ns at LAT_PCT[] percentiles
+} LAT_SUMMARY;
+
+extern int LAT_ON;			// +lat given
+extern const double LAT_PCT[LAT_NPCT];
+
+// Time a call: LAT_BEGIN(t); <call>; LAT_END(LAT_<op>, t);
+#define LAT_BEGIN(t) ((t) = LAT_ON ? lat_now() : 0)
+#define LAT_END(op, t) do { if (LAT_ON) lat_record((op), lat_now() - (t)); } while (0)
+
+// Forward declarations ...
+void lat_init(int nsources);
+void lat_thread(int w_id);
+long long lat_now(void);
+void lat_record(int op, long long ns);
+int lat_readdir(DIR *dir, struct dirent *entry, struct dirent **result);
+int lat_report(FILE *log, const char *outdir, char **source_paths);
+const char *lat_op_name(int op);
+LAT_SUMMARY *lat_summarize(void);
+
+#endif // PWALK_LAT_H
@@ -0,0 +1,524 @@
+// pwalk_merge.c - -merge support; one path-sorted output from all workers.
+// See pwalk_merge.h for the overall scheme.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <assert.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include "pwalk.h"
+#include "pwalk_merge.h"
+#include "pwalk_lat.h"
+
+#define MERGE_ARENA_MIN (1024*1024)	// Initial per-worker arena
+#define MERGE_INDEX_STRIDE 64		// Run index keeps every Nth key
+#define MERGE_READ_BUF (64*1024)	// stdio buffer per run cursor
+#define MERGE_COPY_BUF (1024*1024)	// For part concatenation
+
+// In-memory block; offsets into the owning worker's arena ...
+typedef struct {
+   size_t koff, doff;
+   unsigned klen, dlen;		// klen excludes NUL
+   char *k;			// Valid only while sorting
+} MBLOCK;
+
+// Spilled run file & its sparse in-memory index ...
+typedef struct {
+   char *path;
+   unsigned long long nblocks;
+   int nidx, maxidx;
+   char **idx_key;
+   off_t *idx_off;
+} MRUN;
+
+// Per-worker state ...
+static struct {
+   char *arena;			// Keys & data of blocks in current run
+   size_t used, size;
+   MBLOCK *blk;
+   size_t nblk, maxblk;
+   int nruns;			// Runs spilled by this worker
+   // Sorted readdir() state ...
+   char *names;			// Packed [ino][type][name\0] records
+   size_t nused, nsize;
+   char **ent;			// Sorted record pointers
+   size_t nent, maxent, next;
+   int loaded;
+} MW[MAX_WORKERS+1];
+
+static char MERGE_DIR[MAXPATHLEN+1];
+static size_t MERGE_WORKER_BUDGET;
+static MRUN *RUNS = NULL;
+static int NRUNS = 0, MAXRUNS = 0;
+static unsigned long long SPILL_BYTES = 0;
+static pthread_mutex_t MERGE_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// merge_keycmp() - Compare relative paths component-wise, so a directory's subdirectories
+// sort immediately after it (ie: '/' sorts lower than any other byte).
+
+int
+merge_keycmp(const char *a, const char *b)
+{
+   unsigned char ca, cb;
+
+   for (;; a++, b++) {
+      ca = (*a == '/') ? 1 : (unsigned char) *a;
+      cb = (*b == '/') ? 1 : (unsigned char) *b;
+      if (ca != cb || ca == 0) return (ca - cb);
+   }
+}
+
+static int
+mblock_cmp(const void *a, const void *b)
+{
+   return (merge_keycmp(((MBLOCK *) a)->k, ((MBLOCK *) b)->k));
+}
+
+// merge_init() - Create OUTPUT_DIR/pwalk_merge and size per-worker runs ...
+
+void
+merge_init(char *outdir, int nworkers, unsigned long long mem_budget)
+{
+   struct rlimit rl;
+
+   sprintf(MERGE_DIR, "%s/pwalk_merge", outdir);
+   if (mkdir(MERGE_DIR, 0755) != 0) abend("Cannot create -merge run directory!");
+   MERGE_WORKER_BUDGET = mem_budget / nworkers;
+   if (MERGE_WORKER_BUDGET < MERGE_ARENA_MIN) MERGE_WORKER_BUDGET = MERGE_ARENA_MIN;
+
+   // The merge opens every run at once (per partition); ask for all the fds we may have ...
+   if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+      rl.rlim_cur = rl.rlim_max;
+      (void) setrlimit(RLIMIT_NOFILE, &rl);
+   }
+}
+
+// @@@ SECTION: Run spilling @@@
+
+static void
+run_index_add(MRUN *r, const char *key, off_t off)
+{
+   if (r->nidx >= r->maxidx) {
+      r->maxidx = r->maxidx ? 2*r->maxidx : 64;
+      r->idx_key = realloc(r->idx_key, r->maxidx * sizeof(char *));
+      r->idx_off = realloc(r->idx_off, r->maxidx * sizeof(off_t));
+      if (!r->idx_key || !r->idx_off) abend("Cannot grow -merge run index!");
+   }
+   r->idx_key[r->nidx] = strdup(key);
+   r->idx_off[r->nidx++] = off;
+}
+
+// Register a finished run (MT-safe) ...
+static void
+run_register(MRUN *r)
+{
+   pthread_mutex_lock(&MERGE_mutex);
+   if (NRUNS >= MAXRUNS) {
+      MAXRUNS = MAXRUNS ? 2*MAXRUNS : 64;
+      RUNS = realloc(RUNS, MAXRUNS * sizeof(MRUN));
+      if (RUNS == NULL) abend("Cannot grow -merge run list!");
+   }
+   RUNS[NRUNS++] = *r;
+   pthread_mutex_unlock(&MERGE_mutex);
+}
+
+// Write one record: [klen][dlen][key][data] ...
+static off_t
+run_write_record(FILE *f, off_t off, const char *key, unsigned klen, const char *data, unsigned dlen)
+{
+   if (fwrite(&klen, sizeof(klen), 1, f) != 1 ||
+       fwrite(&dlen, sizeof(dlen), 1, f) != 1 ||
+       fwrite(key, 1, klen, f) != klen ||
+       fwrite(data, 1, dlen, f) != dlen)
+      abend("Cannot write -merge run file!");
+   return (off + sizeof(klen) + sizeof(dlen) + klen + dlen);
+}
+
+// Sort worker's in-memory blocks and spill them as one run ...
+static void
+merge_spill(int w_id)
+{
+   MRUN r;
+   FILE *f;
+   size_t i;
+   off_t off = 0;
+   char path[MAXPATHLEN+64];
+
+   if (MW[w_id].nblk == 0) return;
+   for (i = 0; i < MW[w_id].nblk; i++) MW[w_id].blk[i].k = MW[w_id].arena + MW[w_id].blk[i].koff;
+   qsort(MW[w_id].blk, MW[w_id].nblk, sizeof(MBLOCK), mblock_cmp);
+
+   sprintf(path, "%s/run-%03d-%04d", MERGE_DIR, w_id, MW[w_id].nruns++);
+   if ((f = fopen(path, "wx")) == NULL) abend("Cannot create -merge run file!");
+   setvbuf(f, NULL, _IOFBF, MERGE_COPY_BUF);
+   bzero(&r, sizeof(r));
+   r.path = strdup(path);
+   for (i = 0; i < MW[w_id].nblk; i++) {
+      MBLOCK *b = &MW[w_id].blk[i];
+      if ((i % MERGE_INDEX_STRIDE) == 0) run_index_add(&r, b->k, off);
+      off = run_write_record(f, off, b->k, b->klen, MW[w_id].arena + b->doff, b->dlen);
+   }
+   if (fclose(f) != 0) abend("Cannot close -merge run file!");
+   r.nblocks = MW[w_id].nblk;
+   run_register(&r);
+   __atomic_add_fetch(&SPILL_BYTES, (unsigned long long) off, __ATOMIC_RELAXED);
+
+   MW[w_id].nblk = 0;
+   MW[w_id].used = 0;
+}
+
+// merge_put_block() - Take the worker's current directory output as one block.  Leading
+// newlines (the .ls/.cmp blank-line separators) are dropped; merge_finish() re-inserts them.
+
+void
+merge_put_block(int w_id, const char *key, PW_OBUF *o)
+{
+   char *data = o->buf;
+   size_t dlen = o->len, klen = strlen(key), need;
+   MBLOCK *b;
+
+   while (dlen && *data == '\n') { data++; dlen--; }
+   if (dlen == 0) goto done;
+
+   need = klen + 1 + dlen;
+   if (MW[w_id].used && MW[w_id].used + need > MERGE_WORKER_BUDGET) merge_spill(w_id);
+   if (MW[w_id].used + need > MW[w_id].size) {
+      MW[w_id].size = MW[w_id].size ? 2*MW[w_id].size : MERGE_ARENA_MIN;
+      if (MW[w_id].size > MERGE_WORKER_BUDGET) MW[w_id].size = MERGE_WORKER_BUDGET;
+      if (MW[w_id].size < need) MW[w_id].size = need;
+      MW[w_id].arena = realloc(MW[w_id].arena, MW[w_id].size);
+      if (MW[w_id].arena == NULL) abend("Cannot grow -merge arena!");
+   }
+   if (MW[w_id].nblk >= MW[w_id].maxblk) {
+      MW[w_id].maxblk = MW[w_id].maxblk ? 2*MW[w_id].maxblk : 1024;
+      MW[w_id].blk = realloc(MW[w_id].blk, MW[w_id].maxblk * sizeof(MBLOCK));
+      if (MW[w_id].blk == NULL) abend("Cannot grow -merge block list!");
+   }
+   b = &MW[w_id].blk[MW[w_id].nblk++];
+   b->koff = MW[w_id].used;
+   b->klen = klen;
+   memcpy(MW[w_id].arena + b->koff, key, klen + 1);
+   b->doff = b->koff + klen + 1;
+   b->dlen = dlen;
+   memcpy(MW[w_id].arena + b->doff, data, dlen);
+   MW[w_id].used += need;
+
+done:
+   o->drained += o->len;
+   o->len = 0;
+}
+
+// @@@ SECTION: Sorted readdir @@@
+
+#define ENT_NAME(e) ((e) + sizeof(ino_t) + 1)
+
+static int
+ent_cmp(const void *a, const void *b)
+{
+   return (strcmp(ENT_NAME(*(char **) a), ENT_NAME(*(char **) b)));
+}
+
+// merge_readdir() - readdir_r() work-alike returning a directory's entries sorted by name,
+// so each block's content is deterministic.  First call slurps the whole directory.
+
+int
+merge_readdir(int w_id, DIR *dir, struct dirent *entry, struct dirent **result)
+{
+   struct dirent *de;
+   size_t i, len;
+   char *rec;
+   int rc;
+
+   if (!MW[w_id].loaded) {
+      MW[w_id].nused = MW[w_id].nent = MW[w_id].next = 0;
+      while (((rc = lat_readdir(dir, entry, &de)) == 0) && (de == entry)) {
+         len = sizeof(ino_t) + 1 + strlen(entry->d_name) + 1;
+         if (MW[w_id].nused + len > MW[w_id].nsize) {
+            MW[w_id].nsize = MW[w_id].nsize ? 2*MW[w_id].nsize + len : 64*1024;
+            MW[w_id].names = realloc(MW[w_id].names, MW[w_id].nsize);
+            if (MW[w_id].names == NULL) abend("Cannot grow -merge readdir buffer!");
+         }
+         rec = MW[w_id].names + MW[w_id].nused;
+         memcpy(rec, &entry->d_ino, sizeof(ino_t));
+#if defined(SOLARIS)
+         rec[sizeof(ino_t)] = 0;
+#else
+         rec[sizeof(ino_t)] = entry->d_type;
+#endif
+         strcpy(ENT_NAME(rec), entry->d_name);
+         MW[w_id].nused += len;
+         MW[w_id].nent += 1;
+      }
+      if (rc != 0) return (rc);
+      // Now that the arena is stable, point at the records & sort ...
+      if (MW[w_id].nent > MW[w_id].maxent) {
+         MW[w_id].maxent = MW[w_id].nent;
+         MW[w_id].ent = realloc(MW[w_id].ent, MW[w_id].maxent * sizeof(char *));
+         if (MW[w_id].ent == NULL) abend("Cannot grow -merge readdir index!");
+      }
+      for (i = 0, rec = MW[w_id].names; i < MW[w_id].nent; i++) {
+         MW[w_id].ent[i] = rec;
+         rec += sizeof(ino_t) + 1 + strlen(ENT_NAME(rec)) + 1;
+      }
+      qsort(MW[w_id].ent, MW[w_id].nent, sizeof(char *), ent_cmp);
+      MW[w_id].loaded = 1;
+   }
+
+   if (MW[w_id].next >= MW[w_id].nent) {	// End of directory; reset for next one
+      MW[w_id].loaded = 0;
+      *result = NULL;
+      return (0);
+   }
+   rec = MW[w_id].ent[MW[w_id].next++];
+   memcpy(&entry->d_ino, rec, sizeof(ino_t));
+#if !defined(SOLARIS)
+   entry->d_type = rec[sizeof(ino_t)];
+#endif
+   strcpy(entry->d_name, ENT_NAME(rec));
+#if !defined(SOLARIS) && !defined(__LINUX__)
+   entry->d_namlen = strlen(entry->d_name);
+#endif
+   *result = entry;
+   return (0);
+}
+
+// @@@ SECTION: k-way merge @@@
+
+typedef struct {
+   FILE *f;
+   int run;
+   char *key, *data;
+   unsigned klen, dlen;
+   size_t kcap, dcap;
+} MCURSOR;
+
+// Read next record; returns 0 at EOF ...
+static int
+cursor_next(MCURSOR *c)
+{
+   if (fread(&c->klen, sizeof(c->klen), 1, c->f) != 1) return (0);
+   if (fread(&c->dlen, sizeof(c->dlen), 1, c->f) != 1) abend("Truncated -merge run file!");
+   if (c->klen + 1 > c->kcap) { c->kcap = 2*(c->klen + 1); c->key = realloc(c->key, c->kcap); }
+   if (c->dlen > c->dcap) { c->dcap = 2*c->dlen; c->data = realloc(c->data, c->dcap); }
+   if (!c->key || !c->data) abend("Cannot grow -merge cursor!");
+   if (fread(c->key, 1, c->klen, c->f) != c->klen || fread(c->data, 1, c->dlen, c->f) != c->dlen)
+      abend("Truncated -merge run file!");
+   c->key[c->klen] = '\0';
+   return (1);
+}
+
+static int
+cursor_less(MCURSOR *a, MCURSOR *b)
+{
+   int rc = merge_keycmp(a->key, b->key);
+   return (rc < 0 || (rc == 0 && a->run < b->run));
+}
+
+static void
+heap_down(MCURSOR **h, int n, int i)
+{
+   int l, m;
+   MCURSOR *t;
+
+   for (;;) {
+      l = 2*i + 1; m = i;
+      if (l < n && cursor_less(h[l], h[m])) m = l;
+      if (l+1 < n && cursor_less(h[l+1], h[m])) m = l+1;
+      if (m == i) return;
+      t = h[i]; h[i] = h[m]; h[m] = t;
+      i = m;
+   }
+}
+
+// One partition of the final merge: keys in [lo, hi) from every run ...
+typedef struct {
+   int part;
+   int last;
+   const char *lo, *hi;		// NULL means unbounded
+   MERGE_OUTPUT_T *mo;
+   char path[MAXPATHLEN+64];
+   unsigned long long blocks, bytes;
+} MPART;
+
+static void *
+merge_part_thread(void *arg)
+{
+   MPART *mp = arg;
+   MERGE_OUTPUT_T *mo = mp->mo;
+   MCURSOR *cur, **heap;
+   FILE *out;
+   char cmd[MAXPATHLEN+128];
+   int i, j, n = 0, rc;
+
+   sprintf(mp->path, "%s/part-%03d%s", MERGE_DIR, mp->part, mo->gz ? ".gz" : "");
+   if (mo->gz) {
+      sprintf(cmd, "gzip > %s", mp->path);
+      out = popen(cmd, "w");
+   } else {
+      out = fopen(mp->path, "wx");
+   }
+   if (out == NULL) abend("Cannot create -merge part file!");
+   setvbuf(out, NULL, _IOFBF, MERGE_COPY_BUF);
+   if (mp->part == 0) fputs(mo->prologue, out);
+
+   // Position a cursor in every run at the first key >= lo ...
+   cur = calloc(NRUNS, sizeof(MCURSOR));
+   heap = calloc(NRUNS, sizeof(MCURSOR *));
+   if (!cur || !heap) abend("Cannot allocate -merge cursors!");
+   for (i = 0; i < NRUNS; i++) {
+      cur[i].run = i;
+      if ((cur[i].f = fopen(RUNS[i].path, "r")) == NULL) abend("Cannot open -merge run file!");
+      setvbuf(cur[i].f, NULL, _IOFBF, MERGE_READ_BUF);
+      if (mp->lo) {
+         for (j = RUNS[i].nidx - 1; j > 0; j--)		// Last sampled key < lo
+            if (merge_keycmp(RUNS[i].idx_key[j], mp->lo) < 0) break;
+         if (j > 0 && fseeko(cur[i].f, RUNS[i].idx_off[j], SEEK_SET) != 0)
+            abend("Cannot seek -merge run file!");
+      }
+      while ((rc = cursor_next(&cur[i])) && mp->lo && merge_keycmp(cur[i].key, mp->lo) < 0) ;
+      if (rc && (mp->hi == NULL || merge_keycmp(cur[i].key, mp->hi) < 0)) heap[n++] = &cur[i];
+   }
+   for (i = n/2 - 1; i >= 0; i--) heap_down(heap, n, i);
+
+   // Classic k-way merge ...
+   while (n > 0) {
+      if (mp->blocks) fputs(mo->sep, out);
+      if (fwrite(heap[0]->data, 1, heap[0]->dlen, out) != heap[0]->dlen) abend("Cannot write -merge part file!");
+      mp->blocks += 1;
+      mp->bytes += heap[0]->dlen;
+      if (!cursor_next(heap[0]) || (mp->hi && merge_keycmp(heap[0]->key, mp->hi) >= 0))
+         heap[0] = heap[--n];
+      heap_down(heap, n, 0);
+   }
+
+   if (mp->last) fputs(mo->trailer, out);
+   if ((mo->gz ? pclose(out) : fclose(out)) != 0) abend("Cannot close -merge part file!");
+   for (i = 0; i < NRUNS; i++) {
+      fclose(cur[i].f);
+      free(cur[i].key);
+      free(cur[i].data);
+   }
+   free(cur);
+   free(heap);
+   return (NULL);
+}
+
+static int
+samplecmp(const void *a, const void *b)
+{
+   return (merge_keycmp(*(char **) a, *(char **) b));
+}
+
+// Append file <path> to <fd> ...
+static void
+append_file(int fd, char *path, char *buf)
+{
+   int in;
+   ssize_t nr;
+
+   if ((in = open(path, O_RDONLY)) < 0) abend("Cannot open -merge part file!");
+   while ((nr = read(in, buf, MERGE_COPY_BUF)) > 0)
+      if (write(fd, buf, nr) != nr) abend("Cannot write -merge output!");
+   if (nr < 0) abend("Cannot read -merge part file!");
+   close(in);
+}
+
+// merge_finish() - Spill what's left, merge every run into mo->ofile, clean up.
+// Must be called only after all workers are idle.
+
+void
+merge_finish(MERGE_OUTPUT_T *mo, MERGE_STATS_T *ms)
+{
+   int i, j, k, fd, nparts, nsamples, maxparts;
+   char **samples, *buf, sep_path[MAXPATHLEN+64], cmd[MAXPATHLEN+128];
+   unsigned long long blocks_so_far = 0;
+   struct rlimit rl;
+   pthread_t *tids;
+   MPART *parts;
+   FILE *f;
+
+   for (i = 0; i <= MAX_WORKERS; i++) merge_spill(i);
+
+   // Choose partition boundaries from the runs' sampled keys ...
+   for (i = 0, nsamples = 0; i < NRUNS; i++) nsamples += RUNS[i].nidx;
+   samples = malloc((nsamples + 1) * sizeof(char *));
+   for (i = 0, k = 0; i < NRUNS; i++)
+      for (j = 0; j < RUNS[i].nidx; j++) samples[k++] = RUNS[i].idx_key[j];
+   qsort(samples, nsamples, sizeof(char *), samplecmp);
+
+   // Each partition holds every run open; stay well inside the fd limit ...
+   maxparts = mo->nthreads;
+   if (NRUNS && getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur != RLIM_INFINITY)
+      if ((int) ((rl.rlim_cur - 64) / NRUNS) < maxparts) maxparts = (rl.rlim_cur - 64) / NRUNS;
+   if (NRUNS && maxparts < 1) abend("-merge: too many runs for fd limit; raise -merge= memory!");
+   nparts = (nsamples < maxparts) ? nsamples : maxparts;
+   if (nparts < 1) nparts = 1;
+
+   parts = calloc(nparts, sizeof(MPART));
+   tids = calloc(nparts, sizeof(pthread_t));
+   for (i = 0, k = 0; i < nparts; i++) {
+      parts[k].part = k;
+      parts[k].mo = mo;
+      parts[k].lo = (k == 0) ? NULL : samples[(i * nsamples) / nparts];
+      if (k > 0 && merge_keycmp(parts[k].lo, parts[k-1].lo ? parts[k-1].lo : "") <= 0) continue;
+      k++;
+   }
+   nparts = k;
+   for (i = 0; i < nparts; i++) {
+      parts[i].hi = (i+1 < nparts) ? parts[i+1].lo : NULL;
+      parts[i].last = (i+1 == nparts);
+      assert(pthread_create(&tids[i], NULL, merge_part_thread, &parts[i]) == 0);
+   }
+   for (i = 0; i < nparts; i++) pthread_join(tids[i], NULL);
+
+   // Concatenate parts, re-inserting block separators between non-empty parts ...
+   sep_path[0] = '\0';
+   if (mo->gz && mo->sep[0]) {			// Separator must be its own gzip member
+      sprintf(sep_path, "%s/sep.gz", MERGE_DIR);
+      sprintf(cmd, "gzip > %s", sep_path);
+      if ((f = popen(cmd, "w")) == NULL) abend("Cannot create -merge separator!");
+      fputs(mo->sep, f);
+      pclose(f);
+   }
+   if ((fd = open(mo->ofile, O_WRONLY|O_CREAT|O_EXCL, 0644)) < 0) abend("Cannot create -merge output!");
+   buf = malloc(MERGE_COPY_BUF);
+   bzero(ms, sizeof(*ms));
+   for (i = 0; i < nparts; i++) {
+      if (blocks_so_far && parts[i].blocks && mo->sep[0]) {
+         if (sep_path[0]) append_file(fd, sep_path, buf);
+         else if (write(fd, mo->sep, strlen(mo->sep)) < 0) abend("Cannot write -merge output!");
+      }
+      append_file(fd, parts[i].path, buf);
+      unlink(parts[i].path);
+      blocks_so_far += parts[i].blocks;
+      ms->bytes += parts[i].bytes;
+   }
+   if (close(fd) != 0) abend("Cannot close -merge output!");
+   if (sep_path[0]) unlink(sep_path);
+
+   ms->blocks = blocks_so_far;
+   ms->runs = NRUNS;
+   ms->spill_bytes = SPILL_BYTES;
+   ms->parts = nparts;
+
+   for (i = 0; i < NRUNS; i++) {
+      unlink(RUNS[i].path);
+      for (j = 0; j < RUNS[i].nidx; j++) free(RUNS[i].idx_key[j]);
+      free(RUNS[i].idx_key);
+      free(RUNS[i].idx_off);
+      free(RUNS[i].path);
+   }
+   NRUNS = 0;
+   rmdir(MERGE_DIR);
+   free(samples);
+   free(parts);
+   free(tids);
+   free(buf);
+}
@@ -0,0 +1,40 @@
+#ifndef PWALK_MERGE_H
+#define PWALK_MERGE_H 1
+
+// pwalk_merge.h - -merge support; one path-sorted output from all workers.
+//
+// With -merge, each worker's output for one directory is a 'block' keyed by that
+// directory's relative path.  Workers collect blocks into bounded in-memory runs,
+// which get sorted and spilled to OUTPUT_DIR/pwalk_merge/run-WWW-NNNN files.  After
+// the treewalk, merge_finish() range-partitions the key space across threads, each of
+// which k-way merges its slice of every run into a part file; the parts are then
+// concatenated into the final listing (valid as multi-member gzip, too).
+
+#include <dirent.h>
+#include "pwalk_output.h"
+
+typedef struct {
+   unsigned long long blocks;		// Blocks merged
+   unsigned long long bytes;		// Uncompressed bytes merged
+   unsigned long long runs;		// Run files spilled
+   unsigned long long spill_bytes;	// Bytes written to run files
+   int parts;				// Parallel merge partitions
+} MERGE_STATS_T;
+
+typedef struct {
+   char *ofile;				// Final output pathname
+   int gz;				// gzip parts (-gz)
+   char *sep;				// Written between blocks (eg: "\n" for .ls), or ""
+   char *prologue;			// Written once at start (eg: XML or CSV header), or ""
+   char *trailer;			// Written once at end (eg: "</xml-listing>"), or ""
+   int nthreads;			// Max parallel merge partitions
+} MERGE_OUTPUT_T;
+
+// Forward declarations ...
+void merge_init(char *outdir, int nworkers, unsigned long long mem_budget);
+void merge_put_block(int w_id, const char *key, PW_OBUF *o);
+int merge_readdir(int w_id, DIR *dir, struct dirent *entry, struct dirent **result);
+void merge_finish(MERGE_OUTPUT_T *mo, MERGE_STATS_T *ms);
+int merge_keycmp(const char *a, const char *b);
+
+#endif // PWALK_MERGE_H
@@ -0,0 +1,566 @@
+// pwalk_metrics.c - -metrics[=<file>] and -metrics_port=<port>; the walk's counters as
+// Prometheus/OpenMetrics text.  See pwalk_metrics.h for what is exported, and how.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <limits.h>
+#include <ctype.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "pwalk.h"
+#include "pwalk_sums.h"
+#include "pwalk_lat.h"
+#include "pwalk_metrics.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0				// (OSX: SO_NOSIGPIPE instead)
+#endif
+
+#define WS_FIELD(f) offsetof(PWALK_STATS_T, f)
+
+// Every PWALK_STATS_T counter, as pwalk_<name>_total ...
+static const struct {
+   const char *name;
+   size_t off;
+   int ns;				// Nanoseconds, exported as seconds
+   const char *help;
+} COUNTERS[] = {
+   { "opendirs", WS_FIELD(NOpendirs), 0, "opendir() calls" },
+   { "scanned", WS_FIELD(NScanned), 0, "Entries scanned" },
+   { "selected", WS_FIELD(NSelected), 0, "Entries selected" },
+   { "removed", WS_FIELD(NRemoved), 0, "Files removed (-rm)" },
+   { "removed_dirs", WS_FIELD(NRemovedDirs), 0, "Directories removed (-rm=tree)" },
+   { "trashed", WS_FIELD(NTrashed), 0, "Files moved (-trash)" },
+   { "trash_copied", WS_FIELD(NTrashCopied), 0, "Files moved by copy and unlink, across filesystems (-trash)" },
+   { "acls", WS_FIELD(NACLs), 0, "Files and directories with ACLs processed" },
+   { "stat_calls", WS_FIELD(NStatCalls), 0, "fstatat() calls on entries" },
+   { "dirs", WS_FIELD(NDirs), 0, "Entries that were directories" },
+   { "files", WS_FIELD(NFiles), 0, "Entries that were files" },
+   { "symlinks", WS_FIELD(NSymlinks), 0, "Entries that were symlinks" },
+   { "others", WS_FIELD(NOthers), 0, "Entries that were not directories, files, or symlinks" },
+   { "stat_errors", WS_FIELD(NStatErrs), 0, "fstatat() errors on entries" },
+   { "warnings", WS_FIELD(NWarnings), 0, "Scan issues other than fstatat() errors" },
+   { "zero_files", WS_FIELD(NZeroFiles), 0, "Files of size 0" },
+   { "hardlink_files", WS_FIELD(NHardLinkFiles), 0, "Non-directories with link count > 1" },
+   { "hardlinks", WS_FIELD(NHardLinks), 0, "Sum of link counts > 1" },
+   { "physical_bytes", WS_FIELD(NBytesPhysical), 0, "Space allocated" },
+   { "logical_bytes", WS_FIELD(NBytesLogical), 0, "Nominal file sizes" },
+   { "readonly_zero_files", WS_FIELD(READONLY_Zero_Files), 0, "READONLY zero-length files" },
+   { "readonly_opens", WS_FIELD(READONLY_Opens), 0, "READONLY file opens" },
+   { "readonly_errors", WS_FIELD(READONLY_Errors), 0, "READONLY open or read errors" },
+   { "readonly_read_bytes", WS_FIELD(READONLY_Sums.read_bytes), 0, "READONLY bytes read" },
+   { "readonly_read_seconds", WS_FIELD(READONLY_Sums.read_ns), 1, "READONLY time in pread()" },
+   { "readonly_hole_bytes", WS_FIELD(READONLY_Sums.hole_bytes), 0, "READONLY bytes in holes, not read" },
+   { "readonly_denist_bytes", WS_FIELD(READONLY_DENIST_Bytes), 0, "+denist bytes read" },
+   { "readonly_denist_matches", WS_FIELD(READONLY_DENIST_Matches), 0, "+denist files whose MD5 is in the hash list" },
+   { "cmp_content_files", WS_FIELD(CMP_Content_Files), 0, "-cmp content compares" },
+   { "cmp_content_diffs", WS_FIELD(CMP_Content_Diffs), 0, "-cmp content compares that found a difference (or error)" },
+   { "cmp_content_bytes", WS_FIELD(CMP_Content_Bytes), 0, "-cmp SOURCE bytes read" },
+   { "cmp_content_seconds", WS_FIELD(CMP_Content_ns), 1, "-cmp content compare time" },
+   { "cmp_content_chunked", WS_FIELD(CMP_Content_Chunked), 0, "-cmp files split into -cmp_chunk= chunks" },
+   { "cmp_content_hole_bytes", WS_FIELD(CMP_Content_Holes), 0, "-cmp bytes in holes both sides share, not read" },
+   { "cmp_cache_hits", WS_FIELD(CMP_Cache_Hits), 0, "-cmp_cache pairs not compared" },
+   { "cmp_cache_bytes", WS_FIELD(CMP_Cache_Bytes), 0, "-cmp_cache SOURCE bytes not compared" },
+   { "cmp_cache_reverified", WS_FIELD(CMP_Cache_Reverified), 0, "-cmp_reverify= cache hits compared anyway" },
+   { "cmp_cache_mismatches", WS_FIELD(CMP_Cache_Mismatches), 0, "-cmp_reverify= cache hits that were different" },
+   { "cmp_target_nostat", WS_FIELD(CMP_Target_Nostat), 0, "-cmp entries settled by TARGET directory preload alone" },
+   { "cmp_target_only", WS_FIELD(CMP_Target_Only), 0, "-cmp entries found only in TARGET" },
+   { "python_calls", WS_FIELD(NPythonCalls), 0, "Python calls" },
+   { "python_errors", WS_FIELD(NPythonErrors), 0, "Python errors" },
+};
+#define NCOUNTERS (sizeof(COUNTERS) / sizeof(COUNTERS[0]))
+
+static const char *STATE_NAMES[3] = { "embryonic", "idle", "busy" };
+
+typedef struct {
+   char *p;
+   size_t len, size;
+   int om;				// OpenMetrics 1.0, else Prometheus text 0.0.4
+} MT_BUF;
+
+#define MT_MAX_CONNS 8			// -metrics_port connections served at once
+#define MT_CONN_SECS 5			// ... each closed if not done by then
+
+typedef struct {
+   int fd;				// -1 when free
+   time_t start;			// Accepted
+   char req[4096];			// Request, until its headers are in
+   size_t n;
+   MT_BUF out;				// Whole response (p NULL until built)
+   size_t sent;				// ... bytes of it sent
+} MT_CONN;
+
+static MT_CONN CONN[MT_MAX_CONNS];
+
+static char *FILE_NAME = NULL;		// -metrics file, or NULL
+static char *TMP_NAME;
+static int SECS;
+static int NWORKERS, NSOURCES, NTALLY;
+static char **SOURCE_PATHS;
+static count_64 *TALLY_SIZES;
+static void (*STATUS)(MT_STATUS *);
+static void (*LOG)(char *, int);
+static time_t T_START;
+static int RUNNING = 1;
+static int WRITE_ERRORS = 0;
+
+static int LISTEN_FD = -1;		// -metrics_port, or -1
+static int STOP_PIPE[2];		// mt_stop() wakes the thread with this
+static pthread_t THREAD;
+static int STARTED = 0;
+
+static void
+buf_init(MT_BUF *b, int om)
+{
+   b->size = 64*1024;
+   if ((b->p = malloc(b->size)) == NULL) abend("-metrics: cannot malloc!");
+   b->len = 0;
+   b->om = om;
+}
+
+static void
+bprintf(MT_BUF *b, const char *fmt, ...)
+{
+   va_list ap;
+   int n;
+
+   for (;;) {
+      va_start(ap, fmt);
+      n = vsnprintf(b->p + b->len, b->size - b->len, fmt, ap);
+      va_end(ap);
+      if (n < 0) abend("-metrics: vsnprintf() failed!");
+      if (b->len + n < b->size) break;
+      b->size = 2 * (b->len + n + 1);
+      if ((b->p = realloc(b->p, b->size)) == NULL) abend("-metrics: cannot realloc!");
+   }
+   b->len += n;
+}
+
+// family() - HELP and TYPE of pwalk_<name>.  A 0.0.4 counter's family name is its samples'
+// (with _total); an OpenMetrics counter's is without it.
+
+static void
+family(MT_BUF *b, const char *name, const char *type, const char *help)
+{
+   const char *sfx = (!b->om && strcmp(type, "counter") == 0) ? "_total" : "";
+
+   bprintf(b, "# HELP pwalk_%s%s %s\n# TYPE pwalk_%s%s %s\n", name, sfx, help, name, sfx, type);
+}
+
+// series() - Start a sample: pwalk_<name><sfx>{source="<source>"[,<more>]} ...
+
+static void
+series(MT_BUF *b, const char *name, const char *sfx, const char *source, const char *more)
+{
+   const char *s;
+
+   bprintf(b, "pwalk_%s%s{source=\"", name, sfx);
+   for (s = source; *s; s++) {
+      if (*s == '\\' || *s == '"') bprintf(b, "\\%c", *s);
+      else if (*s == '\n') bprintf(b, "\\n");
+      else bprintf(b, "%c", *s);
+   }
+   bprintf(b, "\"%s%s} ", more ? "," : "", more ? more : "");
+}
+
+// ws_read() - Sum the workers' WS counters (lock-free) into <src>, per source path; but the
+// MAX_inode_* values are maxima.
+
+static void
+ws_read(PWALK_STATS_T *src)
+{
+   count_64 *from, *to, v;
+   size_t i;
+   int w, s;
+
+   for (w = 0; w < NWORKERS; w++) {		// Worker w_id works source w_id % NSOURCES
+      if (WS[w] == NULL) continue;
+      from = (count_64 *) WS[w];
+      to = (count_64 *) &src[w % NSOURCES];
+      for (i = 0; i < sizeof(PWALK_STATS_T) / sizeof(count_64); i++)
+         to[i] += __atomic_load_n(&from[i], __ATOMIC_RELAXED);
+   }
+   for (s = 0; s < NSOURCES; s++) src[s].MAX_inode_Value_Seen = src[s].MAX_inode_Value_Selected = 0;
+   for (w = 0; w < NWORKERS; w++) {
+      if (WS[w] == NULL) continue;
+      s = w % NSOURCES;
+      v = __atomic_load_n(&WS[w]->MAX_inode_Value_Seen, __ATOMIC_RELAXED);
+      if (v > src[s].MAX_inode_Value_Seen) src[s].MAX_inode_Value_Seen = v;
+      v = __atomic_load_n(&WS[w]->MAX_inode_Value_Selected, __ATOMIC_RELAXED);
+      if (v > src[s].MAX_inode_Value_Selected) src[s].MAX_inode_Value_Selected = v;
+   }
+}
+
+static void
+put_latency(MT_BUF *b)
+{
+   LAT_SUMMARY *sum, *p;
+   const char *source;
+   char more[64];
+   int i, op, k;
+
+   if ((sum = lat_summarize()) == NULL) return;
+   family(b, "call_latency_seconds", "summary", "Call latencies (+lat)");
+   for (i = 0; i < NSOURCES + 2; i++) {
+      source = (i == 0) ? "*" : (i == 1) ? "-" : SOURCE_PATHS[i-2];
+      for (op = 0; op < LAT_NOPS; op++) {
+         p = &sum[i * LAT_NOPS + op];
+         if (p->n == 0) continue;
+         for (k = 0; k < LAT_NPCT; k++) {
+            sprintf(more, "op=\"%s\",quantile=\"%g\"", lat_op_name(op), LAT_PCT[k] / 100.);
+            series(b, "call_latency_seconds", "", source, more);
+            bprintf(b, "%.9f\n", p->p[k] / 1e9);
+         }
+         sprintf(more, "op=\"%s\"", lat_op_name(op));
+         series(b, "call_latency_seconds", "_sum", source, more);
+         bprintf(b, "%.9f\n", p->sum / 1e9);
+         series(b, "call_latency_seconds", "_count", source, more);
+         bprintf(b, "%llu\n", p->n);
+      }
+   }
+   free(sum);
+}
+
+// generate() - All of the metrics, as of now, into <b>.
+
+static void
+generate(MT_BUF *b)
+{
+   PWALK_STATS_T *src;
+   MT_STATUS st;
+   count_64 v;
+   char more[64];
+   time_t now = time(NULL);
+   size_t c;
+   int s, i, alg, any;
+
+   if ((src = calloc(NSOURCES, sizeof(PWALK_STATS_T))) == NULL) abend("-metrics: cannot calloc!");
+   ws_read(src);
+   memset(&st, 0, sizeof(st));
+   STATUS(&st);
+
+   family(b, "running", "gauge", "1 while the walk is running, then 0");
+   bprintf(b, "pwalk_running %d\n", RUNNING);
+   family(b, "start_time_seconds", "gauge", "When the walk started");
+   bprintf(b, "pwalk_start_time_seconds %lld\n", (long long) T_START);
+   family(b, "elapsed_seconds", "gauge", "Time since the walk started");
+   bprintf(b, "pwalk_elapsed_seconds %lld\n", (long long) (now - T_START));
+   family(b, "workers", "gauge", "Workers, by state");
+   for (i = 0; i < 3; i++) bprintf(b, "pwalk_workers{state=\"%s\"} %u\n", STATE_NAMES[i], st.workers[i]);
+   family(b, "fifo_pushes", "counter", "Directories pushed onto the FIFO");
+   bprintf(b, "pwalk_fifo_pushes_total %llu\n", st.fifo_pushes);
+   family(b, "fifo_pops", "counter", "Directories popped from the FIFO");
+   bprintf(b, "pwalk_fifo_pops_total %llu\n", st.fifo_pops);
+   family(b, "fifo_depth", "gauge", "Directories on the FIFO");
+   bprintf(b, "pwalk_fifo_depth %llu\n", st.fifo_depth);
+   family(b, "cmp_chunks_queued", "gauge", "-cmp chunks queued");
+   bprintf(b, "pwalk_cmp_chunks_queued %llu\n", st.cmp_chunks);
+
+   for (c = 0; c < NCOUNTERS; c++) {
+      family(b, COUNTERS[c].name, "counter", COUNTERS[c].help);
+      for (s = 0; s < NSOURCES; s++) {
+         v = *(count_64 *) ((char *) &src[s] + COUNTERS[c].off);
+         series(b, COUNTERS[c].name, "_total", SOURCE_PATHS[s], NULL);
+         if (COUNTERS[c].ns) bprintf(b, "%.9f\n", v / 1e9);
+         else bprintf(b, "%llu\n", v);
+      }
+   }
+
+   for (any = 0, alg = 0; alg < SUM_NALGS; alg++)
+      for (s = 0; s < NSOURCES; s++) any |= (src[s].READONLY_Sums.bytes[alg] != 0) << alg;
+   if (any) {
+      family(b, "readonly_digest_bytes", "counter", "READONLY bytes digested, by algorithm");
+      for (alg = 0; alg < SUM_NALGS; alg++)
+         for (s = 0; (any & (1 << alg)) && s < NSOURCES; s++) {
+            sprintf(more, "alg=\"%s\"", SUM_NAMES[alg]);
+            series(b, "readonly_digest_bytes", "_total", SOURCE_PATHS[s], more);
+            bprintf(b, "%llu\n", src[s].READONLY_Sums.bytes[alg]);
+         }
+      family(b, "readonly_digest_seconds", "counter", "READONLY digest time, by algorithm");
+      for (alg = 0; alg < SUM_NALGS; alg++)
+         for (s = 0; (any & (1 << alg)) && s < NSOURCES; s++) {
+            sprintf(more, "alg=\"%s\"", SUM_NAMES[alg]);
+            series(b, "readonly_digest_seconds", "_total", SOURCE_PATHS[s], more);
+            bprintf(b, "%.9f\n", src[s].READONLY_Sums.ns[alg] / 1e9);
+         }
+   }
+
+   if (NTALLY >= 0) {
+      static const char *TALLY_NAME[3] = { "tally_files", "tally_size_bytes", "tally_space_bytes" };
+      static const char *TALLY_HELP[3] = {
+         "+tally files, by size bucket", "+tally sum of sizes, by size bucket", "+tally sum of space, by size bucket"
+      };
+      for (c = 0; c < 3; c++) {
+         family(b, TALLY_NAME[c], "counter", TALLY_HELP[c]);
+         for (s = 0; s < NSOURCES; s++)
+            for (i = 0; i <= NTALLY; i++) {	// Bucket[NTALLY] catches the rest
+               if (i < NTALLY) sprintf(more, "size_le=\"%llu\"", TALLY_SIZES[i]);
+               else strcpy(more, "size_le=\"+Inf\"");
+               series(b, TALLY_NAME[c], "_total", SOURCE_PATHS[s], more);
+               bprintf(b, "%llu\n", (c == 0) ? src[s].TALLY_BUCKET.count[i] :
+                  (c == 1) ? src[s].TALLY_BUCKET.size[i] : src[s].TALLY_BUCKET.space[i]);
+            }
+      }
+   }
+
+   family(b, "max_inode_seen", "gauge", "Highest inode number seen");
+   for (s = 0; s < NSOURCES; s++) {
+      series(b, "max_inode_seen", "", SOURCE_PATHS[s], NULL);
+      bprintf(b, "%llu\n", src[s].MAX_inode_Value_Seen);
+   }
+   family(b, "max_inode_selected", "gauge", "Highest inode number selected");
+   for (s = 0; s < NSOURCES; s++) {
+      series(b, "max_inode_selected", "", SOURCE_PATHS[s], NULL);
+      bprintf(b, "%llu\n", src[s].MAX_inode_Value_Selected);
+   }
+
+   put_latency(b);
+   if (b->om) bprintf(b, "# EOF\n");
+   free(src);
+}
+
+// write_file() - Write the -metrics file atomically: to <file>.tmp, then rename() it over.
+
+static void
+write_file(void)
+{
+   char msg[PATH_MAX+128];
+   MT_BUF b;
+   FILE *f;
+   int ok;
+
+   buf_init(&b, 0);
+   generate(&b);
+   ok = ((f = fopen(TMP_NAME, "w")) != NULL);
+   if (ok) {
+      ok = (fwrite(b.p, 1, b.len, f) == b.len);
+      ok = (fclose(f) == 0) && ok;
+   }
+   if (ok) ok = (rename(TMP_NAME, FILE_NAME) == 0);
+   if (!ok && WRITE_ERRORS++ == 0) {		// Just say so once
+      snprintf(msg, sizeof(msg), "WARNING: -metrics: cannot write %s (%s)\n", FILE_NAME, strerror(errno));
+      LOG(msg, 0);
+   }
+   free(b.p);
+}
+
+// @@@ -metrics_port connections; non-blocking, all polled by mt_thread() @@@
+
+// conn_open() - Take an accepted connection, or close it if all MT_MAX_CONNS are busy.
+
+static void
+conn_open(int fd)
+{
+#ifdef SO_NOSIGPIPE
+   int one = 1;
+#endif
+   MT_CONN *c;
+   int i;
+
+   for (i = 0; i < MT_MAX_CONNS && CONN[i].fd >= 0; i++) ;
+   if (i == MT_MAX_CONNS || fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) < 0) {
+      close(fd);
+      return;
+   }
+#ifdef SO_NOSIGPIPE
+   setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+   c = &CONN[i];
+   c->fd = fd;
+   c->start = time(NULL);
+   c->n = 0;
+   c->req[0] = '\0';
+   c->out.p = NULL;
+   c->sent = 0;
+}
+
+static void
+conn_close(MT_CONN *c)
+{
+   close(c->fd);
+   c->fd = -1;
+   free(c->out.p);
+   c->out.p = NULL;
+}
+
+// conn_request() - Build the whole response to the request in <c>, for /metrics (or /).
+
+static void
+conn_request(MT_CONN *c)
+{
+   char method[8], path[256], *p;
+   const char *status = "200 OK";
+   MT_BUF b;
+
+   if (sscanf(c->req, "%7s %255s", method, path) != 2) {
+      conn_close(c);
+      return;
+   }
+   for (p = c->req; *p; p++) *p = tolower((unsigned char) *p);	// For Accept:
+   buf_init(&b, strstr(c->req, "application/openmetrics-text") != NULL);
+
+   if (strcmp(method, "GET") && strcmp(method, "HEAD")) status = "405 Method Not Allowed";
+   else if (strcmp(path, "/metrics") && strcmp(path, "/")) status = "404 Not Found";
+   else generate(&b);
+   if (status[0] != '2') bprintf(&b, "%s\n", status);
+
+   buf_init(&c->out, b.om);
+   bprintf(&c->out, "HTTP/1.0 %s\r\nContent-Type: %s\r\nContent-Length: %lu\r\nConnection: close\r\n\r\n",
+      status, (status[0] != '2') ? "text/plain" : b.om ?
+      "application/openmetrics-text; version=1.0.0; charset=utf-8" : "text/plain; version=0.0.4; charset=utf-8",
+      (unsigned long) b.len);
+   if (strcmp(method, "HEAD")) bprintf(&c->out, "%s", b.p);
+   free(b.p);
+}
+
+// conn_io() - Read the request until its headers are in, then send the response; closes
+// <c> when done, on error, or at EOF.
+
+static void
+conn_io(MT_CONN *c)
+{
+   ssize_t r;
+
+   if (c->out.p == NULL) {
+      r = recv(c->fd, c->req + c->n, sizeof(c->req) - 1 - c->n, 0);
+      if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) return;
+      if (r <= 0) {
+         conn_close(c);
+         return;
+      }
+      c->req[c->n += r] = '\0';
+      if (!strstr(c->req, "\r\n\r\n") && !strstr(c->req, "\n\n") && c->n < sizeof(c->req) - 1) return;
+      conn_request(c);
+      if (c->fd < 0) return;
+   }
+   while (c->sent < c->out.len) {
+      r = send(c->fd, c->out.p + c->sent, c->out.len - c->sent, MSG_NOSIGNAL);
+      if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) return;
+      if (r <= 0) break;
+      c->sent += r;
+   }
+   conn_close(c);
+}
+
+// mt_thread() - Write the -metrics file every SECS, and answer -metrics_port requests,
+// until mt_stop().  One poll() covers the stop pipe, the listener, and every connection;
+// none blocks the others, and each gets MT_CONN_SECS to finish.
+
+static void *
+mt_thread(void *arg)
+{
+   struct pollfd pfd[2 + MT_MAX_CONNS];
+   time_t next_write = T_START + SECS, now;
+   int fd, i, nconn, timeout;
+
+   for (i = 0; i < MT_MAX_CONNS; i++) CONN[i].fd = -1;
+   pfd[0].fd = STOP_PIPE[0];
+   pfd[0].events = POLLIN;
+   pfd[1].fd = LISTEN_FD;			// (Ignored when -1)
+   pfd[1].events = POLLIN;
+   for (;;) {
+      now = time(NULL);
+      for (i = nconn = 0; i < MT_MAX_CONNS; i++) {
+         if (CONN[i].fd >= 0 && now - CONN[i].start >= MT_CONN_SECS) conn_close(&CONN[i]);
+         pfd[2+i].fd = CONN[i].fd;		// (Ignored when -1)
+         pfd[2+i].events = CONN[i].out.p ? POLLOUT : POLLIN;
+         pfd[2+i].revents = 0;
+         nconn += (CONN[i].fd >= 0);
+      }
+      pfd[0].revents = pfd[1].revents = 0;
+      timeout = -1;
+      if (FILE_NAME) timeout = (next_write > now) ? (next_write - now) * 1000 : 0;
+      if (nconn && (timeout < 0 || timeout > 1000)) timeout = 1000;	// To time them out
+      if (poll(pfd, 2 + MT_MAX_CONNS, timeout) < 0) continue;	// EINTR (SIGUSR1)
+      if (pfd[0].revents) break;
+      for (i = 0; i < MT_MAX_CONNS; i++)
+         if (CONN[i].fd >= 0 && pfd[2+i].revents) conn_io(&CONN[i]);
+      if ((pfd[1].revents & POLLIN) && (fd = accept(LISTEN_FD, NULL, NULL)) >= 0) conn_open(fd);
+      if (FILE_NAME && (now = time(NULL)) >= next_write) {
+         write_file();
+         next_write = now + SECS;
+      }
+   }
+   for (i = 0; i < MT_MAX_CONNS; i++)
+      if (CONN[i].fd >= 0) conn_close(&CONN[i]);
+   return (NULL);
+}
+
+// mt_start() - Start writing -metrics to <file> every <secs>, and/or serving them on
+// 127.0.0.1:<port>.  <ntally> is N_TALLY_BUCKETS, or -1 without +tally; <status> gives the
+// worker and FIFO state (without MP_mutex); <log> is LogMsg().  Returns -1 (with errno) if
+// <port> cannot be listened on, else 0.
+
+int
+mt_start(const char *file, int secs, int port, int nworkers, int nsources, char **source_paths,
+   int ntally, count_64 *tally_sizes, void (*status)(MT_STATUS *st), void (*log)(char *msg, int force_flush))
+{
+   struct sockaddr_in sa;
+   int one = 1, e;
+
+   if (sizeof(PWALK_STATS_T) % sizeof(count_64)) abend("-metrics: PWALK_STATS_T is not all count_64's!");
+   SECS = secs;
+   NWORKERS = nworkers;
+   NSOURCES = (nsources > 0) ? nsources : 1;
+   SOURCE_PATHS = source_paths;
+   NTALLY = ntally;
+   TALLY_SIZES = tally_sizes;
+   STATUS = status;
+   LOG = log;
+   T_START = time(NULL);
+   if (file) {
+      if ((FILE_NAME = strdup(file)) == NULL || (TMP_NAME = malloc(strlen(file) + 5)) == NULL)
+         abend("-metrics: cannot malloc!");
+      sprintf(TMP_NAME, "%s.tmp", file);
+   }
+
+   if (port) {
+      if ((LISTEN_FD = socket(AF_INET, SOCK_STREAM, 0)) < 0) return (-1);
+      setsockopt(LISTEN_FD, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+      memset(&sa, 0, sizeof(sa));
+      sa.sin_family = AF_INET;
+      sa.sin_port = htons(port);
+      sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);	// Not to be scraped from elsewhere
+      if (bind(LISTEN_FD, (struct sockaddr *) &sa, sizeof(sa)) || listen(LISTEN_FD, 8)) {
+         e = errno;
+         close(LISTEN_FD);
+         LISTEN_FD = -1;
+         errno = e;
+         return (-1);
+      }
+   }
+
+   if (pipe(STOP_PIPE)) abend("-metrics: cannot create pipe!");
+   if (pthread_create(&THREAD, NULL, mt_thread, NULL)) abend("Cannot create metrics thread!");
+   STARTED = 1;
+   return (0);
+}
+
+// mt_stop() - Stop serving, and write the -metrics file one last time.
+
+void
+mt_stop(void)
+{
+   if (!STARTED) return;
+   if (write(STOP_PIPE[1], "", 1) != 1) abend("-metrics: cannot wake metrics thread!");
+   pthread_join(THREAD, NULL);
+   close(STOP_PIPE[0]);
+   close(STOP_PIPE[1]);
+   if (LISTEN_FD >= 0) close(LISTEN_FD);
+   LISTEN_FD = -1;
+   RUNNING = 0;
+   if (FILE_NAME) write_file();
+   STARTED = 0;
+}
@@ -0,0 +1,45 @@
+#ifndef PWALK_METRICS_H
+#define PWALK_METRICS_H 1
+
+// pwalk_metrics.h - -metrics[=<file>] and -metrics_port=<port>; the walk's counters, as
+// Prometheus/OpenMetrics text, for job schedulers and dashboards.
+//
+// Exported, each (but the worker and FIFO state) per source path (source="<path>"):
+//	pwalk_<stat>_total	- every PWALK_STATS_T counter (scanned, dirs, logical_bytes,
+//				  readonly_read_bytes, cmp_content_bytes, ...), ns as _seconds
+//	pwalk_readonly_digest_bytes_total{alg=}, ..._seconds_total{alg=} - +crc, +md5, etc.
+//	pwalk_tally_{files,size_bytes,space_bytes}_total{size_le=} - with +tally
+//	pwalk_max_inode_{seen,selected} - gauges
+//	pwalk_call_latency_seconds{op=,quantile=} - summaries, with +lat; source="*" is overall,
+//				  and "-" the threads not working for any one worker (-writers=)
+//	pwalk_workers{state=}, pwalk_fifo_{pushes,pops}_total, pwalk_fifo_depth,
+//	pwalk_cmp_chunks_queued, pwalk_running, pwalk_start_time_seconds, pwalk_elapsed_seconds
+//
+// The values are read from each worker's own WS[w_id] (which it subtotals into after each
+// directory) with relaxed loads, and the worker and FIFO state from a caller-supplied
+// function that must not take MP_mutex; so workers are never stopped or locked out, and
+// each value is a recent one (not a consistent cut across all of them).
+//
+// -metrics writes the file (default ${OUTPUT_DIR}/pwalk_metrics.prom) every -metrics_secs=
+// (default MT_DEFAULT_SECS), and once more after the walk with pwalk_running 0; each write
+// goes to <file>.tmp, then rename()s over <file>, so a reader (node_exporter's textfile
+// collector) never sees a partial file.  That is Prometheus text format 0.0.4, which the
+// textfile collector parses.  -metrics_port= serves the same on 127.0.0.1 only, for the
+// duration of the walk: OpenMetrics 1.0 when the scraper's Accept: asks for it, else 0.0.4.
+// Its connections are non-blocking and polled together with the file's timer, so a slow
+// or stalled scraper holds up neither the file nor other scrapes.
+
+#define MT_DEFAULT_SECS 15
+
+typedef struct {
+   unsigned workers[3];			// By wstatus_t: EMBRYONIC, IDLE, BUSY
+   count_64 fifo_pushes, fifo_pops, fifo_depth;
+   count_64 cmp_chunks;			// -cmp chunks queued
+} MT_STATUS;
+
+// Forward declarations ...
+int mt_start(const char *file, int secs, int port, int nworkers, int nsources, char **source_paths,
+   int ntally, count_64 *tally_sizes, void (*status)(MT_STATUS *st), void (*log)(char *msg, int force_flush));
+void mt_stop(void);
+
+#endif // PWALK_METRICS_H
@@ -0,0 +1,186 @@
+// pwalk_output.c - Per-worker append-only output buffers & fast formatters.
+// See pwalk_output.h for the hot-path inline appenders.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <assert.h>
+#include "pwalk_output.h"
+#include "pwalk_writer.h"
+#include "pwalk_lat.h"
+
+extern void abend(char *str);
+
+// po_init() - Attach a buffer of <size> bytes to <sink> ...
+
+void
+po_init(PW_OBUF *o, FILE *sink, size_t size)
+{
+   o->buf = malloc(size);
+   if (o->buf == NULL) abend("Cannot malloc worker output buffer!");
+   o->size = size;
+   o->len = 0;
+   o->drained = 0;
+   o->sink = sink;
+   o->hold = 0;
+   o->ring = NULL;
+   o->mark = 0;
+}
+
+// po_drain() - Hand pending bytes to the sink (stdio may still hold them) ...
+
+void
+po_drain(PW_OBUF *o)
+{
+   size_t n;
+   long long t_lat;
+
+   if (o->len == 0 || o->hold) return;
+   if (o->ring) {					// Writer thread owns it now; take a fresh buffer
+      n = o->len;
+      wr_submit(o->ring, &o->buf, &o->len, &o->size, o->mark);
+      o->drained += n - o->len;				// (partial record may carry over)
+      o->mark = 0;
+      return;
+   }
+   LAT_BEGIN(t_lat);
+   if (o->sink && fwrite(o->buf, 1, o->len, o->sink) != o->len)
+      abend("Cannot write worker output!");
+   LAT_END(LAT_WRITE, t_lat);
+   o->drained += o->len;
+   o->len = 0;
+}
+
+// po_flush() - Drain and push through to the OS (or queue for a writer thread) ...
+
+void
+po_flush(PW_OBUF *o)
+{
+   long long t_lat;
+
+   po_drain(o);
+   if (o->sink && !o->ring) {
+      LAT_BEGIN(t_lat);
+      fflush(o->sink);
+      LAT_END(LAT_WRITE, t_lat);
+   }
+}
+
+// po_make_room() - Called by po_reserve() when <n> more bytes won't fit ...
+
+void
+po_make_room(PW_OBUF *o, size_t n)
+{
+   if (o->buf == NULL) po_init(o, NULL, PO_BUF_SIZE);	// Eg: output with no primary mode
+   po_drain(o);
+   if (o->len + n > o->size) {				// Held, or single append larger than buffer
+      o->size = (o->len + n > 2*o->size) ? o->len + n : 2*o->size;
+      o->buf = realloc(o->buf, o->size);
+      if (o->buf == NULL) abend("Cannot grow worker output buffer!");
+   }
+}
+
+void
+po_free(PW_OBUF *o)
+{
+   po_flush(o);
+   free(o->buf);
+   o->buf = NULL;
+   o->size = 0;
+}
+
+// po_printf() - For cold paths; formats directly into the buffer ...
+
+void
+po_printf(PW_OBUF *o, const char *fmt, ...)
+{
+   va_list ap;
+   size_t avail;
+   int n;
+   char *p;
+
+   p = po_reserve(o, 256);
+   avail = o->size - o->len;
+   va_start(ap, fmt);
+   n = vsnprintf(p, avail, fmt, ap);
+   va_end(ap);
+   assert(n >= 0);
+   if ((size_t) n >= avail) {				// Didn't fit; make room & redo
+      p = po_reserve(o, n + 1);
+      va_start(ap, fmt);
+      vsnprintf(p, n + 1, fmt, ap);
+      va_end(ap);
+   }
+   o->len += n;
+}
+
+// @@@ SECTION: Formatters @@@
+
+char *
+po_fmt_u64(char *p, unsigned long long v)
+{
+   static const char digits2[201] =
+      "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+      "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+      "8081828384858687888990919293949596979899";
+   char tmp[PO_NUM_MAX], *t = tmp + sizeof(tmp);
+   int n;
+
+   while (v >= 100) {					// Two digits per divide
+      t -= 2;
+      memcpy(t, &digits2[(v % 100) * 2], 2);
+      v /= 100;
+   }
+   if (v >= 10) { t -= 2; memcpy(t, &digits2[v * 2], 2); }
+   else *--t = '0' + v;
+   n = tmp + sizeof(tmp) - t;
+   memcpy(p, t, n);
+   return (p + n);
+}
+
+char *
+po_fmt_s64(char *p, long long v)
+{
+   if (v < 0) { *p++ = '-'; return (po_fmt_u64(p, -(unsigned long long) v)); }
+   return (po_fmt_u64(p, v));
+}
+
+char *
+po_fmt_hex(char *p, unsigned long long v)
+{
+   char tmp[16], *t = tmp + sizeof(tmp);
+   int n;
+
+   do { *--t = "0123456789abcdef"[v & 0xf]; v >>= 4; } while (v);
+   n = tmp + sizeof(tmp) - t;
+   memcpy(p, t, n);
+   return (p + n);
+}
+
+// Zero-padded to mindigits, like "%03o" ...
+char *
+po_fmt_oct(char *p, unsigned long long v, int mindigits)
+{
+   char tmp[PO_NUM_MAX], *t = tmp + sizeof(tmp);
+   int n;
+
+   do { *--t = '0' + (v & 7); v >>= 3; } while (v);
+   while ((tmp + sizeof(tmp) - t) < mindigits && t > tmp) *--t = '0';
+   n = tmp + sizeof(tmp) - t;
+   memcpy(p, t, n);
+   return (p + n);
+}
+
+// RFC 4180 quoting: always quote, double any embedded '"' ...
+char *
+po_fmt_qstr(char *p, const char *s)
+{
+   *p++ = '"';
+   for (; *s; s++) {
+      if (*s == '"') *p++ = '"';
+      *p++ = *s;
+   }
+   *p++ = '"';
+   return (p);
+}
@@ -0,0 +1,119 @@
+#ifndef PWALK_OUTPUT_H
+#define PWALK_OUTPUT_H 1
+
+// pwalk_output.h - Per-worker append-only output buffers & fast formatters.
+//
+// Hot-path output (one line per selected dirent) is assembled here with specialized
+// integer/hex/octal/string writers instead of fprintf(); the bytes are handed to the
+// worker's sink FILE* (or writer ring) only when the buffer fills or a flush is due.
+// Cold paths may use po_printf().  Nothing here locks; each PW_OBUF belongs to one worker.
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+
+#define PO_BUF_SIZE (256*1024)		// Default per-worker output buffer
+
+typedef struct {
+   char *buf;				// Append-only bytes not yet handed to sink
+   size_t len;				// Bytes pending in buf
+   size_t size;				// Allocated size of buf
+   unsigned long long drained;		// Bytes already handed to sink (for po_tell())
+   FILE *sink;				// Destination; NULL discards
+   int hold;				// Never drain; grow instead (eg: -merge blocks)
+   struct wr_ring *ring;		// When set, drains go to a writer thread instead of sink
+   size_t mark;				// End of last complete record (see po_mark())
+} PW_OBUF;
+
+// Forward declarations ...
+void po_init(PW_OBUF *o, FILE *sink, size_t size);
+void po_make_room(PW_OBUF *o, size_t n);
+void po_drain(PW_OBUF *o);
+void po_flush(PW_OBUF *o);
+void po_free(PW_OBUF *o);
+void po_printf(PW_OBUF *o, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+// Formatters: write at p, return new end, no NUL ...
+char *po_fmt_u64(char *p, unsigned long long v);
+char *po_fmt_s64(char *p, long long v);
+char *po_fmt_hex(char *p, unsigned long long v);
+char *po_fmt_oct(char *p, unsigned long long v, int mindigits);
+char *po_fmt_qstr(char *p, const char *s);
+
+// @@@ Inline appenders (hot path) ...
+
+// Worst-case width of any single po_fmt_* number ...
+#define PO_NUM_MAX 24
+
+static inline char *
+po_reserve(PW_OBUF *o, size_t n)
+{
+   if (o->len + n > o->size) po_make_room(o, n);
+   return (o->buf + o->len);
+}
+
+static inline void
+po_commit(PW_OBUF *o, char *end)
+{
+   o->len = end - o->buf;
+}
+
+static inline void
+po_putc(PW_OBUF *o, char c)
+{
+   *po_reserve(o, 1) = c;
+   o->len += 1;
+}
+
+static inline void
+po_write(PW_OBUF *o, const char *s, size_t n)
+{
+   memcpy(po_reserve(o, n), s, n);
+   o->len += n;
+}
+
+static inline void
+po_puts(PW_OBUF *o, const char *s)
+{
+   po_write(o, s, strlen(s));
+}
+
+static inline void
+po_putu64(PW_OBUF *o, unsigned long long v)
+{
+   po_commit(o, po_fmt_u64(po_reserve(o, PO_NUM_MAX), v));
+}
+
+static inline void
+po_puts64(PW_OBUF *o, long long v)
+{
+   po_commit(o, po_fmt_s64(po_reserve(o, PO_NUM_MAX), v));
+}
+
+static inline void
+po_puthex(PW_OBUF *o, unsigned long long v)
+{
+   po_commit(o, po_fmt_hex(po_reserve(o, PO_NUM_MAX), v));
+}
+
+static inline void
+po_putoct(PW_OBUF *o, unsigned long long v, int mindigits)
+{
+   po_commit(o, po_fmt_oct(po_reserve(o, PO_NUM_MAX + mindigits), v, mindigits));
+}
+
+// Note a record (eg: directory) boundary; -shards only cuts buffers at these ...
+static inline void
+po_mark(PW_OBUF *o)
+{
+   o->mark = o->len;
+}
+
+// Bytes ever written to this stream, like ftell() on the sink would report ...
+static inline unsigned long long
+po_tell(PW_OBUF *o)
+{
+   return (o->drained + o->len);
+}
+
+#endif // PWALK_OUTPUT_H
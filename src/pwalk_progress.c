@@ -0,0 +1,290 @@
+// pwalk_progress.c - Live progress snapshots, on demand (SIGUSR1) or every -progress=<secs>.
+// See pwalk_progress.h for the counters, averages, and outputs.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <signal.h>
+#include <pthread.h>
+#include "pwalk.h"
+#include "pwalk_progress.h"
+
+// Longest snapshot line: ~90 bytes of text, a source path cut to 100, and six numbers of
+// up to 24 characters; pg_cat() truncates anything longer rather than overflow.
+#define PG_LINE_MAX 384
+
+PG_COUNTERS PG[MAX_WORKERS+1];
+
+// Decay per sample, exp(-PG_SAMPLE_SECS/60), ... /300, ... /900; for 1, 5, 15 minutes ...
+static const double AVG_DECAY[3] = { 0.920044415, 0.983471454, 0.994459848 };
+
+typedef struct {
+   count_64 dirs, entries, bytes;	// At the last sample
+   double entries_avg[3], bytes_avg[3];	// Per second
+} PG_TOTALS;
+
+static volatile sig_atomic_t SNAP_WANTED = 0;
+static pthread_mutex_t PG_mutex = PTHREAD_MUTEX_INITIALIZER;	// For STOP
+static pthread_cond_t PG_cond = PTHREAD_COND_INITIALIZER;
+static int STOP = 0;
+static pthread_t THREAD;
+static int STARTED = 0;
+
+static int SECS;			// -progress=<secs>, or 0
+static int NWORKERS, NSOURCES;
+static char **SOURCE_PATHS;
+static void (*STATUS)(unsigned *, count_64 *);
+static void (*LOG)(char *, int);
+static char CSV_FILE[PATH_MAX+64];
+
+static PG_TOTALS ALL, *SRC;		// Overall, and per source path
+static double FIFO_TREND[3];		// FIFO depth change, per second
+static double FIFO_RATE;		// ... over the last sample alone, for the ETA
+static count_64 FIFO_LAST;
+static double T_SAMPLE;			// When the last sample was taken
+static time_t T_START;
+
+static void
+sigusr1(int sig)
+{
+   SNAP_WANTED = 1;
+}
+
+// ema() - Fold <rate> into moving average <avg> number <k> (0, 1, 2: 1, 5, 15 minutes).
+// Like load averages, they start at 0 and climb, rather than taking the first sample whole.
+
+static double
+ema(double avg, double rate, int k)
+{
+   return (avg * AVG_DECAY[k] + rate * (1. - AVG_DECAY[k]));
+}
+
+static double
+now_secs(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (ts.tv_sec + ts.tv_nsec / 1e9);
+}
+
+// read_counters() - Sum the counters (lock-free) of source <s>'s workers into <t>.
+
+static void
+read_counters(PG_TOTALS *t, int s)
+{
+   int w;
+
+   t->dirs = t->entries = t->bytes = 0;
+   for (w = s; w < NWORKERS; w += NSOURCES) {		// Worker w_id works source w_id % NSOURCES
+      t->dirs += __atomic_load_n(&PG[w].dirs, __ATOMIC_RELAXED);
+      t->entries += __atomic_load_n(&PG[w].entries, __ATOMIC_RELAXED);
+      t->bytes += __atomic_load_n(&PG[w].bytes, __ATOMIC_RELAXED);
+   }
+}
+
+static void
+totals_sample(PG_TOTALS *t, PG_TOTALS *now, double dt)
+{
+   int k;
+
+   for (k = 0; k < 3; k++) {
+      t->entries_avg[k] = ema(t->entries_avg[k], (now->entries - t->entries) / dt, k);
+      t->bytes_avg[k] = ema(t->bytes_avg[k], (now->bytes - t->bytes) / dt, k);
+   }
+   t->dirs = now->dirs;
+   t->entries = now->entries;
+   t->bytes = now->bytes;
+}
+
+// sample() - Read every worker's counters and update the moving averages.
+
+static void
+sample(void)
+{
+   PG_TOTALS all, src;
+   count_64 depth;
+   unsigned busy;
+   double t = now_secs(), dt = t - T_SAMPLE;
+   int s, k;
+
+   if (dt <= 0.) return;
+   memset(&all, 0, sizeof(all));
+   for (s = 0; s < NSOURCES; s++) {
+      read_counters(&src, s);
+      totals_sample(&SRC[s], &src, dt);
+      all.dirs += src.dirs; all.entries += src.entries; all.bytes += src.bytes;
+   }
+   totals_sample(&ALL, &all, dt);
+
+   STATUS(&busy, &depth);
+   FIFO_RATE = ((double) depth - (double) FIFO_LAST) / dt;
+   for (k = 0; k < 3; k++)
+      FIFO_TREND[k] = ema(FIFO_TREND[k], FIFO_RATE, k);
+   FIFO_LAST = depth;
+   T_SAMPLE = t;
+}
+
+static void
+csv_row(FILE *f, time_t now, const char *source, PG_TOTALS *t, unsigned busy, count_64 depth, double eta)
+{
+   const char *s;
+
+   fprintf(f, "%lld,%lld,\"", (long long) now, (long long) (now - T_START));
+   for (s = source; *s; s++) {
+      if (*s == '"') fputc('"', f);
+      fputc(*s, f);
+   }
+   fprintf(f, "\",%llu,%llu,%llu,%.1f,%.1f,%.1f,%.0f,%.0f,%.0f,%u,%llu,%.1f,%.0f\n",
+      t->dirs, t->entries, t->bytes,
+      t->entries_avg[0], t->entries_avg[1], t->entries_avg[2],
+      t->bytes_avg[0], t->bytes_avg[1], t->bytes_avg[2],
+      busy, depth, FIFO_TREND[0] * 60., eta);
+}
+
+// pg_cat() - Append to <msg> at <*n>, never past <size>.
+
+static void
+pg_cat(char *msg, size_t size, size_t *n, const char *fmt, ...)
+{
+   va_list ap;
+   int rc;
+
+   va_start(ap, fmt);
+   rc = vsnprintf(msg + *n, size - *n, fmt, ap);
+   va_end(ap);
+   if (rc > 0) *n = (*n + rc < size) ? *n + rc : size - 1;
+}
+
+// snapshot() - Current counters, with the averages as of the last sample, to the log and
+// pwalk_progress.csv.
+
+static void
+snapshot(void)
+{
+   char msg[PG_LINE_MAX * (2 + MAXPATHS)];
+   size_t n = 0;
+   PG_TOTALS all = ALL, src[MAXPATHS];
+   count_64 depth;
+   unsigned busy;
+   time_t now = time(NULL);
+   double eta;
+   FILE *f;
+   int s;
+
+   all.dirs = all.entries = all.bytes = 0;	// Live counts, last sample's averages
+   for (s = 0; s < NSOURCES; s++) {
+      src[s] = SRC[s];
+      read_counters(&src[s], s);
+      all.dirs += src[s].dirs; all.entries += src[s].entries; all.bytes += src[s].bytes;
+   }
+   STATUS(&busy, &depth);
+   eta = (FIFO_RATE < 0.) ? depth / -FIFO_RATE : (depth == 0 ? 0. : -1.);
+
+   pg_cat(msg, sizeof(msg), &n, "PROGRESS: %llds elapsed, %llu dirs, %llu entries, %llu bytes; %u workers BUSY, FIFO depth=%llu (%+.1f/min)",
+      (long long) (now - T_START), all.dirs, all.entries, all.bytes, busy, depth, FIFO_TREND[0] * 60.);
+   if (eta >= 0.) pg_cat(msg, sizeof(msg), &n, ", ETA %.0fs\n", eta);
+   else pg_cat(msg, sizeof(msg), &n, ", ETA ? (FIFO not draining)\n");
+   pg_cat(msg, sizeof(msg), &n, "PROGRESS: entries/sec %.1f %.1f %.1f, MB/sec %.2f %.2f %.2f (1/5/15 min)\n",
+      ALL.entries_avg[0], ALL.entries_avg[1], ALL.entries_avg[2],
+      ALL.bytes_avg[0] / 1e6, ALL.bytes_avg[1] / 1e6, ALL.bytes_avg[2] / 1e6);
+   if (NSOURCES > 1)
+      for (s = 0; s < NSOURCES; s++)
+         pg_cat(msg, sizeof(msg), &n, "PROGRESS: %.100s: entries/sec %.1f %.1f %.1f, MB/sec %.2f %.2f %.2f\n", SOURCE_PATHS[s],
+            SRC[s].entries_avg[0], SRC[s].entries_avg[1], SRC[s].entries_avg[2],
+            SRC[s].bytes_avg[0] / 1e6, SRC[s].bytes_avg[1] / 1e6, SRC[s].bytes_avg[2] / 1e6);
+   LOG(msg, 1);
+
+   if ((f = fopen(CSV_FILE, "a")) == NULL) return;
+   if (ftell(f) == 0)
+      fprintf(f, "time,elapsed,source,dirs,entries,bytes,entries_1m,entries_5m,entries_15m,"
+         "bytes_1m,bytes_5m,bytes_15m,busy,fifo_depth,fifo_trend,eta\n");
+   csv_row(f, now, "*", &all, busy, depth, eta);
+   for (s = 0; s < NSOURCES; s++) csv_row(f, now, SOURCE_PATHS[s], &src[s], busy, depth, eta);
+   fclose(f);
+}
+
+// pg_thread() - Wake each second (or at pg_stop()); sample every PG_SAMPLE_SECS, and
+// snapshot when asked.
+
+static void *
+pg_thread(void *arg)
+{
+   time_t now, next_sample, next_snap;
+   struct timespec ts;
+
+   next_sample = T_START + PG_SAMPLE_SECS;
+   next_snap = SECS ? T_START + SECS : 0;
+   pthread_mutex_lock(&PG_mutex);
+   while (!STOP) {
+      clock_gettime(CLOCK_REALTIME, &ts);
+      ts.tv_sec += 1;
+      pthread_cond_timedwait(&PG_cond, &PG_mutex, &ts);
+      if (STOP) break;
+      pthread_mutex_unlock(&PG_mutex);
+      now = time(NULL);
+      if (now >= next_sample) {
+         sample();
+         next_sample += PG_SAMPLE_SECS;
+         if (next_sample <= now) next_sample = now + PG_SAMPLE_SECS;	// Overslept
+      }
+      if (SNAP_WANTED || (next_snap && now >= next_snap)) {
+         SNAP_WANTED = 0;
+         snapshot();
+         if (next_snap) while (next_snap <= now) next_snap += SECS;
+      }
+      pthread_mutex_lock(&PG_mutex);
+   }
+   pthread_mutex_unlock(&PG_mutex);
+   return (NULL);
+}
+
+// pg_start() - Catch SIGUSR1 and start the progress thread.  <status> gives busy workers
+// and FIFO depth (without MP_mutex); <log> is LogMsg().
+
+void
+pg_start(int secs, const char *outdir, int nworkers, int nsources, char **source_paths,
+   void (*status)(unsigned *nw_busy, count_64 *fifo_depth), void (*log)(char *msg, int force_flush))
+{
+   struct sigaction sa;
+   unsigned nw_busy;
+
+   SECS = secs;
+   NWORKERS = nworkers;
+   NSOURCES = (nsources > 0) ? nsources : 1;
+   SOURCE_PATHS = source_paths;
+   STATUS = status;
+   LOG = log;
+   snprintf(CSV_FILE, sizeof(CSV_FILE), "%s%cpwalk_progress.csv", outdir, PATHSEPCHR);
+   if ((SRC = calloc(NSOURCES, sizeof(PG_TOTALS))) == NULL) abend("Cannot calloc progress totals!");
+   T_START = time(NULL);
+   T_SAMPLE = now_secs();
+   STATUS(&nw_busy, &FIFO_LAST);		// The source paths, queued
+
+   memset(&sa, 0, sizeof(sa));
+   sa.sa_handler = sigusr1;
+   sa.sa_flags = SA_RESTART;
+   sigemptyset(&sa.sa_mask);
+   sigaction(SIGUSR1, &sa, NULL);
+
+   if (pthread_create(&THREAD, NULL, pg_thread, NULL)) abend("Cannot create progress thread!");
+   STARTED = 1;
+}
+
+// pg_stop() - Stop the progress thread; SIGUSR1 goes back to its default.
+
+void
+pg_stop(void)
+{
+   if (!STARTED) return;
+   pthread_mutex_lock(&PG_mutex);
+   STOP = 1;
+   pthread_cond_signal(&PG_cond);
+   pthread_mutex_unlock(&PG_mutex);
+   pthread_join(THREAD, NULL);
+   signal(SIGUSR1, SIG_DFL);
+   STARTED = 0;
+}
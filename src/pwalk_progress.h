@@ -0,0 +1,44 @@
+#ifndef PWALK_PROGRESS_H
+#define PWALK_PROGRESS_H 1
+
+// pwalk_progress.h - Live progress snapshots, on demand (SIGUSR1) or every -progress=<secs>.
+//
+// Each worker counts the directories it has finished, the entries it has scanned, and the
+// logical bytes it has selected in its own PG[w_id] (a cache line each).  Only the worker
+// writes its counters, with plain relaxed stores, so counting costs what DS counting does;
+// the progress thread reads them with relaxed loads.  Busy workers and FIFO depth come
+// from a caller-supplied function that must not take MP_mutex, either.  So nothing the
+// workers contend for is touched to take a snapshot.
+//
+// The progress thread samples every PG_SAMPLE_SECS, and keeps entries/sec and bytes/sec
+// (overall, and per source path) as 1, 5 and 15-minute exponential moving averages, the
+// way load averages are kept (starting from 0), and likewise the FIFO depth's rate of
+// change.  A snapshot goes to pwalk.log on SIGUSR1 and every -progress=<secs>, and as rows
+// (one overall, "*", then one per source path) appended to ${OUTPUT_DIR}/pwalk_progress.csv:
+//	time,elapsed,source,dirs,entries,bytes,entries_1m,entries_5m,entries_15m,
+//	bytes_1m,bytes_5m,bytes_15m,busy,fifo_depth,fifo_trend,eta
+// fifo_trend is directories/min (negative when the FIFO is draining).  The walk's size is
+// not known ahead, so eta is the time to drain the FIFO at the rate it changed over the
+// last sample alone (the 1-minute trend lags too far behind); -1 while it is not draining.
+
+#define PG_SAMPLE_SECS 5
+
+typedef struct {
+   count_64 dirs;			// Directories finished
+   count_64 entries;			// Dirents scanned
+   count_64 bytes;			// Logical bytes of selected() non-directories
+   char pad[64 - 3*sizeof(count_64)];	// One per cache line
+} PG_COUNTERS;
+
+extern PG_COUNTERS PG[MAX_WORKERS+1];
+
+// Only worker <w_id> may call this on PG[w_id] ...
+#define PG_ADD(w_id, field, n) \
+   __atomic_store_n(&PG[w_id].field, PG[w_id].field + (n), __ATOMIC_RELAXED)
+
+// Forward declarations ...
+void pg_start(int secs, const char *outdir, int nworkers, int nsources, char **source_paths,
+   void (*status)(unsigned *nw_busy, count_64 *fifo_depth), void (*log)(char *msg, int force_flush));
+void pg_stop(void);
+
+#endif // PWALK_PROGRESS_H
@@ -1,6 +1,11 @@
 // pwalk_report.c - pwalk generic output reporting module.
-
-/// @@@ DEVELOPMENTAL!  NOT FUNCTIONAL YET! @@@
+//
+// Drives -csv output from the pwalk_report_fields[] registry below.  The chosen fields
+// (from -csv=<list> or a -pfile= [csv] section) are compiled ONCE into CSV_PROG[], a
+// flat list of opcodes; each row is then produced by a single switch-loop over that
+// program, using the hand-rolled formatters from pwalk_output.c rather than a runtime
+// printf format.  csv_compile() also folds the fields' PWget_* bits into PWget_MASK so the
+// treewalk fetches only what the report needs.
 
 #define PWALK_REPORT_SOURCE 1
 
@@ -11,250 +16,440 @@
 #include <assert.h>
 #include <ctype.h>
 #include <fcntl.h>
+#include <sys/param.h>
 #include <sys/stat.h>
 #include "pwalk.h"
 #include "pwalk_report.h"
+#include "pwalk_output.h"
 #include "pwalk_onefs.h"
 
-static struct {
-   char *name;
-   void *value;
-   char *format;
-} RPT_LINE[64];
+// Field opcodes; one per distinct way of fetching a value ...
+typedef enum {
+   RPT_NA = 0,			// Not available on this platform (yet)
+   RPT_IFSPATH, RPT_PATH, RPT_NAME, RPT_REF_TIME, RPT_WALK_TIME,
+   RPT_ATIME, RPT_MTIME, RPT_CTIME, RPT_BIRTHTIME,
+   RPT_UID, RPT_GID, RPT_NLINK, RPT_BLKS, RPT_SIZE, RPT_INO, RPT_DEV,
+   RPT_MODE, RPT_MODE_STR,
+   RPT_OWNER_NAME, RPT_GROUP_NAME, RPT_OWNER_SID, RPT_GROUP_SID,
+   RPT_ST_FLAG			// Boolean: (st_flags & bit) != 0
+} RPT_OP;
+
+// Output formats ...
+typedef enum { K_DEC, K_SDEC, K_HEX, K_OCT, K_BOOL, K_STR, K_QSTR } RPT_KIND;
 
 typedef struct {
-   int mask;			// Source for data
+   int mask;			// Source for data (PWget_* bits)
    char *name;
-   char *format;
+   RPT_OP op;
+   RPT_KIND kind;		// Default output format
    char *desc;
+   unsigned long bit;		// RPT_ST_FLAG only
 } RPT_FIELD;
 
+// st_flags bits are only meaningful where they exist; a zero bit means 'not available' ...
+#define FLAG_FIELD(f, desc) { PWget_STAT, #f, RPT_ST_FLAG, K_BOOL, desc, f }
+#if !defined(UF_NODUMP)
+#define UF_NODUMP 0
+#endif
+#if !defined(UF_IMMUTABLE)
+#define UF_IMMUTABLE 0
+#endif
+#if !defined(UF_APPEND)
+#define UF_APPEND 0
+#endif
+#if !defined(UF_OPAQUE)
+#define UF_OPAQUE 0
+#endif
+#if !defined(UF_NOUNLINK)
+#define UF_NOUNLINK 0
+#endif
+#if !defined(UF_INHERIT)
+#define UF_INHERIT 0
+#endif
+#if !defined(UF_WRITECACHE)
+#define UF_WRITECACHE 0
+#endif
+#if !defined(UF_WC_INHERIT)
+#define UF_WC_INHERIT 0
+#endif
+#if !defined(UF_DOS_NOINDEX)
+#define UF_DOS_NOINDEX 0
+#endif
+#if !defined(UF_ADS)
+#define UF_ADS 0
+#endif
+#if !defined(UF_HASADS)
+#define UF_HASADS 0
+#endif
+#if !defined(UF_WC_ENDURANT)
+#define UF_WC_ENDURANT 0
+#endif
+#if !defined(UF_SPARSE)
+#define UF_SPARSE 0
+#endif
+#if !defined(UF_REPARSE)
+#define UF_REPARSE 0
+#endif
+#if !defined(UF_ISI_UNUSED1)
+#define UF_ISI_UNUSED1 0
+#endif
+#if !defined(UF_HIDDEN)
+#define UF_HIDDEN 0
+#endif
+#if !defined(SF_ARCHIVED)
+#define SF_ARCHIVED 0
+#endif
+#if !defined(SF_IMMUTABLE)
+#define SF_IMMUTABLE 0
+#endif
+#if !defined(SF_APPEND)
+#define SF_APPEND 0
+#endif
+#if !defined(SF_FILE_STUBBED)
+#define SF_FILE_STUBBED 0
+#endif
+#if !defined(SF_NOUNLINK)
+#define SF_NOUNLINK 0
+#endif
+#if !defined(SF_SNAPSHOT)
+#define SF_SNAPSHOT 0
+#endif
+#if !defined(SF_NOCOW)
+#define SF_NOCOW 0
+#endif
+#if !defined(SF_CACHED_STUB)
+#define SF_CACHED_STUB 0
+#endif
+#if !defined(SF_HASNTFSACL)
+#define SF_HASNTFSACL 0
+#endif
+#if !defined(SF_HASNTFSOG)
+#define SF_HASNTFSOG 0
+#endif
+#if !defined(UF_DOS_ARCHIVE)
+#define UF_DOS_ARCHIVE 0
+#endif
+#if !defined(UF_DOS_HIDDEN)
+#define UF_DOS_HIDDEN 0
+#endif
+#if !defined(UF_DOS_RO)
+#define UF_DOS_RO 0
+#endif
+#if !defined(UF_DOS_SYSTEM)
+#define UF_DOS_SYSTEM 0
+#endif
+
+#if defined(__ONEFS__)
+#define ONEFS_OP(op) op
+#else
+#define ONEFS_OP(op) RPT_NA
+#endif
+
 static RPT_FIELD pwalk_report_fields[] = {
-   { 0, "ifspath", "\"%s\"", "File pathname, rooted in /ifs" },
-   { PWget_STAT, "ref_time", "%ld", "Time of metadata query" },
-   { PWget_STAT, "st_atime", "%ld", "File access time" },
-   { PWget_STAT, "st_mtime", "%ld", "File modify time" },
-   { PWget_STAT, "st_ctime", "%ld", "File change time" },
-   { PWget_STAT, "st_birthtime", "%ld", "File birth time" },	// Not accurate over NFS
-   { PWget_STAT, "st_uid", "%lu", "File owner UID" },
-   { PWget_STAT, "st_gid", "%lu", "File owner GID" },
-   { PWget_STAT, "st_nlink", "%llu", "Number of hard links" },
-   { PWget_STAT, "st_blks", "%llu", "File number of 1K blocks allocated" },
-   { PWget_STAT, "st_size", "%llu", "File nominal file size" },
-   { PWget_STAT, "st_mode", "%03o", "File mode bits (octal)" },
-   { PWget_STAT, "st_mode_str", "%s", "File mode bits (as 'rwx' string)" },
-   { PWget_STAT, "dir_sum_st_size", "%llu", "Directory sum of st_size" },
-   { PWget_STAT, "dir_sum_st_blks", "%llu", "Directory sum of st_blks" },
-
-   { PWget_OWNER, "owner_uid", "%s", "Owner UID" },
-   { PWget_OWNER, "owner_sid", "%s", "Owner SID" },
-   { PWget_OWNER, "owner_name", "%s", "Owner name" },
-   { PWget_OWNER, "group_gid", "%s", "Owner group GID" },
-   { PWget_OWNER, "group_sid", "%s", "Owner group SID" },
-   { PWget_GROUP, "group_name", "%s", "Group name" },
-   { PWget_ACL4,  "NFS4_ACL_CHEX", "%x", "File ACL4 in hexadecimal format" },
-   { PWget_ACL4,  "NFS4_ACL_ONEFS_str", "%s", "File ACL4 in OneFS format (experimental)" },
-   { PWget_STUB,  "m_stubbed", "%d", "OneFS: File is stubbed (boolean)" },
-
-//#ifdef __ONEFS__
-   { PWget_SD,    "owner_ondisk", "%s", "Owner ondisk" },
-   { PWget_SD,    "group_ondisk", "%s", "Group name ondisk (SID or GID)" },
-   { PWget_WORM,  "w_ctime", "%ld", "OneFS: SmartLock WORM ctime (Compliance mode only)" },
-   { PWget_WORM,  "w_committed", "%d", "OneFS: SmartLock WORM committed state (boolean)" },
-   { PWget_WORM,  "w_expiration_time", "%ld", "OneFS: SmartLock WORM committed state (boolean)" },
-   { PWget_WORM,  "w_compliance", "%d", "OneFS: SmartLock Compliance mode (boolean)" },
-   { PWget_WORM,  "eff_ctime", "%lu", "OneFS: Effective ctime for SmartLock" },
-   { PWget_WORM,  "eff_commit_str", "%c", "OneFS: SmartLock status code [-CcX]" },
-   { PWget_WORM,  "eff_expiration_time", "%ld", "OneFS: SmartLock expiration time" },
-//#endif
+   { 0, "ifspath", RPT_IFSPATH, K_QSTR, "File pathname, rooted in /ifs" },
+   { 0, "path", RPT_PATH, K_QSTR, "File pathname, relative to source path" },
+   { 0, "name", RPT_NAME, K_QSTR, "File name" },
+   { PWget_STAT, "ref_time", RPT_REF_TIME, K_SDEC, "Time of metadata query" },
+   { 0, "walk_time", RPT_WALK_TIME, K_SDEC, "Time the walk started (same in every row)" },
+   { PWget_STAT, "st_atime", RPT_ATIME, K_SDEC, "File access time" },
+   { PWget_STAT, "st_mtime", RPT_MTIME, K_SDEC, "File modify time" },
+   { PWget_STAT, "st_ctime", RPT_CTIME, K_SDEC, "File change time" },
+   { PWget_STAT, "st_birthtime", RPT_BIRTHTIME, K_SDEC, "File birth time" },	// Not accurate over NFS
+   { PWget_STAT, "st_uid", RPT_UID, K_DEC, "File owner UID" },
+   { PWget_STAT, "st_gid", RPT_GID, K_DEC, "File owner GID" },
+   { PWget_STAT, "st_nlink", RPT_NLINK, K_DEC, "Number of hard links" },
+   { PWget_STAT, "st_blks", RPT_BLKS, K_DEC, "File number of 1K blocks allocated" },
+   { PWget_STAT, "st_size", RPT_SIZE, K_DEC, "File nominal file size" },
+   { PWget_STAT, "st_ino", RPT_INO, K_DEC, "File inode number" },
+   { PWget_STAT, "st_dev", RPT_DEV, K_DEC, "File device number" },
+   { PWget_STAT, "st_mode", RPT_MODE, K_OCT, "File mode bits (octal)" },
+   { PWget_STAT, "st_mode_str", RPT_MODE_STR, K_STR, "File mode bits (as 'rwx' string)" },
+   { PWget_STAT, "dir_sum_st_size", RPT_NA, K_DEC, "Directory sum of st_size" },
+   { PWget_STAT, "dir_sum_st_blks", RPT_NA, K_DEC, "Directory sum of st_blks" },
+
+   { PWget_STAT,  "owner_uid", RPT_UID, K_DEC, "Owner UID" },
+   { PWget_SD,    "owner_sid", ONEFS_OP(RPT_OWNER_SID), K_QSTR, "Owner SID" },
+   { PWget_OWNER, "owner_name", RPT_OWNER_NAME, K_QSTR, "Owner name" },
+   { PWget_STAT,  "group_gid", RPT_GID, K_DEC, "Owner group GID" },
+   { PWget_SD,    "group_sid", ONEFS_OP(RPT_GROUP_SID), K_QSTR, "Owner group SID" },
+   { PWget_GROUP, "group_name", RPT_GROUP_NAME, K_QSTR, "Group name" },
+   { PWget_ACL4,  "NFS4_ACL_CHEX", RPT_NA, K_STR, "File ACL4 in hexadecimal format" },
+   { PWget_ACL4,  "NFS4_ACL_ONEFS_str", RPT_NA, K_QSTR, "File ACL4 in OneFS format (experimental)" },
+   { PWget_STAT,  "m_stubbed", (SF_FILE_STUBBED ? RPT_ST_FLAG : RPT_NA), K_BOOL,
+                  "OneFS: File is stubbed (boolean)", SF_FILE_STUBBED },
+
+   // klooge: OneFS-only sources below are not plumbed into directory_scan() yet ...
+   { PWget_SD,    "owner_ondisk", RPT_NA, K_QSTR, "Owner ondisk" },
+   { PWget_SD,    "group_ondisk", RPT_NA, K_QSTR, "Group name ondisk (SID or GID)" },
+   { PWget_WORM,  "w_ctime", RPT_NA, K_SDEC, "OneFS: SmartLock WORM ctime (Compliance mode only)" },
+   { PWget_WORM,  "w_committed", RPT_NA, K_BOOL, "OneFS: SmartLock WORM committed state (boolean)" },
+   { PWget_WORM,  "w_expiration_time", RPT_NA, K_SDEC, "OneFS: SmartLock WORM committed state (boolean)" },
+   { PWget_WORM,  "w_compliance", RPT_NA, K_BOOL, "OneFS: SmartLock Compliance mode (boolean)" },
+   { PWget_WORM,  "eff_ctime", RPT_NA, K_DEC, "OneFS: Effective ctime for SmartLock" },
+   { PWget_WORM,  "eff_commit_str", RPT_NA, K_STR, "OneFS: SmartLock status code [-CcX]" },
+   { PWget_WORM,  "eff_expiration_time", RPT_NA, K_SDEC, "OneFS: SmartLock expiration time" },
 
 // BEGIN st_flags ...
 //#define	UF_SETTABLE	0xf000ffff	/* mask of owner changeable flags */
 //#define	SF_SETTABLE	0x0fff0000	/* mask of superuser changeable flags */
-   { PWget_STAT, "UF_NODUMP", "%d", "do not dump file" },
-   { PWget_STAT, "UF_IMMUTABLE", "%d", "file may not be changed" },
-   { PWget_STAT, "UF_APPEND", "%d", "writes to file may only append" },
-   { PWget_STAT, "UF_OPAQUE", "%d", "directory is opaque wrt. union" },
-   { PWget_STAT, "UF_NOUNLINK", "%d", "file may not be removed or renamed" },
-   { PWget_STAT, "UF_INHERIT", "%d", "this flag is unused but set on" },
-   { PWget_STAT, "UF_WRITECACHE", "%d", "writes are cached." },
-   { PWget_STAT, "UF_WC_INHERIT", "%d", "unused but set on all new files." },
-   { PWget_STAT, "UF_DOS_NOINDEX", "%d", "DOS attr: don't index." },
-   { PWget_STAT, "UF_ADS	", "%d", "file is ADS directory or stream." },
-   { PWget_STAT, "UF_HASADS", "%d", "file has ADS dir." },
-   { PWget_STAT, "UF_WC_ENDURANT", "%d", "write cache is endurant." },
-   { PWget_STAT, "UF_SPARSE", "%d", "file is sparse" },
-   { PWget_STAT, "UF_REPARSE", "%d", "reparse point" },
-   { PWget_STAT, "UF_ISI_UNUSED1", "%d", "ISI UNUSED FLAG VALUE" },
-   { PWget_STAT, "UF_HIDDEN", "%d", "file is hidden" },
-   { PWget_STAT, "SF_ARCHIVED", "%d", "file is archived" },
-   { PWget_STAT, "SF_IMMUTABLE", "%d", "file may not be changed" },
-   { PWget_STAT, "SF_APPEND", "%d", "writes to file may only append" },
-   { PWget_STAT, "SF_FILE_STUBBED", "%d", "file is a stub of archived file" },
-   { PWget_STAT, "SF_NOUNLINK", "%d", "file may not be removed or renamed" },
-   { PWget_STAT, "SF_SNAPSHOT", "%d", "snapshot inode" },
-   { PWget_STAT, "SF_NOCOW", "%d", "don't snapshot inode" },
-   { PWget_STAT, "SF_CACHED_STUB", "%d", "stub has cached data" },
-   { PWget_STAT, "SF_HASNTFSACL", "%d", "file has an NTFS ACL block" },
-   { PWget_STAT, "SF_HASNTFSOG", "%d", "file has an NTFS owner/group block" },
-   { PWget_STAT, "UF_DOS_ARCHIVE", "%d", "DOS Attribute: ARCHIVE bit" },
-   { PWget_STAT, "UF_DOS_HIDDEN", "%d", "DOS Attribute: HIDDEN bit" },
-   { PWget_STAT, "UF_DOS_RO", "%d", "DOS Attribute: READONLY bit" },
-   { PWget_STAT, "UF_DOS_SYSTEM", "%d", "DOS Attribute: SYSTEM bit" },
+   FLAG_FIELD(UF_NODUMP, "do not dump file"),
+   FLAG_FIELD(UF_IMMUTABLE, "file may not be changed"),
+   FLAG_FIELD(UF_APPEND, "writes to file may only append"),
+   FLAG_FIELD(UF_OPAQUE, "directory is opaque wrt. union"),
+   FLAG_FIELD(UF_NOUNLINK, "file may not be removed or renamed"),
+   FLAG_FIELD(UF_INHERIT, "this flag is unused but set on"),
+   FLAG_FIELD(UF_WRITECACHE, "writes are cached."),
+   FLAG_FIELD(UF_WC_INHERIT, "unused but set on all new files."),
+   FLAG_FIELD(UF_DOS_NOINDEX, "DOS attr: don't index."),
+   FLAG_FIELD(UF_ADS, "file is ADS directory or stream."),
+   FLAG_FIELD(UF_HASADS, "file has ADS dir."),
+   FLAG_FIELD(UF_WC_ENDURANT, "write cache is endurant."),
+   FLAG_FIELD(UF_SPARSE, "file is sparse"),
+   FLAG_FIELD(UF_REPARSE, "reparse point"),
+   FLAG_FIELD(UF_ISI_UNUSED1, "ISI UNUSED FLAG VALUE"),
+   FLAG_FIELD(UF_HIDDEN, "file is hidden"),
+   FLAG_FIELD(SF_ARCHIVED, "file is archived"),
+   FLAG_FIELD(SF_IMMUTABLE, "file may not be changed"),
+   FLAG_FIELD(SF_APPEND, "writes to file may only append"),
+   FLAG_FIELD(SF_FILE_STUBBED, "file is a stub of archived file"),
+   FLAG_FIELD(SF_NOUNLINK, "file may not be removed or renamed"),
+   FLAG_FIELD(SF_SNAPSHOT, "snapshot inode"),
+   FLAG_FIELD(SF_NOCOW, "don't snapshot inode"),
+   FLAG_FIELD(SF_CACHED_STUB, "stub has cached data"),
+   FLAG_FIELD(SF_HASNTFSACL, "file has an NTFS ACL block"),
+   FLAG_FIELD(SF_HASNTFSOG, "file has an NTFS owner/group block"),
+   FLAG_FIELD(UF_DOS_ARCHIVE, "DOS Attribute: ARCHIVE bit"),
+   FLAG_FIELD(UF_DOS_HIDDEN, "DOS Attribute: HIDDEN bit"),
+   FLAG_FIELD(UF_DOS_RO, "DOS Attribute: READONLY bit"),
+   FLAG_FIELD(UF_DOS_SYSTEM, "DOS Attribute: SYSTEM bit"),
 // END st_flags ...
 
-   { 0, NULL, NULL, NULL }
+   { 0, NULL, RPT_NA, K_DEC, NULL }
 };
 
-// save_string() - keep a string & return pointer to it, else die!
+// The compiled -csv program; built by csv_field_add(), finalized by csv_compile() ...
+static struct {
+   RPT_OP op;
+   RPT_KIND kind;
+   unsigned long bit;
+   RPT_FIELD *field;
+} CSV_PROG[CSV_MAX_FIELDS];
+static int CSV_NF = 0;
+
+// Worst-case formatted width of one field, for the CSV_ROW_MAX check ...
+static int
+field_max_width(RPT_OP op, RPT_KIND kind)
+{
+   switch (op) {
+      case RPT_IFSPATH:
+      case RPT_PATH:		return (2*MAXPATHLEN + 2);	// Every char a '"', plus quotes
+      case RPT_NAME:		return (2*1024 + 2);		// OneFS allows long names
+      case RPT_OWNER_NAME:
+      case RPT_GROUP_NAME:	return (2*64 + 2);
+      case RPT_OWNER_SID:
+      case RPT_GROUP_SID:	return (2*128 + 2);
+      case RPT_MODE_STR:	return (16);
+      default:			return (kind == K_OCT ? 23 : 21);	// 64-bit octal | decimal
+   }
+}
+
+// @@@ SECTION: Formatters (numbers come from pwalk_output.c) @@@
+// Each writes at p and returns the new end; no NUL termination.
 
 static char *
-save_string(char *str)
+fmt_str(char *p, char *s)
 {
-   char *p;
+   while (*s) *p++ = *s++;
+   return (p);
+}
 
-   p = malloc(strlen(str)+1);
-   assert (p != NULL);
-   strcpy(p, str);
-   return(p);
+// Integer value per kind ...
+static char *
+fmt_int(char *p, RPT_KIND kind, long long v)
+{
+   switch (kind) {
+      case K_SDEC: return (po_fmt_s64(p, v));
+      case K_HEX:  return (po_fmt_hex(p, (unsigned long long) v));
+      case K_OCT:  return (po_fmt_oct(p, (unsigned long long) v, 3));
+      case K_BOOL: *p++ = v ? '1' : '0'; return (p);
+      default:     return (po_fmt_u64(p, (unsigned long long) v));
+   }
 }
 
-// pwalk_report_bind() - bind worker-specific addresses into RPT_LINE[]
+// @@@ SECTION: Field list parsing & compilation @@@
 
-void
-pwalk_report_bind(char *path, struct stat *sb, pw_ifs_info_t *wi)
+// csv_field_add() - Append one field to the program.  <spec> is "<name>[ <format>]" as in a
+// [csv] section line, or "<name>[:<format>]" as in a -csv= list.  <format> overrides the
+// default for integer fields: dec, hex, oct, or a printf-style conversion (%d %u %x %o).
+
+int
+csv_field_add(char *spec)
 {
-   int i, found;
-
-   for (i=0; RPT_LINE[i].name; i++) {
-      found = 0;
-      if (strcmp(RPT_LINE[i].name, "ifspath") == 0)
-         PWget_MASK |= pwalk_report_fields[i].mask;
-      else if (strcmp(RPT_LINE[i].name, "ref_time") == 0)
-         ;
-      else if (strcmp(RPT_LINE[i].name, "st_atime") == 0)
-         ;
-      else if (strcmp(RPT_LINE[i].name, "st_mtime") == 0)
-         ;
-      else if (strcmp(RPT_LINE[i].name, "st_ctime") == 0)
-         ;
-      else if (strcmp(RPT_LINE[i].name, "st_birthtime") == 0)
-         ;
-      else if (strcmp(RPT_LINE[i].name, "st_uid") == 0)
-         ;
-      else if (strcmp(RPT_LINE[i].name, "st_gid") == 0)
-         ;
-      else if (strcmp(RPT_LINE[i].name, "st_blks") == 0)
-         ;
-      else if (strcmp(RPT_LINE[i].name, "st_size") == 0)
-         ;
-      else if (strcmp(RPT_LINE[i].name, "st_mode") == 0)
-         ;
-      else if (strcmp(RPT_LINE[i].name, "st_mode_str") == 0)
-         ;
-      else if (strcmp(RPT_LINE[i].name, "dir_sum_st_size") == 0)
-         ;
-      else if (strcmp(RPT_LINE[i].name, "dir_sum_st_blks") == 0)
-         ;
-      else if (strcmp(RPT_LINE[i].name, "NFS4_ACL_MASK") == 0)
-         ;
-      else if (strcmp(RPT_LINE[i].name, "NFS4_ACL_ONEFS_str") == 0)
-         ;
-      else if (strcmp(RPT_LINE[i].name, "m_stubbed") == 0)
-         ;
-      else if (strcmp(RPT_LINE[i].name, "w_ctime") == 0)
-         ;
-      else if (strcmp(RPT_LINE[i].name, "w_committed") == 0)
-         ;
-      else if (strcmp(RPT_LINE[i].name, "w_expiration_time") == 0)
-         ;
-      else if (strcmp(RPT_LINE[i].name, "eff_ctime") == 0)
-         ;
-      else if (strcmp(RPT_LINE[i].name, "eff_commit_str") == 0)
-         ;
-      else if (strcmp(RPT_LINE[i].name, "eff_expiration_time") == 0)
-         ;
-      else assert("RPT field name unknown!" == NULL);
+   char name[128], *fmt;
+   RPT_FIELD *f;
+   RPT_KIND kind;
+   int len;
+
+   len = strcspn(spec, " \t:");
+   if (len == 0 || len >= sizeof(name))
+      { fprintf(stderr, "ERROR: \"%s\" - bad -csv field specification!\n", spec); exit(-1); }
+   memcpy(name, spec, len);
+   name[len] = '\0';
+   fmt = spec + len;
+   fmt += strspn(fmt, " \t:");
+
+   for (f = pwalk_report_fields; f->name; f++)
+      if (strcmp(name, f->name) == 0) break;
+   if (f->name == NULL)
+      { fprintf(stderr, "ERROR: \"%s\" - unknown -csv field (try -csv=help)!\n", name); exit(-1); }
+   if (f->op == RPT_NA || (f->op == RPT_ST_FLAG && f->bit == 0))
+      { fprintf(stderr, "ERROR: \"%s\" - -csv field not available on %s!\n", name, PWALK_PLATFORM); exit(-1); }
+   if (CSV_NF >= CSV_MAX_FIELDS)
+      { fprintf(stderr, "ERROR: Too many -csv fields (max %d)!\n", CSV_MAX_FIELDS); exit(-1); }
+
+   kind = f->kind;
+   if (*fmt) {
+      if (kind == K_STR || kind == K_QSTR)
+         { fprintf(stderr, "ERROR: \"%s\" - string field takes no format!\n", name); exit(-1); }
+      len = strlen(fmt);
+      if (strcmp(fmt, "dec") == 0 || fmt[len-1] == 'u') kind = K_DEC;
+      else if (fmt[len-1] == 'd') kind = K_SDEC;
+      else if (strcmp(fmt, "hex") == 0 || fmt[len-1] == 'x') kind = K_HEX;
+      else if (strcmp(fmt, "oct") == 0 || fmt[len-1] == 'o') kind = K_OCT;
+      else { fprintf(stderr, "ERROR: \"%s %s\" - bad -csv field format!\n", name, fmt); exit(-1); }
    }
+
+   CSV_PROG[CSV_NF].op = f->op;
+   CSV_PROG[CSV_NF].kind = kind;
+   CSV_PROG[CSV_NF].bit = f->bit;
+   CSV_PROG[CSV_NF].field = f;
+   return (++CSV_NF);
 }
 
-// clean_line() - normalize input string
-// Input lines are:
-//	# comment
-//	// comment
-//	<non-alphanumeric> comment
-//	name <format>
+// csv_fields_parse() - Parses -csv=<name>[,<name>...] list (modifies list) ...
 
-static int
-parse_line(char *line, char **p_name, char **p_format)
+int
+csv_fields_parse(char *list)
 {
    char *p;
 
-   *p_name = *p_format = NULL;
-
-   // Eliminate newline and whitespace at end ...
-   if ((p = index(line, '\n'))) *p = '\0';
-   for (p -= 1; p >= line; p--) if (isspace(*p)) *p = '\0'; else break;
-   // Eliminate whitespace at beginning ...
-   for (p = line; *p; p++) if (isspace(*p)) *p = '\0'; else break;
-   // If 1st non-white character is non-alphanumeric, entire line is a comment ...
-   // If line is blank, treat like a comment ...
-   if (*p == '\0') return(0); 
-   if (!isalnum(*p)) return(0); 
-   *p_name = p;
-   strsep(&p, " \t");
-   *p_format = p;
-   
-   return(1);
+   while ((p = strsep(&list, ","))) {
+      if (*p == '\0') continue;
+      csv_field_add(p);
+   }
+   return (CSV_NF);
 }
 
-// csv_pfile_parse() - Parses -csv= input parameter file
-
 int
-csv_pfile_parse(char *pfile)
+csv_nfields(void)
 {
-   FILE *fp;
-   char line[1024]; // generous
-   char *p_name, *p_format;
-   int found, i, linenum, nf;
-   
-   if ((fp = fopen(pfile, "r")) == NULL)
-     { fprintf(stderr, "ERROR: Cannot open -csv= file!\n"); exit(-1); }
-
-   nf = linenum = 0;
-   while (fgets(line, sizeof(line), fp)) {
-      linenum += 1;
-      if (parse_line(line, &p_name, &p_format) == 0) continue;	// comment or blank line
-      for (i=0, found=0; pwalk_report_fields[i].name; i++) {
-         if (strcmp(p_name, pwalk_report_fields[i].name) == 0) {
-            found = 1;
-            PWget_MASK |= pwalk_report_fields[i].mask;			// mask; aggregate source bits
-            RPT_LINE[nf].name = pwalk_report_fields[i].name;		// name; field name
-            if (p_format) {
-               RPT_LINE[nf].format = save_string(p_format);		// format; dynamic, user-set
-            } else {
-               RPT_LINE[nf].format = pwalk_report_fields[i].format;	// format; static, default
-            }
-            break;
-         }
-      }
-      if (!found) { fprintf(stderr, "ERROR: \"%s\" - bad field specification!\n", p_name); exit(-1); }
-      nf += 1;
-   }
+   return (CSV_NF);
+}
+
+// csv_compile() - Validate the program once all fields are known and gather PWget_MASK bits.
+
+void
+csv_compile(void)
+{
+   int i, width = 0;
+
+   if (CSV_NF < 1)
+      { fprintf(stderr, "ERROR: -csv requires fields; use -csv=<list> or a -pfile= [csv] section!\n"); exit(-1); }
 
-   if (ferror(fp))
-     { fprintf(stderr, "ERROR: Error reading -csv= file!\n"); exit(-1); }
-   if (nf < 1)
-     { fprintf(stderr, "ERROR: No valid fields in -csv= file!\n"); exit(-1); }
+   for (i = 0; i < CSV_NF; i++) {
+      PWget_MASK |= CSV_PROG[i].field->mask;
+      width += field_max_width(CSV_PROG[i].op, CSV_PROG[i].kind) + 1;
+   }
+   if (width >= CSV_ROW_MAX)
+      { fprintf(stderr, "ERROR: -csv row too wide (%d > %d bytes)!\n", width, CSV_ROW_MAX); exit(-1); }
 
    if (VERBOSE > 1) {
-      fprintf(stderr, "-csv with %d fields from these sources;\n", nf);
+      fprintf(stderr, "-csv with %d fields from these sources;\n", CSV_NF);
       if (PWget_MASK & PWget_STAT) fprintf(stderr, "\tPWget_STAT\n");
+      if (PWget_MASK & PWget_OWNER) fprintf(stderr, "\tPWget_OWNER\n");
+      if (PWget_MASK & PWget_GROUP) fprintf(stderr, "\tPWget_GROUP\n");
       if (PWget_MASK & PWget_WORM) fprintf(stderr, "\tPWget_WORM\n");
       if (PWget_MASK & PWget_STUB) fprintf(stderr, "\tPWget_STUB\n");
       if (PWget_MASK & PWget_ACLP) fprintf(stderr, "\tPWget_ACLP\n");
       if (PWget_MASK & PWget_ACL4) fprintf(stderr, "\tPWget_ACL4\n");
       if (PWget_MASK & PWget_SD) fprintf(stderr, "\tPWget_SD\n");
    }
-   return (nf);
+}
+
+// csv_fields_help() - List the registry (-csv=help) ...
+
+void
+csv_fields_help(FILE *f)
+{
+   RPT_FIELD *r;
+
+   fprintf(f, "-csv fields available on %s:\n", PWALK_PLATFORM);
+   for (r = pwalk_report_fields; r->name; r++) {
+      if (r->op == RPT_NA || (r->op == RPT_ST_FLAG && r->bit == 0)) continue;
+      fprintf(f, "	%-20s // %s\n", r->name, r->desc);
+   }
+}
+
+// @@@ SECTION: Row output @@@
+
+// csv_format_header() - Column-name row, including trailing newline ...
+
+char *
+csv_format_header(char *p)
+{
+   int i;
+
+   for (i = 0; i < CSV_NF; i++) {
+      if (i) *p++ = ',';
+      p = fmt_str(p, CSV_PROG[i].field->name);
+   }
+   *p++ = '\n';
+   return (p);
+}
+
+// csv_format_row() - Run the compiled program for one dirent; caller's buffer must hold
+// CSV_ROW_MAX bytes.  Returns end of row (after the newline); no NUL termination.
+
+char *
+csv_format_row(char *p, PW_REPORT_ENTRY *e)
+{
+   struct stat *sb = e->sb;
+   int i;
+
+   for (i = 0; i < CSV_NF; i++) {
+      if (i) *p++ = ',';
+      switch (CSV_PROG[i].op) {
+         case RPT_IFSPATH:	p = po_fmt_qstr(p, e->abspath); break;
+         case RPT_PATH:		p = po_fmt_qstr(p, e->path); break;
+         case RPT_NAME:		p = po_fmt_qstr(p, e->name); break;
+         case RPT_REF_TIME:	p = fmt_int(p, CSV_PROG[i].kind, e->ref_time); break;
+         case RPT_WALK_TIME:	p = fmt_int(p, CSV_PROG[i].kind, e->walk_time); break;
+         case RPT_ATIME:	p = fmt_int(p, CSV_PROG[i].kind, sb->st_atime); break;
+         case RPT_MTIME:	p = fmt_int(p, CSV_PROG[i].kind, sb->st_mtime); break;
+         case RPT_CTIME:	p = fmt_int(p, CSV_PROG[i].kind, sb->st_ctime); break;
+         case RPT_BIRTHTIME:	p = fmt_int(p, CSV_PROG[i].kind, sb->st_birthtime); break;
+         case RPT_UID:		p = fmt_int(p, CSV_PROG[i].kind, sb->st_uid); break;
+         case RPT_GID:		p = fmt_int(p, CSV_PROG[i].kind, sb->st_gid); break;
+         case RPT_NLINK:	p = fmt_int(p, CSV_PROG[i].kind, sb->st_nlink); break;
+         case RPT_BLKS:		// 1K units, rounding up if -bs=512
+            p = fmt_int(p, CSV_PROG[i].kind,
+               (e->st_block_size == 1024) ? sb->st_blocks : (sb->st_blocks+1)/2);
+            break;
+         case RPT_SIZE:		p = fmt_int(p, CSV_PROG[i].kind, sb->st_size); break;
+         case RPT_INO:		p = fmt_int(p, CSV_PROG[i].kind, sb->st_ino); break;
+         case RPT_DEV:		p = fmt_int(p, CSV_PROG[i].kind, sb->st_dev); break;
+         case RPT_MODE:		p = fmt_int(p, CSV_PROG[i].kind, sb->st_mode); break;
+         case RPT_MODE_STR:	p = fmt_str(p, e->mode_str); break;
+         case RPT_OWNER_NAME:	p = po_fmt_qstr(p, e->owner_name); break;
+         case RPT_GROUP_NAME:	p = po_fmt_qstr(p, e->group_name); break;
+         case RPT_OWNER_SID:	p = po_fmt_qstr(p, e->owner_sid); break;
+         case RPT_GROUP_SID:	p = po_fmt_qstr(p, e->group_sid); break;
+#if HAVE_STRUCT_STAT_ST_FLAGS
+         case RPT_ST_FLAG:	*p++ = (sb->st_flags & CSV_PROG[i].bit) ? '1' : '0'; break;
+#endif
+         default:		assert("-csv opcode unknown!" == NULL);
+      }
+   }
+   *p++ = '\n';
+   return (p);
 }
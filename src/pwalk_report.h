@@ -1,10 +1,32 @@
 #if !defined(PWALK_REPORT_H)
 #define PWALK_REPORT_H 1
 
+// Everything the -csv formatter may need to know about one dirent.  Caller fills
+// in what it has; fields whose PWget_MASK bits were not requested may be garbage.
+struct stat;
+typedef struct {
+   char *path;			// RelPathName
+   char *abspath;		// AbsPathName
+   char *name;			// FileName
+   struct stat *sb;		// dirent's stat() buffer
+   char *mode_str;		// 'rwx' string
+   char *owner_name, *group_name;
+   char *owner_sid, *group_sid;
+   long ref_time;		// Time of metadata query
+   long walk_time;		// Time the walk started
+   int st_block_size;		// 512 or 1024 (-bs=)
+} PW_REPORT_ENTRY;
+
+#define CSV_MAX_FIELDS 64	// Max columns in one -csv row
+#define CSV_ROW_MAX (64*1024)	// Worst-case formatted row; enforced by csv_compile()
+
 // Forward declarations ...
-int csv_pfile_parse(char *pfile);
-void pwalk_report_dir_start(void);
-void pwalk_report_dir_entry(void);
-void pwalk_report_dir_end(void);
+int csv_field_add(char *spec);
+int csv_fields_parse(char *list);
+int csv_nfields(void);
+void csv_compile(void);
+void csv_fields_help(FILE *f);
+char *csv_format_header(char *p);
+char *csv_format_row(char *p, PW_REPORT_ENTRY *e);
 
 #endif // PWALK_REPORT_H
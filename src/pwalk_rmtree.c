@@ -0,0 +1,69 @@
+// pwalk_rmtree.c - -rm=tree support; bottom-up rmdir() of emptied directories.
+// See pwalk_rmtree.h for the overall scheme.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pwalk.h"
+#include "pwalk_rmtree.h"
+
+static SUB_TREE *RMT = NULL;
+
+// A node's data is its kept flag: something in it stays, so it does too ...
+
+static void
+merge_kept(void *to, const void *from)
+{
+   *(int *) to |= *(const int *) from;
+}
+
+// complete() - Hold a directory that can go, for rmt_done()'s caller to rmdir(); one that
+// is kept (or top-level) keeps its parent too.
+
+static int
+complete(SUB_NODE *n)
+{
+   if (n->parent && !*(int *) n->data) return (SUB_HOLD);
+   *(int *) n->data = 1;
+   return (SUB_FREE);
+}
+
+void
+rmt_init(void)
+{
+   RMT = sub_new("-rm=tree", sizeof(int), complete, merge_kept);
+}
+
+// rmt_push() - Note directory <relpath> as pushed; call BEFORE it goes on the FIFO.
+
+void
+rmt_push(const char *relpath)
+{
+   sub_push(RMT, relpath);
+}
+
+// rmt_done() - The scan of <relpath> is over; <kept> if anything in it stays.  Returns a
+// directory now ready for rmdir() (<relpath> itself, or an ancestor it was the last thing
+// outstanding for), or NULL.  The caller must pass any directory returned to rmt_removed().
+
+RMT_NODE *
+rmt_done(const char *relpath, int kept)
+{
+   return (sub_done(RMT, relpath, &kept));
+}
+
+// rmt_removed() - Record the rmdir() of <n> (<ok> if it is gone) and free it; returns its
+// parent if that is now ready for rmdir() too, or NULL.
+
+RMT_NODE *
+rmt_removed(RMT_NODE *n, int ok)
+{
+   *(int *) n->data = !ok;
+   return (sub_release(RMT, n));
+}
+
+const char *
+rmt_path(RMT_NODE *n)
+{
+   return (n->path);
+}
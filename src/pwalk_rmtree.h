@@ -0,0 +1,26 @@
+#ifndef PWALK_RMTREE_H
+#define PWALK_RMTREE_H 1
+
+// pwalk_rmtree.h - -rm=tree support; bottom-up rmdir() of emptied directories, in parallel
+// with the treewalk itself.
+//
+// Directories are tracked with pwalk_subtree.h: whichever worker finishes the last scan
+// anywhere below a directory removes it, unlocked, and then goes on up the tree.  So no
+// directory is rmdir()'d before everything under it is done, and no second walk is needed.
+//
+// A directory still holding anything (a non-selected entry, a failed -rm, a subdirectory
+// that was skipped or kept) is kept, and so are all its ancestors; it is not even tried.
+// Top-level directories (those named on the command line) are always kept.
+
+#include "pwalk_subtree.h"
+
+typedef SUB_NODE RMT_NODE;
+
+// Forward declarations ...
+void rmt_init(void);
+void rmt_push(const char *relpath);
+RMT_NODE *rmt_done(const char *relpath, int kept);
+RMT_NODE *rmt_removed(RMT_NODE *n, int ok);
+const char *rmt_path(RMT_NODE *n);
+
+#endif // PWALK_RMTREE_H
@@ -0,0 +1,93 @@
+// pwalk_rollup.c - +rollup support; du-style cumulative subtree totals, during the walk.
+// See pwalk_rollup.h for the overall scheme.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pwalk.h"
+#include "pwalk_subtree.h"
+#include "pwalk_rollup.h"
+
+static SUB_TREE *RU = NULL;
+static FILE *ROLLUP = NULL;			// (Written only from complete(), which is locked)
+static unsigned long long RECORDS = 0;
+
+static void
+add_totals(void *vto, const void *vfrom)
+{
+   RU_TOTALS *to = vto;
+   const RU_TOTALS *from = vfrom;
+
+   to->files += from->files;
+   to->dirs += from->dirs;
+   to->lsize += from->lsize;
+   to->psize += from->psize;
+   if (from->max_mtime > to->max_mtime) to->max_mtime = from->max_mtime;
+}
+
+// put_record() - One CSV line (locked).
+
+static void
+put_record(const char *path, unsigned depth, RU_TOTALS *t)
+{
+   const char *s;
+
+   fputc('"', ROLLUP);
+   for (s = path; *s; s++) {
+      if (*s == '"') fputc('"', ROLLUP);
+      fputc(*s, ROLLUP);
+   }
+   fprintf(ROLLUP, "\",%u,%llu,%llu,%llu,%llu,%lld\n", depth,
+      t->files, t->dirs, t->lsize, t->psize, (long long) t->max_mtime);
+   RECORDS += 1;
+}
+
+// complete() - Everything under <n> is done; write its record.
+
+static int
+complete(SUB_NODE *n)
+{
+   put_record(n->path, n->depth, n->data);
+   return (SUB_FREE);
+}
+
+// ru_init() - Create pwalk_rollup.csv in <outdir>; 0 if OK, else -1.
+
+int
+ru_init(const char *outdir)
+{
+   char ofile[4096];
+
+   RU = sub_new("+rollup", sizeof(RU_TOTALS), complete, add_totals);
+   snprintf(ofile, sizeof(ofile), "%s%cpwalk_rollup.csv", outdir, PATHSEPCHR);
+   if ((ROLLUP = fopen(ofile, "w")) == NULL) return (-1);
+   fprintf(ROLLUP, "path,depth,files,dirs,lsize,psize,max_mtime\n");
+   return (0);
+}
+
+// ru_push() - Note directory <relpath> as pushed; call BEFORE it goes on the FIFO.
+
+void
+ru_push(const char *relpath)
+{
+   sub_push(RU, relpath);
+}
+
+// ru_done() - The scan of <relpath> is over, with <t> its direct totals.  Writes the
+// records of <relpath> and of each ancestor it was the last thing outstanding for.
+
+void
+ru_done(const char *relpath, RU_TOTALS *t)
+{
+   sub_done(RU, relpath, t);
+}
+
+// ru_close() - Close pwalk_rollup.csv; returns records written.
+
+unsigned long long
+ru_close(void)
+{
+   if (ROLLUP) fclose(ROLLUP);
+   ROLLUP = NULL;
+   return (RECORDS);
+}
@@ -0,0 +1,35 @@
+#ifndef PWALK_ROLLUP_H
+#define PWALK_ROLLUP_H 1
+
+// pwalk_rollup.h - +rollup support; du-style cumulative subtree totals, during the walk.
+//
+// The "S:" and <summary> lines total each directory's direct children only.  With
+// +rollup, directories are tracked with pwalk_subtree.h, each node holding an accumulator:
+// a finished scan adds the directory's own totals, and whichever worker finishes the last
+// scan anywhere below a directory writes its rollup record, and adds its totals into the
+// parent's.  So every record is complete when written, and no second pass is needed.
+//
+// Records go to ${OUTPUT_DIR}/pwalk_rollup.csv as directories complete (bottom-up, not
+// sorted), one per directory:
+//	path,depth,files,dirs,lsize,psize,max_mtime
+// where depth 0 is a <directory> argument, and the rest are for the whole subtree: the
+// same selected() files, directories, and logical and physical bytes as the S: lines,
+// and the newest mtime among them (epoch seconds).
+
+#include <time.h>
+
+typedef struct {
+   unsigned long long files;		// Regular files
+   unsigned long long dirs;		// Directories below
+   unsigned long long lsize;		// Bytes logical
+   unsigned long long psize;		// Bytes physical
+   time_t max_mtime;			// Newest mtime
+} RU_TOTALS;
+
+// Forward declarations ...
+int ru_init(const char *outdir);
+void ru_push(const char *relpath);
+void ru_done(const char *relpath, RU_TOTALS *t);
+unsigned long long ru_close(void);
+
+#endif // PWALK_ROLLUP_H
@@ -0,0 +1,189 @@
+// pwalk_subtree.c - Subtree completion tracking, during the walk; for -rm=tree and +rollup.
+// See pwalk_subtree.h for the overall scheme.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "pwalk.h"
+#include "pwalk_subtree.h"
+
+#define DATA_ALIGN 16			// Of each node's data, after its path
+
+// Nodes exist only for directories with work outstanding, so a table holds about as many
+// as the FIFO does; it doubles when it averages 2 per bucket.
+struct sub_tree {
+   pthread_mutex_t mutex;
+   SUB_NODE **table;
+   unsigned long size, nodes;
+   size_t data_size;
+   int (*complete)(SUB_NODE *n);
+   void (*merge)(void *to, const void *from);
+   char what[32];			// For abend() messages
+};
+
+static SUB_NODE *
+node_find(SUB_TREE *t, const char *path, size_t len, unsigned h)
+{
+   SUB_NODE *n;
+
+   for (n = t->table[h & (t->size - 1)]; n; n = n->next)
+      if (n->hash == h && strncmp(n->path, path, len) == 0 && n->path[len] == '\0') return (n);
+   return (NULL);
+}
+
+static void
+table_grow(SUB_TREE *t)
+{
+   SUB_NODE **old = t->table, *n, *nn;
+   unsigned long old_size = t->size, i;
+   char msg[64];
+
+   t->size *= 2;
+   if ((t->table = calloc(t->size, sizeof(SUB_NODE *))) == NULL) {
+      sprintf(msg, "%s: cannot calloc table!", t->what);
+      abend(msg);
+   }
+   for (i = 0; i < old_size; i++)
+      for (n = old[i]; n; n = nn) {
+         nn = n->next;
+         n->next = t->table[n->hash & (t->size - 1)];
+         t->table[n->hash & (t->size - 1)] = n;
+      }
+   free(old);
+}
+
+static SUB_NODE *
+node_add(SUB_TREE *t, const char *path, size_t len, unsigned h, SUB_NODE *parent)
+{
+   SUB_NODE *n, **b;
+   size_t off = (sizeof(SUB_NODE) + len + DATA_ALIGN - 1) & ~(size_t) (DATA_ALIGN - 1);
+   char msg[64];
+
+   if (t->nodes >= 2 * t->size) table_grow(t);
+   if ((n = calloc(1, off + t->data_size)) == NULL) {
+      sprintf(msg, "%s: cannot malloc node!", t->what);
+      abend(msg);
+   }
+   memcpy(n->path, path, len);
+   n->path[len] = '\0';
+   n->data = (char *) n + off;
+   n->hash = h;
+   n->parent = parent;
+   n->depth = parent ? parent->depth + 1 : 0;
+   n->pending = 1;				// Its own scan
+   b = &t->table[h & (t->size - 1)];
+   n->next = *b;
+   *b = n;
+   t->nodes += 1;
+   return (n);
+}
+
+static void
+node_free(SUB_TREE *t, SUB_NODE *n)
+{
+   SUB_NODE **pp;
+
+   for (pp = &t->table[n->hash & (t->size - 1)]; *pp != n; pp = &(*pp)->next) ;
+   *pp = n->next;
+   t->nodes -= 1;
+   free(n);
+}
+
+// settle() - Drop one count from <n> (locked), completing it and its ancestors as their
+// counts reach 0; returns a node complete() held, or NULL.
+
+static SUB_NODE *
+settle(SUB_TREE *t, SUB_NODE *n)
+{
+   SUB_NODE *p;
+
+   while (n && --n->pending == 0) {
+      if (t->complete(n) == SUB_HOLD) return (n);
+      p = n->parent;
+      if (p) t->merge(p->data, n->data);
+      node_free(t, n);
+      n = p;
+   }
+   return (NULL);
+}
+
+// sub_new() - A tracker whose nodes carry <data_size> bytes of user data; <what> names it
+// in abend() messages.
+
+SUB_TREE *
+sub_new(const char *what, size_t data_size, int (*complete)(SUB_NODE *n),
+   void (*merge)(void *to, const void *from))
+{
+   SUB_TREE *t;
+
+   if ((t = calloc(1, sizeof(SUB_TREE))) == NULL) abend("Cannot malloc subtree tracker!");
+   pthread_mutex_init(&t->mutex, NULL);
+   t->size = 64 * 1024;
+   if ((t->table = calloc(t->size, sizeof(SUB_NODE *))) == NULL) abend("Cannot calloc subtree table!");
+   t->data_size = data_size;
+   t->complete = complete;
+   t->merge = merge;
+   snprintf(t->what, sizeof(t->what), "%s", what);
+   return (t);
+}
+
+// sub_push() - Note directory <relpath> as pushed; call BEFORE it goes on the FIFO, so its
+// node exists by the time it is popped.
+
+void
+sub_push(SUB_TREE *t, const char *relpath)
+{
+   SUB_NODE *parent;
+   const char *s;
+   size_t len = strlen(relpath), plen;
+   unsigned h, ph;
+
+   s = strrchr(relpath, PATHSEPCHR);
+   plen = s ? s - relpath : 0;
+   h = fnv1a(relpath, len);
+   ph = fnv1a(relpath, plen);
+
+   pthread_mutex_lock(&t->mutex);
+   if ((parent = node_find(t, relpath, plen, ph)) == NULL)
+      parent = node_add(t, relpath, plen, ph, NULL);
+   parent->pending += 1;
+   node_add(t, relpath, len, h, parent);
+   pthread_mutex_unlock(&t->mutex);
+}
+
+// sub_done() - The scan of <relpath> is over; merge <data> (its own) into its node and drop
+// its count.  Returns a node complete() held (<relpath>'s, or an ancestor's), or NULL.
+
+SUB_NODE *
+sub_done(SUB_TREE *t, const char *relpath, const void *data)
+{
+   SUB_NODE *n;
+   size_t len = strlen(relpath);
+   unsigned h = fnv1a(relpath, len);
+
+   pthread_mutex_lock(&t->mutex);
+   if ((n = node_find(t, relpath, len, h)) == NULL)
+      n = node_add(t, relpath, len, h, NULL);	// A top-level directory that pushed nothing
+   t->merge(n->data, data);
+   n = settle(t, n);
+   pthread_mutex_unlock(&t->mutex);
+   return (n);
+}
+
+// sub_release() - Done with held node <n>: merge its data into its parent's, free it, and
+// drop the parent's count.  Returns the next node complete() held, or NULL.
+
+SUB_NODE *
+sub_release(SUB_TREE *t, SUB_NODE *n)
+{
+   SUB_NODE *p;
+
+   pthread_mutex_lock(&t->mutex);
+   p = n->parent;
+   if (p) t->merge(p->data, n->data);
+   node_free(t, n);
+   p = settle(t, p);
+   pthread_mutex_unlock(&t->mutex);
+   return (p);
+}
@@ -0,0 +1,44 @@
+#ifndef PWALK_SUBTREE_H
+#define PWALK_SUBTREE_H 1
+
+// pwalk_subtree.h - Subtree completion tracking, during the walk; for -rm=tree and +rollup.
+//
+// Each directory pushed onto the FIFO gets a SUB_NODE, keyed by its relative path, with a
+// count of outstanding work: 1 for its own scan, plus 1 for each subdirectory pushed by that
+// scan.  When a worker finishes scanning a directory, it merges the directory's own data
+// into its node and drops its count; whichever worker drops a count to 0 (finishing the last
+// scan anywhere below it) completes that node.  The user's complete() sees it, its data
+// merges into its parent's, and the parent's count drops in turn, and so on up the tree.
+// So every directory completes after everything under it, and no second walk is needed.
+//
+// complete() runs locked.  It returns SUB_FREE to go on up the tree at once, or SUB_HOLD
+// to hand the node back to the caller of sub_done() (eg: to rmdir() it unlocked), who must
+// pass it to sub_release() when finished with it.  A parent with no node yet when a
+// directory is pushed is a top-level directory (depth 0, no parent); so is a directory
+// that pushed nothing and was never pushed itself.
+
+#include <sys/types.h>
+
+typedef struct sub_node {
+   struct sub_node *next;		// Hash chain
+   struct sub_node *parent;		// NULL for a top-level directory
+   unsigned long pending;		// Own scan (until done) + subdirectories not yet done
+   unsigned depth;			// 0 for a top-level directory
+   unsigned hash;
+   void *data;				// User's, zeroed (allocated with the node)
+   char path[1];			// Relative path, as pushed (allocated to fit)
+} SUB_NODE;
+
+#define SUB_FREE 0			// complete(): done with it
+#define SUB_HOLD 1			// ... caller of sub_done() or sub_release() gets it
+
+typedef struct sub_tree SUB_TREE;
+
+// Forward declarations ...
+SUB_TREE *sub_new(const char *what, size_t data_size, int (*complete)(SUB_NODE *n),
+   void (*merge)(void *to, const void *from));
+void sub_push(SUB_TREE *t, const char *relpath);
+SUB_NODE *sub_done(SUB_TREE *t, const char *relpath, const void *data);
+SUB_NODE *sub_release(SUB_TREE *t, SUB_NODE *n);
+
+#endif // PWALK_SUBTREE_H
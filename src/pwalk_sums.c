@@ -1,25 +1,995 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
 #include <unistd.h>
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <sys/uio.h>
+#include "pwalk_sums.h"
+#include "pwalk_extents.h"
+#include "pwalk_io.h"
+
+// These loops are the whole cost of +crc, +md5, etc; optimize them even in -g builds ...
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC optimize ("O2")
+#endif
+
+// ... which with -O0 on the command line still needs small helpers forced inline
+#if defined(__GNUC__)
+#define SUMS_INLINE static inline __attribute__((always_inline))
+#else
+#define SUMS_INLINE static inline
+#endif
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define SUMS_X86 1
+#include <immintrin.h>
+#include <cpuid.h>
+#endif
+#if defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#define SUMS_ARM 1
+#include <arm_acle.h>
+#endif
 
 // @@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@ crc-32 @@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@
 
-// crc32() - Reads entire open file and calculates CRC-32 value.
-// RETURNS: CRC value in passed variable, bytes processed as function value.
+// Two polynomials, both bit-reflected with ~0 pre- and post-conditioning:
+//	CRC-32  (0xEDB88320) - as used by gzip, zlib, Ethernet, PNG; `gzip -l` and zlib's crc32() agree.
+//	CRC-32C (0x82F63B78) - Castagnoli, as used by iSCSI, ext4, btrfs.
+// Each has a portable slicing-by-8 version; sums_init() picks hardware paths where the
+// CPU has them (x86: PCLMULQDQ folding for CRC-32, SSE4.2 crc32 for CRC-32C; ARMv8 CRC
+// instructions for both) after checking them against the tables.
+
+#define CRC32_POLY 0xEDB88320
+#define CRC32C_POLY 0x82F63B78
+
+static unsigned CRC32_T[8][256];
+static unsigned CRC32C_T[8][256];
+
+static void
+crc_tables(unsigned t[8][256], unsigned poly)
+{
+   unsigned c, i, j;
+
+   for (i = 0; i < 256; i++) {
+      c = i;
+      for (j = 0; j < 8; j++) c = (c & 1) ? (c >> 1) ^ poly : (c >> 1);
+      t[0][i] = c;
+   }
+   for (i = 0; i < 256; i++)
+      for (j = 1; j < 8; j++)
+         t[j][i] = (t[j-1][i] >> 8) ^ t[0][t[j-1][i] & 0xff];
+}
+
+// Slicing-by-8; <c> and the result are the raw (already-inverted) register ...
+static unsigned
+crc_slice8(unsigned t[8][256], unsigned c, const unsigned char *p, size_t len)
+{
+   unsigned lo, hi;
+
+   while (len && ((size_t) p & 7)) { c = (c >> 8) ^ t[0][(c ^ *p++) & 0xff]; len--; }
+   while (len >= 8) {
+#if defined(__BIG_ENDIAN__) || (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+      lo = c ^ (p[0] | p[1] << 8 | p[2] << 16 | (unsigned) p[3] << 24);
+      hi = p[4] | p[5] << 8 | p[6] << 16 | (unsigned) p[7] << 24;
+#else
+      lo = c ^ *(const unsigned *) p;
+      hi = *(const unsigned *) (p + 4);
+#endif
+      c = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^ t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24] ^
+          t[3][hi & 0xff] ^ t[2][(hi >> 8) & 0xff] ^ t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+      p += 8;
+      len -= 8;
+   }
+   while (len--) c = (c >> 8) ^ t[0][(c ^ *p++) & 0xff];
+   return (c);
+}
+
+static unsigned
+crc32_sw(unsigned c, const unsigned char *p, size_t len)
+{
+   return (crc_slice8(CRC32_T, c, p, len));
+}
+
+static unsigned
+crc32c_sw(unsigned c, const unsigned char *p, size_t len)
+{
+   return (crc_slice8(CRC32C_T, c, p, len));
+}
+
+#if SUMS_X86
+// CRC-32 by carry-less multiply folding; after Intel's "Fast CRC Computation for Generic
+// Polynomials Using PCLMULQDQ Instruction" (Gopal et al, 2009).  Folds 64 bytes per
+// iteration, then Barrett-reduces; shorter/odd tails are left to the tables.
+
+__attribute__((target("sse4.1,pclmul")))
+static unsigned
+crc32_pclmul(unsigned c, const unsigned char *p, size_t len)
+{
+   static const unsigned long long __attribute__((aligned(16))) k1k2[] = { 0x0154442bd4ULL, 0x01c6e41596ULL };
+   static const unsigned long long __attribute__((aligned(16))) k3k4[] = { 0x01751997d0ULL, 0x00ccaa009eULL };
+   static const unsigned long long __attribute__((aligned(16))) k5k0[] = { 0x0163cd6124ULL, 0 };
+   static const unsigned long long __attribute__((aligned(16))) poly[] = { 0x01db710641ULL, 0x01f7011641ULL };
+   __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+   size_t n;
+
+   if (len < 64) return (crc32_sw(c, p, len));
+   n = len & ~(size_t) 15;
+
+   x1 = _mm_loadu_si128((__m128i *) (p + 0x00));
+   x2 = _mm_loadu_si128((__m128i *) (p + 0x10));
+   x3 = _mm_loadu_si128((__m128i *) (p + 0x20));
+   x4 = _mm_loadu_si128((__m128i *) (p + 0x30));
+   x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(c));
+   x0 = _mm_load_si128((__m128i *) k1k2);
+   p += 64; n -= 64;
+
+   while (n >= 64) {				// Four parallel folds ...
+      x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+      x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+      x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+      x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+      x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+      x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+      x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+      x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+      y5 = _mm_loadu_si128((__m128i *) (p + 0x00));
+      y6 = _mm_loadu_si128((__m128i *) (p + 0x10));
+      y7 = _mm_loadu_si128((__m128i *) (p + 0x20));
+      y8 = _mm_loadu_si128((__m128i *) (p + 0x30));
+      x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+      x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+      x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+      x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+      p += 64; n -= 64;
+   }
+
+   // ... into 128 bits ...
+   x0 = _mm_load_si128((__m128i *) k3k4);
+   x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+   x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+   x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+   x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+   x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+   x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+   x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+   x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+   x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+   while (n >= 16) {				// ... remaining 16-byte blocks ...
+      x2 = _mm_loadu_si128((__m128i *) p);
+      x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+      x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+      x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+      p += 16; n -= 16;
+   }
+
+   // ... 128 to 64 bits ...
+   x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+   x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+   x1 = _mm_srli_si128(x1, 8);
+   x1 = _mm_xor_si128(x1, x2);
+   x0 = _mm_loadl_epi64((__m128i *) k5k0);
+   x2 = _mm_srli_si128(x1, 4);
+   x1 = _mm_and_si128(x1, x3);
+   x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+   x1 = _mm_xor_si128(x1, x2);
+
+   // ... Barrett reduction to 32 bits ...
+   x0 = _mm_load_si128((__m128i *) poly);
+   x2 = _mm_and_si128(x1, x3);
+   x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+   x2 = _mm_and_si128(x2, x3);
+   x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+   x1 = _mm_xor_si128(x1, x2);
+   c = _mm_extract_epi32(x1, 1);
+
+   return (crc32_sw(c, p, len & 15));
+}
+
+// CRC-32C with the SSE4.2 crc32 instruction, 8 bytes at a time ...
+
+__attribute__((target("sse4.2")))
+static unsigned
+crc32c_sse42(unsigned c, const unsigned char *p, size_t len)
+{
+   unsigned long long c64;
+
+   while (len && ((size_t) p & 7)) { c = _mm_crc32_u8(c, *p++); len--; }
+   c64 = c;
+   while (len >= 8) {
+      c64 = _mm_crc32_u64(c64, *(const unsigned long long *) p);
+      p += 8; len -= 8;
+   }
+   c = (unsigned) c64;
+   while (len--) c = _mm_crc32_u8(c, *p++);
+   return (c);
+}
+#endif // SUMS_X86
+
+#if SUMS_ARM
+static unsigned
+crc32_armv8(unsigned c, const unsigned char *p, size_t len)
+{
+   while (len && ((size_t) p & 7)) { c = __crc32b(c, *p++); len--; }
+   while (len >= 8) { c = __crc32d(c, *(const unsigned long long *) p); p += 8; len -= 8; }
+   while (len--) c = __crc32b(c, *p++);
+   return (c);
+}
+
+static unsigned
+crc32c_armv8(unsigned c, const unsigned char *p, size_t len)
+{
+   while (len && ((size_t) p & 7)) { c = __crc32cb(c, *p++); len--; }
+   while (len >= 8) { c = __crc32cd(c, *(const unsigned long long *) p); p += 8; len -= 8; }
+   while (len--) c = __crc32cb(c, *p++);
+   return (c);
+}
+#endif // SUMS_ARM
+
+// Selected implementations (set once by sums_init(), before any worker runs) ...
+static unsigned (*CRC32_F)(unsigned, const unsigned char *, size_t) = crc32_sw;
+static unsigned (*CRC32C_F)(unsigned, const unsigned char *, size_t) = crc32c_sw;
+static const char *CRC32_IMPL = "slice8";
+static const char *CRC32C_IMPL = "slice8";
+
+// crc32_update(), crc32c_update() - zlib-style running CRC; start with crc = 0.
+
+unsigned
+crc32_update(unsigned crc, const void *buf, size_t len)
+{
+   return (~CRC32_F(~crc, buf, len));
+}
+
+unsigned
+crc32c_update(unsigned crc, const void *buf, size_t len)
+{
+   return (~CRC32C_F(~crc, buf, len));
+}
+
+// crc_selftest() - Known answers (CRC catalogue "check" values for "123456789"), then a
+// cross-check against the tables over assorted lengths and alignments.  Returns 0 if OK.
+
+static int
+crc_selftest(unsigned (*f)(unsigned, const unsigned char *, size_t), unsigned (*ref)(unsigned, const unsigned char *, size_t), unsigned check)
+{
+   static unsigned char buf[4096+16];
+   unsigned i, off, len;
+
+   if (~f(~0U, (const unsigned char *) "123456789", 9) != check) return (-1);
+   for (i = 0; i < sizeof(buf); i++) buf[i] = (unsigned char) (i * 2654435761U >> 13);
+   for (off = 0; off < 16; off += 3)
+      for (len = 0; len <= 4096; len += (len < 160) ? 1 : 61)
+         if (f(0x12345678, buf + off, len) != ref(0x12345678, buf + off, len)) return (-1);
+   // Incremental == one-shot ...
+   if (f(f(~0U, buf, 1000), buf + 1000, 3000) != f(~0U, buf, 4000)) return (-1);
+   return (0);
+}
+
+// @@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@ md5, sha-1, sha-256 @@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@
+
+// All three are Merkle-Damgard over 64-byte blocks and differ only in their compression
+// function, initial state, and byte order; they share the block buffering and padding
+// below.  SHA-1 and SHA-256 use the x86 SHA extensions when present (sums_init() checks
+// them against the C versions first); MD5 is a serial chain of dependent adds, so there is
+// nothing to vectorize for a single stream and it stays in C.
+
+#define ROL32(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+#define ROR32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+#define LOAD32_LE(p) ((unsigned) (p)[0] | (unsigned) (p)[1] << 8 | (unsigned) (p)[2] << 16 | (unsigned) (p)[3] << 24)
+#define LOAD32_BE(p) ((unsigned) (p)[3] | (unsigned) (p)[2] << 8 | (unsigned) (p)[1] << 16 | (unsigned) (p)[0] << 24)
+
+typedef void (*BLK_F)(unsigned *h, const unsigned char *p, size_t nblocks);
+
+typedef struct {
+   unsigned h[8];			// Chaining state
+   unsigned long long len;		// Bytes hashed so far
+   unsigned char buf[64];		// Partial block
+   BLK_F f;				// Compression function
+} BLK_CTX;
+
+static const unsigned MD5_K[64] = {
+   0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+   0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+   0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+   0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+   0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+   0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+   0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+   0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391 };
+
+static const unsigned SHA256_K[64] = {
+   0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+   0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+   0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+   0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+   0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+   0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+   0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+   0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2 };
+
+#define MD5_F(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))
+#define MD5_G(x, y, z) ((y) ^ ((z) & ((x) ^ (y))))
+#define MD5_H(x, y, z) ((x) ^ (y) ^ (z))
+#define MD5_I(x, y, z) ((y) ^ ((x) | ~(z)))
+#define MD5_STEP(f, a, b, c, d, x, k, s) { (a) += f((b), (c), (d)) + (x) + (k); (a) = ROL32((a), (s)) + (b); }
+
+static void
+md5_blocks(unsigned *h, const unsigned char *p, size_t nblocks)
+{
+   unsigned a, b, c, d, x[16];
+   int i;
+
+   for (; nblocks; nblocks--, p += 64) {
+      for (i = 0; i < 16; i++) x[i] = LOAD32_LE(p + 4*i);
+      a = h[0]; b = h[1]; c = h[2]; d = h[3];
+      for (i = 0; i < 16; i += 4) {
+         MD5_STEP(MD5_F, a, b, c, d, x[i], MD5_K[i], 7);
+         MD5_STEP(MD5_F, d, a, b, c, x[i+1], MD5_K[i+1], 12);
+         MD5_STEP(MD5_F, c, d, a, b, x[i+2], MD5_K[i+2], 17);
+         MD5_STEP(MD5_F, b, c, d, a, x[i+3], MD5_K[i+3], 22);
+      }
+      for (i = 16; i < 32; i += 4) {
+         MD5_STEP(MD5_G, a, b, c, d, x[(5*i+1) & 15], MD5_K[i], 5);
+         MD5_STEP(MD5_G, d, a, b, c, x[(5*i+6) & 15], MD5_K[i+1], 9);
+         MD5_STEP(MD5_G, c, d, a, b, x[(5*i+11) & 15], MD5_K[i+2], 14);
+         MD5_STEP(MD5_G, b, c, d, a, x[(5*i+16) & 15], MD5_K[i+3], 20);
+      }
+      for (i = 32; i < 48; i += 4) {
+         MD5_STEP(MD5_H, a, b, c, d, x[(3*i+5) & 15], MD5_K[i], 4);
+         MD5_STEP(MD5_H, d, a, b, c, x[(3*i+8) & 15], MD5_K[i+1], 11);
+         MD5_STEP(MD5_H, c, d, a, b, x[(3*i+11) & 15], MD5_K[i+2], 16);
+         MD5_STEP(MD5_H, b, c, d, a, x[(3*i+14) & 15], MD5_K[i+3], 23);
+      }
+      for (i = 48; i < 64; i += 4) {
+         MD5_STEP(MD5_I, a, b, c, d, x[(7*i) & 15], MD5_K[i], 6);
+         MD5_STEP(MD5_I, d, a, b, c, x[(7*i+7) & 15], MD5_K[i+1], 10);
+         MD5_STEP(MD5_I, c, d, a, b, x[(7*i+14) & 15], MD5_K[i+2], 15);
+         MD5_STEP(MD5_I, b, c, d, a, x[(7*i+21) & 15], MD5_K[i+3], 21);
+      }
+      h[0] += a; h[1] += b; h[2] += c; h[3] += d;
+   }
+}
+
+static void
+sha1_blocks_sw(unsigned *h, const unsigned char *p, size_t nblocks)
+{
+   unsigned a, b, c, d, e, t, w[80];
+   int i;
+
+   for (; nblocks; nblocks--, p += 64) {
+      for (i = 0; i < 16; i++) w[i] = LOAD32_BE(p + 4*i);
+      for (i = 16; i < 80; i++) w[i] = ROL32(w[i-3] ^ w[i-8] ^ w[i-14] ^ w[i-16], 1);
+      a = h[0]; b = h[1]; c = h[2]; d = h[3]; e = h[4];
+      for (i = 0; i < 80; i++) {
+         if (i < 20) t = ((b & c) | (~b & d)) + 0x5a827999;
+         else if (i < 40) t = (b ^ c ^ d) + 0x6ed9eba1;
+         else if (i < 60) t = ((b & c) | (b & d) | (c & d)) + 0x8f1bbcdc;
+         else t = (b ^ c ^ d) + 0xca62c1d6;
+         t += ROL32(a, 5) + e + w[i];
+         e = d; d = c; c = ROL32(b, 30); b = a; a = t;
+      }
+      h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+   }
+}
+
+static void
+sha256_blocks_sw(unsigned *h, const unsigned char *p, size_t nblocks)
+{
+   unsigned a, b, c, d, e, f, g, k, t1, t2, w[64];
+   int i;
+
+   for (; nblocks; nblocks--, p += 64) {
+      for (i = 0; i < 16; i++) w[i] = LOAD32_BE(p + 4*i);
+      for (i = 16; i < 64; i++)
+         w[i] = w[i-16] + w[i-7]
+            + (ROR32(w[i-15], 7) ^ ROR32(w[i-15], 18) ^ (w[i-15] >> 3))
+            + (ROR32(w[i-2], 17) ^ ROR32(w[i-2], 19) ^ (w[i-2] >> 10));
+      a = h[0]; b = h[1]; c = h[2]; d = h[3]; e = h[4]; f = h[5]; g = h[6]; k = h[7];
+      for (i = 0; i < 64; i++) {
+         t1 = k + (ROR32(e, 6) ^ ROR32(e, 11) ^ ROR32(e, 25)) + (g ^ (e & (f ^ g))) + SHA256_K[i] + w[i];
+         t2 = (ROR32(a, 2) ^ ROR32(a, 13) ^ ROR32(a, 22)) + ((a & b) | (c & (a | b)));
+         k = g; g = f; f = e; e = d + t1; d = c; c = b; b = a; a = t1 + t2;
+      }
+      h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e; h[5] += f; h[6] += g; h[7] += k;
+   }
+}
+
+#if SUMS_X86
+// SHA extensions; 4 rounds per sha1rnds4, 2 per sha256rnds2, message schedule in hardware.
+// The rounds are macro-unrolled since sha1rnds4's round function must be an immediate.
+
+// CPUID.(EAX=7,ECX=0):EBX bit 29; not all compilers' __builtin_cpu_supports() know "sha" ...
+static int
+sums_cpu_sha(void)
+{
+   unsigned a, b, c, d;
+
+   return (__get_cpuid_count(7, 0, &a, &b, &c, &d) && (b & (1 << 29)));
+}
+
+#define SHA1_MSG(m0, m1, m2, m3) m0 = _mm_sha1msg2_epu32(_mm_xor_si128(_mm_sha1msg1_epu32(m0, m1), m2), m3)
+#define SHA1_4(e0, e1, m, fn) { e0 = _mm_sha1nexte_epu32(e0, m); e1 = abcd; abcd = _mm_sha1rnds4_epu32(abcd, e0, fn); }
+
+__attribute__((target("sha,sse4.1")))
+static void
+sha1_blocks_ni(unsigned *h, const unsigned char *p, size_t nblocks)
+{
+   const __m128i bswap = _mm_set_epi64x(0x0001020304050607LL, 0x08090a0b0c0d0e0fLL);
+   __m128i abcd, abcd_save, e0, e1, e_save, m0, m1, m2, m3;
+
+   abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) h), 0x1b);
+   e0 = _mm_set_epi32(h[4], 0, 0, 0);
+   for (; nblocks; nblocks--, p += 64) {
+      abcd_save = abcd; e_save = e0;
+      m0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (p)), bswap);
+      m1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (p + 16)), bswap);
+      m2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (p + 32)), bswap);
+      m3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (p + 48)), bswap);
+      e0 = _mm_add_epi32(e0, m0); e1 = abcd; abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);	// 0-3
+      SHA1_4(e1, e0, m1, 0);
+      SHA1_4(e0, e1, m2, 0);
+      SHA1_4(e1, e0, m3, 0);
+      SHA1_MSG(m0, m1, m2, m3); SHA1_4(e0, e1, m0, 0);				// 16-19
+      SHA1_MSG(m1, m2, m3, m0); SHA1_4(e1, e0, m1, 1);
+      SHA1_MSG(m2, m3, m0, m1); SHA1_4(e0, e1, m2, 1);
+      SHA1_MSG(m3, m0, m1, m2); SHA1_4(e1, e0, m3, 1);
+      SHA1_MSG(m0, m1, m2, m3); SHA1_4(e0, e1, m0, 1);
+      SHA1_MSG(m1, m2, m3, m0); SHA1_4(e1, e0, m1, 1);
+      SHA1_MSG(m2, m3, m0, m1); SHA1_4(e0, e1, m2, 2);				// 40-43
+      SHA1_MSG(m3, m0, m1, m2); SHA1_4(e1, e0, m3, 2);
+      SHA1_MSG(m0, m1, m2, m3); SHA1_4(e0, e1, m0, 2);
+      SHA1_MSG(m1, m2, m3, m0); SHA1_4(e1, e0, m1, 2);
+      SHA1_MSG(m2, m3, m0, m1); SHA1_4(e0, e1, m2, 2);
+      SHA1_MSG(m3, m0, m1, m2); SHA1_4(e1, e0, m3, 3);				// 60-63
+      SHA1_MSG(m0, m1, m2, m3); SHA1_4(e0, e1, m0, 3);
+      SHA1_MSG(m1, m2, m3, m0); SHA1_4(e1, e0, m1, 3);
+      SHA1_MSG(m2, m3, m0, m1); SHA1_4(e0, e1, m2, 3);
+      SHA1_MSG(m3, m0, m1, m2); SHA1_4(e1, e0, m3, 3);				// 76-79
+      e0 = _mm_sha1nexte_epu32(e0, e_save);
+      abcd = _mm_add_epi32(abcd, abcd_save);
+   }
+   _mm_storeu_si128((__m128i *) h, _mm_shuffle_epi32(abcd, 0x1b));
+   h[4] = _mm_extract_epi32(e0, 3);
+}
+
+#define SHA256_MSG(m0, m1, m2, m3) m0 = _mm_sha256msg2_epu32(_mm_add_epi32(_mm_sha256msg1_epu32(m0, m1), _mm_alignr_epi8(m3, m2, 4)), m3)
+#define SHA256_4(m, i) { \
+   t = _mm_add_epi32(m, _mm_loadu_si128((const __m128i *) (SHA256_K + (i)))); \
+   s1 = _mm_sha256rnds2_epu32(s1, s0, t); \
+   s0 = _mm_sha256rnds2_epu32(s0, s1, _mm_shuffle_epi32(t, 0x0e)); }
+
+__attribute__((target("sha,sse4.1")))
+static void
+sha256_blocks_ni(unsigned *h, const unsigned char *p, size_t nblocks)
+{
+   const __m128i bswap = _mm_set_epi64x(0x0c0d0e0f08090a0bLL, 0x0405060700010203LL);
+   __m128i s0, s1, s0_save, s1_save, t, m0, m1, m2, m3;
+   int i;
+
+   // h[] is ABCD EFGH; the instructions want ABEF and CDGH ...
+   t = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) h), 0xb1);		// CDAB
+   s1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) (h + 4)), 0x1b);	// EFGH
+   s0 = _mm_alignr_epi8(t, s1, 8);						// ABEF
+   s1 = _mm_blend_epi16(s1, t, 0xf0);						// CDGH
+   for (; nblocks; nblocks--, p += 64) {
+      s0_save = s0; s1_save = s1;
+      m0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (p)), bswap);
+      m1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (p + 16)), bswap);
+      m2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (p + 32)), bswap);
+      m3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (p + 48)), bswap);
+      SHA256_4(m0, 0);
+      SHA256_4(m1, 4);
+      SHA256_4(m2, 8);
+      SHA256_4(m3, 12);
+      for (i = 16; i < 64; i += 16) {
+         SHA256_MSG(m0, m1, m2, m3); SHA256_4(m0, i);
+         SHA256_MSG(m1, m2, m3, m0); SHA256_4(m1, i + 4);
+         SHA256_MSG(m2, m3, m0, m1); SHA256_4(m2, i + 8);
+         SHA256_MSG(m3, m0, m1, m2); SHA256_4(m3, i + 12);
+      }
+      s0 = _mm_add_epi32(s0, s0_save);
+      s1 = _mm_add_epi32(s1, s1_save);
+   }
+   t = _mm_shuffle_epi32(s0, 0x1b);						// FEBA
+   s1 = _mm_shuffle_epi32(s1, 0xb1);						// DCHG
+   _mm_storeu_si128((__m128i *) h, _mm_blend_epi16(t, s1, 0xf0));		// DCBA
+   _mm_storeu_si128((__m128i *) (h + 4), _mm_alignr_epi8(s1, t, 8));	// HGFE
+}
+#endif // SUMS_X86
+
+static BLK_F SHA1_F = sha1_blocks_sw;
+static BLK_F SHA256_F = sha256_blocks_sw;
+static const char *SHA1_IMPL = "c";
+static const char *SHA256_IMPL = "c";
+
+static void
+blk_init(BLK_CTX *c, int alg)
+{
+   static const unsigned md5_h[4] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476 };
+   static const unsigned sha1_h[5] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0 };
+   static const unsigned sha256_h[8] = {
+      0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+
+   c->len = 0;
+   if (alg == SUM_MD5) { memcpy(c->h, md5_h, sizeof(md5_h)); c->f = md5_blocks; }
+   else if (alg == SUM_SHA1) { memcpy(c->h, sha1_h, sizeof(sha1_h)); c->f = SHA1_F; }
+   else { memcpy(c->h, sha256_h, sizeof(sha256_h)); c->f = SHA256_F; }
+}
+
+static void
+blk_update(BLK_CTX *c, const unsigned char *p, size_t len)
+{
+   size_t have = c->len & 63, take;
+
+   c->len += len;
+   if (have) {
+      take = (len < 64 - have) ? len : 64 - have;
+      memcpy(c->buf + have, p, take);
+      p += take; len -= take;
+      if (have + take < 64) return;
+      c->f(c->h, c->buf, 1);
+   }
+   if (len >= 64) {
+      c->f(c->h, p, len / 64);
+      p += len & ~(size_t) 63; len &= 63;
+   }
+   if (len) memcpy(c->buf, p, len);
+}
+
+// blk_final() - Pad with 0x80, zeroes, and the bit length; then emit <nwords> of state.
+static void
+blk_final(BLK_CTX *c, int big_endian, int nwords, unsigned char *out)
+{
+   unsigned char pad[72] = { 0x80 };
+   unsigned long long bits = c->len * 8;
+   size_t npad = ((c->len & 63) < 56) ? 56 - (c->len & 63) : 120 - (c->len & 63);
+   int i;
+
+   for (i = 0; i < 8; i++) pad[npad + i] = big_endian ? bits >> (56 - 8*i) : bits >> (8*i);
+   blk_update(c, pad, npad + 8);
+   for (i = 0; i < 4 * nwords; i++)
+      out[i] = big_endian ? c->h[i/4] >> (24 - 8*(i&3)) : c->h[i/4] >> (8*(i&3));
+}
+
+// @@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@ xxh64 @@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@
+
+// XXH64 (seed 0), as printed by `xxhsum -H1` - a fast non-cryptographic hash for
+// change detection when a CRC is too weak and SHA-256 too slow.  Four independent
+// 64-bit lanes keep the multipliers busy; it is already memory-bound in plain C.
+
+#define XXH_P1 0x9e3779b185ebca87ULL
+#define XXH_P2 0xc2b2ae3d27d4eb4fULL
+#define XXH_P3 0x165667b19e3779f9ULL
+#define XXH_P4 0x85ebca77c2b2ae63ULL
+#define XXH_P5 0x27d4eb2f165667c5ULL
+#define ROL64(x, n) (((x) << (n)) | ((x) >> (64 - (n))))
+
+typedef struct {
+   unsigned long long v[4];
+   unsigned long long len;
+   unsigned char buf[32];
+} XXH_CTX;
+
+SUMS_INLINE unsigned long long
+load64_le(const unsigned char *p)
+{
+   unsigned long long v;
+
+   memcpy(&v, p, 8);
+#if defined(__BIG_ENDIAN__) || (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+   v = __builtin_bswap64(v);
+#endif
+   return (v);
+}
+
+SUMS_INLINE unsigned long long
+xxh_round(unsigned long long acc, unsigned long long in)
+{
+   acc += in * XXH_P2;
+   return (ROL64(acc, 31) * XXH_P1);
+}
+
+static void
+xxh_init(XXH_CTX *c)
+{
+   c->v[0] = XXH_P1 + XXH_P2;
+   c->v[1] = XXH_P2;
+   c->v[2] = 0;
+   c->v[3] = -XXH_P1;
+   c->len = 0;
+}
+
+static void
+xxh_update(XXH_CTX *c, const unsigned char *p, size_t len)
+{
+   size_t have = c->len & 31, take;
+   unsigned long long v0, v1, v2, v3;
+
+   c->len += len;
+   if (have) {
+      take = (len < 32 - have) ? len : 32 - have;
+      memcpy(c->buf + have, p, take);
+      p += take; len -= take;
+      if (have + take < 32) return;
+      c->v[0] = xxh_round(c->v[0], load64_le(c->buf));
+      c->v[1] = xxh_round(c->v[1], load64_le(c->buf + 8));
+      c->v[2] = xxh_round(c->v[2], load64_le(c->buf + 16));
+      c->v[3] = xxh_round(c->v[3], load64_le(c->buf + 24));
+   }
+   v0 = c->v[0]; v1 = c->v[1]; v2 = c->v[2]; v3 = c->v[3];
+   for (; len >= 32; p += 32, len -= 32) {
+      v0 = xxh_round(v0, load64_le(p));
+      v1 = xxh_round(v1, load64_le(p + 8));
+      v2 = xxh_round(v2, load64_le(p + 16));
+      v3 = xxh_round(v3, load64_le(p + 24));
+   }
+   c->v[0] = v0; c->v[1] = v1; c->v[2] = v2; c->v[3] = v3;
+   if (len) memcpy(c->buf, p, len);
+}
+
+static unsigned long long
+xxh_final(XXH_CTX *c)
+{
+   unsigned long long h;
+   const unsigned char *p = c->buf;
+   size_t len = c->len & 31;
+   int i;
+
+   if (c->len >= 32) {
+      h = ROL64(c->v[0], 1) + ROL64(c->v[1], 7) + ROL64(c->v[2], 12) + ROL64(c->v[3], 18);
+      for (i = 0; i < 4; i++) h = (h ^ xxh_round(0, c->v[i])) * XXH_P1 + XXH_P4;
+   } else
+      h = XXH_P5;
+   h += c->len;
+   for (; len >= 8; p += 8, len -= 8) h = ROL64(h ^ xxh_round(0, load64_le(p)), 27) * XXH_P1 + XXH_P4;
+   if (len >= 4) { h = ROL64(h ^ (LOAD32_LE(p) * XXH_P1), 23) * XXH_P2 + XXH_P3; p += 4; len -= 4; }
+   for (; len; p++, len--) h = ROL64(h ^ (*p * XXH_P5), 11) * XXH_P1;
+   h ^= h >> 33; h *= XXH_P2;
+   h ^= h >> 29; h *= XXH_P3;
+   h ^= h >> 32;
+   return (h);
+}
+
+// @@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@ digest engine @@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@
+
+// sums_file() reads each file once and feeds every selected digest from the same
+// buffer while it is still in cache, so +crc +md5 +sha256 costs one read of the data,
+// not three.
+
+const char *SUM_NAMES[SUM_NALGS] = { "crc", "crc32c", "md5", "sha1", "sha256", "xxh64" };
+
+typedef struct {
+   unsigned crc32, crc32c;
+   BLK_CTX md5, sha1, sha256;
+   XXH_CTX xxh64;
+} SUM_CTX;
+
+static long long
+sums_ns(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ((long long) ts.tv_sec * 1000000000 + ts.tv_nsec);
+}
+
+static void
+sums_begin(SUM_CTX *c, int algs)
+{
+   c->crc32 = c->crc32c = 0;
+   if (algs & SUM_MD5) blk_init(&c->md5, SUM_MD5);
+   if (algs & SUM_SHA1) blk_init(&c->sha1, SUM_SHA1);
+   if (algs & SUM_SHA256) blk_init(&c->sha256, SUM_SHA256);
+   if (algs & SUM_XXH64) xxh_init(&c->xxh64);
+}
+
+// Feed one buffer to every selected digest; per-digest ns if <st> ...
+static void
+sums_update(SUM_CTX *c, int algs, const unsigned char *p, size_t len, SUM_STATS *st)
+{
+   long long t0, t1;
+   int i;
+
+   t0 = st ? sums_ns() : 0;
+   for (i = 0; i < SUM_NALGS; i++) {
+      if (!(algs & (1 << i))) continue;
+      switch (1 << i) {
+         case SUM_CRC32: c->crc32 = crc32_update(c->crc32, p, len); break;
+         case SUM_CRC32C: c->crc32c = crc32c_update(c->crc32c, p, len); break;
+         case SUM_MD5: blk_update(&c->md5, p, len); break;
+         case SUM_SHA1: blk_update(&c->sha1, p, len); break;
+         case SUM_SHA256: blk_update(&c->sha256, p, len); break;
+         case SUM_XXH64: xxh_update(&c->xxh64, p, len); break;
+      }
+      if (st) {
+         t1 = sums_ns();
+         st->bytes[i] += len;
+         st->ns[i] += t1 - t0;
+         t0 = t1;
+      }
+   }
+}
+
+static void
+sums_end(SUM_CTX *c, int algs, SUM_VALUES *v)
+{
+   v->crc32 = c->crc32;
+   v->crc32c = c->crc32c;
+   if (algs & SUM_MD5) blk_final(&c->md5, 0, 4, v->md5);
+   if (algs & SUM_SHA1) blk_final(&c->sha1, 1, 5, v->sha1);
+   if (algs & SUM_SHA256) blk_final(&c->sha256, 1, 8, v->sha256);
+   if (algs & SUM_XXH64) v->xxh64 = xxh_final(&c->xxh64);
+}
+
+// sums_read() - Digest open file from <off> up to <end> (or EOF when <end> < 0); returns the
+// offset reached.
+
+static off_t
+sums_read(int fd, char *rbuf, size_t rbuf_size, int algs, SUM_CTX *c, SUM_STATS *st, off_t off, off_t end)
+{
+   ssize_t nbytes;
+   size_t want;
+   long long t0, t1;
+
+   t0 = sums_ns();
+   while (end < 0 || off < end) {
+      want = (end < 0 || end - off > (off_t) rbuf_size) ? rbuf_size : (size_t) (end - off);
+      if ((nbytes = io_pread(fd, rbuf, want, off, IO_SUMS)) <= 0) break;
+      t1 = sums_ns();
+      st->read_ns += t1 - t0;
+      st->read_bytes += nbytes;
+      sums_update(c, algs, (unsigned char *) rbuf, nbytes, st);
+      off += nbytes;
+      t0 = sums_ns();
+   }
+   return (off);
+}
+
+// sums_zeros() - Digest <len> zero bytes (a hole) without reading them.
+
+static void
+sums_zeros(SUM_CTX *c, int algs, off_t len, SUM_STATS *st)
+{
+   static const unsigned char zeros[64*1024];
+
+   st->hole_bytes += len;
+   for (; len > (off_t) sizeof(zeros); len -= sizeof(zeros)) sums_update(c, algs, zeros, sizeof(zeros), st);
+   if (len > 0) sums_update(c, algs, zeros, len, st);
+}
+
+// sums_file() - Reads entire open file once, computing every digest selected in <algs>.
+// Past the first buffer, holes in a sparse file are digested as zeros, not read.
+// RETURNS: digests in <v>, bytes processed as function value; adds to counters in <st>.
 // NOTE: Caller should assume result is valid iff returned size matches file's size.
 // MT-safe.
 
 size_t
-crc32(int fd, char *rbuf, int rbuf_size, unsigned *crc_val)
+sums_file(int fd, char *rbuf, size_t rbuf_size, int algs, SUM_VALUES *v, SUM_STATS *st)
+{
+   SUM_CTX c;
+   EXT_MAP m;
+   struct stat sb;
+   off_t off;
+   int i;
+
+   sums_begin(&c, algs);
+   off = sums_read(fd, rbuf, rbuf_size, algs, &c, st, 0, rbuf_size);
+   if (off == (off_t) rbuf_size) {		// More to come; any holes in it?
+      if (fstat(fd, &sb) == 0 && sb.st_size > off && ext_map(fd, off, sb.st_size, &m) >= 0 &&
+          ext_data_bytes(&m) < sb.st_size - off) {
+         for (i = 0; i < m.n; i++) {
+            sums_zeros(&c, algs, m.start[i] - off, st);
+            if ((off = sums_read(fd, rbuf, rbuf_size, algs, &c, st, m.start[i], m.end[i])) != m.end[i]) break;
+         }
+         if (i == m.n) {			// Trailing hole, up to the size mapped
+            sums_zeros(&c, algs, sb.st_size - off, st);
+            off = sb.st_size;
+         }
+      } else {
+         off = sums_read(fd, rbuf, rbuf_size, algs, &c, st, off, -1);
+      }
+   }
+   sums_end(&c, algs, v);
+   return (off);
+}
+
+// sums_buf() - Digests in <algs> of one buffer (eg: a sample of a file).  MT-safe.
+
+void
+sums_buf(int algs, const void *buf, size_t len, SUM_VALUES *v)
+{
+   SUM_CTX c;
+
+   sums_begin(&c, algs);
+   sums_update(&c, algs, buf, len, NULL);
+   sums_end(&c, algs, v);
+}
+
+static char *
+sums_hex(char *s, const unsigned char *p, int n)
+{
+   while (n--) {
+      *s++ = "0123456789abcdef"[*p >> 4];
+      *s++ = "0123456789abcdef"[*p++ & 15];
+   }
+   *s = '\0';
+   return (s);
+}
+
+// sums_format() - Append " crc=0x... md5=..." for the digests in <algs> to <s> (which needs
+// SUM_STR_MAX bytes).  <v> NULL means a zero-length file; those get the *_SUM_ZERO values.
+
+char *
+sums_format(char *s, int algs, SUM_VALUES *v)
 {
-   size_t nbytes, nbytes_t;
+   char *p = s;
 
-   nbytes_t = 0;
-   while ((nbytes = pread(fd, rbuf, rbuf_size, nbytes_t)) > 0) {
-      nbytes_t += nbytes;
+   if (algs & SUM_CRC32) p += sprintf(p, " crc=0x%x", v ? v->crc32 : 0);
+   if (algs & SUM_CRC32C) p += sprintf(p, " crc32c=0x%x", v ? v->crc32c : 0);
+   if (algs & SUM_MD5) { p = stpcpy(p, " md5="); p = v ? sums_hex(p, v->md5, 16) : stpcpy(p, MD5_SUM_ZERO); }
+   if (algs & SUM_SHA1) { p = stpcpy(p, " sha1="); p = v ? sums_hex(p, v->sha1, 20) : stpcpy(p, SHA1_SUM_ZERO); }
+   if (algs & SUM_SHA256) { p = stpcpy(p, " sha256="); p = v ? sums_hex(p, v->sha256, 32) : stpcpy(p, SHA256_SUM_ZERO); }
+   if (algs & SUM_XXH64) {
+      if (v) p += sprintf(p, " xxh64=%016llx", v->xxh64);
+      else p = stpcpy(stpcpy(p, " xxh64="), XXH64_SUM_ZERO);
    }
-   *crc_val = 0xdeadbeef ^ nbytes_t;
-   return(nbytes_t);
+   *p = '\0';
+   return (s);
+}
+
+// sums_format_failed() - As sums_format(), but " md5=?" etc.; for a file that could not be
+// opened or read in full, whose digests would be wrong.
+
+char *
+sums_format_failed(char *s, int algs)
+{
+   char *p = s;
+   int i;
+
+   for (i = 0; i < SUM_NALGS; i++)
+      if (algs & (1 << i)) p = stpcpy(stpcpy(stpcpy(p, " "), SUM_NAMES[i]), "=?");
+   *p = '\0';
+   return (s);
+}
+
+// sums_format_none() - As sums_format(), but " md5=-" etc.; for a directory, symlink or other
+// non-regular entry, which has no content to digest.  The CRCs stay 0x0, as they always were.
+
+char *
+sums_format_none(char *s, int algs)
+{
+   char *p = s;
+   int i;
+
+   for (i = 0; i < SUM_NALGS; i++)
+      if (algs & (1 << i))
+         p = stpcpy(stpcpy(stpcpy(p, " "), SUM_NAMES[i]), ((1 << i) & (SUM_CRC32|SUM_CRC32C)) ? "=0x0" : "=-");
+   *p = '\0';
+   return (s);
+}
+
+// sums_selftest() - Known answers for each digest (FIPS 180 / RFC 1321 examples; xxhsum),
+// at every split point so the buffering is exercised too.  Returns 0 if OK.
+
+static int
+sums_selftest(void)
+{
+   static const char *msg[] = { "", "abc", "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq" };
+   static const char *ans[][3] = {
+      { " md5=" MD5_SUM_ZERO, " md5=900150983cd24fb0d6963f7d28e17f72", " md5=8215ef0796a20bcaaae116d3876c664a" },
+      { " sha1=" SHA1_SUM_ZERO, " sha1=a9993e364706816aba3e25717850c26c9cd0d89d", " sha1=84983e441c3bd26ebaae4aa1f95129e5e54670f1" },
+      { " sha256=" SHA256_SUM_ZERO, " sha256=ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad",
+         " sha256=248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1" },
+      { " xxh64=" XXH64_SUM_ZERO, " xxh64=44bc2cf5ad770999", " xxh64=f06103773e8585df" } };
+   static const int alg[] = { SUM_MD5, SUM_SHA1, SUM_SHA256, SUM_XXH64 };
+   char s[SUM_STR_MAX];
+   SUM_CTX c;
+   SUM_VALUES v;
+   size_t i, j, k, len;
+
+   for (i = 0; i < sizeof(alg)/sizeof(alg[0]); i++)
+      for (j = 0; j < sizeof(msg)/sizeof(msg[0]); j++) {
+         len = strlen(msg[j]);
+         for (k = 0; k <= len; k++) {
+            sums_begin(&c, alg[i]);
+            sums_update(&c, alg[i], (const unsigned char *) msg[j], k, NULL);
+            sums_update(&c, alg[i], (const unsigned char *) msg[j] + k, len - k, NULL);
+            sums_end(&c, alg[i], &v);
+            if (strcmp(sums_format(s, alg[i], &v), ans[i][j]) != 0) return (-1);
+         }
+      }
+   return (0);
+}
+
+// blk_selftest() - Hardware block function must match C version over several blocks ...
+static int
+blk_selftest(BLK_F f, BLK_F ref, int nwords)
+{
+   static unsigned char buf[64*8];
+   unsigned h1[8], h2[8];
+   unsigned i;
+
+   for (i = 0; i < sizeof(buf); i++) buf[i] = (unsigned char) (i * 2654435761U >> 11);
+   for (i = 0; i < 8; i++) h1[i] = h2[i] = 0x01234567 * (i + 1);
+   f(h1, buf, 8);
+   ref(h2, buf, 8);
+   return (memcmp(h1, h2, nwords * sizeof(unsigned)) != 0);
+}
+
+// sums_init() - Build tables, self-test everything, pick fastest self-tested
+// implementations.  Call once, early.  Returns number of self-test failures (hardware
+// paths that fail are not used; C versions that fail are fatal to the caller).
+
+int
+sums_init(void)
+{
+   int fails = 0;
+
+   crc_tables(CRC32_T, CRC32_POLY);
+   crc_tables(CRC32C_T, CRC32C_POLY);
+   if (crc_selftest(crc32_sw, crc32_sw, 0xCBF43926)) fails++;
+   if (crc_selftest(crc32c_sw, crc32c_sw, 0xE3069283)) fails++;
+
+#if SUMS_X86
+   __builtin_cpu_init();
+   if (__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1")) {
+      if (crc_selftest(crc32_pclmul, crc32_sw, 0xCBF43926) == 0) { CRC32_F = crc32_pclmul; CRC32_IMPL = "pclmul"; }
+      else fails++;
+   }
+   if (__builtin_cpu_supports("sse4.2")) {
+      if (crc_selftest(crc32c_sse42, crc32c_sw, 0xE3069283) == 0) { CRC32C_F = crc32c_sse42; CRC32C_IMPL = "sse4.2"; }
+      else fails++;
+   }
+   if (sums_cpu_sha() && __builtin_cpu_supports("sse4.1")) {
+      if (blk_selftest(sha1_blocks_ni, sha1_blocks_sw, 5) == 0) { SHA1_F = sha1_blocks_ni; SHA1_IMPL = "sha-ni"; }
+      else fails++;
+      if (blk_selftest(sha256_blocks_ni, sha256_blocks_sw, 8) == 0) { SHA256_F = sha256_blocks_ni; SHA256_IMPL = "sha-ni"; }
+      else fails++;
+   }
+#endif
+#if SUMS_ARM
+   if (crc_selftest(crc32_armv8, crc32_sw, 0xCBF43926) == 0) { CRC32_F = crc32_armv8; CRC32_IMPL = "armv8"; }
+   else fails++;
+   if (crc_selftest(crc32c_armv8, crc32c_sw, 0xE3069283) == 0) { CRC32C_F = crc32c_armv8; CRC32C_IMPL = "armv8"; }
+   else fails++;
+#endif
+   if (sums_selftest()) fails++;	// With the selected implementations
+   return (fails);
+}
+
+// sums_impl() - Name of selected implementation for one digest (a single SUM_* bit).
+
+const char *
+sums_impl(int alg)
+{
+   switch (alg) {
+      case SUM_CRC32: return (CRC32_IMPL);
+      case SUM_CRC32C: return (CRC32C_IMPL);
+      case SUM_SHA1: return (SHA1_IMPL);
+      case SUM_SHA256: return (SHA256_IMPL);
+      default: return ("c");
+   }
+}
+
+// sums_bench() - Hot-cache MB/s of one digest (a single SUM_* bit) over <buf>, for the log.
+
+double
+sums_bench(int alg, void *buf, size_t len)
+{
+   SUM_CTX c;
+   SUM_VALUES v;
+   long long t0, t1;
+   int i, iters = 32;
+
+   memset(buf, 0x5a, len);
+   sums_begin(&c, alg);
+   t0 = sums_ns();
+   for (i = 0; i < iters; i++) sums_update(&c, alg, buf, len, NULL);
+   sums_end(&c, alg, &v);
+   t1 = sums_ns();
+   __asm__ __volatile__("" : : "r" (&v) : "memory");	// Result is "used"; keeps the loop
+   return ((t1 > t0) ? (double) len * iters * 1000. / (t1 - t0) : 0.);
 }
 
 // @@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@ crc-16 @@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@
@@ -1,7 +1,44 @@
 #ifndef PWALK_SUMS_H
 #define PWALK_SUMS_H 1
 
-size_t crc32(int fd, char *rbuf, int rbuf_size, unsigned *crc_val);
+#include <sys/types.h>
+
+// Digests for +crc, +crc32c, +md5, +sha1, +sha256, +xxh64; SUM_* bits select them ...
+#define SUM_CRC32	0x01
+#define SUM_CRC32C	0x02
+#define SUM_MD5		0x04
+#define SUM_SHA1	0x08
+#define SUM_SHA256	0x10
+#define SUM_XXH64	0x20
+#define SUM_NALGS	6		// Bit i is SUM_NAMES[i]
+#define SUM_STR_MAX	256		// sums_format() output, all digests
+
+typedef struct {
+   unsigned crc32, crc32c;
+   unsigned char md5[16], sha1[20], sha256[32];
+   unsigned long long xxh64;
+} SUM_VALUES;
+
+typedef struct {
+   unsigned long long bytes[SUM_NALGS];	// Bytes digested, per algorithm
+   unsigned long long ns[SUM_NALGS];	// ... and time spent on them
+   unsigned long long read_bytes;	// Bytes read (once, for all algorithms)
+   unsigned long long read_ns;		// ... and time spent in pread()
+   unsigned long long hole_bytes;	// Bytes in holes, digested as zeros without a read
+} SUM_STATS;
+
+extern const char *SUM_NAMES[SUM_NALGS];
+
+int sums_init(void);
+const char *sums_impl(int alg);
+double sums_bench(int alg, void *buf, size_t len);
+unsigned crc32_update(unsigned crc, const void *buf, size_t len);
+unsigned crc32c_update(unsigned crc, const void *buf, size_t len);
+void sums_buf(int algs, const void *buf, size_t len, SUM_VALUES *v);
+size_t sums_file(int fd, char *rbuf, size_t rbuf_size, int algs, SUM_VALUES *v, SUM_STATS *st);
+char *sums_format(char *s, int algs, SUM_VALUES *v);
+char *sums_format_failed(char *s, int algs);
+char *sums_format_none(char *s, int algs);
 unsigned short crc16(const unsigned char *data_p, int length);
 
 #define MD5_SUM_ZERO "d41d8cd98f00b204e9800998ecf8427e"
@@ -9,5 +46,6 @@ unsigned short crc16(const unsigned char *data_p, int length);
 #define SHA224_SUM_ZERO "d14a028c2a3a2bc9476102bb288234c415a2b01f828ea62ac5b3e42f"
 #define SHA256_SUM_ZERO "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"
 #define SHA384_SUM_ZERO "38b060a751ac96384cd9327eb1b1e36a21fdb71114be07434c0cc7bf63f6e1da274edebfe76f65fbd51ad2f14898b95b"
+#define XXH64_SUM_ZERO "ef46db3751d8e999"
 
 #endif // PWALK_SUMS_H
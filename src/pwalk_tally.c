@@ -0,0 +1,380 @@
+// pwalk_tally.c - +tally_by= support; +tally histograms along other dimensions.
+// See pwalk_tally.h for the dimensions and outputs.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "pwalk.h"
+#include "pwalk_tally.h"
+
+#define DIM_UID 0
+#define DIM_TOP 1
+#define DIM_AGE 2
+#define DIM_ATIME 3
+#define DIM_EXT 4
+#define DIM_SIZE 5
+
+static const char *DIM_NAMES[] = { "uid", "top", "age", "atime", "ext", "size", NULL };
+static const int DIM_NUMERIC[] = { 1, 0, 1, 1, 0, 1 };	// Keys compare as numbers
+
+#define EXT_MAX 32			// Longer "extensions" are not extensions
+
+// Age bands, by upper bound in days; band 0 is a time in the future ...
+static const int AGE_DAYS[] = { 0, 1, 7, 30, 91, 182, 365, 2*365, 3*365, 5*365, INT_MAX };
+static const char *AGE_LABELS[] = { "future", "<1d", "<1w", "<1m", "<3m", "<6m", "<1y", "<2y", "<3y", "<5y", ">=5y" };
+#define AGE_BANDS (sizeof(AGE_DAYS) / sizeof(AGE_DAYS[0]))
+
+typedef struct t_ent {
+   struct t_ent *next;
+   unsigned hash;
+   count_64 count, size, space;
+   char key[1];				// Dimension values, each ending in '\t' (allocated to fit)
+} T_ENT;
+
+typedef struct {
+   T_ENT **tab;
+   unsigned long size, n;
+} T_TABLE;
+
+typedef struct {
+   char *spec;				// As given, eg: "top+age"
+   int ndims;
+   int dim[TALLY_DIMS_MAX];
+   T_TABLE shard[MAX_WORKERS+1];	// Per-worker counts
+} T_SPEC;
+
+static T_SPEC SPECS[TALLY_BY_MAX];
+static int NSPECS = 0;
+static int SPEC_DIMS = 0;		// Mask of dimensions any <spec> uses
+
+static time_t NOW;
+static int NBUCKETS;
+static unsigned long long *BUCKET_SIZE;
+
+static char *TOP[MAX_WORKERS+1];	// Worker's current top-level directory
+
+// tally_by_parse() - Add one <spec> (or a comma-separated list); 0 if OK, -1 if not.
+
+int
+tally_by_parse(char *spec)
+{
+   char *s, *d, *save1, *save2;
+   T_SPEC *t;
+   int i;
+
+   spec = strdup(spec);
+   for (s = strtok_r(spec, ",", &save1); s; s = strtok_r(NULL, ",", &save1)) {
+      if (NSPECS >= TALLY_BY_MAX) return (-1);
+      t = &SPECS[NSPECS++];
+      t->spec = strdup(s);
+      t->ndims = 0;
+      for (d = strtok_r(s, "+", &save2); d; d = strtok_r(NULL, "+", &save2)) {
+         for (i = 0; DIM_NAMES[i]; i++)
+            if (strcmp(d, DIM_NAMES[i]) == 0) break;
+         if (DIM_NAMES[i] == NULL || t->ndims >= TALLY_DIMS_MAX) return (-1);
+         t->dim[t->ndims++] = i;
+         SPEC_DIMS |= 1 << i;
+      }
+      if (t->ndims == 0) return (-1);
+   }
+   free(spec);
+   return (NSPECS ? 0 : -1);
+}
+
+int
+tally_by_count(void)
+{
+   return (NSPECS);
+}
+
+// tally_by_init() - Age bands are relative to <now>; the size dimension uses the +tally
+// buckets (<bucket_size>[0..nbuckets-1], then the overflow bucket).
+
+void
+tally_by_init(time_t now, int nbuckets, unsigned long long *bucket_size)
+{
+   NOW = now;
+   NBUCKETS = nbuckets;
+   BUCKET_SIZE = bucket_size;
+}
+
+// tally_by_dir() - Worker <w_id> is now scanning <relpathdir>; note its top-level directory,
+// the first <len> bytes of it (see dir_root() in pwalk.c).
+
+void
+tally_by_dir(int w_id, const char *relpathdir, size_t len)
+{
+   if (!(SPEC_DIMS & (1 << DIM_TOP))) return;
+   if (TOP[w_id] == NULL && (TOP[w_id] = malloc(PATH_MAX)) == NULL) abend("+tally_by: cannot malloc!");
+
+   if (len >= PATH_MAX) len = PATH_MAX - 1;
+   memcpy(TOP[w_id], relpathdir, len);
+   TOP[w_id][len] = '\0';
+}
+
+static int
+age_band(time_t t)
+{
+   long long days;
+   int i;
+
+   if (t > NOW) return (0);
+   days = (NOW - t) / 86400;
+   for (i = 1; i < AGE_BANDS - 1 && days >= AGE_DAYS[i]; i++) ;
+   return (i);
+}
+
+// key_put() - Append one dimension value to a key, and its '\t' terminator.
+
+static char *
+key_put(char *k, char *end, const char *v, size_t len)
+{
+   for ( ; len && k < end - 1; len--, v++)		// No tabs or newlines in keys ...
+      *k++ = ((unsigned char) *v < ' ') ? '?' : *v;
+   *k++ = '\t';
+   return (k);
+}
+
+static void
+table_grow(T_TABLE *t)
+{
+   T_ENT **old = t->tab, *e, *en;
+   unsigned long old_size = t->size, i;
+
+   t->size = old_size ? 2 * old_size : 256;
+   if ((t->tab = calloc(t->size, sizeof(T_ENT *))) == NULL) abend("+tally_by: cannot calloc table!");
+   for (i = 0; i < old_size; i++)
+      for (e = old[i]; e; e = en) {
+         en = e->next;
+         e->next = t->tab[e->hash & (t->size - 1)];
+         t->tab[e->hash & (t->size - 1)] = e;
+      }
+   free(old);
+}
+
+// table_add() - Add counts to <key> (of <len> bytes) in <t>.
+
+static void
+table_add(T_TABLE *t, const char *key, size_t len, count_64 count, count_64 size, count_64 space)
+{
+   T_ENT *e, **b;
+   unsigned h = fnv1a(key, len);
+
+   if (t->n >= t->size) table_grow(t);
+   b = &t->tab[h & (t->size - 1)];
+   for (e = *b; e; e = e->next)
+      if (e->hash == h && memcmp(e->key, key, len) == 0 && e->key[len] == '\0') break;
+   if (e == NULL) {
+      if ((e = malloc(sizeof(T_ENT) + len)) == NULL) abend("+tally_by: cannot malloc entry!");
+      memcpy(e->key, key, len);
+      e->key[len] = '\0';
+      e->hash = h;
+      e->count = e->size = e->space = 0;
+      e->next = *b;
+      *b = e;
+      t->n += 1;
+   }
+   e->count += count;
+   e->size += size;
+   e->space += space;
+}
+
+// tally_by_file() - Count regular file <name> (<sb>, in +tally size <bucket>, occupying
+// <space> bytes) into each <spec>.
+
+void
+tally_by_file(int w_id, const char *name, struct stat *sb, int bucket, unsigned long long space)
+{
+   char key[PATH_MAX + 128], num[32], ext[EXT_MAX+1], *k, *end = key + sizeof(key);
+   const char *dot;
+   size_t len;
+   int s, d, n;
+
+   for (s = 0; s < NSPECS; s++) {
+      k = key;
+      for (d = 0; d < SPECS[s].ndims; d++) {
+         switch (SPECS[s].dim[d]) {
+         case DIM_UID:
+            n = sprintf(num, "%u", (unsigned) sb->st_uid);
+            k = key_put(k, end, num, n);
+            break;
+         case DIM_TOP:
+            k = key_put(k, end, TOP[w_id], strlen(TOP[w_id]));
+            break;
+         case DIM_AGE:
+            n = sprintf(num, "%d", age_band(sb->st_mtime));
+            k = key_put(k, end, num, n);
+            break;
+         case DIM_ATIME:
+            n = sprintf(num, "%d", age_band(sb->st_atime));
+            k = key_put(k, end, num, n);
+            break;
+         case DIM_EXT:
+            len = 0;
+            if ((dot = strrchr(name, '.')) != NULL && dot != name && strlen(dot+1) <= EXT_MAX)
+               for (dot++; *dot; dot++) ext[len++] = tolower((unsigned char) *dot);
+            k = key_put(k, end, ext, len);
+            break;
+         case DIM_SIZE:
+            n = sprintf(num, "%d", bucket);
+            k = key_put(k, end, num, n);
+            break;
+         }
+      }
+      table_add(&SPECS[s].shard[w_id], key, k - key, 1, sb->st_size, space);
+   }
+}
+
+// @@@ SECTION: Output @@@
+
+static T_SPEC *SORT_SPEC;		// qsort() context
+
+// key_cmp() - Dimension by dimension; numerically where the dimension is a number.
+
+static int
+key_cmp(const void *a, const void *b)
+{
+   const char *ka = (*(T_ENT **) a)->key, *kb = (*(T_ENT **) b)->key;
+   unsigned long long va, vb;
+   size_t la, lb;
+   int d, rc;
+
+   for (d = 0; d < SORT_SPEC->ndims; d++) {
+      la = strchr(ka, '\t') - ka;
+      lb = strchr(kb, '\t') - kb;
+      if (DIM_NUMERIC[SORT_SPEC->dim[d]]) {
+         va = strtoull(ka, NULL, 10);
+         vb = strtoull(kb, NULL, 10);
+         if (va != vb) return (va < vb ? -1 : 1);
+      } else {
+         if ((rc = memcmp(ka, kb, la < lb ? la : lb)) != 0) return (rc);
+         if (la != lb) return (la < lb ? -1 : 1);
+      }
+      ka += la + 1;
+      kb += lb + 1;
+   }
+   return (0);
+}
+
+// tally_size_label() - The +tally bucket label for <bsize>, eg: "<= 4 KiB".
+
+void
+tally_size_label(char *buf, unsigned long long bsize, const char *relop)
+{
+   sprintf(buf, "%s %llu %s", relop,
+      (bsize < (1ULL << 20)) ? (bsize >> 10) :
+         (bsize < (1ULL << 30)) ? (bsize >> 20) :
+            (bsize < (1ULL << 40)) ? (bsize >> 30) :
+               (bsize >> 40),
+      bsize < (1ULL << 20) ? "KiB" :
+         bsize < (1ULL << 30) ? "MiB" :
+            bsize < (1ULL << 40) ? "GiB" :
+               "TiB");
+}
+
+// csv_str() - <s> (<len> bytes) as a quoted CSV field.
+
+static void
+csv_str(FILE *f, const char *s, size_t len)
+{
+   fputc('"', f);
+   for ( ; len; len--, s++) {
+      if (*s == '"') fputc('"', f);
+      fputc(*s, f);
+   }
+   fputc('"', f);
+}
+
+static void
+put_value(FILE *f, int dim, const char *v, size_t len)
+{
+   char label[64];
+   int i = atoi(v);
+
+   switch (dim) {
+   case DIM_AGE:
+   case DIM_ATIME:
+      fprintf(f, "\"%s\"", AGE_LABELS[i]);
+      break;
+   case DIM_SIZE:
+      if (i >= NBUCKETS) tally_size_label(label, BUCKET_SIZE[NBUCKETS-1], ">");
+      else tally_size_label(label, BUCKET_SIZE[i], BUCKET_SIZE[i] ? "<=" : "=");
+      fprintf(f, "\"%s\"", label);
+      break;
+   case DIM_UID:
+      fwrite(v, 1, len, f);
+      break;
+   default:
+      csv_str(f, v, len);
+   }
+}
+
+// tally_by_output() - Merge workers' counts and write each <spec>'s CSV (columns as for
+// pwalk_tally.csv, with one per dimension in place of Bucket).  Returns 0, or -1 if a
+// CSV cannot be written.
+
+int
+tally_by_output(const char *outdir, const char *tag, int nworkers)
+{
+   char ofile[PATH_MAX+64];
+   T_TABLE all;
+   T_ENT *e, **rows;
+   count_64 tcount, tsize, tspace;
+   const char *k;
+   size_t len;
+   unsigned long i, n;
+   int s, w, d, rc = 0;
+   FILE *f;
+
+   for (s = 0; s < NSPECS; s++) {
+      memset(&all, 0, sizeof(all));
+      tcount = tsize = tspace = 0;
+      for (w = 0; w < nworkers; w++)
+         for (i = 0; i < SPECS[s].shard[w].size; i++)
+            for (e = SPECS[s].shard[w].tab[i]; e; e = e->next) {
+               table_add(&all, e->key, strlen(e->key), e->count, e->size, e->space);
+               tcount += e->count; tsize += e->size; tspace += e->space;
+            }
+
+      if ((rows = malloc((all.n + 1) * sizeof(T_ENT *))) == NULL) abend("+tally_by: cannot malloc rows!");
+      for (n = i = 0; i < all.size; i++)
+         for (e = all.tab[i]; e; e = e->next) rows[n++] = e;
+      SORT_SPEC = &SPECS[s];
+      qsort(rows, n, sizeof(T_ENT *), key_cmp);
+
+      sprintf(ofile, "%s%cpwalk_tally_%s.csv", outdir, PATHSEPCHR, SPECS[s].spec);
+      if ((f = fopen(ofile, "w")) == NULL) { rc = -1; goto next; }
+      fprintf(f, "Tag");
+      for (d = 0; d < SPECS[s].ndims; d++) fprintf(f, ",%s", DIM_NAMES[SPECS[s].dim[d]]);
+      fprintf(f, ",Count,Count%%,sum(Size),Size%%,sum(Space),Space%%,Inflation\n");
+      for (i = 0; i < n; i++) {
+         e = rows[i];
+         fprintf(f, "%s", tag);
+         for (k = e->key, d = 0; d < SPECS[s].ndims; d++, k += len + 1) {
+            len = strchr(k, '\t') - k;
+            fputc(',', f);
+            put_value(f, SPECS[s].dim[d], k, len);
+         }
+         fprintf(f, ",%llu,%04.02f,%llu,%04.02f,%llu,%04.02f,%06.04f\n",
+            e->count, tcount ? 100. * e->count / tcount : 0.,
+            e->size, tsize ? 100. * e->size / tsize : 0.,
+            e->space, tspace ? 100. * e->space / tspace : 0.,
+            e->size ? e->space / (double) e->size : 0.);
+      }
+      fprintf(f, "%s", tag);
+      for (d = 0; d < SPECS[s].ndims; d++) fprintf(f, ",\"%s\"", d ? "" : "TOTALS");
+      fprintf(f, ",%llu,%04.02f,%llu,%04.02f,%llu,%04.02f,%06.04f\n",
+         tcount, 100., tsize, 100., tspace, 100., tsize ? tspace / (double) tsize : 0.);
+      if (fclose(f) != 0) rc = -1;
+next:
+      free(rows);
+      for (i = 0; i < all.size; i++)
+         for (e = all.tab[i]; e; e = all.tab[i]) { all.tab[i] = e->next; free(e); }
+      free(all.tab);
+   }
+   return (rc);
+}
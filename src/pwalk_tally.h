@@ -0,0 +1,37 @@
+#ifndef PWALK_TALLY_H
+#define PWALK_TALLY_H 1
+
+// pwalk_tally.h - +tally_by= support; +tally histograms along other dimensions.
+//
+// +tally counts regular files into size buckets.  +tally_by=<spec>[,<spec> ...] adds one
+// more histogram per <spec>, each written to its own pwalk_tally_<spec>.csv.  A <spec> is
+// one dimension, or several joined by '+' for a histogram over their combinations:
+//	uid	- file owner's uid
+//	top	- top-level directory (first level below each <directory> argument)
+//	age	- mtime age band, relative to the start of the run
+//	atime	- atime age band, likewise
+//	ext	- file name extension (lowercase, after the last '.')
+//	size	- the +tally size bucket
+// eg: +tally_by=uid,ext,top+age
+//
+// Each worker counts into its own hash table per <spec>, keyed by the file's values along
+// those dimensions; the tables are merged at the end, as +tally merges its WS counters,
+// and each CSV row is one key, sorted dimension by dimension.
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#define TALLY_BY_MAX 8			// <spec>s per run
+#define TALLY_DIMS_MAX 4		// Dimensions per <spec>
+
+// Forward declarations ...
+int tally_by_parse(char *spec);
+int tally_by_count(void);
+void tally_by_init(time_t now, int nbuckets, unsigned long long *bucket_size);
+void tally_by_dir(int w_id, const char *relpathdir, size_t top_len);
+void tally_by_file(int w_id, const char *name, struct stat *sb, int bucket, unsigned long long space);
+int tally_by_output(const char *outdir, const char *tag, int nworkers);
+void tally_size_label(char *buf, unsigned long long bsize, const char *relop);
+
+#endif // PWALK_TALLY_H
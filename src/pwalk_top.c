@@ -0,0 +1,233 @@
+// pwalk_top.c - +top= support; the N largest/oldest/widest/deepest, by per-worker heaps.
+// See pwalk_top.h for the metrics and outputs.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "pwalk.h"
+#include "pwalk_top.h"
+
+#define M_SIZE 0
+#define M_PSIZE 1
+#define M_MTIME 2
+#define M_ATIME 3
+#define M_ENTRIES 4
+#define M_DEPTH 5
+
+static const char *M_NAMES[] = { "size", "psize", "mtime", "atime", "entries", "depth", NULL };
+static const int M_NEGATED[] = { 0, 0, 1, 1, 0, 0 };	// Key is -value (oldest ranks highest)
+
+typedef struct {
+   long long key;			// Higher ranks higher
+   char *path;
+} H_ENT;
+
+typedef struct {
+   H_ENT *ent;				// Min-heap on key; ent[0] is the least kept
+   unsigned long n;
+} HEAP;
+
+typedef struct {
+   int metric;
+   unsigned long limit;			// <N>
+   HEAP heap[MAX_WORKERS+1];		// Per-worker
+} TOP_SPEC;
+
+static TOP_SPEC SPECS[TOP_MAX];
+static int NSPECS = 0;
+static int FILE_METRICS = 0;		// Mask of metrics top_file() looks at
+static int BLOCK_SIZE = 1024;
+
+static const char *CURDIR[MAX_WORKERS+1];	// Worker's current directory (its WDAT.DirPath)
+static long long DEPTH[MAX_WORKERS+1];	// ... and its depth below its <directory> argument
+
+// top_parse() - Add one <N>:<metric> (or a comma-separated list); 0 if OK, -1 if not.
+
+int
+top_parse(char *spec)
+{
+   char *s, *m, *save, *end;
+   unsigned long n;
+   int i, j;
+
+   spec = strdup(spec);
+   for (s = strtok_r(spec, ",", &save); s; s = strtok_r(NULL, ",", &save)) {
+      n = strtoul(s, &end, 10);
+      if (end == s || *end != ':' || n == 0 || NSPECS >= TOP_MAX) return (-1);
+      m = end + 1;
+      for (i = 0; M_NAMES[i]; i++)
+         if (strcmp(m, M_NAMES[i]) == 0) break;
+      if (M_NAMES[i] == NULL) return (-1);
+      for (j = 0; j < NSPECS; j++)
+         if (SPECS[j].metric == i) return (-1);	// One pwalk_top_<metric>.csv each
+      SPECS[NSPECS].metric = i;
+      SPECS[NSPECS].limit = n;
+      NSPECS += 1;
+      if (i != M_ENTRIES) FILE_METRICS |= 1 << i;
+   }
+   free(spec);
+   return (NSPECS ? 0 : -1);
+}
+
+int
+top_count(void)
+{
+   return (NSPECS);
+}
+
+// top_init() - <st_block_size> is the -bs= unit of st_blocks, for psize.
+
+void
+top_init(int st_block_size)
+{
+   BLOCK_SIZE = st_block_size;
+}
+
+// top_dir() - Worker <w_id> is now scanning <relpathdir>, which must stay put until its
+// next top_dir(); work out its depth below its first <root_len> bytes (see dir_root() in
+// pwalk.c) for entries in it.
+
+void
+top_dir(int w_id, const char *relpathdir, size_t root_len)
+{
+   const char *p;
+   long long depth = 0;
+
+   CURDIR[w_id] = relpathdir;
+   if (!(FILE_METRICS & (1 << M_DEPTH))) return;
+
+   for (p = relpathdir + root_len; *p; p++)	// Count the components after its <directory> arg
+      if (*p != PATHSEPCHR && (p == relpathdir + root_len || p[-1] == PATHSEPCHR)) depth += 1;
+   DEPTH[w_id] = depth;
+}
+
+// heap_offer() - Keep <key> in <t>'s heap for <w_id> if it ranks in the top <N> so far;
+// <dir> and <name> (or NULL) make its path, built only if it goes in.
+
+static void
+heap_offer(TOP_SPEC *t, int w_id, long long key, const char *dir, const char *name)
+{
+   HEAP *h = &t->heap[w_id];
+   H_ENT e, *a;
+   unsigned long i, c;
+   size_t len;
+
+   if (h->n == t->limit && key <= h->ent[0].key) return;	// The usual case
+   if (h->ent == NULL && (h->ent = malloc(t->limit * sizeof(H_ENT))) == NULL)
+      abend("+top: cannot malloc heap!");
+
+   len = strlen(dir);
+   if ((e.path = malloc(len + (name ? strlen(name) + 2 : 1))) == NULL) abend("+top: cannot malloc path!");
+   memcpy(e.path, dir, len + 1);
+   if (name) {
+      if (len && dir[len-1] != PATHSEPCHR) e.path[len++] = PATHSEPCHR;
+      strcpy(e.path + len, name);
+   }
+   e.key = key;
+
+   a = h->ent;
+   if (h->n < t->limit) {		// Sift up from the end ...
+      for (i = h->n++; i > 0 && a[(i-1)/2].key > key; i = (i-1)/2) a[i] = a[(i-1)/2];
+   } else {				// Replace the least; sift down ...
+      free(a[0].path);
+      for (i = 0; (c = 2*i + 1) < h->n; i = c) {
+         if (c + 1 < h->n && a[c+1].key < a[c].key) c += 1;
+         if (a[c].key >= key) break;
+         a[i] = a[c];
+      }
+   }
+   a[i] = e;
+}
+
+// top_file() - Offer a selected() dirent in the current directory to the file metrics.
+
+void
+top_file(int w_id, const char *name, struct stat *sb)
+{
+   TOP_SPEC *t;
+   long long key;
+   int s;
+
+   if (FILE_METRICS == 0) return;
+   for (s = 0; s < NSPECS; s++) {
+      t = &SPECS[s];
+      if (t->metric == M_ENTRIES) continue;
+      if (t->metric == M_DEPTH) key = DEPTH[w_id] + 1;
+      else if (!S_ISREG(sb->st_mode)) continue;
+      else if (t->metric == M_SIZE) key = sb->st_size;
+      else if (t->metric == M_PSIZE) key = (long long) sb->st_blocks * BLOCK_SIZE;
+      else if (t->metric == M_MTIME) key = -(long long) sb->st_mtime;
+      else key = -(long long) sb->st_atime;
+      heap_offer(t, w_id, key, CURDIR[w_id], name);
+   }
+}
+
+// top_entries() - The current directory's scan is over; it had <nentries> entries.
+
+void
+top_entries(int w_id, unsigned long long nentries)
+{
+   int s;
+
+   for (s = 0; s < NSPECS; s++)
+      if (SPECS[s].metric == M_ENTRIES) heap_offer(&SPECS[s], w_id, (long long) nentries, CURDIR[w_id], NULL);
+}
+
+static int
+ent_cmp(const void *a, const void *b)
+{
+   const H_ENT *ea = a, *eb = b;
+
+   if (ea->key != eb->key) return (ea->key > eb->key ? -1 : 1);
+   return (strcmp(ea->path, eb->path));
+}
+
+// top_output() - Merge the workers' heaps and write each pwalk_top_<metric>.csv; 0 if OK.
+
+int
+top_output(const char *outdir, int nworkers)
+{
+   char ofile[PATH_MAX+64];
+   H_ENT *all;
+   const char *s;
+   unsigned long i, n;
+   int t, w, rc = 0;
+   FILE *f;
+
+   for (t = 0; t < NSPECS; t++) {
+      for (n = 0, w = 0; w < nworkers; w++) n += SPECS[t].heap[w].n;
+      if ((all = malloc((n + 1) * sizeof(H_ENT))) == NULL) abend("+top: cannot malloc merge!");
+      for (n = 0, w = 0; w < nworkers; w++) {
+         if (SPECS[t].heap[w].n == 0) continue;
+         memcpy(all + n, SPECS[t].heap[w].ent, SPECS[t].heap[w].n * sizeof(H_ENT));
+         n += SPECS[t].heap[w].n;
+      }
+      qsort(all, n, sizeof(H_ENT), ent_cmp);
+      if (n > SPECS[t].limit) n = SPECS[t].limit;
+
+      sprintf(ofile, "%s%cpwalk_top_%s.csv", outdir, PATHSEPCHR, M_NAMES[SPECS[t].metric]);
+      if ((f = fopen(ofile, "w")) == NULL) { rc = -1; goto next; }
+      fprintf(f, "rank,%s,path\n", M_NAMES[SPECS[t].metric]);
+      for (i = 0; i < n; i++) {
+         fprintf(f, "%lu,%lld,\"", i + 1, M_NEGATED[SPECS[t].metric] ? -all[i].key : all[i].key);
+         for (s = all[i].path; *s; s++) {
+            if (*s == '"') fputc('"', f);
+            fputc(*s, f);
+         }
+         fprintf(f, "\"\n");
+      }
+      if (fclose(f) != 0) rc = -1;
+next:
+      free(all);
+      for (w = 0; w < nworkers; w++) {
+         for (i = 0; i < SPECS[t].heap[w].n; i++) free(SPECS[t].heap[w].ent[i].path);
+         free(SPECS[t].heap[w].ent);
+         SPECS[t].heap[w].ent = NULL;
+         SPECS[t].heap[w].n = 0;
+      }
+   }
+   return (rc);
+}
@@ -0,0 +1,36 @@
+#ifndef PWALK_TOP_H
+#define PWALK_TOP_H 1
+
+// pwalk_top.h - +top= support; the N largest/oldest/widest/deepest, without sorting -ls output.
+//
+// +top=<N>:<metric>[,<N>:<metric> ...] keeps the <N> highest-ranked entries by <metric>:
+//	size	- regular files with the largest st_size
+//	psize	- regular files with the most space (st_blocks)
+//	mtime	- regular files with the oldest mtime
+//	atime	- regular files with the oldest atime
+//	entries	- directories with the most entries (scanned, selected or not)
+//	depth	- entries (of any type) deepest below their <directory> argument
+// eg: +top=1000:size,100:mtime
+//
+// Each worker keeps a bounded min-heap per <metric>, so an entry costs one compare with the
+// heap's least member unless it is going in; memory is O(N x workers), whatever the size of
+// the tree.  The heaps are merged after the walk, and each <metric> is written, highest
+// first, to ${OUTPUT_DIR}/pwalk_top_<metric>.csv as:
+//	rank,<metric>,path
+// where mtime and atime are epoch seconds, and depth 1 is a <directory> argument's child.
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#define TOP_MAX 6			// <metric>s per run (each at most once)
+
+// Forward declarations ...
+int top_parse(char *spec);
+int top_count(void);
+void top_init(int st_block_size);
+void top_dir(int w_id, const char *relpathdir, size_t root_len);
+void top_file(int w_id, const char *name, struct stat *sb);
+void top_entries(int w_id, unsigned long long nentries);
+int top_output(const char *outdir, int nworkers);
+
+#endif // PWALK_TOP_H
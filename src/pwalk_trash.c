@@ -0,0 +1,203 @@
+// pwalk_trash.c - -trash support; move selected files into the -target= hierarchy.
+// See pwalk_trash.h for the overall scheme.
+
+#if defined(LINUX)
+#define _GNU_SOURCE		// renameat2(), RENAME_NOREPLACE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "pwalk.h"
+#include "pwalk_trash.h"
+
+// @@@ SECTION: TARGET directories known to exist @@@
+
+typedef struct tdir {
+   struct tdir *next;
+   unsigned hash;
+   char path[1];			// Relative to TARGET (allocated to fit)
+} TDIR;
+
+static pthread_mutex_t TDIR_mutex = PTHREAD_MUTEX_INITIALIZER;
+static TDIR **TABLE = NULL;
+static unsigned long TABLE_SIZE = 0;
+static unsigned long NDIRS = 0;
+
+static int
+tdir_known(const char *path, size_t len, unsigned h)
+{
+   TDIR *d;
+   int found = 0;
+
+   pthread_mutex_lock(&TDIR_mutex);
+   for (d = TABLE[h & (TABLE_SIZE - 1)]; d; d = d->next)
+      if (d->hash == h && strncmp(d->path, path, len) == 0 && d->path[len] == '\0') { found = 1; break; }
+   pthread_mutex_unlock(&TDIR_mutex);
+   return (found);
+}
+
+static void
+table_grow(void)
+{
+   TDIR **old = TABLE, *d, *dn;
+   unsigned long old_size = TABLE_SIZE, i;
+
+   TABLE_SIZE *= 2;
+   if ((TABLE = calloc(TABLE_SIZE, sizeof(TDIR *))) == NULL) abend("-trash: cannot calloc table!");
+   for (i = 0; i < old_size; i++)
+      for (d = old[i]; d; d = dn) {
+         dn = d->next;
+         d->next = TABLE[d->hash & (TABLE_SIZE - 1)];
+         TABLE[d->hash & (TABLE_SIZE - 1)] = d;
+      }
+   free(old);
+}
+
+static void
+tdir_add(const char *path, size_t len, unsigned h)
+{
+   TDIR *d;
+
+   if ((d = malloc(sizeof(TDIR) + len)) == NULL) abend("-trash: cannot malloc directory!");
+   memcpy(d->path, path, len);
+   d->path[len] = '\0';
+   d->hash = h;
+
+   pthread_mutex_lock(&TDIR_mutex);
+   if (NDIRS >= 2 * TABLE_SIZE) table_grow();
+   d->next = TABLE[h & (TABLE_SIZE - 1)];	// A racing duplicate is harmless
+   TABLE[h & (TABLE_SIZE - 1)] = d;
+   NDIRS += 1;
+   pthread_mutex_unlock(&TDIR_mutex);
+}
+
+void
+trash_init(void)
+{
+   TABLE_SIZE = 4096;
+   if ((TABLE = calloc(TABLE_SIZE, sizeof(TDIR *))) == NULL) abend("-trash: cannot calloc table!");
+}
+
+// mkdirs() - mkdir -p the first <len> bytes of <path>, relative to <tdfd>.
+
+static int
+mkdirs(int tdfd, const char *path, size_t len)
+{
+   char dir[PATH_MAX];
+   const char *s;
+   unsigned h;
+
+   while (len && path[len-1] == PATHSEPCHR) len--;
+   if (len == 0 || (len == 1 && path[0] == '.')) return (0);	// The TARGET root itself
+   h = fnv1a(path, len);
+   if (tdir_known(path, len, h)) return (0);
+
+   if (len >= PATH_MAX) { errno = ENAMETOOLONG; return (-1); }
+   memcpy(dir, path, len);
+   dir[len] = '\0';
+   if (mkdirat(tdfd, dir, 0777) != 0 && errno != EEXIST) {
+      if (errno != ENOENT) return (-1);
+      for (s = path + len - 1; s > path && *s != PATHSEPCHR; s--) ;
+      if (mkdirs(tdfd, path, s - path) != 0) return (-1);		// Parent first ...
+      if (mkdirat(tdfd, dir, 0777) != 0 && errno != EEXIST) return (-1);
+   }
+   tdir_add(path, len, h);
+   return (0);
+}
+
+// trash_dir_open() - mkdir -p <reldir> under TARGET (<tdfd>), unless already known to
+// exist, and open it.  Returns its fd (for trash_move()), or -1 with errno set.
+
+int
+trash_dir_open(int tdfd, const char *reldir)
+{
+   if (mkdirs(tdfd, reldir, strlen(reldir)) != 0) return (-1);
+   return (openat(tdfd, reldir, O_RDONLY|O_DIRECTORY));
+}
+
+// @@@ SECTION: Moves @@@
+
+// move_rename() - renameat(), but never over an existing TARGET entry.
+
+static int
+move_rename(int sdfd, int tdfd, const char *name)
+{
+   struct stat tsb;
+
+#if defined(RENAME_NOREPLACE)
+   if (renameat2(sdfd, name, tdfd, name, RENAME_NOREPLACE) == 0) return (0);
+   if (errno != EINVAL && errno != ENOSYS) return (-1);		// Else: not on this filesystem
+#endif
+   // NOTE: Not atomic, but only another writer into TARGET can slip in between ...
+   if (fstatat(tdfd, name, &tsb, AT_SYMLINK_NOFOLLOW) == 0) { errno = EEXIST; return (-1); }
+   return (renameat(sdfd, name, tdfd, name));
+}
+
+// move_copy() - Copy <name> from SOURCE to TARGET, for EXDEV; the caller unlinks it.
+
+static int
+move_copy(int sdfd, int tdfd, const char *name, struct stat *sb, char *buf, size_t bufsize)
+{
+   struct timespec times[2];
+   ssize_t n, w, off;
+   int fds, fdt, rc = -1, e;
+
+   if (S_ISLNK(sb->st_mode)) {
+      if ((n = readlinkat(sdfd, name, buf, bufsize - 1)) < 0) return (-1);
+      buf[n] = '\0';
+      if (symlinkat(buf, tdfd, name) != 0) return (-1);
+      (void) fchownat(tdfd, name, sb->st_uid, sb->st_gid, AT_SYMLINK_NOFOLLOW);
+      return (0);
+   }
+   if (!S_ISREG(sb->st_mode)) { errno = EXDEV; return (-1); }
+
+   if ((fds = openat(sdfd, name, O_RDONLY|O_NOFOLLOW)) < 0) return (-1);
+   if ((fdt = openat(tdfd, name, O_WRONLY|O_CREAT|O_EXCL|O_NOFOLLOW, 0600)) < 0) {
+      e = errno; close(fds); errno = e;
+      return (-1);
+   }
+   while ((n = read(fds, buf, bufsize)) > 0) {
+      for (off = 0; off < n; off += w)
+         if ((w = write(fdt, buf + off, n - off)) < 0) goto out;
+   }
+   if (n < 0) goto out;
+   (void) fchown(fdt, sb->st_uid, sb->st_gid);		// Only root can give files away
+   if (fchmod(fdt, sb->st_mode & 07777) != 0) goto out;
+   times[0] = sb->st_atimespec;
+   times[1] = sb->st_mtimespec;
+   if (futimens(fdt, times) != 0) goto out;
+   rc = 0;
+out:
+   e = errno;
+   close(fds);
+   if (close(fdt) != 0 && rc == 0) { rc = -1; e = errno; }
+   if (rc) unlinkat(tdfd, name, 0);		// No partial copies left behind
+   errno = e;
+   return (rc);
+}
+
+// trash_move() - Move <name> (<sb> from its lstat()) from the SOURCE directory <sdfd> to
+// the same name in the TARGET directory <tdfd> (from trash_dir_open()).  <buf> is scratch
+// for a copy.  Sets <how> and returns 0, or returns -1 with errno set (EEXIST: TARGET
+// already has <name>).
+
+int
+trash_move(int sdfd, int tdfd, const char *name, struct stat *sb, char *buf, size_t bufsize, int *how)
+{
+   *how = TRASH_RENAMED;
+   if (move_rename(sdfd, tdfd, name) == 0) return (0);
+   if (errno != EXDEV) return (-1);
+
+   *how = TRASH_COPIED;
+   if (move_copy(sdfd, tdfd, name, sb, buf, bufsize) != 0) return (-1);
+   if (unlinkat(sdfd, name, 0) != 0) return (-1);
+   return (0);
+}
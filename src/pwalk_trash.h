@@ -0,0 +1,30 @@
+#ifndef PWALK_TRASH_H
+#define PWALK_TRASH_H 1
+
+// pwalk_trash.h - -trash support; move selected files into the -target= hierarchy.
+//
+// Each selected non-directory SOURCE/<relpath> is renameat() to TARGET/<relpath>, never
+// replacing anything already there (RENAME_NOREPLACE where the platform has it).  The
+// TARGET directory it goes into is made first, mkdir -p style, but once per SOURCE
+// directory scanned: on the first move from each directory, the caller gets the TARGET
+// directory from trash_dir_open(), and moves every file by name between the two open
+// directories.  The TARGET directories known to exist are remembered in a table shared by
+// all workers, so a directory's ancestors are not looked at again either.  mkdirat() is
+// tried first; only when it fails with ENOENT is the parent made, recursively.
+//
+// When SOURCE and TARGET are on different filesystems, rename fails with EXDEV and the
+// file is copied instead (data, mode, owner, times), then unlinked.  Symlinks are
+// re-created; other file types cannot be moved across filesystems.
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#define TRASH_RENAMED 0			// trash_move() <how>
+#define TRASH_COPIED 1			// ... copied and unlinked (EXDEV)
+
+// Forward declarations ...
+void trash_init(void);
+int trash_dir_open(int tdfd, const char *reldir);
+int trash_move(int sdfd, int tdfd, const char *name, struct stat *sb, char *buf, size_t bufsize, int *how);
+
+#endif // PWALK_TRASH_H
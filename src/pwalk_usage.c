@@ -0,0 +1,288 @@
+// pwalk_usage.c - +usage support; per-owner and per-group usage accounting, in one walk.
+// See pwalk_usage.h for the scheme and outputs.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <pthread.h>
+#include <pwd.h>
+#include <grp.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "pwalk.h"
+#include "pwalk_usage.h"
+
+#define U_UID 0				// Tables, by what they are keyed on
+#define U_GID 1
+#define U_UID_TOP 2
+#define U_TABLES 3
+
+#define EMPTY (~0ULL)			// Key of an unused slot
+
+typedef struct {
+   unsigned long long key;		// id, or (top << 32 | uid)
+   count_64 files, dirs, others, lsize, psize;
+} U_ENT;
+
+typedef struct {
+   unsigned id;
+   char *name;
+} U_NAME;
+
+typedef struct {
+   U_ENT *slot;
+   unsigned long size, n;		// size is a power of 2; kept at most 3/4 full
+} U_TABLE;
+
+static U_TABLE TABLES[U_TABLES][MAX_WORKERS+1];	// Per-worker
+static int BY_TOP = 0;
+static int BLOCK_SIZE = 1024;
+
+// Top-level directories are numbered as first seen, under TOP_mutex; each worker keeps the
+// name and number of the last one it saw, and only looks again when that changes.
+static pthread_mutex_t TOP_mutex = PTHREAD_MUTEX_INITIALIZER;
+static char **TOPS = NULL;
+static unsigned long NTOPS = 0, TOPS_SIZE = 0;
+static char *WTOP[MAX_WORKERS+1];		// Worker's current top-level directory ...
+static unsigned long WTOP_N[MAX_WORKERS+1];	// ... and its number
+
+// usage_init() - <by_top> for +usage=top; <st_block_size> is the -bs= unit of st_blocks.
+
+void
+usage_init(int by_top, int st_block_size)
+{
+   BY_TOP = by_top;
+   BLOCK_SIZE = st_block_size;
+}
+
+// top_number() - Number of top-level directory <top> (of <len> bytes), new or not (locked).
+
+static unsigned long
+top_number(const char *top, size_t len)
+{
+   unsigned long i;
+
+   for (i = NTOPS; i > 0; i--)		// Few, and the latest is the likeliest
+      if (strncmp(TOPS[i-1], top, len) == 0 && TOPS[i-1][len] == '\0') return (i-1);
+   if (NTOPS == TOPS_SIZE) {
+      TOPS_SIZE = TOPS_SIZE ? 2 * TOPS_SIZE : 64;
+      if ((TOPS = realloc(TOPS, TOPS_SIZE * sizeof(char *))) == NULL) abend("+usage: cannot realloc!");
+   }
+   if ((TOPS[NTOPS] = malloc(len + 1)) == NULL) abend("+usage: cannot malloc!");
+   memcpy(TOPS[NTOPS], top, len);
+   TOPS[NTOPS][len] = '\0';
+   return (NTOPS++);
+}
+
+// usage_dir() - Worker <w_id> is now scanning <relpathdir>; note its top-level directory,
+// the first <len> bytes of it (see dir_root() in pwalk.c).
+
+void
+usage_dir(int w_id, const char *relpathdir, size_t len)
+{
+   if (!BY_TOP) return;
+   if (WTOP[w_id] == NULL) {
+      if ((WTOP[w_id] = malloc(PATH_MAX)) == NULL) abend("+usage: cannot malloc!");
+      WTOP[w_id][0] = '\0';
+      WTOP_N[w_id] = EMPTY;
+   }
+   if (len >= PATH_MAX) len = PATH_MAX - 1;
+   if (WTOP_N[w_id] != EMPTY && strncmp(WTOP[w_id], relpathdir, len) == 0 && WTOP[w_id][len] == '\0')
+      return;					// Same as last time
+
+   memcpy(WTOP[w_id], relpathdir, len);
+   WTOP[w_id][len] = '\0';
+   pthread_mutex_lock(&TOP_mutex);
+   WTOP_N[w_id] = top_number(relpathdir, len);
+   pthread_mutex_unlock(&TOP_mutex);
+}
+
+static unsigned long
+key_slot(unsigned long long key, unsigned long size)
+{
+   key *= 0x9E3779B97F4A7C15ULL;		// Fibonacci hashing; top bits are the best mixed
+   return ((unsigned long) (key >> 32) & (size - 1));
+}
+
+static void
+table_grow(U_TABLE *t)
+{
+   U_ENT *old = t->slot;
+   unsigned long old_size = t->size, i, j;
+
+   t->size = old_size ? 2 * old_size : 256;
+   if ((t->slot = malloc(t->size * sizeof(U_ENT))) == NULL) abend("+usage: cannot malloc table!");
+   for (i = 0; i < t->size; i++) t->slot[i].key = EMPTY;
+   for (i = 0; i < old_size; i++) {
+      if (old[i].key == EMPTY) continue;
+      for (j = key_slot(old[i].key, t->size); t->slot[j].key != EMPTY; j = (j + 1) & (t->size - 1)) ;
+      t->slot[j] = old[i];
+   }
+   free(old);
+}
+
+// table_slot() - <key>'s entry in <t>, zeroed if new.
+
+static U_ENT *
+table_slot(U_TABLE *t, unsigned long long key)
+{
+   U_ENT *e;
+   unsigned long j;
+
+   if (4 * (t->n + 1) > 3 * t->size) table_grow(t);
+   for (j = key_slot(key, t->size); ; j = (j + 1) & (t->size - 1)) {
+      e = &t->slot[j];
+      if (e->key == key) return (e);
+      if (e->key == EMPTY) break;
+   }
+   memset(e, 0, sizeof(*e));
+   e->key = key;
+   t->n += 1;
+   return (e);
+}
+
+static void
+ent_add(U_ENT *e, struct stat *sb, count_64 space)
+{
+   if (S_ISREG(sb->st_mode)) e->files += 1;
+   else if (S_ISDIR(sb->st_mode)) { e->dirs += 1; return; }
+   else e->others += 1;
+   e->lsize += sb->st_size;
+   e->psize += space;
+}
+
+// usage_file() - Count a selected() dirent of the current directory.
+
+void
+usage_file(int w_id, struct stat *sb)
+{
+   count_64 space = sb->st_blocks * BLOCK_SIZE;
+
+   ent_add(table_slot(&TABLES[U_UID][w_id], sb->st_uid), sb, space);
+   ent_add(table_slot(&TABLES[U_GID][w_id], sb->st_gid), sb, space);
+   if (BY_TOP)
+      ent_add(table_slot(&TABLES[U_UID_TOP][w_id], (unsigned long long) WTOP_N[w_id] << 32 | sb->st_uid), sb, space);
+}
+
+static int
+ent_cmp(const void *a, const void *b)
+{
+   const U_ENT *ea = a, *eb = b;
+
+   if (ea->psize != eb->psize) return (ea->psize > eb->psize ? -1 : 1);
+   if (ea->key != eb->key) return (ea->key < eb->key ? -1 : 1);
+   return (0);
+}
+
+// id_name() - User or group name of <id>, or "" if it has none.
+
+static void
+id_name(char *name, size_t size, int group, unsigned id)
+{
+   char buf64k[64*1024];
+   struct passwd pwd, *pwd_p = NULL;
+   struct group grp, *grp_p = NULL;
+
+   name[0] = '\0';
+   if (group) {
+      getgrgid_r(id, &grp, buf64k, sizeof(buf64k), &grp_p);
+      if (grp_p) snprintf(name, size, "%s", grp.gr_name);
+   } else {
+      getpwuid_r(id, &pwd, buf64k, sizeof(buf64k), &pwd_p);
+      if (pwd_p) snprintf(name, size, "%s", pwd.pw_name);
+   }
+}
+
+static int
+name_cmp(const void *a, const void *b)
+{
+   const U_NAME *na = a, *nb = b;
+
+   return (na->id < nb->id ? -1 : na->id > nb->id);
+}
+
+static void
+put_quoted(FILE *f, const char *s)
+{
+   fputc('"', f);
+   for ( ; *s; s++) {
+      if (*s == '"') fputc('"', f);
+      fputc(*s, f);
+   }
+   fputc('"', f);
+}
+
+// usage_output() - Merge the workers' tables and write each pwalk_usage_*.csv; 0 if OK.
+
+int
+usage_output(const char *outdir, int nworkers)
+{
+   static const char *fname[U_TABLES] = { "uid", "gid", "uid_top" };
+   static const char *header[U_TABLES] = { "uid,owner", "gid,group", "uid,owner,top" };
+   char ofile[PATH_MAX+64], name[256];
+   U_TABLE all;
+   U_ENT *e, *rows;
+   U_NAME *names = NULL, *nm, key;
+   unsigned long i, n, nnames = 0;
+   int t, w, rc = 0;
+   FILE *f;
+
+   for (t = 0; t < U_TABLES; t++) {
+      if (t == U_UID_TOP && !BY_TOP) continue;
+      memset(&all, 0, sizeof(all));
+      table_grow(&all);
+      for (w = 0; w < nworkers; w++) {
+         for (i = 0; i < TABLES[t][w].size; i++) {
+            if (TABLES[t][w].slot[i].key == EMPTY) continue;
+            e = table_slot(&all, TABLES[t][w].slot[i].key);
+            e->files += TABLES[t][w].slot[i].files;
+            e->dirs += TABLES[t][w].slot[i].dirs;
+            e->others += TABLES[t][w].slot[i].others;
+            e->lsize += TABLES[t][w].slot[i].lsize;
+            e->psize += TABLES[t][w].slot[i].psize;
+         }
+         free(TABLES[t][w].slot);
+         memset(&TABLES[t][w], 0, sizeof(U_TABLE));
+      }
+
+      if ((rows = malloc((all.n + 1) * sizeof(U_ENT))) == NULL) abend("+usage: cannot malloc rows!");
+      for (n = i = 0; i < all.size; i++)
+         if (all.slot[i].key != EMPTY) rows[n++] = all.slot[i];
+      qsort(rows, n, sizeof(U_ENT), ent_cmp);
+
+      sprintf(ofile, "%s%cpwalk_usage_%s.csv", outdir, PATHSEPCHR, fname[t]);
+      if ((f = fopen(ofile, "w")) == NULL) { rc = -1; goto next; }
+      fprintf(f, "%s,files,dirs,others,lsize,psize\n", header[t]);
+      for (i = 0; i < n; i++) {			// Names now, once per id ...
+         key.id = (unsigned) (rows[i].key & 0xffffffffULL);
+         if (t == U_UID_TOP && (nm = bsearch(&key, names, nnames, sizeof(U_NAME), name_cmp)) != NULL) {
+            fprintf(f, "%u,", key.id);
+            put_quoted(f, nm->name);
+         } else {
+            id_name(name, sizeof(name), t == U_GID, key.id);
+            fprintf(f, "%u,", key.id);
+            put_quoted(f, name);
+            if (t == U_UID && BY_TOP) {	// ... kept for pwalk_usage_uid_top.csv
+               if ((names = realloc(names, (nnames + 1) * sizeof(U_NAME))) == NULL) abend("+usage: cannot realloc!");
+               names[nnames].id = key.id;
+               names[nnames++].name = strdup(name);
+            }
+         }
+         if (t == U_UID_TOP) {
+            fputc(',', f);
+            put_quoted(f, TOPS[rows[i].key >> 32]);
+         }
+         fprintf(f, ",%llu,%llu,%llu,%llu,%llu\n",
+            rows[i].files, rows[i].dirs, rows[i].others, rows[i].lsize, rows[i].psize);
+      }
+      if (fclose(f) != 0) rc = -1;
+next:
+      free(rows);
+      free(all.slot);
+      if (t == U_UID && nnames) qsort(names, nnames, sizeof(U_NAME), name_cmp);
+   }
+   for (i = 0; i < nnames; i++) free(names[i].name);
+   free(names);
+   return (rc);
+}
@@ -0,0 +1,29 @@
+#ifndef PWALK_USAGE_H
+#define PWALK_USAGE_H 1
+
+// pwalk_usage.h - +usage support; per-owner and per-group usage accounting, in one walk.
+//
+// +usage totals the selected() entries per uid and per gid; +usage=top also totals them per
+// uid within each top-level directory (first level below each <directory> argument).  Each
+// worker counts into its own open-addressing hash tables, keyed by the numeric id (and, for
+// +usage=top, a small number standing for the top-level directory, looked up once per
+// directory scanned), so an entry costs one probe and a few adds.  The tables are merged
+// after the walk, and user and group names are looked up then, once per id; nothing here
+// calls getpwuid() or getgrgid() per file.
+//
+// Outputs, in ${OUTPUT_DIR}, most space first:
+//	pwalk_usage_uid.csv	- uid,owner,files,dirs,others,lsize,psize
+//	pwalk_usage_gid.csv	- gid,group,files,dirs,others,lsize,psize
+//	pwalk_usage_uid_top.csv	- uid,owner,top,files,dirs,others,lsize,psize (+usage=top)
+// As on the "S:" lines, lsize and psize are of non-directories only.
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+// Forward declarations ...
+void usage_init(int by_top, int st_block_size);
+void usage_dir(int w_id, const char *relpathdir, size_t top_len);
+void usage_file(int w_id, struct stat *sb);
+int usage_output(const char *outdir, int nworkers);
+
+#endif // PWALK_USAGE_H
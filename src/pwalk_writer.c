@@ -0,0 +1,639 @@
+// pwalk_writer.c - -writers support; worker output drained by dedicated writer thread(s).
+// See pwalk_writer.h for the overall scheme.
+
+#if defined(LINUX)
+#define _GNU_SOURCE		// fopencookie()
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <assert.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include "pwalk.h"
+#include "pwalk_writer.h"
+#include "pwalk_lat.h"
+
+#define WR_MAX_RINGS ((MAX_WORKERS+1)*8)	// Room for per-worker aux outputs, too
+#define WR_MAX_WRITERS 64
+#define WR_MAX_STYPES 8				// Sharded output types (ls, err, acl4bin, ...)
+#define WR_IDLE_NS (20*1000*1000)		// Writer sleep when idle (bounds lost wakeups)
+#define WR_STALL_NS (100*1000)			// Worker sleep waiting for a free buffer
+
+extern void abend(char *str);
+extern void fix_owner(FILE *file);
+
+// Per-writer state ...
+static struct {
+   pthread_t thread;
+   pthread_mutex_t mutex;
+   pthread_cond_t cond;
+   int sleeping;
+   unsigned long long writevs, bytes;
+   int shard_files;
+} WR[WR_MAX_WRITERS];
+
+static WR_RING *RINGS[WR_MAX_RINGS];
+static int NRINGS = 0;
+static int NWRITERS = 0;
+static int WR_STOP = 0;
+static int WR_ABEND = 0;			// wr_abend_flush() under way
+static int WR_ABEND_DONE = 0;			// ... writers done with it
+static pthread_mutex_t WR_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Shard state; SHARD[stype*NSHARDS + j] is only touched by writer j%NWRITERS ...
+typedef struct {
+   FILE *f;			// Current file (NULL until first record)
+   int seq;			// Rotation sequence number of current file
+   unsigned long long fbytes;	// Bytes written to current file
+   time_t opened;
+   WR_RING *owner;		// Ring with a record in progress, or NULL
+} WR_SHARD;
+
+static struct {
+   char ftype[16];
+   int gz;
+   char *prologue, *trailer;
+   size_t plen, tlen;
+} STYPE[WR_MAX_STYPES];
+
+static int NSTYPES = 0;
+static int NSHARDS = 0;
+static WR_SHARD *SHARD = NULL;
+static char SHARD_DIR[MAXPATHLEN+1];
+static unsigned long long SHARD_MAX_BYTES = 0;	// 0: no size-based rotation
+static int SHARD_MAX_SECS = 0;			// 0: no time-based rotation
+
+#define LOAD(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define STORE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+// wr_wake() - Nudge ring's writer if it is idle.  Signalling without the mutex can lose
+// a wakeup, but the writer's timed wait bounds the cost of that.
+
+static void
+wr_wake(WR_RING *r)
+{
+   int k = r->id % NWRITERS;
+
+   if (LOAD(&WR[k].sleeping)) pthread_cond_signal(&WR[k].cond);
+}
+
+// write_all() - writev() until every byte of iov[0..n-1] is out ...
+
+static void
+write_all(int fd, struct iovec *iov, int n, int k)
+{
+   ssize_t rc;
+   long long t_lat;
+
+   while (n > 0) {
+      LAT_BEGIN(t_lat);
+      rc = writev(fd, iov, n);
+      LAT_END(LAT_WRITE, t_lat);
+      if (rc < 0) {
+         if (errno == EINTR) continue;
+         abend("Writer thread cannot write worker output!");
+      }
+      WR[k].writevs += 1;
+      WR[k].bytes += rc;
+      while (n > 0 && (size_t) rc >= iov->iov_len) {	// Skip fully-written buffers ...
+         rc -= iov->iov_len;
+         iov++; n--;
+      }
+      if (n > 0) {					// ... and trim a partial one
+         iov->iov_base = (char *) iov->iov_base + rc;
+         iov->iov_len -= rc;
+      }
+   }
+}
+
+static void
+write_bytes(int fd, char *buf, size_t len, int k)
+{
+   struct iovec iov;
+
+   iov.iov_base = buf;
+   iov.iov_len = len;
+   write_all(fd, &iov, 1, k);
+}
+
+// @@@ SECTION: Shard files @@@
+
+// shard_open() - ${OUTPUT_DIR}/shard-JJJ-SSSS.<ftype>[.gz], with its type's prologue ...
+
+static void
+shard_open(int s, int k)
+{
+   WR_SHARD *sh = &SHARD[s];
+   int t = s / NSHARDS;
+   char ofile[MAXPATHLEN+64];
+
+   if (STYPE[t].gz) {
+      sprintf(ofile, "gzip > %s/shard-%03d-%04d.%s.gz", SHARD_DIR, s % NSHARDS, sh->seq, STYPE[t].ftype);
+      sh->f = popen(ofile, "w");
+   } else {
+      sprintf(ofile, "%s/shard-%03d-%04d.%s", SHARD_DIR, s % NSHARDS, sh->seq, STYPE[t].ftype);
+      sh->f = fopen(ofile, "wx");			// O_EXCL create
+   }
+   if (sh->f == NULL) abend("Cannot create shard output file!");
+   fix_owner(sh->f);
+   sh->fbytes = 0;
+   sh->opened = time(NULL);
+   WR[k].shard_files += 1;
+   if (STYPE[t].plen) write_bytes(fileno(sh->f), STYPE[t].prologue, STYPE[t].plen, k);
+}
+
+static void
+shard_close(int s, int k)
+{
+   WR_SHARD *sh = &SHARD[s];
+   int t = s / NSHARDS;
+
+   if (STYPE[t].tlen) write_bytes(fileno(sh->f), STYPE[t].trailer, STYPE[t].tlen, k);
+   if (STYPE[t].gz ? pclose(sh->f) : fclose(sh->f))
+      abend("Cannot close shard output file!");
+   sh->f = NULL;
+   sh->seq += 1;
+}
+
+// shard_rotate_due() - Only asked at record boundaries ...
+
+static int
+shard_rotate_due(WR_SHARD *sh)
+{
+   if (SHARD_MAX_BYTES && sh->fbytes >= SHARD_MAX_BYTES) return 1;
+   if (SHARD_MAX_SECS && (time(NULL) - sh->opened) >= SHARD_MAX_SECS) return 1;
+   return 0;
+}
+
+// wr_shards_init() - Enable -shards=<N>; call before wr_init() and wr_shard_type().
+
+void
+wr_shards_init(char *outdir, int nshards, unsigned long long max_bytes, int max_secs)
+{
+   assert(nshards > 0);
+   strncpy(SHARD_DIR, outdir, MAXPATHLEN);
+   NSHARDS = nshards;
+   SHARD_MAX_BYTES = max_bytes;
+   SHARD_MAX_SECS = max_secs;
+   SHARD = calloc(WR_MAX_STYPES * nshards, sizeof(WR_SHARD));
+   if (SHARD == NULL) abend("Cannot malloc shard table!");
+}
+
+// wr_shard_type() - Register an output type to be sharded; prologue & trailer are
+// written at the start and end of every shard file of that type (copied).
+
+void
+wr_shard_type(char *ftype, int gz, char *prologue, size_t plen, char *trailer, size_t tlen)
+{
+   assert(NSTYPES < WR_MAX_STYPES && strlen(ftype) < sizeof(STYPE[0].ftype));
+   strcpy(STYPE[NSTYPES].ftype, ftype);
+   STYPE[NSTYPES].gz = gz;
+   STYPE[NSTYPES].prologue = malloc(plen + 1);
+   STYPE[NSTYPES].trailer = malloc(tlen + 1);
+   memcpy(STYPE[NSTYPES].prologue, prologue, plen);
+   memcpy(STYPE[NSTYPES].trailer, trailer, tlen);
+   STYPE[NSTYPES].plen = plen;
+   STYPE[NSTYPES].tlen = tlen;
+   NSTYPES += 1;
+}
+
+static int
+stype_find(char *ftype)
+{
+   int t;
+
+   for (t = 0; t < NSTYPES; t++)
+      if (strcmp(STYPE[t].ftype, ftype) == 0) return (t);
+   abend("Output type was not registered for -shards!");
+   return (-1);
+}
+
+// @@@ SECTION: Writer threads @@@
+
+// ring_drain_fd() - Write consecutive unsharded buffers; returns number written.
+
+static unsigned
+ring_drain_fd(WR_RING *r, unsigned tail, unsigned head, int k)
+{
+   struct iovec iov[WR_IOV_MAX];
+   unsigned n;
+   int fd = r->full[tail % WR_RING_SEGS].fd;
+   WR_SEG *s;
+
+   // Gather consecutive buffers bound for the same fd ...
+   for (n = 0; (tail + n) != head && n < WR_IOV_MAX; n++) {
+      s = &r->full[(tail + n) % WR_RING_SEGS];
+      if (s->shard >= 0 || s->fd != fd) break;
+      iov[n].iov_base = s->buf;
+      iov[n].iov_len = s->len;
+   }
+   write_all(fd, iov, n, k);
+   return (n);
+}
+
+// ring_drain_shard() - Write consecutive buffers for one shard, unless another ring is
+// mid-record on it, or ours are the start of a record whose end isn't queued yet and the
+// worker isn't waiting on us (returns 0).  Rotates the shard file if due at the record's end.
+
+static unsigned
+ring_drain_shard(WR_RING *r, unsigned tail, unsigned head, int k)
+{
+   struct iovec iov[WR_IOV_MAX];
+   unsigned n;
+   int shard = r->full[tail % WR_RING_SEGS].shard;
+   WR_SHARD *sh = &SHARD[shard];
+   unsigned long long bytes = 0;
+   WR_SEG *s = NULL;
+
+   if (sh->owner && sh->owner != r) return (0);		// Wait for their record to end
+   for (n = 0; (tail + n) != head && n < WR_IOV_MAX; n++) {
+      s = &r->full[(tail + n) % WR_RING_SEGS];
+      if (s->shard != shard) break;
+      iov[n].iov_base = s->buf;
+      iov[n].iov_len = s->len;
+      bytes += s->len;
+   }
+   s = &r->full[(tail + n - 1) % WR_RING_SEGS];		// Last one written
+   if (!s->eor && sh->owner != r &&			// Don't take the shard mid-record ...
+         (head - tail) < WR_RING_SEGS-1 && !LOAD(&WR_STOP) && !LOAD(&WR_ABEND))
+      return (0);					// ... unless the worker needs the buffers
+   if (sh->f == NULL) shard_open(shard, k);
+   write_all(fileno(sh->f), iov, n, k);
+   sh->fbytes += bytes;
+   sh->owner = s->eor ? NULL : r;
+   if (s->eor && shard_rotate_due(sh)) shard_close(shard, k);
+   return (n);
+}
+
+// ring_drain() - Write everything queued on <r> that can be; returns number of buffers written.
+
+static int
+ring_drain(WR_RING *r, int k)
+{
+   unsigned tail, head, n, i, fh;
+   int nsegs = 0;
+
+   tail = r->full_tail;
+   head = LOAD(&r->full_head);
+   while (tail != head) {
+      if (r->full[tail % WR_RING_SEGS].shard >= 0)
+         n = ring_drain_shard(r, tail, head, k);
+      else
+         n = ring_drain_fd(r, tail, head, k);
+      if (n == 0) break;
+      // Hand buffers back; free queue can't overflow, as a ring never has more than WR_RING_SEGS ...
+      fh = r->free_head;
+      for (i = 0; i < n; i++) {
+         r->free[(fh + i) % WR_RING_SEGS] = r->full[(tail + i) % WR_RING_SEGS];
+         r->free[(fh + i) % WR_RING_SEGS].len = 0;
+      }
+      STORE(&r->free_head, fh + n);
+      tail += n;
+      STORE(&r->full_tail, tail);
+      nsegs += n;
+   }
+   return (nsegs);
+}
+
+// ring_abend() - From wr_abend_flush(): write <r>'s producer buffer as it stands, which
+// may be the rest of a record already partly written, and end an unfinished record with
+// WR_TRUNCATED; that releases its shard.  The producer may still be running, so this is
+// only best effort.
+
+static void
+ring_abend(WR_RING *r, int k)
+{
+   PW_OBUF *o = r->po;
+   WR_SHARD *sh = NULL;
+   char *buf = NULL;
+   size_t len = 0, mark = 0;
+   int fd = r->fd, s;
+
+   r->abended = 1;
+   if (o) {
+      buf = LOAD(&o->buf);
+      len = buf ? LOAD(&o->len) : 0;
+      mark = LOAD(&o->mark);
+   }
+   if (r->stype >= 0) {
+      s = r->stype * NSHARDS + r->cur;		// Where its record (if any) is going
+      sh = &SHARD[s];
+      if (len == 0 && sh->owner != r) return;
+      if (sh->f == NULL) shard_open(s, k);
+      fd = fileno(sh->f);
+   }
+   if (fd < 0 || (len == 0 && sh == NULL)) return;
+   if (len) write_bytes(fd, buf, len, k);
+   if (sh ? (mark < len || sh->owner == r) : (len && buf[len-1] != '\n')) {
+      if (len && buf[len-1] != '\n') write_bytes(fd, "\n", 1, k);
+      write_bytes(fd, WR_TRUNCATED, strlen(WR_TRUNCATED), k);
+   }
+   if (sh) sh->owner = NULL;
+}
+
+// writer_abend() - Write everything queued, then every ring's producer buffer; rings that
+// are mid-record go first, so the shards they hold are free for the others.
+
+static void
+writer_abend(int k)
+{
+   int i, n, pass;
+
+   n = LOAD(&NRINGS);
+   for (pass = 0; pass < 2; pass++) {
+      for (i = k; i < n; i += NWRITERS)
+         while (ring_drain(RINGS[i], k)) ;
+      for (i = k; i < n; i += NWRITERS) {
+         if (RINGS[i]->abended) continue;
+         if (pass == 0 && !(RINGS[i]->stype >= 0 &&
+               SHARD[RINGS[i]->stype * NSHARDS + RINGS[i]->cur].owner == RINGS[i])) continue;
+         ring_abend(RINGS[i], k);
+      }
+   }
+}
+
+// writer_thread() - Serve rings id%NWRITERS == k until wr_finish() and all rings are empty.
+
+static void *
+writer_thread(void *arg)
+{
+   int k = (int) (long) arg;
+   int i, n, stop, did;
+   struct timespec ts;
+
+   while (1) {
+      stop = LOAD(&WR_STOP);
+      if (LOAD(&WR_ABEND)) {
+         writer_abend(k);
+         break;
+      }
+      did = 0;
+      n = LOAD(&NRINGS);
+      for (i = k; i < n; i += NWRITERS)
+         did += ring_drain(RINGS[i], k);
+      if (did) continue;
+      if (stop) break;
+      // Idle; wait for a wr_wake() or timeout ...
+      pthread_mutex_lock(&WR[k].mutex);
+      STORE(&WR[k].sleeping, 1);
+      clock_gettime(CLOCK_REALTIME, &ts);
+      ts.tv_nsec += WR_IDLE_NS;
+      if (ts.tv_nsec >= 1000000000) { ts.tv_sec += 1; ts.tv_nsec -= 1000000000; }
+      pthread_cond_timedwait(&WR[k].cond, &WR[k].mutex, &ts);
+      STORE(&WR[k].sleeping, 0);
+      pthread_mutex_unlock(&WR[k].mutex);
+   }
+   // Close our shards ...
+   for (i = 0; i < NSTYPES * NSHARDS; i++)
+      if ((i % NSHARDS) % NWRITERS == k && SHARD[i].f) shard_close(i, k);
+   if (LOAD(&WR_ABEND)) __atomic_add_fetch(&WR_ABEND_DONE, 1, __ATOMIC_RELEASE);
+   return (NULL);
+}
+
+// wr_init() - Start <nwriters> writer threads; called once, before any wr_ring_open().
+// With -shards, there's no use for more writers than shards.
+
+void
+wr_init(int nwriters)
+{
+   int k;
+
+   assert(nwriters > 0);
+   NWRITERS = (nwriters > WR_MAX_WRITERS) ? WR_MAX_WRITERS : nwriters;
+   if (NSHARDS && NWRITERS > NSHARDS) NWRITERS = NSHARDS;
+   for (k = 0; k < NWRITERS; k++) {
+      assert(pthread_mutex_init(&WR[k].mutex, NULL) == 0);
+      assert(pthread_cond_init(&WR[k].cond, NULL) == 0);
+      if (pthread_create(&WR[k].thread, NULL, writer_thread, (void *) (long) k))
+         abend("Cannot create writer thread!");
+   }
+}
+
+// @@@ SECTION: Producer (worker) side @@@
+
+// wr_ring_open() - New ring for <fd>, or for shards of <ftype> if not NULL, with
+// WR_RING_SEGS-1 spare <bufsize> buffers.  The caller's current buffer (in <po>) is the
+// last of the ring's WR_RING_SEGS.
+
+WR_RING *
+wr_ring_open(int fd, char *ftype, size_t bufsize, PW_OBUF *po)
+{
+   WR_RING *r;
+   int i, k, nmine;
+
+   assert(NWRITERS > 0);
+   r = calloc(1, sizeof(*r));
+   if (r == NULL) abend("Cannot malloc writer ring!");
+   r->fd = fd;
+   r->stype = ftype ? stype_find(ftype) : -1;
+   r->po = po;
+   for (i = 0; i < WR_RING_SEGS-1; i++) {
+      r->free[i].buf = malloc(bufsize);
+      if (r->free[i].buf == NULL) abend("Cannot malloc writer ring buffer!");
+      r->free[i].size = bufsize;
+   }
+   r->free_head = WR_RING_SEGS-1;
+
+   pthread_mutex_lock(&WR_mutex);
+   if (NRINGS >= WR_MAX_RINGS) abend("Too many writer rings!");
+   r->id = NRINGS;
+   RINGS[r->id] = r;
+   STORE(&NRINGS, r->id + 1);
+   pthread_mutex_unlock(&WR_mutex);
+
+   // Start rings of the same writer on different shards of that writer's ...
+   if (r->stype >= 0) {
+      k = r->id % NWRITERS;
+      nmine = (NSHARDS - k + NWRITERS - 1) / NWRITERS;
+      r->cur = k + NWRITERS * ((r->id / NWRITERS) % nmine);
+   }
+   return (r);
+}
+
+// queue_seg() - Producer side of the full queue; can't overflow (see ring_drain()).
+
+static void
+queue_seg(WR_RING *r, char *buf, size_t len, size_t size, int eor)
+{
+   unsigned head = r->full_head;
+   WR_SEG *s = &r->full[head % WR_RING_SEGS];
+
+   s->buf = buf;
+   s->len = len;
+   s->size = size;
+   s->fd = r->fd;
+   s->shard = -1;
+   s->eor = eor;
+   r->mid_record = !eor;
+   if (r->stype >= 0) {
+      s->shard = r->stype * NSHARDS + r->cur;
+      if (eor) {					// Next record goes to our writer's next shard
+         r->cur += NWRITERS;
+         if (r->cur >= NSHARDS) r->cur = r->id % NWRITERS;
+      }
+   }
+   STORE(&r->full_head, head + 1);
+   wr_wake(r);
+}
+
+// take_free() - Next free buffer, waiting if all are in flight ...
+
+static WR_SEG *
+take_free(WR_RING *r)
+{
+   struct timespec ts = { 0, WR_STALL_NS };
+   unsigned ft = r->free_tail;
+
+   while (ft == LOAD(&r->free_head)) {
+      r->stalls += 1;
+      wr_wake(r);
+      nanosleep(&ts, NULL);
+   }
+   return (&r->free[ft % WR_RING_SEGS]);
+}
+
+// wr_submit() - Queue caller's buffer (*buf, *len) for writing and replace it with a free
+// one.  Only the ring's one producer thread may call this.  For shards, only the first
+// <mark> bytes (complete records) are queued when there are any; the rest is carried over
+// into the new buffer.
+
+void
+wr_submit(WR_RING *r, char **buf, size_t *len, size_t *size, size_t mark)
+{
+   size_t carry = 0;
+   WR_SEG *s;
+
+   if (*len == 0) return;
+   if (r->stype < 0 || mark == *len) {
+      queue_seg(r, *buf, *len, *size, 1);
+   } else if (mark == 0) {				// Record bigger than buffer
+      queue_seg(r, *buf, *len, *size, 0);
+   } else {
+      carry = *len - mark;
+      queue_seg(r, *buf, mark, *size, 1);
+   }
+   s = take_free(r);
+   if (carry) {
+      if (s->size < carry) {
+         s->buf = realloc(s->buf, carry);
+         if (s->buf == NULL) abend("Cannot grow writer ring buffer!");
+         s->size = carry;
+      }
+      memcpy(s->buf, *buf + mark, carry);
+   }
+   *buf = s->buf;
+   *size = s->size;
+   *len = carry;
+   STORE(&r->free_tail, r->free_tail + 1);
+}
+
+// @@@ SECTION: Sharded FILE* streams (for outputs written with stdio) @@@
+
+// wr_fopen() - FILE* whose bytes go to shards of <ftype> through a ring.  Caller must
+// fflush() and po_mark() *po at record boundaries, and detach the ring before fclose().
+// Only where WR_HAVE_FOPEN.
+
+#if WR_HAVE_FOPEN
+static ssize_t
+cookie_write(void *cookie, const char *buf, size_t n)
+{
+   po_write((PW_OBUF *) cookie, buf, n);
+   return (n);
+}
+
+static int
+cookie_close(void *cookie)
+{
+   po_free((PW_OBUF *) cookie);
+   free(cookie);
+   return (0);
+}
+
+#if !defined(LINUX)
+static int
+funopen_write(void *cookie, const char *buf, int n)
+{
+   return ((int) cookie_write(cookie, buf, n));
+}
+#endif
+#endif // WR_HAVE_FOPEN
+
+FILE *
+wr_fopen(char *ftype, size_t bufsize, PW_OBUF **po)
+{
+   PW_OBUF *o;
+   FILE *f = NULL;
+
+   o = malloc(sizeof(*o));
+   if (o == NULL) abend("Cannot malloc shard stream!");
+   po_init(o, NULL, bufsize);
+#if defined(LINUX)
+   cookie_io_functions_t io = { NULL, cookie_write, NULL, cookie_close };
+   f = fopencookie(o, "w", io);
+#elif WR_HAVE_FOPEN
+   f = funopen(o, NULL, funopen_write, NULL, cookie_close);
+#endif
+   if (f == NULL) abend("Cannot open shard stream!");
+   o->ring = wr_ring_open(-1, ftype, bufsize, o);
+   *po = o;
+   return (f);
+}
+
+// @@@ SECTION: Shutdown @@@
+
+// wr_finish() - Drain all rings, stop writer threads (closing shard files), and free spare
+// buffers.  Producers must have submitted their last buffers (and stopped using their
+// rings) first.
+
+void
+wr_finish(WR_STATS_T *st)
+{
+   WR_RING *r;
+   int i, k;
+
+   memset(st, 0, sizeof(*st));
+   if (NWRITERS == 0) return;
+   STORE(&WR_STOP, 1);
+   for (k = 0; k < NWRITERS; k++) {
+      pthread_cond_signal(&WR[k].cond);
+      pthread_join(WR[k].thread, NULL);
+      st->writevs += WR[k].writevs;
+      st->bytes += WR[k].bytes;
+      st->shard_files += WR[k].shard_files;
+   }
+   for (i = 0; i < NRINGS; i++) {
+      r = RINGS[i];
+      st->stalls += r->stalls;
+      while (r->free_tail != r->free_head)
+         free(r->free[r->free_tail++ % WR_RING_SEGS].buf);
+   }
+   st->nwriters = NWRITERS;
+   st->nrings = NRINGS;
+   NWRITERS = 0;
+}
+
+// wr_abend_flush() - Best effort from abend(): give writers up to 10 seconds to write
+// every ring's queued and open buffers (see writer_abend()) and close their shard files.
+
+void
+wr_abend_flush(void)
+{
+   struct timespec ts = { 0, 10*1000*1000 };
+   int k, tries;
+
+   if (NWRITERS == 0) return;
+   for (k = 0; k < NWRITERS; k++)
+      if (pthread_equal(pthread_self(), WR[k].thread)) return;	// Can't wait on ourself!
+   if (__atomic_exchange_n(&WR_ABEND, 1, __ATOMIC_ACQ_REL)) return;	// Only once
+   for (tries = 0; tries < 1000; tries++) {
+      if (LOAD(&WR_ABEND_DONE) == NWRITERS) return;
+      for (k = 0; k < NWRITERS; k++) pthread_cond_signal(&WR[k].cond);
+      nanosleep(&ts, NULL);
+   }
+}
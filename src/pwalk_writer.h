@@ -0,0 +1,94 @@
+#ifndef PWALK_WRITER_H
+#define PWALK_WRITER_H 1
+
+// pwalk_writer.h - -writers support; worker output drained by dedicated writer thread(s).
+//
+// Each worker's PW_OBUF gets a WR_RING: a small pool of large buffers and two single-
+// producer/single-consumer queues.  When the worker's buffer fills (or a flush is due)
+// the whole buffer is queued to a writer thread and a free one is taken in its place;
+// no locks, no copies.  Writer threads gather queued buffers into writev() calls and
+// hand the buffers back.  A worker only waits when all of its buffers are in flight.
+//
+// With -shards=<N>, a ring's buffers go to shard files instead of the worker's own file.
+// Shard j of each output type is only ever written by writer thread j%NWRITERS, so a
+// worker's ring (served by one writer) round-robins its records over that writer's
+// shards.  Buffers are cut at record (directory) boundaries.  A record that spans buffers
+// is held back until its last buffer is queued, and only then written, so a shard is
+// never left mid-record by a worker that stopped producing; only a record bigger than the
+// whole ring (when the worker would otherwise wait) makes the ring own its shard until the
+// record ends.  Workers submit such an open record at every record boundary, whatever
+// -flush= says (see wr_mid_record()).  Shard files rotate at record boundaries by size or
+// age.
+//
+// wr_abend_flush() has the writers write out what is queued, then each ring's producer
+// buffer (the ring's <po>) as it stands, ending any unfinished record with WR_TRUNCATED,
+// then close their shard files.
+
+#include <stdio.h>
+#include <sys/types.h>
+#include "pwalk_output.h"
+
+// Platforms where wr_fopen() can shard stdio-written outputs (.err, .acl4*) ...
+#if defined(LINUX) || defined(BSD)
+#define WR_HAVE_FOPEN 1
+#else
+#define WR_HAVE_FOPEN 0
+#endif
+
+#define WR_RING_SEGS 8			// Buffers per worker ring (power of 2)
+#define WR_IOV_MAX 64			// Max buffers per writev()
+#define WR_TRUNCATED "@ FATAL: pwalk abend; output truncated here\n"
+
+typedef struct {
+   char *buf;
+   size_t len;				// Bytes queued
+   size_t size;				// Allocated size
+   int fd;				// Destination when not sharded
+   int shard;				// Destination shard, or -1
+   int eor;				// Buffer ends at a record boundary
+} WR_SEG;
+
+typedef struct wr_ring {
+   int id;				// Ring index; also selects its writer thread
+   int fd;				// Default destination
+   int stype;				// Shard type, or -1 to write fd
+   int cur;				// Shard for next record (0..nshards-1)
+   WR_SEG full[WR_RING_SEGS];		// Worker -> writer
+   unsigned full_head, full_tail;
+   WR_SEG free[WR_RING_SEGS];		// Writer -> worker
+   unsigned free_head, free_tail;
+   unsigned long long stalls;		// Times the worker waited for a free buffer
+   int mid_record;			// Producer has queued part of a record (not its end)
+   PW_OBUF *po;				// Producer's open buffer (for wr_abend_flush())
+   int abended;				// wr_abend_flush() wrote it out
+} WR_RING;
+
+typedef struct {
+   int nwriters;
+   int nrings;
+   unsigned long long writevs;		// writev() calls
+   unsigned long long bytes;		// Bytes written
+   unsigned long long stalls;		// Worker waits for a free buffer
+   int shard_files;			// Shard files created
+} WR_STATS_T;
+
+// Forward declarations ...
+void wr_shards_init(char *outdir, int nshards, unsigned long long max_bytes, int max_secs);
+void wr_shard_type(char *ftype, int gz, char *prologue, size_t plen, char *trailer, size_t tlen);
+void wr_init(int nwriters);
+WR_RING *wr_ring_open(int fd, char *ftype, size_t bufsize, PW_OBUF *po);
+FILE *wr_fopen(char *ftype, size_t bufsize, PW_OBUF **po);
+void wr_submit(WR_RING *r, char **buf, size_t *len, size_t *size, size_t mark);
+void wr_finish(WR_STATS_T *st);
+void wr_abend_flush(void);
+
+// wr_mid_record() - True when <o>'s ring is holding a partly-queued record; the producer
+// should submit the rest at its next record boundary rather than wait for a flush.
+
+static inline int
+wr_mid_record(PW_OBUF *o)
+{
+   return (o->ring && o->ring->mid_record);
+}
+
+#endif // PWALK_WRITER_H